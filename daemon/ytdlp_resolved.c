@@ -0,0 +1,251 @@
+/*
+ * Prism yt-dlp Plugin - Resolve Daemon
+ *
+ * prism_ytdlp_resolved owns one resolver for every player process on a
+ * host: one cache, one set of rate limits and back-offs, one concurrency
+ * budget, and one extraction per media however many processes ask for it
+ * at once. Plugins configured with its socket send it their resolves and
+ * probes, and resolve in process while it is not running. Several daemons,
+ * on one host or many, each take a share of the media when plugins list
+ * them all.
+ *
+ * Each connection carries one request. A pool of workers takes turns
+ * accepting, so a slow extraction holds up only its own worker.
+ *
+ * Usage:
+ *   prism_ytdlp_resolved [--socket <path | tcp:host:port>] [--allow-remote]
+ *                        [--workers <n>] [--max-concurrent <n>]
+ *                        [--cache-capacity <n>] [--cache-ttl-ms <ms>]
+ *                        [--ytdlp <path>] [--shared-cache <name>]
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "prism_ytdlp_plugin.h"
+#include "ytdlp_internal.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define RESOLVED_WORKERS 32
+#define RESOLVED_MAX_CONCURRENT 8
+#define RESOLVED_ACCEPT_POLL_MS 250   /* Workers check for shutdown this often */
+#define RESOLVED_IO_TIMEOUT_MS 10000  /* Reading a request or writing an answer */
+
+typedef struct Options {
+    const char* socket_path;
+    bool allow_remote;
+    int workers;
+    int max_concurrent;
+    int cache_capacity;
+    int cache_ttl_ms;
+    const char* ytdlp_path;
+    const char* shared_cache;
+} Options;
+
+typedef struct Server {
+    int listen_fd;
+    PrismResolver* resolver;
+} Server;
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    s_stop = 1;
+}
+
+/* ============================================================================
+ * Workers
+ * ========================================================================== */
+
+static void serve_connection(Server* server, int fd, YtdlpArena* arena) {
+    YtdlpArenaMark mark = ytdlp_arena_mark(arena);
+
+    YtdlpDaemonRequest request;
+    if (ytdlp_daemon_read_request(fd, arena, &request, RESOLVED_IO_TIMEOUT_MS)) {
+        PrismResolvedStream pong;
+        memset(&pong, 0, sizeof(pong));
+        pong.success = true;
+
+        PrismResolvedStream* stream = request.op == YTDLP_DAEMON_PING ?
+            &pong : ytdlp_resolver_serve(server->resolver, &request);
+        if (stream) {
+            ytdlp_daemon_write_stream(fd, stream, RESOLVED_IO_TIMEOUT_MS);
+            if (stream != &pong) prism_ytdlp_free_stream(stream);
+        }
+    }
+
+    ytdlp_arena_release(arena, mark);
+}
+
+static void worker_main(void* arg) {
+    Server* server = (Server*)arg;
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) return;
+
+    while (!s_stop) {
+        struct pollfd p = { server->listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, RESOLVED_ACCEPT_POLL_MS) <= 0) continue;
+
+        /* Another worker may have taken the connection first */
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+
+        serve_connection(server, fd, &scratch->arena);
+        close(fd);
+    }
+}
+
+/* ============================================================================
+ * Main
+ * ========================================================================== */
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("\n");
+    printf("Options:\n");
+    printf("  --socket <endpoint>     Unix socket path or tcp:host:port to listen on\n");
+    printf("                          (default: $XDG_RUNTIME_DIR/prism-ytdlp.sock)\n");
+    printf("  --allow-remote          Accept a TCP address other hosts can reach; peers\n");
+    printf("                          are not authenticated (default: loopback only)\n");
+    printf("  --workers <n>           Requests served at once (default: %d)\n", RESOLVED_WORKERS);
+    printf("  --max-concurrent <n>    yt-dlp extractions run at once (default: %d)\n", RESOLVED_MAX_CONCURRENT);
+    printf("  --cache-capacity <n>    Resolved streams kept (default: 64)\n");
+    printf("  --cache-ttl-ms <ms>     Lifetime of a cached stream (default: 5 minutes)\n");
+    printf("  --ytdlp <path>          yt-dlp binary (default: auto-detect)\n");
+    printf("  --shared-cache <name>   Also use this shared memory cache segment\n");
+}
+
+static void default_socket_path(char* buf, size_t size) {
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && runtime_dir[0]) {
+        snprintf(buf, size, "%s/prism-ytdlp.sock", runtime_dir);
+    } else {
+        snprintf(buf, size, "/tmp/prism-ytdlp-%ld.sock", (long)getuid());
+    }
+}
+
+static bool parse_args(int argc, char* argv[], Options* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return false;
+        } else if (strcmp(arg, "--allow-remote") == 0) {
+            options->allow_remote = true;
+            continue;
+        } else if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        } else if (strcmp(arg, "--socket") == 0) {
+            options->socket_path = value;
+        } else if (strcmp(arg, "--workers") == 0) {
+            options->workers = atoi(value);
+        } else if (strcmp(arg, "--max-concurrent") == 0) {
+            options->max_concurrent = atoi(value);
+        } else if (strcmp(arg, "--cache-capacity") == 0) {
+            options->cache_capacity = atoi(value);
+        } else if (strcmp(arg, "--cache-ttl-ms") == 0) {
+            options->cache_ttl_ms = atoi(value);
+        } else if (strcmp(arg, "--ytdlp") == 0) {
+            options->ytdlp_path = value;
+        } else if (strcmp(arg, "--shared-cache") == 0) {
+            options->shared_cache = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    return options->workers > 0;
+}
+
+int main(int argc, char* argv[]) {
+    char socket_path[YTDLP_PATH_MAX];
+    default_socket_path(socket_path, sizeof(socket_path));
+
+    Options options = {
+        socket_path, false, RESOLVED_WORKERS, RESOLVED_MAX_CONCURRENT, 0, 0, NULL, NULL
+    };
+    if (!parse_args(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* The daemon resolves in process itself and never forwards */
+    PrismYtdlpConfig config;
+    memset(&config, 0, sizeof(config));
+    config.ytdlp_path = options.ytdlp_path;
+    config.auto_download = true;
+    config.shared_cache_name = options.shared_cache;
+    config.daemon_endpoints = "";
+    prism_ytdlp_configure(&config);
+
+    PrismYtdlpResolverConfig resolver_config;
+    memset(&resolver_config, 0, sizeof(resolver_config));
+    resolver_config.max_concurrent_resolves = options.max_concurrent;
+    resolver_config.cache_capacity = options.cache_capacity;
+    resolver_config.cache_ttl_ms = options.cache_ttl_ms;
+
+    Server server;
+    server.resolver = prism_ytdlp_create_resolver(&resolver_config);
+    if (!server.resolver) {
+        fprintf(stderr, "Failed to create resolver\n");
+        return 1;
+    }
+
+    server.listen_fd = ytdlp_daemon_listen(options.socket_path, options.allow_remote);
+    if (server.listen_fd < 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", options.socket_path,
+            errno == EADDRINUSE ? "another daemon is running" :
+            errno == EACCES ? "other hosts could connect; pass --allow-remote to permit it" :
+            strerror(errno));
+        server.resolver->vtable->destroy(server.resolver);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    YtdlpThread* threads = (YtdlpThread*)calloc((size_t)options.workers, sizeof(YtdlpThread));
+    int started = 0;
+    while (threads && started < options.workers && ytdlp_thread_start(&threads[started], worker_main, &server)) {
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Failed to start workers\n");
+        s_stop = 1;
+    } else {
+        printf("Resolving on %s with %d workers\n", options.socket_path, started);
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < started; i++) {
+        ytdlp_thread_join(threads[i]);
+    }
+    free(threads);
+
+    ytdlp_daemon_unlisten(server.listen_fd, options.socket_path);
+
+    server.resolver->vtable->destroy(server.resolver);
+    ytdlp_update_shutdown();
+    ytdlp_daemon_shutdown();
+    ytdlp_process_shutdown();
+    ytdlp_cache_dir_shutdown();
+    ytdlp_zygote_shutdown();
+
+    return started > 0 ? 0 : 1;
+}
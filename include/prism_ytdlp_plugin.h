@@ -10,6 +10,7 @@
 #define PRISM_YTDLP_PLUGIN_H
 
 #include <prism/prism_resolver.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,14 +33,114 @@ extern "C" {
 /* Plugin identifier */
 #define PRISM_YTDLP_PLUGIN_ID "com.prism.ytdlp"
 
+/* How yt-dlp is run */
+typedef enum PrismYtdlpBackend {
+    PRISM_YTDLP_BACKEND_PROCESS = 0,  /* Spawn the yt-dlp binary per extraction */
+    PRISM_YTDLP_BACKEND_PYTHON = 1,   /* Call yt_dlp in an embedded interpreter; falls back to PROCESS */
+    PRISM_YTDLP_BACKEND_ZYGOTE = 2    /* Fork a pre-imported Python process per extraction (POSIX);
+                                         falls back to PROCESS */
+} PrismYtdlpBackend;
+
+/* Why a resolve failed, from yt-dlp's error output */
+typedef enum PrismYtdlpErrorClass {
+    PRISM_YTDLP_ERROR_NONE = 0,          /* The stream succeeded */
+    PRISM_YTDLP_ERROR_UNKNOWN,           /* Not recognized */
+    PRISM_YTDLP_ERROR_RATE_LIMITED,      /* The site throttled or bot-checked requests */
+    PRISM_YTDLP_ERROR_PRIVATE,           /* Private, members-only, paid or needs a login */
+    PRISM_YTDLP_ERROR_REMOVED,           /* Deleted, terminated or never existed */
+    PRISM_YTDLP_ERROR_GEO_BLOCKED,       /* Not available in this country */
+    PRISM_YTDLP_ERROR_AGE_GATED,         /* Needs a signed-in adult account */
+    PRISM_YTDLP_ERROR_OFFLINE_LIVE,      /* Channel not live, or a live event not started yet */
+    PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN,  /* yt-dlp cannot parse the site; needs an update */
+    PRISM_YTDLP_ERROR_UNSUPPORTED,       /* No extractor handles the URL */
+    PRISM_YTDLP_ERROR_TIMEOUT,           /* The process or a request timed out */
+    PRISM_YTDLP_ERROR_NETWORK            /* DNS, connection, TLS or server errors */
+} PrismYtdlpErrorClass;
+
 /* Configuration options */
 typedef struct PrismYtdlpConfig {
     const char* ytdlp_path;       /* Custom path to yt-dlp binary (NULL for auto-detect) */
     const char* install_dir;      /* Directory to install yt-dlp if not found (NULL = temp dir) */
     bool auto_download;           /* Automatically download yt-dlp if not found (default: true) */
     int process_timeout_ms;       /* Timeout for yt-dlp process in milliseconds (default: 30000) */
+    const char* cache_dir;        /* yt-dlp cache directory shared by all runs (NULL = per-user default) */
+    int cache_dir_max_mb;         /* Size bound of cache_dir in MB (0 = 64, <0 = leave caching to yt-dlp) */
+    PrismYtdlpBackend backend;    /* How extractions run (default: PRISM_YTDLP_BACKEND_PROCESS) */
+    const char* python_library;   /* libpython for the embedded backend (NULL = search usual names) */
+    const char* python_path;      /* Directory added to sys.path to find yt_dlp (NULL = none) */
+    const char* python_executable; /* Interpreter the zygote runs (NULL = python3 on PATH) */
+    const char* release_url;      /* Base URL of yt-dlp releases, e.g. a mirror (NULL = GitHub) */
+    const char* shared_cache_name; /* Shared memory cache segment resolvers share across processes (NULL = none) */
+    int shared_cache_mb;          /* Size of the segment if this process creates it (0 = 64) */
+    const char* daemon_endpoints; /* prism_ytdlp_resolved sockets or "tcp:host:port"s, comma-separated (NULL = resolve in process) */
 } PrismYtdlpConfig;
 
+/* Runtime counters */
+typedef struct PrismYtdlpStats {
+    uint64_t resolves;                 /* Completed resolve calls */
+    uint64_t resolve_allocations;      /* Heap allocations made inside all resolve calls */
+    uint64_t last_resolve_allocations; /* Heap allocations made by the most recent resolve */
+    uint64_t heap_allocations;         /* Heap allocations made by the plugin overall */
+    uint64_t cache_hits;               /* Resolves answered from a resolver's cache */
+    uint64_t cache_misses;             /* Resolves that had to run yt-dlp */
+    uint64_t concurrency_waits;        /* Resolves that queued behind a concurrency budget */
+    uint64_t refreshes;                /* Background re-resolves of watched streams */
+    uint64_t direct_resolves;          /* Resolves and probes of direct media URLs, which skip yt-dlp */
+    uint64_t deadline_misses;          /* Resolves that ran out of their options->timeout_ms */
+    uint64_t stale_results;            /* Of those, answered from an earlier extraction */
+    uint64_t negative_hits;            /* Resolves failed from a remembered error without running yt-dlp */
+    uint64_t hedges;                   /* Second yt-dlp runs started for a slow extraction */
+    uint64_t hedge_wins;               /* Extractions answered by the second run */
+    uint64_t shared_hits;              /* Cache hits answered from the shared memory cache */
+    uint64_t shared_cache_errors;      /* Resolvers created without their shared memory cache, which could not be mapped */
+    uint64_t daemon_resolves;          /* Resolves and probes answered by the resolve daemon */
+    uint64_t daemon_fallbacks;         /* Resolves meant for the daemons that ran in process because all were down */
+    uint64_t daemon_timeouts;          /* Resolves meant for the daemons that ran in process because one took too long */
+} PrismYtdlpStats;
+
+/* Per-resolver settings; zero fields inherit the global configuration */
+typedef struct PrismYtdlpResolverConfig {
+    const char* ytdlp_path;       /* yt-dlp binary for this resolver (NULL = global path) */
+    int process_timeout_ms;       /* Timeout for yt-dlp processes (0 = global timeout) */
+    int max_concurrent_resolves;  /* Resolves allowed in flight at once (0 = unlimited) */
+    int cache_capacity;           /* Resolved streams kept (0 = default of 64, <0 = no cache) */
+    int cache_ttl_ms;             /* Lifetime of a cached stream (0 = default of 5 minutes) */
+    int refresh_margin_ms;        /* Re-resolve watched streams this long before expiry (0 = 2 minutes) */
+    int hedge_percentile;         /* Start a second run past this percentile of a host's latency (0 = never) */
+    int hedge_max_percent;        /* Second runs allowed per 100 extractions (0 = 5) */
+    const char* shared_cache_name; /* Shared memory cache segment (NULL = global setting, "" = none) */
+} PrismYtdlpResolverConfig;
+
+/* One rung of a media's format ladder, as reported by yt-dlp */
+typedef struct PrismYtdlpFormat {
+    const char* format_id;        /* yt-dlp format identifier */
+    const char* url;              /* Direct media or manifest URL */
+    const char* ext;              /* Container extension, e.g. "mp4", "webm", "m4a" */
+    const char* protocol;         /* e.g. "https", "m3u8_native", "http_dash_segments" */
+    const char* video_codec;      /* "none" for audio-only formats, NULL if unknown */
+    const char* audio_codec;      /* "none" for video-only formats, NULL if unknown */
+    const char* language;         /* Audio language (NULL if unknown) */
+    int width;
+    int height;
+    double fps;
+    double tbr;                   /* Average total bitrate in kbit/s (0 = unknown) */
+    int64_t expires_at;           /* Unix time the URL stops working (0 = unknown) */
+    const char* const* header_names;   /* HTTP headers to send when fetching `url` */
+    const char* const* header_values;
+    int header_count;
+    const char* cookies;          /* Cookie header value for `url` (NULL if none) */
+} PrismYtdlpFormat;
+
+/* Every format of one media, ordered worst to best as yt-dlp ranks them */
+typedef struct PrismYtdlpFormatList {
+    const char* original_url;
+    const char* title;
+    bool is_live;
+    double duration;              /* Seconds (0 = unknown or live) */
+    int count;
+    const PrismYtdlpFormat* formats;
+} PrismYtdlpFormatList;
+
 /*
  * Get the yt-dlp resolver factory.
  * Can be used to manually create resolvers without going through the plugin system.
@@ -59,8 +160,15 @@ PRISM_YTDLP_API const char* prism_ytdlp_get_path(void);
 
 /*
  * Download yt-dlp binary to the specified directory.
- * If install_dir is NULL, uses a platform-specific default.
+ * If install_dir is NULL, uses the configured install_dir, else a
+ * platform-specific default.
  * progress_callback is called with values 0.0-1.0 during download.
+ * An interrupted download resumes where it stopped, and the file is checked
+ * against the release's SHA-256 checksums before it is installed. Releases
+ * are kept side by side in install_dir/yt-dlp-versions, and the previous one
+ * stays on disk for yt-dlp processes still running from it.
+ * Concurrent calls for one directory share a single download, also across
+ * processes; every caller gets the progress events and the result.
  * Returns PRISM_OK on success.
  */
 PRISM_YTDLP_API PrismError prism_ytdlp_download(
@@ -75,6 +183,92 @@ PRISM_YTDLP_API PrismError prism_ytdlp_download(
  */
 PRISM_YTDLP_API void prism_ytdlp_configure(const PrismYtdlpConfig* config);
 
+/*
+ * Free a stream returned by this plugin's resolve or probe.
+ * Frees every string and header array, then the stream, the same way the
+ * Prism host releases streams it gets back from the resolver.
+ */
+PRISM_YTDLP_API void prism_ytdlp_free_stream(PrismResolvedStream* stream);
+
+/*
+ * Classify why a stream returned by this plugin failed.
+ * PRISM_YTDLP_ERROR_NONE for successful streams; stream->error keeps the
+ * message the class was derived from.
+ */
+PRISM_YTDLP_API PrismYtdlpErrorClass prism_ytdlp_error_class(const PrismResolvedStream* stream);
+
+/*
+ * Whether retrying a failure of this class later may succeed. Private,
+ * removed, geo-blocked, age-gated and unsupported media, and broken
+ * extractors, fail the same way until something else changes.
+ */
+PRISM_YTDLP_API bool prism_ytdlp_error_is_transient(PrismYtdlpErrorClass error_class);
+
+/*
+ * Short name of an error class for logs, e.g. "geo-blocked".
+ */
+PRISM_YTDLP_API const char* prism_ytdlp_error_class_name(PrismYtdlpErrorClass error_class);
+
+/*
+ * Snapshot the plugin's runtime counters.
+ */
+PRISM_YTDLP_API void prism_ytdlp_get_stats(PrismYtdlpStats* stats);
+
+/*
+ * Create a resolver with its own settings, cache partition and counters.
+ * Resolvers created through the factory use the defaults with the global
+ * configuration. config may be NULL. Destroy with the resolver vtable.
+ */
+PRISM_YTDLP_API PrismResolver* prism_ytdlp_create_resolver(const PrismYtdlpResolverConfig* config);
+
+/*
+ * Snapshot the counters of a single resolver created by this plugin.
+ */
+PRISM_YTDLP_API void prism_ytdlp_get_resolver_stats(PrismResolver* resolver, PrismYtdlpStats* stats);
+
+/*
+ * List the full format ladder of a media for adaptive switching. Uses the
+ * resolver's cached extraction when there is one, so after a resolve this
+ * does not run yt-dlp. Returns NULL on failure.
+ * The list is one allocation; release it with prism_ytdlp_free_formats().
+ */
+PRISM_YTDLP_API PrismYtdlpFormatList* prism_ytdlp_get_formats(
+    PrismResolver* resolver,
+    const char* url,
+    const PrismResolverOptions* options
+);
+
+PRISM_YTDLP_API void prism_ytdlp_free_formats(PrismYtdlpFormatList* list);
+
+/*
+ * Receives the re-resolved stream of a watch, on the resolver's refresh
+ * thread. The callback owns `stream` and releases it with
+ * prism_ytdlp_free_stream(). A failed refresh is reported with
+ * stream->success false and retried while the old URLs are still valid,
+ * unless its error class is not transient; then the watch ends.
+ */
+typedef void (*PrismYtdlpRefreshCallback)(uint64_t watch_id, PrismResolvedStream* stream, void* user_data);
+
+/*
+ * Keep a resolved stream fresh: shortly before its signed URLs expire it is
+ * resolved again in the background with the same options, and the result is
+ * passed to `callback`. The watch then follows the new URLs' expiry.
+ * Returns a watch id, or 0 when the stream's URLs carry no known expiry.
+ */
+PRISM_YTDLP_API uint64_t prism_ytdlp_watch_stream(
+    PrismResolver* resolver,
+    const PrismResolvedStream* stream,
+    const PrismResolverOptions* options,
+    PrismYtdlpRefreshCallback callback,
+    void* user_data
+);
+
+/*
+ * Stop refreshing a watched stream. Once this returns the callback is not
+ * called again for `watch_id`, unless it is called from that callback.
+ */
+PRISM_YTDLP_API void prism_ytdlp_unwatch_stream(PrismResolver* resolver, uint64_t watch_id);
+
 #ifdef __cplusplus
 }
 #endif
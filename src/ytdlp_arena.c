@@ -0,0 +1,552 @@
+/*
+ * Prism yt-dlp Plugin - Memory Management
+ *
+ * Counted allocation, per-thread scratch arenas, and copying staged resolved
+ * streams out to the heap.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
+
+/* ============================================================================
+ * Configuration
+ * ========================================================================== */
+
+#define YTDLP_ARENA_CHUNK_SIZE   (16 * 1024)
+#define YTDLP_ARENA_ALIGN        (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+#define YTDLP_BUFFER_MIN_CAP     (16 * 1024)
+
+/* Only the tail of a child's stderr is kept; chatty failures cannot grow it */
+#define YTDLP_STDERR_TAIL_SIZE   (16 * 1024)
+
+/* Scratch buffers above this size are trimmed back when the thread goes idle
+ * so one huge response does not pin memory forever. */
+#define YTDLP_SCRATCH_RETAIN_MAX (1024 * 1024)
+
+#define YTDLP_STREAM_BLOCK_MAGIC 0x59444C50u  /* "YDLP" */
+
+/* ============================================================================
+ * Counted Heap Allocation
+ * ========================================================================== */
+
+static YTDLP_THREAD_LOCAL uint64_t t_alloc_count = 0;
+
+static void count_alloc(void) {
+    t_alloc_count++;
+    ytdlp_atomic_add_u64(&g_ytdlp_stats.heap_allocations, 1);
+}
+
+void* ytdlp_malloc(size_t size) {
+    count_alloc();
+    return malloc(size);
+}
+
+void* ytdlp_calloc(size_t count, size_t size) {
+    count_alloc();
+    return calloc(count, size);
+}
+
+void* ytdlp_realloc(void* ptr, size_t size) {
+    count_alloc();
+    return realloc(ptr, size);
+}
+
+void ytdlp_free(void* ptr) {
+    free(ptr);
+}
+
+uint64_t ytdlp_thread_alloc_count(void) {
+    return t_alloc_count;
+}
+
+/* ============================================================================
+ * Arena
+ * ========================================================================== */
+
+struct YtdlpArenaChunk {
+    YtdlpArenaChunk* next;
+    size_t size;
+    size_t used;
+    /* data follows, aligned */
+};
+
+#define CHUNK_HEADER_SIZE \
+    ((sizeof(YtdlpArenaChunk) + YTDLP_ARENA_ALIGN - 1) & ~(YTDLP_ARENA_ALIGN - 1))
+
+static char* chunk_data(YtdlpArenaChunk* chunk) {
+    return (char*)chunk + CHUNK_HEADER_SIZE;
+}
+
+static size_t align_up(size_t n) {
+    return (n + YTDLP_ARENA_ALIGN - 1) & ~(YTDLP_ARENA_ALIGN - 1);
+}
+
+static YtdlpArenaChunk* chunk_create(size_t min_size) {
+    size_t size = min_size > YTDLP_ARENA_CHUNK_SIZE ? min_size : YTDLP_ARENA_CHUNK_SIZE;
+    YtdlpArenaChunk* chunk = (YtdlpArenaChunk*)ytdlp_malloc(CHUNK_HEADER_SIZE + size);
+    if (!chunk) return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void* ytdlp_arena_alloc(YtdlpArena* arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    YtdlpArenaChunk* chunk = arena->current;
+
+    /* Walk forward through chunks retained from earlier requests */
+    while (chunk && chunk->size - chunk->used < size) {
+        if (chunk->next) {
+            chunk = chunk->next;
+            chunk->used = 0;
+        } else {
+            YtdlpArenaChunk* fresh = chunk_create(size);
+            if (!fresh) return NULL;
+            chunk->next = fresh;
+            chunk = fresh;
+        }
+    }
+
+    if (!chunk) {
+        chunk = chunk_create(size);
+        if (!chunk) return NULL;
+        arena->head = chunk;
+    }
+
+    arena->current = chunk;
+    void* ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+char* ytdlp_arena_strndup(YtdlpArena* arena, const char* s, size_t len) {
+    if (!s) return NULL;
+    char* copy = (char*)ytdlp_arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+char* ytdlp_arena_strdup(YtdlpArena* arena, const char* s) {
+    if (!s) return NULL;
+    return ytdlp_arena_strndup(arena, s, strlen(s));
+}
+
+YtdlpArenaMark ytdlp_arena_mark(const YtdlpArena* arena) {
+    YtdlpArenaMark mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    return mark;
+}
+
+void ytdlp_arena_release(YtdlpArena* arena, YtdlpArenaMark mark) {
+    if (mark.chunk) {
+        arena->current = mark.chunk;
+        mark.chunk->used = mark.used;
+    } else {
+        arena->current = arena->head;
+        if (arena->head) arena->head->used = 0;
+    }
+}
+
+static void arena_destroy(YtdlpArena* arena) {
+    YtdlpArenaChunk* chunk = arena->head;
+    while (chunk) {
+        YtdlpArenaChunk* next = chunk->next;
+        ytdlp_free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+/* ============================================================================
+ * Growable Byte Buffer
+ * ========================================================================== */
+
+void ytdlp_buffer_clear(YtdlpBuffer* buf) {
+    buf->len = 0;
+    if (buf->data) buf->data[0] = '\0';
+}
+
+bool ytdlp_buffer_append(YtdlpBuffer* buf, const char* bytes, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : YTDLP_BUFFER_MIN_CAP;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char* data = (char*)ytdlp_realloc(buf->data, cap);
+        if (!data) return false;
+        buf->data = data;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, bytes, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return true;
+}
+
+char* ytdlp_buffer_reserve(YtdlpBuffer* buf, size_t min_free, size_t* avail) {
+    /* One byte is always kept for the terminator */
+    if (buf->len + min_free + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : YTDLP_BUFFER_MIN_CAP;
+        while (cap < buf->len + min_free + 1) cap *= 2;
+        char* data = (char*)ytdlp_realloc(buf->data, cap);
+        if (!data) return NULL;
+        buf->data = data;
+        buf->cap = cap;
+    }
+    buf->data[buf->len] = '\0';
+    *avail = buf->cap - buf->len - 1;
+    return buf->data + buf->len;
+}
+
+void ytdlp_buffer_commit(YtdlpBuffer* buf, size_t len) {
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void buffer_destroy(YtdlpBuffer* buf) {
+    ytdlp_free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+/* ============================================================================
+ * Bounded Ring Buffer
+ * ========================================================================== */
+
+void ytdlp_ring_clear(YtdlpRing* ring) {
+    ring->start = 0;
+    ring->len = 0;
+    ring->truncated = false;
+}
+
+char* ytdlp_ring_reserve(YtdlpRing* ring, size_t* avail) {
+    if (!ring->data) {
+        ring->cap = YTDLP_STDERR_TAIL_SIZE;
+        ring->data = (char*)ytdlp_malloc(ring->cap + 1);
+        if (!ring->data) return NULL;
+    }
+
+    size_t end = (ring->start + ring->len) % ring->cap;
+    /* Writing runs up to the physical end; past the logical end it overwrites
+     * the oldest bytes, which commit accounts for. */
+    *avail = ring->cap - end;
+    return ring->data + end;
+}
+
+void ytdlp_ring_commit(YtdlpRing* ring, size_t len) {
+    ring->len += len;
+    if (ring->len > ring->cap) {
+        size_t overflow = ring->len - ring->cap;
+        ring->start = (ring->start + overflow) % ring->cap;
+        ring->len = ring->cap;
+        ring->truncated = true;
+    }
+}
+
+void ytdlp_ring_append(YtdlpRing* ring, const char* bytes, size_t len) {
+    while (len > 0) {
+        size_t avail;
+        char* dst = ytdlp_ring_reserve(ring, &avail);
+        if (!dst) return;
+
+        size_t n = len < avail ? len : avail;
+        memcpy(dst, bytes, n);
+        ytdlp_ring_commit(ring, n);
+        bytes += n;
+        len -= n;
+    }
+}
+
+static void reverse_bytes(char* p, size_t n) {
+    for (size_t i = 0, j = n; i + 1 < j; i++, j--) {
+        char t = p[i];
+        p[i] = p[j - 1];
+        p[j - 1] = t;
+    }
+}
+
+const char* ytdlp_ring_linearize(YtdlpRing* ring) {
+    if (!ring->data) return "";
+
+    if (ring->start != 0) {
+        /* In-place rotation: the buffer is full whenever start != 0 */
+        reverse_bytes(ring->data, ring->start);
+        reverse_bytes(ring->data + ring->start, ring->cap - ring->start);
+        reverse_bytes(ring->data, ring->cap);
+        ring->start = 0;
+    }
+    ring->data[ring->len] = '\0';
+
+    const char* text = ring->data;
+    if (ring->truncated) {
+        const char* nl = memchr(text, '\n', ring->len);
+        if (nl && nl[1]) text = nl + 1;
+    }
+    return text;
+}
+
+static void ring_destroy(YtdlpRing* ring) {
+    ytdlp_free(ring->data);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* ============================================================================
+ * Thread-local Scratch
+ * ========================================================================== */
+
+static YTDLP_THREAD_LOCAL YtdlpScratch* t_scratch = NULL;
+
+static void scratch_destroy(void* ptr) {
+    YtdlpScratch* scratch = (YtdlpScratch*)ptr;
+    if (!scratch) return;
+    arena_destroy(&scratch->arena);
+    buffer_destroy(&scratch->out);
+    ring_destroy(&scratch->err);
+    ytdlp_free(scratch);
+}
+
+#ifdef _WIN32
+
+static DWORD s_scratch_fls = FLS_OUT_OF_INDEXES;
+static INIT_ONCE s_scratch_once = INIT_ONCE_STATIC_INIT;
+
+static void WINAPI scratch_fls_callback(void* ptr) {
+    scratch_destroy(ptr);
+}
+
+static BOOL CALLBACK scratch_key_init(PINIT_ONCE once, void* param, void** ctx) {
+    (void)once; (void)param; (void)ctx;
+    s_scratch_fls = FlsAlloc(scratch_fls_callback);
+    return TRUE;
+}
+
+static void scratch_register(YtdlpScratch* scratch) {
+    InitOnceExecuteOnce(&s_scratch_once, scratch_key_init, NULL, NULL);
+    if (s_scratch_fls != FLS_OUT_OF_INDEXES) {
+        FlsSetValue(s_scratch_fls, scratch);
+    }
+}
+
+#else /* POSIX */
+
+static pthread_key_t s_scratch_key;
+static pthread_once_t s_scratch_once = PTHREAD_ONCE_INIT;
+
+static void scratch_key_init(void) {
+    pthread_key_create(&s_scratch_key, scratch_destroy);
+}
+
+static void scratch_register(YtdlpScratch* scratch) {
+    pthread_once(&s_scratch_once, scratch_key_init);
+    pthread_setspecific(s_scratch_key, scratch);
+}
+
+#endif
+
+YtdlpScratch* ytdlp_scratch(void) {
+    if (!t_scratch) {
+        t_scratch = (YtdlpScratch*)ytdlp_calloc(1, sizeof(YtdlpScratch));
+        if (t_scratch) {
+            /* Destroyed with the thread so pooled callers do not leak */
+            scratch_register(t_scratch);
+        }
+    }
+    return t_scratch;
+}
+
+/* Drop oversized buffers once a request is done with them */
+static void scratch_trim(YtdlpScratch* scratch) {
+    if (scratch->out.cap > YTDLP_SCRATCH_RETAIN_MAX) buffer_destroy(&scratch->out);
+}
+
+/* ============================================================================
+ * Resolved Stream Builder
+ * ========================================================================== */
+
+typedef struct YtdlpStreamBlock {
+    PrismResolvedStream stream;  /* Must be first: free(stream) frees the block */
+    uint32_t magic;
+    PrismYtdlpErrorClass error_class;
+} YtdlpStreamBlock;
+
+/* String members, each returned in its own allocation */
+static const size_t s_string_fields[] = {
+    offsetof(PrismResolvedStream, original_url),
+    offsetof(PrismResolvedStream, direct_url),
+    offsetof(PrismResolvedStream, audio_url),
+    offsetof(PrismResolvedStream, title),
+    offsetof(PrismResolvedStream, channel),
+    offsetof(PrismResolvedStream, thumbnail_url),
+    offsetof(PrismResolvedStream, description),
+    offsetof(PrismResolvedStream, video_codec),
+    offsetof(PrismResolvedStream, audio_codec),
+    offsetof(PrismResolvedStream, cookies),
+    offsetof(PrismResolvedStream, error),
+    offsetof(PrismResolvedStream, warning),
+};
+
+#define STRING_FIELD_COUNT (sizeof(s_string_fields) / sizeof(s_string_fields[0]))
+
+static const char** string_field(PrismResolvedStream* stream, size_t i) {
+    return (const char**)((char*)stream + s_string_fields[i]);
+}
+
+void ytdlp_builder_init(YtdlpStreamBuilder* builder, YtdlpArena* arena) {
+    memset(builder, 0, sizeof(*builder));
+    builder->arena = arena;
+}
+
+void ytdlp_builder_set(YtdlpStreamBuilder* builder, const char** field, const char* value) {
+    *field = value ? ytdlp_arena_strdup(builder->arena, value) : NULL;
+}
+
+void ytdlp_builder_set_headers(
+    YtdlpStreamBuilder* builder,
+    const char* const* names,
+    const char* const* values,
+    int count
+) {
+    PrismResolvedStream* stream = &builder->stream;
+    stream->header_names = NULL;
+    stream->header_values = NULL;
+    stream->header_count = 0;
+    if (count <= 0) return;
+
+    const char** n = (const char**)ytdlp_arena_alloc(builder->arena, sizeof(const char*) * (size_t)count);
+    const char** v = (const char**)ytdlp_arena_alloc(builder->arena, sizeof(const char*) * (size_t)count);
+    if (!n || !v) return;
+
+    for (int i = 0; i < count; i++) {
+        n[i] = ytdlp_arena_strdup(builder->arena, names[i]);
+        v[i] = ytdlp_arena_strdup(builder->arena, values[i]);
+        if (!n[i] || !v[i]) return;
+    }
+
+    stream->header_names = n;
+    stream->header_values = v;
+    stream->header_count = count;
+}
+
+void ytdlp_builder_fail(YtdlpStreamBuilder* builder, const char* error) {
+    builder->stream.success = false;
+    builder->error_class = ytdlp_classify_error(error);
+    ytdlp_builder_set(builder, &builder->stream.error, error);
+}
+
+/* Heap copy of `s`; false only when out of memory */
+static bool heap_string(const char* s, const char** out) {
+    *out = NULL;
+    if (!s) return true;
+    size_t n = strlen(s) + 1;
+    char* copy = (char*)ytdlp_malloc(n);
+    if (!copy) return false;
+    memcpy(copy, s, n);
+    *out = copy;
+    return true;
+}
+
+PrismResolvedStream* ytdlp_builder_finish(YtdlpStreamBuilder* builder) {
+    PrismResolvedStream* src = &builder->stream;
+    int header_count = (src->header_names && src->header_values) ? src->header_count : 0;
+
+    YtdlpStreamBlock* block = (YtdlpStreamBlock*)ytdlp_malloc(sizeof(YtdlpStreamBlock));
+    if (!block) return NULL;
+
+    block->magic = YTDLP_STREAM_BLOCK_MAGIC;
+    block->error_class = src->success ? PRISM_YTDLP_ERROR_NONE :
+                         builder->error_class != PRISM_YTDLP_ERROR_NONE ? builder->error_class :
+                         PRISM_YTDLP_ERROR_UNKNOWN;
+
+    /* Every pointer starts NULL so a partial copy can be freed field by field */
+    PrismResolvedStream* dst = &block->stream;
+    *dst = *src;
+    for (size_t i = 0; i < STRING_FIELD_COUNT; i++) {
+        *string_field(dst, i) = NULL;
+    }
+    dst->header_names = NULL;
+    dst->header_values = NULL;
+    dst->header_count = 0;
+
+    /* available_heights is not produced by this resolver */
+    dst->available_heights = NULL;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < STRING_FIELD_COUNT; i++) {
+        ok = heap_string(*string_field(src, i), string_field(dst, i));
+    }
+
+    if (ok && header_count > 0) {
+        size_t array_size = sizeof(const char*) * (size_t)header_count;
+        dst->header_names = (const char**)ytdlp_malloc(array_size);
+        dst->header_values = (const char**)ytdlp_malloc(array_size);
+        ok = dst->header_names && dst->header_values;
+        if (ok) {
+            memset((void*)dst->header_names, 0, array_size);
+            memset((void*)dst->header_values, 0, array_size);
+            dst->header_count = header_count;
+        }
+        for (int i = 0; ok && i < header_count; i++) {
+            ok = heap_string(src->header_names[i], &dst->header_names[i]) &&
+                 heap_string(src->header_values[i], &dst->header_values[i]);
+        }
+    }
+
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (scratch) scratch_trim(scratch);
+
+    if (!ok) {
+        prism_ytdlp_free_stream(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+PRISM_YTDLP_API void prism_ytdlp_free_stream(PrismResolvedStream* stream) {
+    if (!stream) return;
+
+    /* Same layout the Prism host frees: every field is its own allocation */
+    for (size_t i = 0; i < STRING_FIELD_COUNT; i++) {
+        free((void*)*string_field(stream, i));
+    }
+    if (stream->header_names) {
+        for (int i = 0; i < stream->header_count; i++) {
+            free((void*)stream->header_names[i]);
+        }
+        free((void*)stream->header_names);
+    }
+    if (stream->header_values) {
+        for (int i = 0; i < stream->header_count; i++) {
+            free((void*)stream->header_values[i]);
+        }
+        free((void*)stream->header_values);
+    }
+    free(stream->available_heights);
+
+    free(stream);
+}
+
+PRISM_YTDLP_API PrismYtdlpErrorClass prism_ytdlp_error_class(const PrismResolvedStream* stream) {
+    if (!stream || stream->success) return PRISM_YTDLP_ERROR_NONE;
+
+    const YtdlpStreamBlock* block = (const YtdlpStreamBlock*)stream;
+    if (block->magic != YTDLP_STREAM_BLOCK_MAGIC) return PRISM_YTDLP_ERROR_UNKNOWN;
+    return block->error_class;
+}
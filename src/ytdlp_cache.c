@@ -0,0 +1,211 @@
+/*
+ * Prism yt-dlp Plugin - Resolve Cache
+ *
+ * Per-resolver LRU cache of extracted media info. Entries past their TTL
+ * are no longer served but are kept until their slot is needed, so a
+ * resolve that runs out of time can still fall back to one.
+ *
+ * Failures that would only repeat are cached as well, as the error message
+ * in place of the info, so retries of them fail without running yt-dlp.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct CacheEntry {
+    uint32_t hash;
+    char* key;
+    const YtdlpMediaInfo* info;  /* NULL for a failure */
+    char* error;                 /* Message of a failure */
+    uint64_t expires_at;
+    uint64_t last_used;
+} CacheEntry;
+
+struct YtdlpCache {
+    YtdlpMutex lock;
+    CacheEntry* entries;
+    int capacity;
+    int ttl_ms;
+    uint64_t tick;
+};
+
+/* FNV-1a */
+static uint32_t hash_key(const char* key) {
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void entry_clear(CacheEntry* entry) {
+    ytdlp_free(entry->key);
+    ytdlp_free(entry->error);
+    ytdlp_media_info_release(entry->info);
+    memset(entry, 0, sizeof(*entry));
+}
+
+YtdlpCache* ytdlp_cache_create(int capacity, int ttl_ms) {
+    if (capacity <= 0 || ttl_ms <= 0) return NULL;
+
+    YtdlpCache* cache = (YtdlpCache*)ytdlp_calloc(1, sizeof(YtdlpCache));
+    if (!cache) return NULL;
+
+    cache->entries = (CacheEntry*)ytdlp_calloc((size_t)capacity, sizeof(CacheEntry));
+    if (!cache->entries) {
+        ytdlp_free(cache);
+        return NULL;
+    }
+
+    cache->capacity = capacity;
+    cache->ttl_ms = ttl_ms;
+    ytdlp_mutex_init(&cache->lock);
+    return cache;
+}
+
+void ytdlp_cache_destroy(YtdlpCache* cache) {
+    if (!cache) return;
+
+    for (int i = 0; i < cache->capacity; i++) {
+        entry_clear(&cache->entries[i]);
+    }
+    ytdlp_mutex_destroy(&cache->lock);
+    ytdlp_free(cache->entries);
+    ytdlp_free(cache);
+}
+
+static CacheEntry* find_entry(YtdlpCache* cache, const char* key, uint32_t hash) {
+    for (int i = 0; i < cache->capacity; i++) {
+        CacheEntry* entry = &cache->entries[i];
+        if (entry->key && entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Expired entries stay until their slot is reused, for stale lookups. One
+ * whose URLs carry no expiry of their own is served stale for at most one
+ * more TTL, since nothing else says how long its URLs keep working.
+ */
+static bool entry_usable(const YtdlpCache* cache, const CacheEntry* entry, bool allow_stale) {
+    uint64_t now = ytdlp_monotonic_ms();
+    if (now < entry->expires_at) return true;
+    if (!allow_stale) return false;
+    return entry->info->expires_at || now < entry->expires_at + (uint64_t)cache->ttl_ms;
+}
+
+static const YtdlpMediaInfo* cache_lookup(YtdlpCache* cache, const char* key, bool allow_stale) {
+    if (!cache || !key) return NULL;
+
+    uint32_t hash = hash_key(key);
+    const YtdlpMediaInfo* info = NULL;
+
+    ytdlp_mutex_lock(&cache->lock);
+
+    CacheEntry* entry = find_entry(cache, key, hash);
+    if (entry && entry->info && entry_usable(cache, entry, allow_stale)) {
+        entry->last_used = ++cache->tick;
+        info = entry->info;
+        ytdlp_media_info_retain(info);
+    }
+
+    ytdlp_mutex_unlock(&cache->lock);
+    return info;
+}
+
+const YtdlpMediaInfo* ytdlp_cache_get(YtdlpCache* cache, const char* key) {
+    return cache_lookup(cache, key, false);
+}
+
+const YtdlpMediaInfo* ytdlp_cache_get_stale(YtdlpCache* cache, const char* key) {
+    return cache_lookup(cache, key, true);
+}
+
+bool ytdlp_cache_get_failure(YtdlpCache* cache, const char* key, char* error, size_t error_size) {
+    if (!cache || !key) return false;
+
+    uint32_t hash = hash_key(key);
+    bool found = false;
+
+    ytdlp_mutex_lock(&cache->lock);
+
+    CacheEntry* entry = find_entry(cache, key, hash);
+    if (entry && entry->error && ytdlp_monotonic_ms() < entry->expires_at) {
+        entry->last_used = ++cache->tick;
+        snprintf(error, error_size, "%s", entry->error);
+        found = true;
+    }
+
+    ytdlp_mutex_unlock(&cache->lock);
+    return found;
+}
+
+static char* copy_string(const char* s) {
+    size_t len = strlen(s);
+    char* copy = (char*)ytdlp_malloc(len + 1);
+    if (copy) memcpy(copy, s, len + 1);
+    return copy;
+}
+
+/* Store `info` or, when it is NULL, the failure `error` */
+static void cache_store(YtdlpCache* cache, const char* key, const YtdlpMediaInfo* info, const char* error,
+                        int max_ttl_ms) {
+    /* Copy the strings outside the lock */
+    char* key_copy = copy_string(key);
+    char* error_copy = error ? copy_string(error) : NULL;
+    if (!key_copy || (error && !error_copy)) {
+        ytdlp_free(key_copy);
+        ytdlp_free(error_copy);
+        return;
+    }
+
+    int ttl_ms = (max_ttl_ms > 0 && max_ttl_ms < cache->ttl_ms) ? max_ttl_ms : cache->ttl_ms;
+    uint32_t hash = hash_key(key);
+    uint64_t now = ytdlp_monotonic_ms();
+
+    ytdlp_media_info_retain(info);
+
+    ytdlp_mutex_lock(&cache->lock);
+
+    CacheEntry* slot = find_entry(cache, key, hash);
+    if (!slot) {
+        /* Prefer an empty or expired slot, otherwise evict the least recently used */
+        for (int i = 0; i < cache->capacity; i++) {
+            CacheEntry* entry = &cache->entries[i];
+            if (!entry->key || now >= entry->expires_at) {
+                slot = entry;
+                break;
+            }
+            if (!slot || entry->last_used < slot->last_used) {
+                slot = entry;
+            }
+        }
+    }
+
+    entry_clear(slot);
+    slot->hash = hash;
+    slot->key = key_copy;
+    slot->info = info;
+    slot->error = error_copy;
+    slot->expires_at = now + (uint64_t)ttl_ms;
+    slot->last_used = ++cache->tick;
+
+    ytdlp_mutex_unlock(&cache->lock);
+}
+
+void ytdlp_cache_put(YtdlpCache* cache, const char* key, const YtdlpMediaInfo* info, int max_ttl_ms) {
+    if (!cache || !key || !info) return;
+    cache_store(cache, key, info, NULL, max_ttl_ms);
+}
+
+void ytdlp_cache_put_failure(YtdlpCache* cache, const char* key, const char* error, int max_ttl_ms) {
+    if (!cache || !key || !error) return;
+    cache_store(cache, key, NULL, error, max_ttl_ms);
+}
@@ -0,0 +1,316 @@
+/*
+ * Prism yt-dlp Plugin - yt-dlp Cache Directory
+ *
+ * yt-dlp caches the signature and n-parameter functions it derives from the
+ * YouTube player in its --cache-dir, which saves most of the player work on
+ * later runs. The plugin points every run at one managed directory and keeps
+ * it under a size bound by pruning the least recently written files on a
+ * background thread.
+ *
+ * yt-dlp writes cache entries to a temporary file and renames it into place,
+ * so concurrent children can share the directory.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_CACHE_DIR_PRUNE_INTERVAL_MS (10 * 60 * 1000)  /* Minimum spacing of prune passes */
+#define YTDLP_CACHE_DIR_MIN_AGE_S 60                       /* Files younger than this may be in use */
+
+typedef struct CacheFile {
+    char* path;
+    uint64_t size;
+    int64_t mtime;
+} CacheFile;
+
+typedef struct CacheFileList {
+    CacheFile* files;
+    int count;
+    int capacity;
+    uint64_t total;
+} CacheFileList;
+
+typedef struct PruneJob {
+    char dir[YTDLP_PATH_MAX];
+    uint64_t max_bytes;
+} PruneJob;
+
+static YtdlpMutex s_lock = YTDLP_MUTEX_INIT;
+static char s_prepared[YTDLP_PATH_MAX];   /* Last directory known to exist */
+static YtdlpThread s_prune_thread;
+static bool s_prune_started = false;      /* s_prune_thread needs joining */
+static bool s_prune_running = false;
+static uint64_t s_last_prune_ms = 0;
+static PruneJob s_prune_job;
+
+/* ============================================================================
+ * Directories
+ * ========================================================================== */
+
+#ifdef _WIN32
+    #define PATH_SEPARATOR '\\'
+#else
+    #define PATH_SEPARATOR '/'
+#endif
+
+static bool is_separator(char c) {
+#ifdef _WIN32
+    return c == '\\' || c == '/';
+#else
+    return c == '/';
+#endif
+}
+
+static bool make_directory(const char* path) {
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(path, 0700) == 0 || (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+/* Create `dir` and any missing parents */
+static bool make_directories(const char* dir) {
+    char path[YTDLP_PATH_MAX];
+    size_t len = strlen(dir);
+    if (len == 0 || len >= sizeof(path)) return false;
+    memcpy(path, dir, len + 1);
+
+    for (size_t i = 1; i < len; i++) {
+        if (!is_separator(path[i]) || is_separator(path[i - 1])) continue;
+#ifdef _WIN32
+        if (path[i - 1] == ':') continue;  /* Drive root */
+#endif
+        path[i] = '\0';
+        make_directory(path);
+        path[i] = PATH_SEPARATOR;
+    }
+    return make_directory(path);
+}
+
+static void default_cache_dir(char* path, size_t size) {
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (base && base[0]) {
+        snprintf(path, size, "%s\\Prism\\yt-dlp-cache", base);
+    } else {
+        snprintf(path, size, "C:\\Prism\\yt-dlp-cache");
+    }
+#else
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg && xdg[0]) {
+        snprintf(path, size, "%s/prism/yt-dlp", xdg);
+    } else if (home && home[0]) {
+        snprintf(path, size, "%s/.cache/prism/yt-dlp", home);
+    } else {
+        snprintf(path, size, "/tmp/prism/yt-dlp-cache");
+    }
+#endif
+}
+
+bool ytdlp_cache_dir_prepare(const char* configured, char* dir, size_t dir_size) {
+    if (configured && configured[0]) {
+        snprintf(dir, dir_size, "%s", configured);
+    } else {
+        default_cache_dir(dir, dir_size);
+    }
+
+    ytdlp_mutex_lock(&s_lock);
+    bool ready = strcmp(s_prepared, dir) == 0;
+    ytdlp_mutex_unlock(&s_lock);
+    if (ready) return true;
+
+    if (!make_directories(dir)) return false;
+
+    ytdlp_mutex_lock(&s_lock);
+    snprintf(s_prepared, sizeof(s_prepared), "%s", dir);
+    ytdlp_mutex_unlock(&s_lock);
+    return true;
+}
+
+/* ============================================================================
+ * Pruning
+ * ========================================================================== */
+
+static void add_file(CacheFileList* list, const char* path, uint64_t size, int64_t mtime) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        CacheFile* grown = (CacheFile*)ytdlp_realloc(list->files, sizeof(CacheFile) * (size_t)capacity);
+        if (!grown) return;
+        list->files = grown;
+        list->capacity = capacity;
+    }
+
+    size_t len = strlen(path) + 1;
+    char* copy = (char*)ytdlp_malloc(len);
+    if (!copy) return;
+    memcpy(copy, path, len);
+
+    CacheFile* file = &list->files[list->count++];
+    file->path = copy;
+    file->size = size;
+    file->mtime = mtime;
+    list->total += size;
+}
+
+#ifdef _WIN32
+
+static void collect_files(CacheFileList* list, const char* dir, int depth) {
+    char pattern[YTDLP_PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+
+    do {
+        if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+
+        char path[YTDLP_PATH_MAX];
+        snprintf(path, sizeof(path), "%s\\%s", dir, entry.cFileName);
+
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (depth < 4) collect_files(list, path, depth + 1);
+            continue;
+        }
+
+        /* FILETIME counts 100 ns intervals since 1601 */
+        uint64_t ticks = ((uint64_t)entry.ftLastWriteTime.dwHighDateTime << 32) |
+                         entry.ftLastWriteTime.dwLowDateTime;
+        int64_t mtime = (int64_t)(ticks / 10000000u) - 11644473600LL;
+        uint64_t size = ((uint64_t)entry.nFileSizeHigh << 32) | entry.nFileSizeLow;
+        add_file(list, path, size, mtime);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+}
+
+static void remove_file(const char* path) {
+    DeleteFileA(path);  /* Fails harmlessly if a child has it open */
+}
+
+#else /* POSIX */
+
+static void collect_files(CacheFileList* list, const char* dir, int depth) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char path[YTDLP_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < 4) collect_files(list, path, depth + 1);
+        } else if (S_ISREG(st.st_mode)) {
+            add_file(list, path, (uint64_t)st.st_size, (int64_t)st.st_mtime);
+        }
+    }
+
+    closedir(d);
+}
+
+static void remove_file(const char* path) {
+    unlink(path);
+}
+
+#endif
+
+static int compare_oldest_first(const void* a, const void* b) {
+    int64_t ta = ((const CacheFile*)a)->mtime;
+    int64_t tb = ((const CacheFile*)b)->mtime;
+    return (ta > tb) - (ta < tb);
+}
+
+/* Delete the least recently written files until the directory is back under
+ * three quarters of its bound, so passes are not needed after every run */
+static void prune_directory(const char* dir, uint64_t max_bytes) {
+    CacheFileList list;
+    memset(&list, 0, sizeof(list));
+    collect_files(&list, dir, 0);
+
+    if (list.total > max_bytes) {
+        qsort(list.files, (size_t)list.count, sizeof(CacheFile), compare_oldest_first);
+
+        uint64_t target = max_bytes / 4 * 3;
+        int64_t cutoff = (int64_t)time(NULL) - YTDLP_CACHE_DIR_MIN_AGE_S;
+        for (int i = 0; i < list.count && list.total > target; i++) {
+            if (list.files[i].mtime > cutoff) break;
+            remove_file(list.files[i].path);
+            list.total -= list.files[i].size;
+        }
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        ytdlp_free(list.files[i].path);
+    }
+    ytdlp_free(list.files);
+}
+
+static void prune_thread(void* arg) {
+    PruneJob* job = (PruneJob*)arg;
+    prune_directory(job->dir, job->max_bytes);
+
+    ytdlp_mutex_lock(&s_lock);
+    s_prune_running = false;
+    ytdlp_mutex_unlock(&s_lock);
+}
+
+void ytdlp_cache_dir_note_use(const char* dir, uint64_t max_bytes) {
+    if (!dir || !dir[0] || max_bytes == 0) return;
+
+    uint64_t now = ytdlp_monotonic_ms();
+
+    ytdlp_mutex_lock(&s_lock);
+
+    bool due = !s_prune_running &&
+               (s_last_prune_ms == 0 || now - s_last_prune_ms >= YTDLP_CACHE_DIR_PRUNE_INTERVAL_MS);
+    if (due) {
+        /* The previous pass has finished; reap it before starting the next */
+        if (s_prune_started) {
+            ytdlp_thread_join(s_prune_thread);
+            s_prune_started = false;
+        }
+
+        snprintf(s_prune_job.dir, sizeof(s_prune_job.dir), "%s", dir);
+        s_prune_job.max_bytes = max_bytes;
+        s_last_prune_ms = now;
+        s_prune_running = ytdlp_thread_start(&s_prune_thread, prune_thread, &s_prune_job);
+        s_prune_started = s_prune_running;
+    }
+
+    ytdlp_mutex_unlock(&s_lock);
+}
+
+void ytdlp_cache_dir_shutdown(void) {
+    ytdlp_mutex_lock(&s_lock);
+    bool started = s_prune_started;
+    s_prune_started = false;
+    ytdlp_mutex_unlock(&s_lock);
+
+    if (started) {
+        ytdlp_thread_join(s_prune_thread);
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * Prism yt-dlp Plugin - Configuration Snapshots
+ *
+ * Immutable configuration published with an RCU-style pointer swap.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <string.h>
+
+#define YTDLP_PROCESS_TIMEOUT_MS 30000
+#define YTDLP_CACHE_DIR_MAX_MB 64
+#define YTDLP_SHARED_CACHE_MB 64
+
+/* Built-in defaults; the initial snapshot is never freed */
+static YtdlpConfig s_default_config = {
+    .refs = 1,
+    .ytdlp_path = {0},
+    .install_dir = {0},
+    .auto_download = true,
+    .process_timeout_ms = YTDLP_PROCESS_TIMEOUT_MS,
+    .cache_dir = {0},
+    .cache_dir_max_mb = YTDLP_CACHE_DIR_MAX_MB,
+    .backend = PRISM_YTDLP_BACKEND_PROCESS,
+    .python_library = {0},
+    .python_path = {0},
+    .python_executable = {0},
+    .release_url = {0},
+    .shared_cache_name = {0},
+    .shared_cache_mb = YTDLP_SHARED_CACHE_MB,
+    .daemon_endpoints = {0}
+};
+
+static YtdlpConfigSlot s_global_slot = {
+    .current = &s_default_config,
+    .epoch = 0,
+    .readers = {0, 0},
+    .writer_lock = YTDLP_MUTEX_INIT
+};
+
+YtdlpConfigSlot* ytdlp_config_global(void) {
+    return &s_global_slot;
+}
+
+/*
+ * Readers announce themselves in the counter for the epoch they started in,
+ * but only for the few instructions between loading `current` and taking a
+ * reference. A writer that has swapped the pointer flips the epoch and waits
+ * for the old epoch's counter to drain; after that nobody can still be about
+ * to reference the old snapshot, and its published reference can be dropped.
+ */
+const YtdlpConfig* ytdlp_config_slot_acquire(YtdlpConfigSlot* slot) {
+    for (;;) {
+        int32_t epoch = ytdlp_atomic_load_i32(&slot->epoch);
+        volatile int32_t* readers = &slot->readers[epoch & 1];
+
+        ytdlp_atomic_add_i32(readers, 1);
+        if (ytdlp_atomic_load_i32(&slot->epoch) != epoch) {
+            ytdlp_atomic_add_i32(readers, -1);
+            continue;
+        }
+
+        YtdlpConfig* config = (YtdlpConfig*)ytdlp_atomic_load_ptr(&slot->current);
+        ytdlp_atomic_add_i32(&config->refs, 1);
+
+        ytdlp_atomic_add_i32(readers, -1);
+        return config;
+    }
+}
+
+void ytdlp_config_release(const YtdlpConfig* config) {
+    YtdlpConfig* mutable_config = (YtdlpConfig*)config;
+    if (!mutable_config) return;
+
+    if (ytdlp_atomic_add_i32(&mutable_config->refs, -1) == 0 &&
+        mutable_config != &s_default_config) {
+        ytdlp_free(mutable_config);
+    }
+}
+
+static void synchronize_readers(YtdlpConfigSlot* slot) {
+    int32_t epoch = ytdlp_atomic_load_i32(&slot->epoch);
+    ytdlp_atomic_add_i32(&slot->epoch, 1);
+
+    while (ytdlp_atomic_load_i32(&slot->readers[epoch & 1]) != 0) {
+        ytdlp_thread_yield();
+    }
+}
+
+YtdlpConfig* ytdlp_config_slot_begin_update(YtdlpConfigSlot* slot) {
+    ytdlp_mutex_lock(&slot->writer_lock);
+
+    /* Under the writer lock the current snapshot cannot be retired */
+    const YtdlpConfig* current = (const YtdlpConfig*)ytdlp_atomic_load_ptr(&slot->current);
+
+    YtdlpConfig* copy = (YtdlpConfig*)ytdlp_malloc(sizeof(YtdlpConfig));
+    if (!copy) {
+        ytdlp_mutex_unlock(&slot->writer_lock);
+        return NULL;
+    }
+
+    memcpy(copy, current, sizeof(YtdlpConfig));
+    copy->refs = 1;  /* The published reference */
+    return copy;
+}
+
+void ytdlp_config_slot_commit(YtdlpConfigSlot* slot, YtdlpConfig* config) {
+    YtdlpConfig* old = (YtdlpConfig*)ytdlp_atomic_exchange_ptr(&slot->current, config);
+    synchronize_readers(slot);
+    ytdlp_mutex_unlock(&slot->writer_lock);
+
+    /* In-flight readers keep their own references to the old snapshot */
+    ytdlp_config_release(old);
+}
+
+void ytdlp_config_slot_abort(YtdlpConfigSlot* slot, YtdlpConfig* config) {
+    ytdlp_free(config);
+    ytdlp_mutex_unlock(&slot->writer_lock);
+}
+
+bool ytdlp_config_slot_init(YtdlpConfigSlot* slot, const YtdlpConfig* initial) {
+    YtdlpConfig* config = (YtdlpConfig*)ytdlp_malloc(sizeof(YtdlpConfig));
+    if (!config) return false;
+
+    memcpy(config, initial, sizeof(YtdlpConfig));
+    config->refs = 1;
+
+    slot->current = config;
+    slot->epoch = 0;
+    slot->readers[0] = 0;
+    slot->readers[1] = 0;
+    ytdlp_mutex_init(&slot->writer_lock);
+    return true;
+}
+
+void ytdlp_config_slot_destroy(YtdlpConfigSlot* slot) {
+    ytdlp_config_release((const YtdlpConfig*)slot->current);
+    slot->current = NULL;
+    ytdlp_mutex_destroy(&slot->writer_lock);
+}
+
+/* ============================================================================
+ * Global Slot Shorthands
+ * ========================================================================== */
+
+const YtdlpConfig* ytdlp_config_acquire(void) {
+    return ytdlp_config_slot_acquire(&s_global_slot);
+}
+
+YtdlpConfig* ytdlp_config_begin_update(void) {
+    return ytdlp_config_slot_begin_update(&s_global_slot);
+}
+
+void ytdlp_config_commit(YtdlpConfig* config) {
+    ytdlp_config_slot_commit(&s_global_slot, config);
+}
+
+void ytdlp_config_abort(YtdlpConfig* config) {
+    ytdlp_config_slot_abort(&s_global_slot, config);
+}
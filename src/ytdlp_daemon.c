@@ -0,0 +1,986 @@
+/*
+ * Prism yt-dlp Plugin - Resolve Daemon Protocol
+ *
+ * prism_ytdlp_resolved runs one resolver for every player process on a host.
+ * Clients send it one request per connection over a unix socket or TCP and
+ * read back the resolved stream. This file holds both ends of the wire
+ * format, the socket handling and the client's routing across several
+ * daemons; the daemon's main loop lives in daemon/.
+ *
+ * A frame is a 4-byte little-endian payload length, then the payload: a
+ * 4-byte magic and a run of records, each a 1-byte tag, a 4-byte
+ * little-endian length and that many bytes. Strings carry their NUL;
+ * integers and doubles are 8 bytes, little-endian. Unknown tags are
+ * skipped, so either side can add fields.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_DAEMON_MAGIC "PYD1"
+#define YTDLP_DAEMON_FRAME_MAX (16u * 1024u * 1024u)
+#define YTDLP_DAEMON_ENDPOINTS_MAX 16
+#define YTDLP_DAEMON_RING_POINTS 160      /* Points per endpoint on the hash ring */
+#define YTDLP_DAEMON_LOAD_PERCENT 125     /* Endpoints take up to 1.25x their share of requests */
+#define YTDLP_DAEMON_CONNECT_MS 1000      /* A connect taking longer counts as unreachable */
+#define YTDLP_DAEMON_HEALTH_MS 1000       /* Endpoints marked down are pinged this often */
+#define YTDLP_DAEMON_PING_MS 5000         /* Endpoints in use, this often */
+
+enum {
+    /* Requests */
+    TAG_OP = 1,
+    TAG_URL = 2,
+    TAG_QUALITY = 3,
+    TAG_LANGUAGE = 4,
+    TAG_TIMEOUT_MS = 5,
+    TAG_INCLUDE_METADATA = 6,
+
+    /* Streams */
+    TAG_SUCCESS = 32,
+    TAG_ERROR_CLASS = 33,
+    TAG_HEADER = 34,           /* Name and value, each with its NUL */
+    TAG_WIDTH = 35,
+    TAG_HEIGHT = 36,
+    TAG_DURATION = 37,
+    TAG_FLAGS = 38,
+    TAG_REQUESTED_QUALITY = 39,
+    TAG_STRING_BASE = 64       /* + index into s_string_fields */
+};
+
+enum {
+    FLAG_LIVE = 1,
+    FLAG_HLS = 2,
+    FLAG_VIDEO = 4,
+    FLAG_AUDIO = 8
+};
+
+/* String members of a stream, in wire order */
+static const size_t s_string_fields[] = {
+    offsetof(PrismResolvedStream, error),
+    offsetof(PrismResolvedStream, warning),
+    offsetof(PrismResolvedStream, original_url),
+    offsetof(PrismResolvedStream, direct_url),
+    offsetof(PrismResolvedStream, audio_url),
+    offsetof(PrismResolvedStream, title),
+    offsetof(PrismResolvedStream, channel),
+    offsetof(PrismResolvedStream, thumbnail_url),
+    offsetof(PrismResolvedStream, description),
+    offsetof(PrismResolvedStream, video_codec),
+    offsetof(PrismResolvedStream, audio_codec),
+    offsetof(PrismResolvedStream, cookies),
+};
+
+#define STRING_FIELD_COUNT (sizeof(s_string_fields) / sizeof(s_string_fields[0]))
+
+static const char** string_field(PrismResolvedStream* stream, size_t index) {
+    return (const char**)((char*)stream + s_string_fields[index]);
+}
+
+/* ============================================================================
+ * Encoding
+ * ========================================================================== */
+
+static void put_u32(char* out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out[i] = (char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const char* in) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)(unsigned char)in[i] << (8 * i);
+    return v;
+}
+
+static uint64_t get_u64(const char* in) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)(unsigned char)in[i] << (8 * i);
+    return v;
+}
+
+static bool put_record(YtdlpBuffer* buf, int tag, const char* bytes, size_t len) {
+    char head[5];
+    head[0] = (char)tag;
+    put_u32(head + 1, (uint32_t)len);
+    return ytdlp_buffer_append(buf, head, sizeof(head)) && ytdlp_buffer_append(buf, bytes, len);
+}
+
+static bool put_string(YtdlpBuffer* buf, int tag, const char* s) {
+    return !s || put_record(buf, tag, s, strlen(s) + 1);
+}
+
+static bool put_int(YtdlpBuffer* buf, int tag, int64_t value) {
+    char bytes[8];
+    uint64_t v = (uint64_t)value;
+    for (int i = 0; i < 8; i++) bytes[i] = (char)(v >> (8 * i));
+    return put_record(buf, tag, bytes, sizeof(bytes));
+}
+
+static bool put_double(YtdlpBuffer* buf, int tag, double value) {
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return put_int(buf, tag, bits);
+}
+
+/* Start a frame; the length is filled in by frame_end() */
+static bool frame_begin(YtdlpBuffer* buf) {
+    ytdlp_buffer_clear(buf);
+    return ytdlp_buffer_append(buf, "\0\0\0\0" YTDLP_DAEMON_MAGIC, 8);
+}
+
+static void frame_end(YtdlpBuffer* buf) {
+    put_u32(buf->data, (uint32_t)(buf->len - 4));
+}
+
+static bool encode_request(YtdlpBuffer* buf, const YtdlpDaemonRequest* request) {
+    bool ok = frame_begin(buf) &&
+              put_int(buf, TAG_OP, request->op) &&
+              put_string(buf, TAG_URL, request->url);
+    if (ok && request->has_options) {
+        ok = put_int(buf, TAG_QUALITY, request->options.quality) &&
+             put_string(buf, TAG_LANGUAGE, request->options.preferred_audio_language) &&
+             put_int(buf, TAG_TIMEOUT_MS, request->options.timeout_ms) &&
+             put_int(buf, TAG_INCLUDE_METADATA, request->options.include_metadata);
+    }
+    if (ok) frame_end(buf);
+    return ok;
+}
+
+static bool encode_stream(YtdlpBuffer* buf, const PrismResolvedStream* stream) {
+    PrismResolvedStream* s = (PrismResolvedStream*)stream;
+    int flags = (s->is_live ? FLAG_LIVE : 0) | (s->is_hls ? FLAG_HLS : 0) |
+                (s->has_video ? FLAG_VIDEO : 0) | (s->has_audio ? FLAG_AUDIO : 0);
+
+    bool ok = frame_begin(buf) &&
+              put_int(buf, TAG_SUCCESS, s->success) &&
+              put_int(buf, TAG_ERROR_CLASS, prism_ytdlp_error_class(s)) &&
+              put_int(buf, TAG_WIDTH, s->width) &&
+              put_int(buf, TAG_HEIGHT, s->height) &&
+              put_double(buf, TAG_DURATION, s->duration) &&
+              put_int(buf, TAG_FLAGS, flags) &&
+              put_int(buf, TAG_REQUESTED_QUALITY, s->requested_quality);
+
+    for (size_t i = 0; ok && i < STRING_FIELD_COUNT; i++) {
+        ok = put_string(buf, TAG_STRING_BASE + (int)i, *string_field(s, i));
+    }
+
+    for (int i = 0; ok && s->header_names && s->header_values && i < s->header_count; i++) {
+        size_t name_len = strlen(s->header_names[i]) + 1;
+        size_t value_len = strlen(s->header_values[i]) + 1;
+        char head[5];
+        head[0] = (char)TAG_HEADER;
+        put_u32(head + 1, (uint32_t)(name_len + value_len));
+        ok = ytdlp_buffer_append(buf, head, sizeof(head)) &&
+             ytdlp_buffer_append(buf, s->header_names[i], name_len) &&
+             ytdlp_buffer_append(buf, s->header_values[i], value_len);
+    }
+
+    if (ok) frame_end(buf);
+    return ok;
+}
+
+/* ============================================================================
+ * Decoding
+ * ========================================================================== */
+
+typedef struct Record {
+    int tag;
+    const char* bytes;
+    size_t len;
+} Record;
+
+/* Step through the records of a payload; false at the end or on a record
+ * that runs past it */
+static bool next_record(const char* payload, size_t len, size_t* offset, Record* out) {
+    if (*offset + 5 > len) return false;
+
+    out->tag = (unsigned char)payload[*offset];
+    out->len = get_u32(payload + *offset + 1);
+    if (out->len > len - *offset - 5) return false;
+
+    out->bytes = payload + *offset + 5;
+    *offset += 5 + out->len;
+    return true;
+}
+
+static bool record_string(const Record* r, const char** out) {
+    if (r->len == 0 || r->bytes[r->len - 1] != '\0') return false;
+    *out = r->bytes;
+    return true;
+}
+
+static bool record_int(const Record* r, int64_t* out) {
+    if (r->len != 8) return false;
+    *out = (int64_t)get_u64(r->bytes);
+    return true;
+}
+
+static bool payload_valid(const char* payload, size_t len) {
+    return len >= 4 && memcmp(payload, YTDLP_DAEMON_MAGIC, 4) == 0;
+}
+
+static bool decode_request(const char* payload, size_t len, YtdlpDaemonRequest* request) {
+    memset(request, 0, sizeof(*request));
+    if (!payload_valid(payload, len)) return false;
+
+    prism_resolver_options_init(&request->options);
+
+    size_t offset = 4;
+    Record r;
+    int64_t v;
+    while (next_record(payload, len, &offset, &r)) {
+        switch (r.tag) {
+            case TAG_OP:
+                if (record_int(&r, &v)) request->op = (YtdlpDaemonOp)v;
+                break;
+            case TAG_URL:
+                record_string(&r, &request->url);
+                break;
+            case TAG_QUALITY:
+                if (record_int(&r, &v)) request->options.quality = (PrismStreamQuality)v;
+                request->has_options = true;
+                break;
+            case TAG_LANGUAGE:
+                record_string(&r, &request->options.preferred_audio_language);
+                break;
+            case TAG_TIMEOUT_MS:
+                if (record_int(&r, &v)) request->options.timeout_ms = (int)v;
+                break;
+            case TAG_INCLUDE_METADATA:
+                if (record_int(&r, &v)) request->options.include_metadata = v != 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (request->op == YTDLP_DAEMON_PING) return true;
+    return request->url != NULL && request->op >= YTDLP_DAEMON_RESOLVE && request->op <= YTDLP_DAEMON_PROBE;
+}
+
+/* Fill the builder from a stream frame held in its arena */
+static bool decode_stream(const char* payload, size_t len, YtdlpStreamBuilder* b) {
+    if (!payload_valid(payload, len)) return false;
+
+    PrismResolvedStream* stream = &b->stream;
+    PrismYtdlpErrorClass error_class = PRISM_YTDLP_ERROR_NONE;
+    int header_count = 0;
+    bool has_success = false;
+
+    size_t offset = 4;
+    Record r;
+    int64_t v;
+    while (next_record(payload, len, &offset, &r)) {
+        if (r.tag >= TAG_STRING_BASE && r.tag < TAG_STRING_BASE + (int)STRING_FIELD_COUNT) {
+            record_string(&r, string_field(stream, (size_t)(r.tag - TAG_STRING_BASE)));
+            continue;
+        }
+        switch (r.tag) {
+            case TAG_SUCCESS:
+                has_success = record_int(&r, &v);
+                stream->success = has_success && v != 0;
+                break;
+            case TAG_ERROR_CLASS:
+                if (record_int(&r, &v)) error_class = (PrismYtdlpErrorClass)v;
+                break;
+            case TAG_WIDTH:
+                if (record_int(&r, &v)) stream->width = (int)v;
+                break;
+            case TAG_HEIGHT:
+                if (record_int(&r, &v)) stream->height = (int)v;
+                break;
+            case TAG_DURATION:
+                if (record_int(&r, &v)) memcpy(&stream->duration, &v, sizeof(double));
+                break;
+            case TAG_FLAGS:
+                if (record_int(&r, &v)) {
+                    stream->is_live = (v & FLAG_LIVE) != 0;
+                    stream->is_hls = (v & FLAG_HLS) != 0;
+                    stream->has_video = (v & FLAG_VIDEO) != 0;
+                    stream->has_audio = (v & FLAG_AUDIO) != 0;
+                }
+                break;
+            case TAG_REQUESTED_QUALITY:
+                if (record_int(&r, &v)) stream->requested_quality = (PrismStreamQuality)v;
+                break;
+            case TAG_HEADER:
+                header_count++;
+                break;
+            default:
+                break;
+        }
+    }
+    if (!has_success) return false;
+
+    if (header_count > 0) {
+        const char** names = (const char**)ytdlp_arena_alloc(b->arena, sizeof(const char*) * (size_t)header_count);
+        const char** values = (const char**)ytdlp_arena_alloc(b->arena, sizeof(const char*) * (size_t)header_count);
+        if (!names || !values) return false;
+
+        int n = 0;
+        offset = 4;
+        while (next_record(payload, len, &offset, &r)) {
+            if (r.tag != TAG_HEADER) continue;
+            const char* name = r.bytes;
+            const char* split = (const char*)memchr(r.bytes, '\0', r.len);
+            if (!split || split + 1 >= r.bytes + r.len || r.bytes[r.len - 1] != '\0') continue;
+            names[n] = name;
+            values[n] = split + 1;
+            n++;
+        }
+        stream->header_names = names;
+        stream->header_values = values;
+        stream->header_count = n;
+    }
+
+    if (!stream->success) {
+        if (!stream->error) stream->error = "Resolve daemon failed";
+        b->error_class = error_class != PRISM_YTDLP_ERROR_NONE ? error_class : ytdlp_classify_error(stream->error);
+    }
+    return true;
+}
+
+
+#ifdef _WIN32
+
+/* ============================================================================
+ * Sockets (Windows: no daemon; every resolve runs in process)
+ * ========================================================================== */
+
+YtdlpDaemonResult ytdlp_daemon_call(const char* endpoints, const char* key, const YtdlpDaemonRequest* request,
+                                    int timeout_ms, YtdlpStreamBuilder* b) {
+    (void)endpoints;
+    (void)key;
+    (void)request;
+    (void)timeout_ms;
+    (void)b;
+    return YTDLP_DAEMON_UNREACHABLE;
+}
+
+int ytdlp_daemon_listen(const char* endpoint, bool allow_remote) {
+    (void)endpoint;
+    (void)allow_remote;
+    return -1;
+}
+
+void ytdlp_daemon_unlisten(int fd, const char* endpoint) {
+    (void)fd;
+    (void)endpoint;
+}
+
+bool ytdlp_daemon_read_request(int fd, YtdlpArena* arena, YtdlpDaemonRequest* request, int timeout_ms) {
+    (void)fd;
+    (void)arena;
+    (void)request;
+    (void)timeout_ms;
+    return false;
+}
+
+bool ytdlp_daemon_write_stream(int fd, const PrismResolvedStream* stream, int timeout_ms) {
+    (void)fd;
+    (void)stream;
+    (void)timeout_ms;
+    return false;
+}
+
+void ytdlp_daemon_shutdown(void) {
+}
+
+#else
+
+/* ============================================================================
+ * Sockets
+ * ========================================================================== */
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0  /* macOS: SO_NOSIGPIPE is set on the socket instead */
+#endif
+
+/* Wait for `events` on `fd` until `deadline` */
+static bool wait_fd(int fd, short events, uint64_t deadline) {
+    for (;;) {
+        uint64_t now = ytdlp_monotonic_ms();
+        if (now >= deadline) return false;
+
+        struct pollfd p = { fd, events, 0 };
+        int n = poll(&p, 1, (int)(deadline - now));
+        if (n > 0) return true;
+        if (n < 0 && errno != EINTR) return false;
+    }
+}
+
+static bool send_all(int fd, const char* data, size_t len, uint64_t deadline) {
+    while (len > 0) {
+        if (!wait_fd(fd, POLLOUT, deadline)) return false;
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, char* data, size_t len, uint64_t deadline) {
+    while (len > 0) {
+        if (!wait_fd(fd, POLLIN, deadline)) return false;
+        ssize_t n = recv(fd, data, len, 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/* Read one frame's payload into `arena` */
+static char* recv_frame(int fd, YtdlpArena* arena, size_t* len, uint64_t deadline) {
+    char head[4];
+    if (!recv_all(fd, head, sizeof(head), deadline)) return NULL;
+
+    *len = get_u32(head);
+    if (*len > YTDLP_DAEMON_FRAME_MAX) return NULL;
+
+    char* payload = (char*)ytdlp_arena_alloc(arena, *len + 1);
+    if (!payload || !recv_all(fd, payload, *len, deadline)) return NULL;
+    return payload;
+}
+
+static void socket_setup(int fd) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+static bool endpoint_is_tcp(const char* endpoint) {
+    return strncmp(endpoint, "tcp:", 4) == 0;
+}
+
+/* Address of a unix socket path or of "tcp:host:port". IPv6 hosts go in
+ * brackets; an empty host is loopback, and "*" is every interface when
+ * listening and loopback when connecting. */
+static bool endpoint_address(const char* endpoint, bool listening, struct sockaddr_storage* addr, socklen_t* len) {
+    memset(addr, 0, sizeof(*addr));
+
+    if (!endpoint_is_tcp(endpoint)) {
+        struct sockaddr_un* un = (struct sockaddr_un*)addr;
+        size_t path_len = strlen(endpoint);
+        if (path_len == 0 || path_len >= sizeof(un->sun_path)) return false;
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, endpoint, path_len + 1);
+        *len = (socklen_t)sizeof(*un);
+        return true;
+    }
+
+    const char* host = endpoint + 4;
+    const char* port = strrchr(host, ':');
+    if (!port || !port[1]) return false;
+
+    size_t host_len = (size_t)(port - host);
+    if (host_len >= 2 && host[0] == '[' && host[host_len - 1] == ']') {
+        host++;
+        host_len -= 2;
+    }
+
+    char name[256];
+    if (host_len >= sizeof(name)) return false;
+    memcpy(name, host, host_len);
+    name[host_len] = '\0';
+    bool any = strcmp(name, "*") == 0;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (listening && any ? AI_PASSIVE : 0);
+
+    struct addrinfo* result = NULL;
+    if (getaddrinfo(any || host_len == 0 ? NULL : name, port + 1, &hints, &result) != 0 || !result) return false;
+
+    bool ok = result->ai_addrlen <= sizeof(*addr);
+    if (ok) {
+        memcpy(addr, result->ai_addr, result->ai_addrlen);
+        *len = (socklen_t)result->ai_addrlen;
+    }
+    freeaddrinfo(result);
+    return ok;
+}
+
+static int socket_connect(const char* endpoint, uint64_t deadline) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    if (!endpoint_address(endpoint, false, &addr, &addr_len)) return -1;
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    socket_setup(fd);
+
+    if (addr.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    /* Local connects finish or fail at once; TCP ones take a round trip */
+    if (connect(fd, (struct sockaddr*)&addr, addr_len) != 0) {
+        int error = errno;
+        socklen_t error_len = sizeof(error);
+        if (error != EINPROGRESS || !wait_fd(fd, POLLOUT, deadline) ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/* Send an encoded request to one endpoint. The builder is filled only if
+ * it answered, so a reply that fails halfway leaves it for the next try. */
+static YtdlpDaemonResult call_endpoint(const char* endpoint, const YtdlpBuffer* frame, uint64_t deadline,
+                                YtdlpStreamBuilder* b) {
+    uint64_t connect_deadline = ytdlp_monotonic_ms() + YTDLP_DAEMON_CONNECT_MS;
+    int fd = socket_connect(endpoint, connect_deadline < deadline ? connect_deadline : deadline);
+
+    bool ok = fd >= 0 && send_all(fd, frame->data, frame->len, deadline);
+
+    YtdlpStreamBuilder reply = *b;
+    size_t len = 0;
+    char* payload = ok ? recv_frame(fd, b->arena, &len, deadline) : NULL;
+    ok = payload && decode_stream(payload, len, &reply);
+    if (ok) *b = reply;
+
+    if (fd >= 0) close(fd);
+    if (ok) return YTDLP_DAEMON_ANSWERED;
+    return ytdlp_monotonic_ms() >= deadline ? YTDLP_DAEMON_TIMED_OUT : YTDLP_DAEMON_UNREACHABLE;
+}
+
+/* ============================================================================
+ * Routing
+ *
+ * A client given several endpoints places each on a hash ring at many
+ * points and sends a URL to the first endpoint clockwise of its key, so
+ * every daemon caches its own share of the media and adding or losing one
+ * moves only that share. Endpoints that are down are skipped and the next
+ * one on the ring takes over. An endpoint already serving more than 1.25x
+ * its share of this process's requests passes new ones on as well, so a
+ * single hot media spreads over the next endpoints instead of queuing on
+ * one (consistent hashing with bounded loads).
+ *
+ * A failed call marks its endpoint down. A background thread pings down
+ * endpoints every second and brings them back when they answer, and pings
+ * the others now and then so a dead one is noticed before a request waits
+ * on it. The router is rebuilt when the endpoint list changes.
+ * ========================================================================== */
+
+typedef struct Endpoint {
+    char address[YTDLP_PATH_MAX];
+    volatile int32_t down;
+    volatile int32_t in_flight;
+} Endpoint;
+
+typedef struct RingPoint {
+    uint32_t hash;
+    int endpoint;
+} RingPoint;
+
+typedef struct Router {
+    volatile int32_t refs;
+    char* list;                 /* The endpoint list it was built from */
+    Endpoint endpoints[YTDLP_DAEMON_ENDPOINTS_MAX];
+    int count;
+    RingPoint* ring;
+    int ring_size;
+    volatile int32_t in_flight;
+
+    YtdlpMutex lock;
+    YtdlpCond wake;
+    volatile bool stop;
+    YtdlpThread health;
+} Router;
+
+static YtdlpMutex s_router_lock = YTDLP_MUTEX_INIT;
+static Router* s_router = NULL;
+
+/* FNV-1a, then a final mix so keys differing in their last bytes still
+ * spread over the whole ring */
+static uint32_t ring_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int compare_points(const void* a, const void* b) {
+    uint32_t x = ((const RingPoint*)a)->hash;
+    uint32_t y = ((const RingPoint*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+/* Every endpoint once, in ring order clockwise from `hash` */
+static int ring_walk(const Router* r, uint32_t hash, int* order) {
+    int lo = 0;
+    int hi = r->ring_size;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (r->ring[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+
+    bool seen[YTDLP_DAEMON_ENDPOINTS_MAX] = { false };
+    int n = 0;
+    for (int i = 0; i < r->ring_size && n < r->count; i++) {
+        int endpoint = r->ring[(lo + i) % r->ring_size].endpoint;
+        if (!seen[endpoint]) {
+            seen[endpoint] = true;
+            order[n++] = endpoint;
+        }
+    }
+    return n;
+}
+
+/* Endpoints to try for `key`, best first: ring order, skipping endpoints
+ * that are down, with those over the load bound moved to the back */
+static int route(Router* r, const char* key, int* order) {
+    int ring_order[YTDLP_DAEMON_ENDPOINTS_MAX];
+    int n = ring_walk(r, ring_hash(key, strlen(key)), ring_order);
+
+    int up = 0;
+    for (int i = 0; i < n; i++) {
+        if (!ytdlp_atomic_load_i32(&r->endpoints[ring_order[i]].down)) up++;
+    }
+    if (up == 0) return 0;
+
+    /* ceil(1.25 * (requests in flight, this one included) / endpoints up) */
+    int64_t load = (int64_t)ytdlp_atomic_load_i32(&r->in_flight) + 1;
+    int64_t capacity = (YTDLP_DAEMON_LOAD_PERCENT * load + 100 * up - 1) / (100 * up);
+
+    int tries = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < n; i++) {
+            Endpoint* e = &r->endpoints[ring_order[i]];
+            if (ytdlp_atomic_load_i32(&e->down)) continue;
+            bool under = ytdlp_atomic_load_i32(&e->in_flight) < capacity;
+            if (under == (pass == 0)) order[tries++] = ring_order[i];
+        }
+    }
+    return tries;
+}
+
+static bool ping(const char* endpoint) {
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) return false;
+
+    YtdlpArenaMark mark = ytdlp_arena_mark(&scratch->arena);
+    YtdlpStreamBuilder b;
+    ytdlp_builder_init(&b, &scratch->arena);
+
+    YtdlpDaemonRequest request;
+    memset(&request, 0, sizeof(request));
+    request.op = YTDLP_DAEMON_PING;
+
+    YtdlpBuffer frame = { NULL, 0, 0 };
+    uint64_t deadline = ytdlp_monotonic_ms() + YTDLP_DAEMON_CONNECT_MS;
+    bool ok = encode_request(&frame, &request) &&
+              call_endpoint(endpoint, &frame, deadline, &b) == YTDLP_DAEMON_ANSWERED &&
+              b.stream.success;
+
+    ytdlp_free(frame.data);
+    ytdlp_arena_release(&scratch->arena, mark);
+    return ok;
+}
+
+static void health_main(void* arg) {
+    Router* r = (Router*)arg;
+    uint64_t checked[YTDLP_DAEMON_ENDPOINTS_MAX] = { 0 };
+
+    ytdlp_mutex_lock(&r->lock);
+    while (!r->stop) {
+        ytdlp_cond_wait_ms(&r->wake, &r->lock, YTDLP_DAEMON_HEALTH_MS);
+        if (r->stop) break;
+        ytdlp_mutex_unlock(&r->lock);
+
+        for (int i = 0; i < r->count && !r->stop; i++) {
+            Endpoint* e = &r->endpoints[i];
+            uint64_t now = ytdlp_monotonic_ms();
+            if (!ytdlp_atomic_load_i32(&e->down) && now - checked[i] < YTDLP_DAEMON_PING_MS) continue;
+
+            checked[i] = now;
+            ytdlp_atomic_store_i32(&e->down, ping(e->address) ? 0 : 1);
+        }
+
+        ytdlp_mutex_lock(&r->lock);
+    }
+    ytdlp_mutex_unlock(&r->lock);
+}
+
+static void router_destroy(Router* r) {
+    ytdlp_mutex_lock(&r->lock);
+    r->stop = true;
+    ytdlp_cond_broadcast(&r->wake);
+    ytdlp_mutex_unlock(&r->lock);
+    ytdlp_thread_join(r->health);
+
+    ytdlp_cond_destroy(&r->wake);
+    ytdlp_mutex_destroy(&r->lock);
+    ytdlp_free(r->ring);
+    ytdlp_free(r->list);
+    ytdlp_free(r);
+}
+
+static void router_release(Router* r) {
+    if (r && ytdlp_atomic_add_i32(&r->refs, -1) == 0) router_destroy(r);
+}
+
+/* Parse a comma-separated endpoint list into a router with its health
+ * checker running; NULL if the list names no endpoint */
+static Router* router_create(const char* list) {
+    Router* r = (Router*)ytdlp_calloc(1, sizeof(Router));
+    if (!r) return NULL;
+
+    size_t list_len = strlen(list);
+    r->list = (char*)ytdlp_malloc(list_len + 1);
+    if (!r->list) {
+        ytdlp_free(r);
+        return NULL;
+    }
+    memcpy(r->list, list, list_len + 1);
+
+    const char* p = list;
+    while (*p && r->count < YTDLP_DAEMON_ENDPOINTS_MAX) {
+        while (*p == ' ' || *p == ',') p++;
+        const char* end = p;
+        while (*end && *end != ',') end++;
+        size_t len = (size_t)(end - p);
+        while (len > 0 && p[len - 1] == ' ') len--;
+
+        if (len > 0 && len < YTDLP_PATH_MAX) {
+            Endpoint* e = &r->endpoints[r->count];
+            memcpy(e->address, p, len);
+            e->address[len] = '\0';
+
+            bool duplicate = false;
+            for (int i = 0; i < r->count; i++) {
+                if (strcmp(r->endpoints[i].address, e->address) == 0) duplicate = true;
+            }
+            if (!duplicate) r->count++;
+        }
+        p = end;
+    }
+
+    r->ring_size = r->count * YTDLP_DAEMON_RING_POINTS;
+    r->ring = r->count > 0 ? (RingPoint*)ytdlp_calloc((size_t)r->ring_size, sizeof(RingPoint)) : NULL;
+    if (!r->ring) {
+        ytdlp_free(r->list);
+        ytdlp_free(r);
+        return NULL;
+    }
+
+    /* Points hash from the address, so every process builds the same ring */
+    for (int i = 0; i < r->count; i++) {
+        for (int j = 0; j < YTDLP_DAEMON_RING_POINTS; j++) {
+            char point[YTDLP_PATH_MAX + 16];
+            int len = snprintf(point, sizeof(point), "%s#%d", r->endpoints[i].address, j);
+            RingPoint* rp = &r->ring[i * YTDLP_DAEMON_RING_POINTS + j];
+            rp->hash = ring_hash(point, (size_t)len);
+            rp->endpoint = i;
+        }
+    }
+    qsort(r->ring, (size_t)r->ring_size, sizeof(RingPoint), compare_points);
+
+    r->refs = 1;
+    ytdlp_mutex_init(&r->lock);
+    ytdlp_cond_init(&r->wake);
+    if (!ytdlp_thread_start(&r->health, health_main, r)) {
+        ytdlp_cond_destroy(&r->wake);
+        ytdlp_mutex_destroy(&r->lock);
+        ytdlp_free(r->ring);
+        ytdlp_free(r->list);
+        ytdlp_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* The router for `list`, replacing the current one if it was built from
+ * another list */
+static Router* router_acquire(const char* list) {
+    ytdlp_mutex_lock(&s_router_lock);
+    Router* replaced = NULL;
+    if (!s_router || strcmp(s_router->list, list) != 0) {
+        replaced = s_router;
+        s_router = router_create(list);
+    }
+    Router* r = s_router;
+    if (r) ytdlp_atomic_add_i32(&r->refs, 1);
+    ytdlp_mutex_unlock(&s_router_lock);
+
+    router_release(replaced);
+    return r;
+}
+
+YtdlpDaemonResult ytdlp_daemon_call(const char* endpoints, const char* key, const YtdlpDaemonRequest* request,
+                                    int timeout_ms, YtdlpStreamBuilder* b) {
+    if (timeout_ms <= 0) return YTDLP_DAEMON_TIMED_OUT;
+    uint64_t deadline = ytdlp_monotonic_ms() + (uint64_t)timeout_ms;
+
+    Router* r = router_acquire(endpoints);
+    if (!r) return YTDLP_DAEMON_UNREACHABLE;
+
+    YtdlpBuffer frame = { NULL, 0, 0 };
+    int order[YTDLP_DAEMON_ENDPOINTS_MAX];
+    int tries = encode_request(&frame, request) ? route(r, key ? key : "", order) : 0;
+
+    YtdlpDaemonResult result = YTDLP_DAEMON_UNREACHABLE;
+    for (int i = 0; i < tries; i++) {
+        Endpoint* e = &r->endpoints[order[i]];
+
+        ytdlp_atomic_add_i32(&e->in_flight, 1);
+        ytdlp_atomic_add_i32(&r->in_flight, 1);
+        result = call_endpoint(e->address, &frame, deadline, b);
+        ytdlp_atomic_add_i32(&r->in_flight, -1);
+        ytdlp_atomic_add_i32(&e->in_flight, -1);
+
+        /* Answered, or out of time, which the next replica would be too */
+        if (result != YTDLP_DAEMON_UNREACHABLE) break;
+
+        /* Fail over to the next replica on the ring */
+        ytdlp_atomic_store_i32(&e->down, 1);
+    }
+
+    ytdlp_free(frame.data);
+    router_release(r);
+    return result;
+}
+
+void ytdlp_daemon_shutdown(void) {
+    ytdlp_mutex_lock(&s_router_lock);
+    Router* r = s_router;
+    s_router = NULL;
+    ytdlp_mutex_unlock(&s_router_lock);
+
+    router_release(r);
+}
+
+/* ============================================================================
+ * Serving
+ * ========================================================================== */
+
+/* Whether only this host can reach `addr`: a unix socket, 127.0.0.0/8, ::1
+ * or an IPv4-mapped loopback address */
+static bool address_is_loopback(const struct sockaddr_storage* addr) {
+    if (addr->ss_family == AF_UNIX) return true;
+
+    if (addr->ss_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)addr;
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+
+    if (addr->ss_family == AF_INET6) {
+        const struct in6_addr* in6 = &((const struct sockaddr_in6*)addr)->sin6_addr;
+        if (IN6_IS_ADDR_LOOPBACK(in6)) return true;
+        return IN6_IS_ADDR_V4MAPPED(in6) && in6->s6_addr[12] == 127;
+    }
+    return false;
+}
+
+int ytdlp_daemon_listen(const char* endpoint, bool allow_remote) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    if (!endpoint_address(endpoint, true, &addr, &addr_len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Peers are not authenticated, so other hosts are let in only on request */
+    if (!allow_remote && !address_is_loopback(&addr)) {
+        errno = EACCES;
+        return -1;
+    }
+
+    bool local = addr.ss_family == AF_UNIX;
+    if (local) {
+        /* A socket file nobody answers on is left over from a daemon that
+         * died; one that answers belongs to a daemon still running */
+        int probe = socket_connect(endpoint, ytdlp_monotonic_ms() + YTDLP_DAEMON_CONNECT_MS);
+        if (probe >= 0) {
+            close(probe);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        unlink(endpoint);
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    socket_setup(fd);
+
+    int one = 1;
+    if (!local) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    /* Only the daemon's own user may connect to a unix socket */
+    mode_t old_mask = local ? umask(0077) : 0;
+    bool bound = bind(fd, (struct sockaddr*)&addr, addr_len) == 0;
+    if (local) umask(old_mask);
+
+    if (!bound || listen(fd, SOMAXCONN) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+void ytdlp_daemon_unlisten(int fd, const char* endpoint) {
+    if (fd >= 0) close(fd);
+    if (!endpoint_is_tcp(endpoint)) unlink(endpoint);
+}
+
+bool ytdlp_daemon_read_request(int fd, YtdlpArena* arena, YtdlpDaemonRequest* request, int timeout_ms) {
+    socket_setup(fd);
+
+    size_t len = 0;
+    char* payload = recv_frame(fd, arena, &len, ytdlp_monotonic_ms() + (uint64_t)timeout_ms);
+    return payload && decode_request(payload, len, request);
+}
+
+bool ytdlp_daemon_write_stream(int fd, const PrismResolvedStream* stream, int timeout_ms) {
+    YtdlpBuffer frame = { NULL, 0, 0 };
+    bool ok = encode_stream(&frame, stream) &&
+              send_all(fd, frame.data, frame.len, ytdlp_monotonic_ms() + (uint64_t)timeout_ms);
+    ytdlp_free(frame.data);
+    return ok;
+}
+
+#endif
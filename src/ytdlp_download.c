@@ -0,0 +1,534 @@
+/*
+ * Prism yt-dlp Plugin - Release Downloads
+ *
+ * Fetches yt-dlp release assets with curl. The transfer goes to <path>.part
+ * and an attempt that is cut off is resumed with a range request, both
+ * within one download and by the next download, so a slow link never starts
+ * over. The finished file must match the SHA-256 the release lists in its
+ * SHA2-256SUMS asset before it is renamed over <path>; a partial or corrupt
+ * download is never launched.
+ *
+ * curl runs on a helper thread while the calling thread reports progress
+ * from the size of the .part file and the length in the response headers.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <urlmon.h>
+    #pragma comment(lib, "urlmon.lib")
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_RELEASES_URL "https://github.com/yt-dlp/yt-dlp/releases/"
+#define YTDLP_CHECKSUMS_ASSET "SHA2-256SUMS"
+#define YTDLP_DOWNLOAD_ATTEMPTS 5
+#define YTDLP_DOWNLOAD_RETRY_DELAY_MS 1000
+#define YTDLP_DOWNLOAD_POLL_MS 100
+#define YTDLP_DOWNLOAD_LOOKUP_TIMEOUT_MS 60000                /* Release lookup and checksums */
+#define YTDLP_DOWNLOAD_ATTEMPT_TIMEOUT_MS (30 * 60 * 1000)    /* Backstop; stalls are caught by curl */
+
+/* Shared curl options: fail on HTTP errors, and give up on a connection that
+ * moves less than 1 KB/s for a minute so the next attempt can resume */
+#define CURL_OPTIONS "-fsS --connect-timeout 30 --speed-limit 1024 --speed-time 60"
+#define CURL_RANGE_ERROR 33
+
+/* Set while downloads must stop, e.g. during plugin shutdown */
+static volatile int32_t s_cancelled = 0;
+
+/* ============================================================================
+ * SHA-256
+ * ========================================================================== */
+
+typedef struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t used;
+} Sha256;
+
+static const uint32_t s_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + s_sha256_k[i] + w[i];
+        uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(Sha256* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(Sha256* ctx, const uint8_t* data, size_t len) {
+    ctx->length += len;
+    while (len > 0) {
+        size_t take = sizeof(ctx->block) - ctx->used;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->used, data, take);
+        ctx->used += take;
+        data += take;
+        len -= take;
+
+        if (ctx->used == sizeof(ctx->block)) {
+            sha256_transform(ctx->state, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256_final(Sha256* ctx, uint8_t digest[32]) {
+    uint64_t bits = ctx->length * 8;
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(ctx->block + ctx->used, 0, sizeof(ctx->block) - ctx->used);
+        sha256_transform(ctx->state, ctx->block);
+        ctx->used = 0;
+    }
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_transform(ctx->state, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+/* Lowercase hex digest of a file's contents */
+static bool sha256_file(const char* path, char hex[65]) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    Sha256 ctx;
+    sha256_init(&ctx);
+
+    uint8_t buf[16384];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        sha256_update(&ctx, buf, n);
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    if (!ok) return false;
+
+    uint8_t digest[32];
+    sha256_final(&ctx, digest);
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Files
+ * ========================================================================== */
+
+static int64_t file_size(const char* path) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return -1;
+    return (int64_t)(((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow);
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    return (int64_t)st.st_size;
+#endif
+}
+
+/* Replace `to` with `from` in one step */
+static bool replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+static bool matches_checksum(const char* path, const char* expected) {
+    char actual[65];
+    return sha256_file(path, actual) && strcmp(actual, expected) == 0;
+}
+
+/* ============================================================================
+ * Release Lookup
+ * ========================================================================== */
+
+/* Copy the text after the last newline of `output` (curl's -w trailer) */
+static void last_line(const char* output, char* line, size_t size) {
+    const char* start = output ? strrchr(output, '\n') : NULL;
+    start = start ? start + 1 : (output ? output : "");
+    size_t len = strcspn(start, "\r\n");
+    if (len >= size) len = 0;
+    memcpy(line, start, len);
+    line[len] = '\0';
+}
+
+/*
+ * URL of the directory holding `version`'s assets, ending in '/'. "latest" is
+ * pinned to the release it currently redirects to, so the checksums and the
+ * asset cannot come from two releases.
+ */
+static bool release_dir(const char* base, const char* version, char* dir, size_t size) {
+    int n;
+    if (version && version[0]) {
+        /* The release tag of a version is the version itself (e.g. 2025.01.15) */
+        n = snprintf(dir, size, "%sdownload/%s/", base, version);
+        return n > 0 && (size_t)n < size;
+    }
+
+    char args[YTDLP_PATH_MAX + 128];
+    snprintf(args, sizeof(args), CURL_OPTIONS " -I -w \"\\n%%{redirect_url}\" \"%slatest/download/" YTDLP_CHECKSUMS_ASSET "\"", base);
+    YtdlpProcessResult result = ytdlp_run_process_cancellable("curl", args, YTDLP_DOWNLOAD_LOOKUP_TIMEOUT_MS, &s_cancelled);
+    if (result.exit_code != 0) return false;
+
+    char location[YTDLP_PATH_MAX];
+    last_line(result.output, location, sizeof(location));
+
+    /* A mirror that serves latest/download/ directly has no redirect */
+    char* slash = strrchr(location, '/');
+    if (!location[0] || !slash) {
+        n = snprintf(dir, size, "%slatest/download/", base);
+    } else {
+        slash[1] = '\0';
+        n = snprintf(dir, size, "%s", location);
+    }
+    return n > 0 && (size_t)n < size;
+}
+
+/* Find `asset` in the release's SHA2-256SUMS ("<hex>  <name>" per line) */
+static bool release_checksum(const char* dir, const char* asset, char hex[65]) {
+    char args[YTDLP_PATH_MAX + 128];
+    snprintf(args, sizeof(args), CURL_OPTIONS " -L \"%s" YTDLP_CHECKSUMS_ASSET "\"", dir);
+    YtdlpProcessResult result = ytdlp_run_process_cancellable("curl", args, YTDLP_DOWNLOAD_LOOKUP_TIMEOUT_MS, &s_cancelled);
+    if (result.exit_code != 0 || !result.output) return false;
+
+    size_t asset_len = strlen(asset);
+    for (const char* line = result.output; *line; ) {
+        size_t len = strcspn(line, "\r\n");
+        const char* name = line + 64;
+
+        bool is_hash = len > 64;
+        for (int i = 0; is_hash && i < 64; i++) {
+            is_hash = isxdigit((unsigned char)line[i]) != 0;
+        }
+        if (is_hash) {
+            while (*name == ' ') name++;
+            if (*name == '*') name++;  /* Binary-mode marker */
+            if ((size_t)(line + len - name) == asset_len && strncmp(name, asset, asset_len) == 0) {
+                for (int i = 0; i < 64; i++) {
+                    hex[i] = (char)tolower((unsigned char)line[i]);
+                }
+                hex[64] = '\0';
+                return true;
+            }
+        }
+
+        line += len;
+        while (*line == '\r' || *line == '\n') line++;
+    }
+    return false;
+}
+
+/* ============================================================================
+ * Transfer
+ * ========================================================================== */
+
+typedef struct Transfer {
+    char args[YTDLP_PATH_MAX * 3 + 256];
+    int exit_code;
+    bool done;
+    YtdlpMutex lock;
+    YtdlpCond cond;
+} Transfer;
+
+static void transfer_thread(void* arg) {
+    Transfer* transfer = (Transfer*)arg;
+    YtdlpProcessResult result = ytdlp_run_process_cancellable("curl", transfer->args, YTDLP_DOWNLOAD_ATTEMPT_TIMEOUT_MS,
+                                                              &s_cancelled);
+
+    ytdlp_mutex_lock(&transfer->lock);
+    transfer->exit_code = result.exit_code;
+    transfer->done = true;
+    ytdlp_cond_signal(&transfer->cond);
+    ytdlp_mutex_unlock(&transfer->lock);
+}
+
+static bool starts_with_nocase(const char* s, const char* prefix) {
+    for (; *prefix; s++, prefix++) {
+        if (tolower((unsigned char)*s) != *prefix) return false;
+    }
+    return true;
+}
+
+/* Status and body length of the last response in a curl -D dump (0 = not yet known) */
+static void read_headers(const char* path, int* status, int64_t* length) {
+    *status = 0;
+    *length = 0;
+
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "HTTP/", 5) == 0) {
+            /* A redirect or 100-continue came before; the next block replaces it */
+            const char* code = strchr(line, ' ');
+            *status = code ? atoi(code + 1) : 0;
+            *length = 0;
+        } else if (starts_with_nocase(line, "content-length:")) {
+            *length = strtoll(line + 15, NULL, 10);
+        }
+    }
+    fclose(f);
+}
+
+/*
+ * One curl run that appends to `part` from its current size. Returns curl's
+ * exit code and the final HTTP status, reporting progress while it runs.
+ */
+static int transfer_once(const char* url, const char* part, const char* headers, int* status,
+                         YtdlpDownloadProgress progress, void* user_data) {
+    int64_t offset = file_size(part);
+    if (offset < 0) offset = 0;
+    remove(headers);
+
+    Transfer transfer;
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.exit_code = -1;
+    snprintf(transfer.args, sizeof(transfer.args), CURL_OPTIONS " -L -C - -D \"%s\" -o \"%s\" \"%s\"",
+             headers, part, url);
+    ytdlp_mutex_init(&transfer.lock);
+    ytdlp_cond_init(&transfer.cond);
+
+    YtdlpThread thread;
+    if (ytdlp_thread_start(&thread, transfer_thread, &transfer)) {
+        float reported = -1.0f;
+
+        ytdlp_mutex_lock(&transfer.lock);
+        while (!transfer.done) {
+            ytdlp_cond_wait_ms(&transfer.cond, &transfer.lock, YTDLP_DOWNLOAD_POLL_MS);
+            if (transfer.done || !progress) continue;
+            ytdlp_mutex_unlock(&transfer.lock);
+
+            int code;
+            int64_t length;
+            read_headers(headers, &code, &length);
+            int64_t size = file_size(part);
+            if ((code == 200 || code == 206) && length > 0 && size >= 0) {
+                float fraction = (float)size / (float)(offset + length);
+                if (fraction > 1.0f) fraction = 1.0f;
+                if (fraction != reported) {
+                    reported = fraction;
+                    progress(fraction, user_data);
+                }
+            }
+
+            ytdlp_mutex_lock(&transfer.lock);
+        }
+        ytdlp_mutex_unlock(&transfer.lock);
+        ytdlp_thread_join(thread);
+    } else {
+        transfer_thread(&transfer);
+    }
+
+    int64_t length;
+    read_headers(headers, status, &length);
+    remove(headers);
+
+    ytdlp_cond_destroy(&transfer.cond);
+    ytdlp_mutex_destroy(&transfer.lock);
+    return transfer.exit_code;
+}
+
+#ifdef _WIN32
+
+/* curl.exe ships with Windows 10 1803 and later; older systems download in
+ * one piece through urlmon, without resuming or progress */
+static bool have_curl(void) {
+    char path[MAX_PATH];
+    return SearchPathA(NULL, "curl.exe", NULL, sizeof(path), path, NULL) != 0;
+}
+
+#endif
+
+/* ============================================================================
+ * Release Downloads
+ * ========================================================================== */
+
+/* Configured release base URL, ending in '/' */
+static void release_base(char* base, size_t size) {
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    snprintf(base, size, "%s", config->release_url[0] ? config->release_url : YTDLP_RELEASES_URL);
+    ytdlp_config_release(config);
+
+    size_t len = strlen(base);
+    if (len > 0 && base[len - 1] != '/' && len + 1 < size) {
+        base[len] = '/';
+        base[len + 1] = '\0';
+    }
+}
+
+bool ytdlp_release_latest(char* version, size_t size) {
+    char base[YTDLP_PATH_MAX], dir[YTDLP_PATH_MAX];
+    release_base(base, sizeof(base));
+    if (!release_dir(base, NULL, dir, sizeof(dir))) return false;
+
+    /* .../download/<tag>/; a mirror without the redirect does not say */
+    size_t len = strlen(dir);
+    if (len < 2) return false;
+    const char* end = dir + len - 1;
+    const char* start = end;
+    while (start > dir && start[-1] != '/') start--;
+
+    size_t tag_len = (size_t)(end - start);
+    if (tag_len == 0 || tag_len >= size || strncmp(start, "download/", 9) == 0) return false;
+    memcpy(version, start, tag_len);
+    version[tag_len] = '\0';
+    return true;
+}
+
+bool ytdlp_release_download(
+    const char* version,
+    const char* asset,
+    const char* path,
+    bool executable,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    char base[YTDLP_PATH_MAX];
+    release_base(base, sizeof(base));
+
+    char dir[YTDLP_PATH_MAX], expected[65];
+    if (!release_dir(base, version, dir, sizeof(dir))) return false;
+    if (!release_checksum(dir, asset, expected)) return false;
+
+    char url[YTDLP_PATH_MAX], part[YTDLP_PATH_MAX], headers[YTDLP_PATH_MAX];
+    int n = snprintf(url, sizeof(url), "%s%s", dir, asset);
+    if (n < 0 || (size_t)n >= sizeof(url)) return false;
+    n = snprintf(part, sizeof(part), "%s.part", path);
+    if (n < 0 || (size_t)n >= sizeof(part)) return false;
+    n = snprintf(headers, sizeof(headers), "%s.part.headers", path);
+    if (n < 0 || (size_t)n >= sizeof(headers)) return false;
+
+    bool verified = false;
+    bool resumable = true;
+
+#ifdef _WIN32
+    resumable = have_curl();
+    if (!resumable) {
+        remove(part);
+        verified = SUCCEEDED(URLDownloadToFileA(NULL, url, part, 0, NULL)) &&
+                   matches_checksum(part, expected);
+        if (!verified) remove(part);
+    }
+#endif
+
+    for (int attempt = 0; resumable && attempt < YTDLP_DOWNLOAD_ATTEMPTS && !verified; attempt++) {
+        if (attempt > 0) sleep_ms(YTDLP_DOWNLOAD_RETRY_DELAY_MS);
+        if (ytdlp_atomic_load_i32(&s_cancelled)) break;
+
+        /* An earlier download may have finished without being installed */
+        bool resumed = file_size(part) > 0;
+        if (resumed && matches_checksum(part, expected)) {
+            verified = true;
+            break;
+        }
+
+        int status = 0;
+        int code = transfer_once(url, part, headers, &status, progress, user_data);
+        if (code == 0) {
+            verified = matches_checksum(part, expected);
+            if (!verified) {
+                remove(part);
+
+                /* A resumed file may have started with bytes of another
+                 * release; a complete transfer that does not match is bad */
+                if (!resumed) break;
+            }
+        } else if (code == CURL_RANGE_ERROR || status == 416) {
+            /* The server cannot continue this file; start over */
+            remove(part);
+        }
+        /* Anything else (timeouts, dropped connections) resumes next attempt */
+    }
+
+    if (!verified) return false;
+
+#ifndef _WIN32
+    if (executable && chmod(part, 0755) != 0) return false;
+#else
+    (void)executable;
+#endif
+
+    if (!replace_file(part, path)) return false;
+
+    if (progress) progress(1.0f, user_data);
+    return true;
+}
+
+void ytdlp_download_set_cancelled(bool cancelled) {
+    ytdlp_atomic_store_i32(&s_cancelled, cancelled ? 1 : 0);
+}
@@ -0,0 +1,160 @@
+/*
+ * Prism yt-dlp Plugin - Error Classes
+ *
+ * Failures surface as text: yt-dlp's stderr, the message of a Python
+ * exception, or one of the plugin's own. The text is matched against a
+ * table of phrases yt-dlp's extractors use, in priority order, so callers
+ * can tell a private or removed video from a network hiccup without
+ * parsing messages themselves.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/* Error lines come last; longer output is matched on its tail */
+#define YTDLP_ERROR_MATCH_MAX 4096
+
+typedef struct ErrorPattern {
+    const char* phrase;  /* Lowercase */
+    PrismYtdlpErrorClass error_class;
+} ErrorPattern;
+
+/*
+ * First match wins, so more specific phrases come before the generic ones
+ * they contain: a geo-blocked YouTube video also reads "Video unavailable",
+ * and a rate-limited page download also reads "Unable to download webpage".
+ */
+static const ErrorPattern s_patterns[] = {
+    { "http error 429", PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "too many requests", PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "rate-limit", PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "rate limit", PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "not a bot", PRISM_YTDLP_ERROR_RATE_LIMITED },
+
+    { "confirm your age", PRISM_YTDLP_ERROR_AGE_GATED },
+    { "age-restricted", PRISM_YTDLP_ERROR_AGE_GATED },
+    { "age restricted", PRISM_YTDLP_ERROR_AGE_GATED },
+    { "inappropriate for some users", PRISM_YTDLP_ERROR_AGE_GATED },
+
+    { "available in your country", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "not available from your location", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "geo restrict", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "geo-restrict", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "georestrict", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "blocked it in your country", PRISM_YTDLP_ERROR_GEO_BLOCKED },
+
+    { "private video", PRISM_YTDLP_ERROR_PRIVATE },
+    { "video is private", PRISM_YTDLP_ERROR_PRIVATE },
+    { "members-only", PRISM_YTDLP_ERROR_PRIVATE },
+    { "join this channel", PRISM_YTDLP_ERROR_PRIVATE },
+    { "requires payment", PRISM_YTDLP_ERROR_PRIVATE },
+    { "login required", PRISM_YTDLP_ERROR_PRIVATE },
+    { "need to log in", PRISM_YTDLP_ERROR_PRIVATE },
+    { "only available for registered users", PRISM_YTDLP_ERROR_PRIVATE },
+
+    { "is offline", PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "not currently live", PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "live event will begin", PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "premieres in", PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "stream has ended", PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+
+    { "has been removed", PRISM_YTDLP_ERROR_REMOVED },
+    { "has been terminated", PRISM_YTDLP_ERROR_REMOVED },
+    { "has been deleted", PRISM_YTDLP_ERROR_REMOVED },
+    { "does not exist", PRISM_YTDLP_ERROR_REMOVED },
+    { "no longer available", PRISM_YTDLP_ERROR_REMOVED },
+    { "copyright claim", PRISM_YTDLP_ERROR_REMOVED },
+    { "video unavailable", PRISM_YTDLP_ERROR_REMOVED },
+    { "http error 404", PRISM_YTDLP_ERROR_REMOVED },
+    { "http error 410", PRISM_YTDLP_ERROR_REMOVED },
+
+    { "unsupported url", PRISM_YTDLP_ERROR_UNSUPPORTED },
+    { "invalid url", PRISM_YTDLP_ERROR_UNSUPPORTED },
+
+    { "unable to extract", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "please report this issue", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "signature extraction failed", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "nsig extraction failed", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "failed to parse json", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "failed to parse yt-dlp output", PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+
+    { "timed out", PRISM_YTDLP_ERROR_TIMEOUT },
+    { "timeout", PRISM_YTDLP_ERROR_TIMEOUT },
+
+    { "unable to download", PRISM_YTDLP_ERROR_NETWORK },
+    { "connection refused", PRISM_YTDLP_ERROR_NETWORK },
+    { "connection reset", PRISM_YTDLP_ERROR_NETWORK },
+    { "connection aborted", PRISM_YTDLP_ERROR_NETWORK },
+    { "remote end closed", PRISM_YTDLP_ERROR_NETWORK },
+    { "name or service not known", PRISM_YTDLP_ERROR_NETWORK },
+    { "temporary failure in name resolution", PRISM_YTDLP_ERROR_NETWORK },
+    { "getaddrinfo failed", PRISM_YTDLP_ERROR_NETWORK },
+    { "nodename nor servname", PRISM_YTDLP_ERROR_NETWORK },
+    { "network is unreachable", PRISM_YTDLP_ERROR_NETWORK },
+    { "no route to host", PRISM_YTDLP_ERROR_NETWORK },
+    { "ssl:", PRISM_YTDLP_ERROR_NETWORK },
+    { "http error 5", PRISM_YTDLP_ERROR_NETWORK },
+    { "urlopen error", PRISM_YTDLP_ERROR_NETWORK },
+
+    { NULL, PRISM_YTDLP_ERROR_UNKNOWN }
+};
+
+PrismYtdlpErrorClass ytdlp_classify_error(const char* text) {
+    if (!text) return PRISM_YTDLP_ERROR_UNKNOWN;
+
+    size_t len = strlen(text);
+    if (len > YTDLP_ERROR_MATCH_MAX) {
+        text += len - YTDLP_ERROR_MATCH_MAX;
+        len = YTDLP_ERROR_MATCH_MAX;
+    }
+
+    /* yt-dlp mixes case freely ("HTTP Error 429", "Private video") */
+    char lower[YTDLP_ERROR_MATCH_MAX + 1];
+    for (size_t i = 0; i < len; i++) {
+        lower[i] = (char)tolower((unsigned char)text[i]);
+    }
+    lower[len] = '\0';
+
+    for (int i = 0; s_patterns[i].phrase; i++) {
+        if (strstr(lower, s_patterns[i].phrase)) return s_patterns[i].error_class;
+    }
+    return PRISM_YTDLP_ERROR_UNKNOWN;
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+PRISM_YTDLP_API bool prism_ytdlp_error_is_transient(PrismYtdlpErrorClass error_class) {
+    switch (error_class) {
+        case PRISM_YTDLP_ERROR_UNKNOWN:
+        case PRISM_YTDLP_ERROR_RATE_LIMITED:
+        case PRISM_YTDLP_ERROR_OFFLINE_LIVE:
+        case PRISM_YTDLP_ERROR_TIMEOUT:
+        case PRISM_YTDLP_ERROR_NETWORK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+PRISM_YTDLP_API const char* prism_ytdlp_error_class_name(PrismYtdlpErrorClass error_class) {
+    switch (error_class) {
+        case PRISM_YTDLP_ERROR_NONE: return "none";
+        case PRISM_YTDLP_ERROR_RATE_LIMITED: return "rate-limited";
+        case PRISM_YTDLP_ERROR_PRIVATE: return "private";
+        case PRISM_YTDLP_ERROR_REMOVED: return "removed";
+        case PRISM_YTDLP_ERROR_GEO_BLOCKED: return "geo-blocked";
+        case PRISM_YTDLP_ERROR_AGE_GATED: return "age-gated";
+        case PRISM_YTDLP_ERROR_OFFLINE_LIVE: return "offline-live";
+        case PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN: return "extractor-broken";
+        case PRISM_YTDLP_ERROR_UNSUPPORTED: return "unsupported";
+        case PRISM_YTDLP_ERROR_TIMEOUT: return "timeout";
+        case PRISM_YTDLP_ERROR_NETWORK: return "network";
+        default: return "unknown";
+    }
+}
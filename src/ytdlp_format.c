@@ -0,0 +1,615 @@
+/*
+ * Prism yt-dlp Plugin - Format Selection
+ *
+ * In-process evaluation of yt-dlp format selectors over an extracted format
+ * ladder, so picking a quality never needs another yt-dlp run.
+ *
+ * Supported syntax is the subset the resolver's fallback chains use, plus
+ * the common single-format forms:
+ *
+ *   alternative ('/' alternative)*       first alternative that selects wins
+ *   alternative = atom ('+' atom)?       a merge needs both sides to select
+ *   atom = name? ('[' filter ']')*
+ *   name = (best|worst|b|w)(video|audio|v|a)?(*)?(.N)? | extension | format id
+ *   filter = key op ['?'] value          numeric: < <= > >= = !=
+ *                                        string:  = ^= $= *=, optionally '!'-negated
+ *
+ * Semantics follow YoutubeDL.build_format_selector: filters narrow the
+ * ladder before the name picks from it, a filter on a missing field fails
+ * unless marked with '?', and best/worst fall back to video- or audio-only
+ * formats when the media has nothing else. Merges behave as without
+ * --video-multistreams/--audio-multistreams. Numeric fields the ladder does
+ * not carry (filesize, abr, ...) count as missing.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SELECTOR_MAX_FILTERS 8
+
+/* ============================================================================
+ * Quality Chains
+ * ========================================================================== */
+
+int ytdlp_quality_height(PrismStreamQuality quality) {
+    switch (quality) {
+        case PRISM_QUALITY_LOW:    return 360;
+        case PRISM_QUALITY_MEDIUM: return 480;
+        case PRISM_QUALITY_HIGH:   return 720;
+        case PRISM_QUALITY_FULL:   return 1080;
+        case PRISM_QUALITY_QHD:    return 1440;
+        case PRISM_QUALITY_4K:     return 2160;
+        case PRISM_QUALITY_AUTO:   return 720;  /* Default to 720p for AUTO */
+        default:
+            /* For numeric values like 360, 720, etc., use directly */
+            if (quality > 0 && quality <= 4320) {
+                return (int)quality;
+            }
+            return 720;  /* Fallback to 720p */
+    }
+}
+
+void ytdlp_format_chain(char* buf, size_t size, bool is_live, int height) {
+    if (is_live) {
+        if (height > 0) {
+            snprintf(buf, size,
+                "best[height<=%d][protocol!=m3u8]/best[height<=%d][protocol!=m3u8_native]/best[height<=%d]",
+                height, height, height);
+        } else {
+            snprintf(buf, size,
+                "best[protocol!=m3u8]/best[protocol!=m3u8_native]/best");
+        }
+    } else {
+        if (height > 0) {
+            snprintf(buf, size,
+                "bestvideo[height<=%d][ext=mp4][protocol!=m3u8]+bestaudio[ext=m4a]/best[height<=%d][ext=mp4][protocol!=m3u8]/best[height<=%d][ext=mp4]/best[ext=mp4]/best",
+                height, height, height);
+        } else {
+            snprintf(buf, size,
+                "bestvideo[ext=mp4][protocol!=m3u8]+bestaudio[ext=m4a]/best[ext=mp4][protocol!=m3u8]/best[ext=mp4]/best");
+        }
+    }
+}
+
+/* ============================================================================
+ * Selector Types
+ * ========================================================================== */
+
+typedef enum FilterOp {
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_PREFIX,
+    OP_SUFFIX,
+    OP_CONTAINS
+} FilterOp;
+
+typedef struct SelectorFilter {
+    const char* key;
+    size_t key_len;
+    FilterOp op;
+    bool numeric;
+    bool negate;          /* String operators only */
+    bool none_inclusive;  /* '?': a missing field passes */
+    double number;
+    const char* value;
+    size_t value_len;
+} SelectorFilter;
+
+typedef enum AtomKind {
+    ATOM_BEST_WORST,
+    ATOM_EXTENSION_AUDIO,
+    ATOM_EXTENSION_VIDEO,
+    ATOM_EXTENSION_STORYBOARD,
+    ATOM_FORMAT_ID
+} AtomKind;
+
+typedef struct SelectorAtom {
+    AtomKind kind;
+    bool best;            /* best (true) or worst */
+    char type;            /* 'v', 'a' or 0 */
+    bool modified;        /* '*' */
+    int index;            /* .N, 1-based */
+    const char* name;
+    size_t name_len;
+    SelectorFilter filters[SELECTOR_MAX_FILTERS];
+    int filter_count;
+} SelectorAtom;
+
+/* Facts about the whole ladder that fallbacks depend on */
+typedef struct SelectContext {
+    bool incomplete_formats;  /* Everything is video-only, or everything is audio-only */
+    bool has_merged_format;   /* Some format carries both video and audio */
+} SelectContext;
+
+/* ============================================================================
+ * Field Access
+ * ========================================================================== */
+
+static bool key_is(const char* key, size_t len, const char* name) {
+    return strlen(name) == len && strncmp(key, name, len) == 0;
+}
+
+/* String field, or NULL when missing or not a string field */
+static const char* string_field(const PrismYtdlpFormat* f, const char* key, size_t len, bool* is_string) {
+    *is_string = true;
+    if (key_is(key, len, "ext")) return f->ext;
+    if (key_is(key, len, "protocol")) return f->protocol;
+    if (key_is(key, len, "vcodec")) return f->video_codec;
+    if (key_is(key, len, "acodec")) return f->audio_codec;
+    if (key_is(key, len, "language")) return f->language;
+    if (key_is(key, len, "format_id")) return f->format_id;
+    *is_string = false;
+    return NULL;
+}
+
+/* Numeric field; false when missing (the ladder uses 0 for unknown) */
+static bool number_field(const PrismYtdlpFormat* f, const char* key, size_t len, double* out) {
+    double value;
+    if (key_is(key, len, "width")) value = f->width;
+    else if (key_is(key, len, "height")) value = f->height;
+    else if (key_is(key, len, "fps")) value = f->fps;
+    else if (key_is(key, len, "tbr")) value = f->tbr;
+    else return false;
+
+    if (value <= 0.0) return false;
+    *out = value;
+    return true;
+}
+
+static bool codec_is_none(const char* codec) {
+    return codec && strcmp(codec, "none") == 0;
+}
+
+/* ============================================================================
+ * Parsing
+ * ========================================================================== */
+
+static bool is_key_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '.' || c == '-';
+}
+
+static const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+/* Parse the contents of one [...] (without brackets) */
+static bool parse_filter(const char* p, const char* end, SelectorFilter* filter) {
+    memset(filter, 0, sizeof(*filter));
+
+    p = skip_spaces(p, end);
+    filter->key = p;
+    while (p < end && is_key_char(*p)) p++;
+    filter->key_len = (size_t)(p - filter->key);
+    if (filter->key_len == 0) return false;
+
+    p = skip_spaces(p, end);
+    if (p < end && *p == '!' && !(p + 1 < end && p[1] == '=')) {
+        filter->negate = true;  /* !^= !$= !*= */
+        p = skip_spaces(p + 1, end);
+    }
+
+    if (end - p >= 2 && p[1] == '=') {
+        switch (p[0]) {
+            case '<': filter->op = OP_LE; break;
+            case '>': filter->op = OP_GE; break;
+            case '!': filter->op = OP_NE; break;
+            case '^': filter->op = OP_PREFIX; break;
+            case '$': filter->op = OP_SUFFIX; break;
+            case '*': filter->op = OP_CONTAINS; break;
+            default:  return false;
+        }
+        p += 2;
+    } else if (p < end && (*p == '<' || *p == '>' || *p == '=')) {
+        filter->op = (*p == '<') ? OP_LT : (*p == '>') ? OP_GT : OP_EQ;
+        p++;
+    } else {
+        return false;
+    }
+
+    p = skip_spaces(p, end);
+    if (p < end && *p == '?') {
+        filter->none_inclusive = true;
+        p = skip_spaces(p + 1, end);
+    }
+
+    const char* value_end = end;
+    while (value_end > p && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+
+    bool quoted = value_end - p >= 2 && (*p == '"' || *p == '\'') && value_end[-1] == *p;
+    if (quoted) {
+        p++;
+        value_end--;
+    }
+    if (value_end <= p) return false;
+
+    filter->value = p;
+    filter->value_len = (size_t)(value_end - p);
+
+    /* Plain numbers compare numerically, like yt-dlp's first filter form */
+    bool digits_only = !quoted;
+    for (const char* c = p; c < value_end; c++) {
+        if (!((*c >= '0' && *c <= '9') || *c == '.')) digits_only = false;
+    }
+
+    if (digits_only && !filter->negate && filter->op <= OP_NE) {
+        filter->numeric = true;
+        filter->number = strtod(p, NULL);
+    } else if (filter->op < OP_EQ) {
+        return false;  /* Ordering needs a number; size suffixes are not supported */
+    } else if (filter->op == OP_NE) {
+        filter->op = OP_EQ;  /* != on strings is negated = */
+        filter->negate = true;
+    }
+
+    return true;
+}
+
+static bool name_in(const char* name, size_t len, const char* const* set) {
+    for (int i = 0; set[i]; i++) {
+        if (key_is(name, len, set[i])) return true;
+    }
+    return false;
+}
+
+static const char* const s_audio_exts[] = {
+    "aiff", "alac", "flac", "m4a", "mka", "mp3", "ogg", "opus", "wav", NULL
+};
+static const char* const s_video_exts[] = {
+    "avi", "flv", "mkv", "mov", "mp4", "webm", "3gp", NULL
+};
+
+/* (best|worst|b|w)(video|audio|v|a)?(\*)?(\.N)? */
+static bool parse_best_worst(const char* p, const char* end, SelectorAtom* atom) {
+    if (end - p >= 4 && strncmp(p, "best", 4) == 0) { atom->best = true; p += 4; }
+    else if (end - p >= 5 && strncmp(p, "worst", 5) == 0) { atom->best = false; p += 5; }
+    else if (p < end && *p == 'b') { atom->best = true; p++; }
+    else if (p < end && *p == 'w') { atom->best = false; p++; }
+    else return false;
+
+    if (end - p >= 5 && strncmp(p, "video", 5) == 0) { atom->type = 'v'; p += 5; }
+    else if (end - p >= 5 && strncmp(p, "audio", 5) == 0) { atom->type = 'a'; p += 5; }
+    else if (p < end && (*p == 'v' || *p == 'a')) { atom->type = *p; p++; }
+
+    if (p < end && *p == '*') {
+        atom->modified = true;
+        p++;
+    }
+
+    atom->index = 1;
+    if (p < end && *p == '.') {
+        p++;
+        if (p >= end || *p < '1' || *p > '9') return false;
+        atom->index = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            atom->index = atom->index * 10 + (*p - '0');
+            p++;
+        }
+    }
+
+    return p == end;
+}
+
+static bool parse_atom(const char* p, const char* end, SelectorAtom* atom) {
+    memset(atom, 0, sizeof(*atom));
+
+    p = skip_spaces(p, end);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+    const char* name_end = p;
+    while (name_end < end && *name_end != '[') name_end++;
+
+    atom->name = p;
+    atom->name_len = (size_t)(name_end - p);
+
+    if (atom->name_len == 0) {
+        atom->kind = ATOM_BEST_WORST;  /* An empty name means best */
+        atom->best = true;
+        atom->index = 1;
+    } else if (parse_best_worst(p, name_end, atom)) {
+        atom->kind = ATOM_BEST_WORST;
+    } else {
+        atom->type = 0;
+        atom->modified = false;
+        atom->best = true;
+        atom->index = 1;
+        if (name_in(p, atom->name_len, s_audio_exts)) atom->kind = ATOM_EXTENSION_AUDIO;
+        else if (name_in(p, atom->name_len, s_video_exts)) atom->kind = ATOM_EXTENSION_VIDEO;
+        else if (key_is(p, atom->name_len, "mhtml")) atom->kind = ATOM_EXTENSION_STORYBOARD;
+        else atom->kind = ATOM_FORMAT_ID;
+    }
+
+    p = name_end;
+    while (p < end) {
+        if (*p != '[') return false;
+        const char* close = memchr(p, ']', (size_t)(end - p));
+        if (!close || atom->filter_count == SELECTOR_MAX_FILTERS) return false;
+        if (!parse_filter(p + 1, close, &atom->filters[atom->filter_count++])) return false;
+        p = close + 1;
+    }
+
+    return true;
+}
+
+/* Find `c` in [p, end) outside of brackets and quotes */
+static const char* find_top_level(const char* p, const char* end, char c) {
+    int depth = 0;
+    char quote = 0;
+    for (; p < end; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            if (depth > 0) quote = *p;
+        } else if (*p == '[') {
+            depth++;
+        } else if (*p == ']') {
+            depth--;
+        } else if (*p == c && depth == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Evaluation
+ * ========================================================================== */
+
+static bool filter_passes(const PrismYtdlpFormat* f, const SelectorFilter* filter) {
+    bool is_string;
+    const char* text = string_field(f, filter->key, filter->key_len, &is_string);
+    double number;
+
+    if (filter->numeric) {
+        if (is_string) {
+            /* A string never equals a number */
+            if (!text) return filter->none_inclusive;
+            return filter->op == OP_NE;
+        }
+        if (!number_field(f, filter->key, filter->key_len, &number)) return filter->none_inclusive;
+
+        switch (filter->op) {
+            case OP_LT: return number < filter->number;
+            case OP_LE: return number <= filter->number;
+            case OP_GT: return number > filter->number;
+            case OP_GE: return number >= filter->number;
+            case OP_EQ: return number == filter->number;
+            case OP_NE: return number != filter->number;
+            default:    return false;
+        }
+    }
+
+    if (!is_string) {
+        if (!number_field(f, filter->key, filter->key_len, &number)) return filter->none_inclusive;
+        return filter->negate;  /* A number never equals a string */
+    }
+    if (!text) return filter->none_inclusive;
+
+    size_t len = strlen(text);
+    bool result;
+    switch (filter->op) {
+        case OP_EQ:
+            result = len == filter->value_len && strncmp(text, filter->value, len) == 0;
+            break;
+        case OP_PREFIX:
+            result = len >= filter->value_len && strncmp(text, filter->value, filter->value_len) == 0;
+            break;
+        case OP_SUFFIX:
+            result = len >= filter->value_len &&
+                     strncmp(text + len - filter->value_len, filter->value, filter->value_len) == 0;
+            break;
+        case OP_CONTAINS: {
+            result = false;
+            for (size_t i = 0; i + filter->value_len <= len && !result; i++) {
+                result = strncmp(text + i, filter->value, filter->value_len) == 0;
+            }
+            break;
+        }
+        default:
+            result = false;
+            break;
+    }
+    return filter->negate ? !result : result;
+}
+
+static bool filters_pass(const PrismYtdlpFormat* f, const SelectorAtom* atom) {
+    for (int i = 0; i < atom->filter_count; i++) {
+        if (!filter_passes(f, &atom->filters[i])) return false;
+    }
+    return true;
+}
+
+static bool ext_is(const PrismYtdlpFormat* f, const SelectorAtom* atom) {
+    return f->ext && key_is(atom->name, atom->name_len, f->ext);
+}
+
+/* The atom's own predicate (yt-dlp's filter_f) */
+static bool atom_accepts(const PrismYtdlpFormat* f, const SelectorAtom* atom) {
+    bool no_video = codec_is_none(f->video_codec);
+    bool no_audio = codec_is_none(f->audio_codec);
+
+    switch (atom->kind) {
+        case ATOM_BEST_WORST: {
+            bool ok;
+            if (atom->type && atom->modified) {
+                ok = (atom->type == 'v') ? !no_video : !no_audio;   /* bv*, ba* */
+            } else if (atom->type) {
+                ok = (atom->type == 'v') ? no_audio : no_video;     /* bv, ba */
+            } else if (!atom->modified) {
+                ok = !no_video && !no_audio;                        /* b, w */
+            } else {
+                ok = true;                                          /* b*, w* */
+            }
+            return ok && (!no_video || !no_audio);
+        }
+        case ATOM_EXTENSION_AUDIO:
+            return ext_is(f, atom) && !no_audio;
+        case ATOM_EXTENSION_VIDEO:
+            return ext_is(f, atom) && !no_audio && !no_video;
+        case ATOM_EXTENSION_STORYBOARD:
+            return ext_is(f, atom) && no_audio && no_video;
+        case ATOM_FORMAT_ID:
+            return f->format_id && strlen(f->format_id) == atom->name_len &&
+                   strncmp(f->format_id, atom->name, atom->name_len) == 0;
+    }
+    return false;
+}
+
+typedef enum MatchPass {
+    PASS_PRIMARY,
+    PASS_INCOMPLETE,   /* best/worst over video- or audio-only media */
+    PASS_SEPARATE      /* video extension when nothing is pre-merged */
+} MatchPass;
+
+static bool pass_accepts(const PrismYtdlpFormat* f, const SelectorAtom* atom, MatchPass pass) {
+    if (!filters_pass(f, atom)) return false;
+
+    switch (pass) {
+        case PASS_PRIMARY:
+            return atom_accepts(f, atom);
+        case PASS_INCOMPLETE:
+            return !codec_is_none(f->video_codec) || !codec_is_none(f->audio_codec);
+        case PASS_SEPARATE:
+            return ext_is(f, atom) && !codec_is_none(f->video_codec);
+    }
+    return false;
+}
+
+/* The index-th match, counting from the best end for best, else the worst */
+static const PrismYtdlpFormat* nth_match(
+    const PrismYtdlpFormatList* list,
+    const SelectorAtom* atom,
+    MatchPass pass,
+    bool* any
+) {
+    int seen = 0;
+    *any = false;
+
+    for (int i = 0; i < list->count; i++) {
+        const PrismYtdlpFormat* f = &list->formats[atom->best ? list->count - 1 - i : i];
+        if (!pass_accepts(f, atom, pass)) continue;
+
+        *any = true;
+        if (++seen == atom->index) return f;
+    }
+    return NULL;
+}
+
+static const PrismYtdlpFormat* select_atom(
+    const PrismYtdlpFormatList* list,
+    const SelectorAtom* atom,
+    const SelectContext* ctx
+) {
+    bool any;
+    const PrismYtdlpFormat* f = nth_match(list, atom, PASS_PRIMARY, &any);
+    if (any) return f;
+
+    bool fallback = atom->kind == ATOM_BEST_WORST && !atom->type && !atom->modified;
+    if (fallback && ctx->incomplete_formats) {
+        return nth_match(list, atom, PASS_INCOMPLETE, &any);
+    }
+    if (atom->kind == ATOM_EXTENSION_VIDEO && !ctx->has_merged_format) {
+        return nth_match(list, atom, PASS_SEPARATE, &any);
+    }
+    return NULL;
+}
+
+/*
+ * yt-dlp's _merge without multistreams: a format that adds no new stream
+ * type (or carries no stream at all) is dropped rather than merged.
+ */
+static void merge_pair(const PrismYtdlpFormat* a, const PrismYtdlpFormat* b, YtdlpFormatSelection* out) {
+    bool a_video = !codec_is_none(a->video_codec);
+    bool a_audio = !codec_is_none(a->audio_codec);
+    bool b_video = !codec_is_none(b->video_codec);
+    bool b_audio = !codec_is_none(b->audio_codec);
+
+    if (!a_video && !a_audio) {
+        out->video = b;
+        out->audio = NULL;
+        return;
+    }
+    if ((!b_video && !b_audio) || (b_audio && a_audio) || (b_video && a_video)) {
+        out->video = a;
+        out->audio = NULL;
+        return;
+    }
+
+    /* Report the merge as video + audio whichever order it was written in */
+    out->video = a_video ? a : b;
+    out->audio = a_video ? b : a;
+}
+
+static void build_context(const PrismYtdlpFormatList* list, SelectContext* ctx) {
+    bool all_video_only = true;
+    bool all_audio_only = true;
+    ctx->has_merged_format = false;
+
+    for (int i = 0; i < list->count; i++) {
+        bool no_video = codec_is_none(list->formats[i].video_codec);
+        bool no_audio = codec_is_none(list->formats[i].audio_codec);
+
+        if (no_video || !no_audio) all_video_only = false;
+        if (!no_video || no_audio) all_audio_only = false;
+        if (!no_video && !no_audio) ctx->has_merged_format = true;
+    }
+
+    ctx->incomplete_formats = all_video_only || all_audio_only;
+}
+
+bool ytdlp_format_select(
+    const PrismYtdlpFormatList* list,
+    const char* selector,
+    YtdlpFormatSelection* out
+) {
+    out->video = NULL;
+    out->audio = NULL;
+    if (!list || !selector) return false;
+
+    SelectContext ctx;
+    build_context(list, &ctx);
+
+    const char* p = selector;
+    const char* end = selector + strlen(selector);
+
+    while (p <= end) {
+        const char* slash = find_top_level(p, end, '/');
+        const char* alt_end = slash ? slash : end;
+        const char* plus = find_top_level(p, alt_end, '+');
+
+        SelectorAtom first;
+        SelectorAtom second;
+        if (!parse_atom(p, plus ? plus : alt_end, &first)) return false;
+        if (plus && (find_top_level(plus + 1, alt_end, '+') ||
+                     !parse_atom(plus + 1, alt_end, &second))) {
+            return false;  /* Merges of more than two formats are not supported */
+        }
+
+        const PrismYtdlpFormat* a = select_atom(list, &first, &ctx);
+        const PrismYtdlpFormat* b = (a && plus) ? select_atom(list, &second, &ctx) : NULL;
+
+        if (a && !plus) {
+            out->video = a;
+            return true;
+        }
+        if (a && b) {
+            merge_pair(a, b, out);
+            return true;
+        }
+
+        if (!slash) break;
+        p = slash + 1;
+    }
+
+    return false;
+}
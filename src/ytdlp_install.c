@@ -0,0 +1,556 @@
+/*
+ * Prism yt-dlp Plugin - yt-dlp Installs
+ *
+ * The onefile yt-dlp builds are PyInstaller bundles that unpack their Python
+ * runtime into a temporary directory on every launch, and the plugin launches
+ * yt-dlp for every resolve. Each release also ships the same build as an
+ * onedir zip, which the plugin extracts once and launches from instead.
+ *
+ * Releases are installed side by side in <install_dir>/yt-dlp-versions/<version>,
+ * each holding the unpacked build or, where the platform has none, the
+ * onefile binary. The file `current` there names the version in use and is
+ * replaced with one rename, so an install or update never touches files a
+ * running yt-dlp is using. The version it replaces is kept for processes
+ * that have not switched yet. Older versions are removed, each once the last
+ * yt-dlp this process runs from it has exited.
+ *
+ * The version an executable reported at install time is recorded next to
+ * it, and a version is only used while its executable still reports it, so a
+ * partial or damaged directory is never launched. Earlier plugin versions
+ * extracted into <install_dir>/yt-dlp-unpacked; those layouts are still found.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <dirent.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_UNPACKED_MARKER ".prism-version"
+#define YTDLP_UNPACKED_VERSION_TIMEOUT_MS 15000   /* First launch may be slowed by scanners */
+#define YTDLP_UNPACKED_EXTRACT_TIMEOUT_MS 300000
+
+/* Onedir release asset and the executable inside it */
+#if defined(_WIN32)
+    #define UNPACKED_ASSET "yt-dlp_win.zip"
+    #define UNPACKED_EXE "yt-dlp.exe"
+    #define PATH_SEPARATOR "\\"
+#elif defined(__APPLE__)
+    #define UNPACKED_ASSET "yt-dlp_macos.zip"
+    #define UNPACKED_EXE "yt-dlp_macos"
+    #define PATH_SEPARATOR "/"
+#elif defined(__linux__) && defined(__x86_64__)
+    #define UNPACKED_ASSET "yt-dlp_linux.zip"
+    #define UNPACKED_EXE "yt-dlp_linux"
+    #define PATH_SEPARATOR "/"
+#else
+    #define UNPACKED_ASSET ""             /* No onedir build for this platform */
+    #define UNPACKED_EXE "yt-dlp"
+    #define PATH_SEPARATOR "/"
+#endif
+
+/* ============================================================================
+ * Files
+ * ========================================================================== */
+
+static bool path_exists(const char* path) {
+#ifdef _WIN32
+    return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
+#else
+    return access(path, F_OK) == 0;
+#endif
+}
+
+static bool make_directory(const char* path) {
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) != 0;
+#else
+    return mkdir(path, 0755) == 0;
+#endif
+}
+
+static bool read_version_file(const char* path, char* version, size_t size) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    bool ok = fgets(version, (int)size, f) != NULL;
+    fclose(f);
+
+    if (ok) version[strcspn(version, "\r\n")] = '\0';
+    return ok && version[0];
+}
+
+static bool write_version_file(const char* path, const char* version) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    bool ok = fprintf(f, "%s\n", version) > 0;
+    return fclose(f) == 0 && ok;
+}
+
+static bool read_marker(const char* dir, char* version, size_t size) {
+    char path[YTDLP_PATH_MAX];
+    snprintf(path, sizeof(path), "%s" PATH_SEPARATOR YTDLP_UNPACKED_MARKER, dir);
+    return read_version_file(path, version, size);
+}
+
+static bool write_marker(const char* dir, const char* version) {
+    char path[YTDLP_PATH_MAX];
+    snprintf(path, sizeof(path), "%s" PATH_SEPARATOR YTDLP_UNPACKED_MARKER, dir);
+    return write_version_file(path, version);
+}
+
+#ifdef _WIN32
+
+static void remove_tree(const char* path) {
+    DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES) return;
+
+    if (!(attributes & FILE_ATTRIBUTE_DIRECTORY) || (attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+        if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+            RemoveDirectoryA(path);
+        } else {
+            DeleteFileA(path);
+        }
+        return;
+    }
+
+    char pattern[YTDLP_PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s\\*", path);
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+
+            char child[YTDLP_PATH_MAX];
+            snprintf(child, sizeof(child), "%s\\%s", path, entry.cFileName);
+            remove_tree(child);
+        } while (FindNextFileA(find, &entry));
+        FindClose(find);
+    }
+
+    RemoveDirectoryA(path);
+}
+
+static bool move_path(const char* from, const char* to) {
+    return MoveFileExA(from, to, 0) != 0;
+}
+
+static bool replace_file(const char* from, const char* to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+/* Call `fn` with the name of every entry of `dir` except . and .. */
+static void list_directory(const char* dir, void (*fn)(const char* name, void* context), void* context) {
+    char pattern[YTDLP_PATH_MAX];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+        fn(entry.cFileName, context);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+}
+
+#else /* POSIX */
+
+static void remove_tree(const char* path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) return;
+
+    if (!S_ISDIR(st.st_mode)) {
+        unlink(path);
+        return;
+    }
+
+    DIR* d = opendir(path);
+    if (d) {
+        struct dirent* entry;
+        while ((entry = readdir(d)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+            char child[YTDLP_PATH_MAX];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            remove_tree(child);
+        }
+        closedir(d);
+    }
+
+    rmdir(path);
+}
+
+static bool move_path(const char* from, const char* to) {
+    return rename(from, to) == 0;
+}
+
+static bool replace_file(const char* from, const char* to) {
+    return rename(from, to) == 0;
+}
+
+/* Call `fn` with the name of every entry of `dir` except . and .. */
+static void list_directory(const char* dir, void (*fn)(const char* name, void* context), void* context) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        fn(entry->d_name, context);
+    }
+    closedir(d);
+}
+
+#endif
+
+/* ============================================================================
+ * Extraction
+ * ========================================================================== */
+
+#ifdef _WIN32
+
+/* tar.exe ships with Windows 10 and later and reads zip archives */
+bool ytdlp_extract_zip(const char* zip, const char* dir) {
+    char args[YTDLP_PATH_MAX * 2 + 32];
+    snprintf(args, sizeof(args), "-xf \"%s\" -C \"%s\"", zip, dir);
+    return ytdlp_run_process("tar", args, YTDLP_UNPACKED_EXTRACT_TIMEOUT_MS).exit_code == 0;
+}
+
+#else /* POSIX */
+
+/* unzip is not installed everywhere; Python's zipfile module is the fallback */
+bool ytdlp_extract_zip(const char* zip, const char* dir) {
+    char args[YTDLP_PATH_MAX * 2 + 32];
+    snprintf(args, sizeof(args), "-qo \"%s\" -d \"%s\"", zip, dir);
+    if (ytdlp_run_process("unzip", args, YTDLP_UNPACKED_EXTRACT_TIMEOUT_MS).exit_code == 0) return true;
+
+    snprintf(args, sizeof(args), "-m zipfile -e \"%s\" \"%s\"", zip, dir);
+    return ytdlp_run_process("python3", args, YTDLP_UNPACKED_EXTRACT_TIMEOUT_MS).exit_code == 0;
+}
+
+#endif
+
+/* ============================================================================
+ * Unpacked Layout
+ * ========================================================================== */
+
+static void layout_dir(const char* install_dir, char* dir, size_t size) {
+    snprintf(dir, size, "%s" PATH_SEPARATOR YTDLP_UNPACKED_DIR, install_dir);
+}
+
+static bool layout_exe(const char* dir, char* exe, size_t size) {
+    int n = snprintf(exe, size, "%s" PATH_SEPARATOR UNPACKED_EXE, dir);
+    return n > 0 && (size_t)n < size;
+}
+
+bool ytdlp_tool_version(const char* path, char* version, size_t size) {
+    YtdlpProcessResult result = ytdlp_run_process(path, "--version", YTDLP_UNPACKED_VERSION_TIMEOUT_MS);
+    if (result.exit_code != 0 || !result.output) return false;
+
+    char* start = result.output;
+    while (isspace((unsigned char)*start)) start++;
+    size_t len = strcspn(start, "\r\n");
+    while (len > 0 && isspace((unsigned char)start[len - 1])) len--;
+    if (len == 0 || len >= size) return false;
+
+    memcpy(version, start, len);
+    version[len] = '\0';
+    return true;
+}
+
+bool ytdlp_unpacked_find(const char* install_dir, char* path, size_t size) {
+    if (!install_dir || !install_dir[0] || !UNPACKED_ASSET[0]) return false;
+
+    char dir[YTDLP_PATH_MAX];
+    layout_dir(install_dir, dir, sizeof(dir));
+
+    char exe[YTDLP_PATH_MAX];
+    char recorded[64], reported[64];
+    if (!layout_exe(dir, exe, sizeof(exe)) || !path_exists(exe) || !read_marker(dir, recorded, sizeof(recorded))) return false;
+    if (!ytdlp_tool_version(exe, reported, sizeof(reported)) || strcmp(recorded, reported) != 0) return false;
+
+    snprintf(path, size, "%s", exe);
+    return true;
+}
+
+/* ============================================================================
+ * Side-by-side Versions
+ * ========================================================================== */
+
+#define YTDLP_VERSIONS_CURRENT "current"
+
+/* <install_dir>/yt-dlp-versions, or an entry in it when `name` is given */
+static bool versions_path(const char* install_dir, const char* name, char* path, size_t size) {
+    int n = name ? snprintf(path, size, "%s" PATH_SEPARATOR YTDLP_VERSIONS_DIR PATH_SEPARATOR "%s", install_dir, name)
+                 : snprintf(path, size, "%s" PATH_SEPARATOR YTDLP_VERSIONS_DIR, install_dir);
+    return n > 0 && (size_t)n < size;
+}
+
+/* The executable of a version directory: the unpacked build's, else the onefile binary */
+static bool version_exe(const char* dir, const char* onefile_asset, char* exe, size_t size) {
+    if (UNPACKED_ASSET[0] && layout_exe(dir, exe, size) && path_exists(exe)) return true;
+
+    int n = snprintf(exe, size, "%s" PATH_SEPARATOR "%s", dir, onefile_asset);
+    return n > 0 && (size_t)n < size && path_exists(exe);
+}
+
+/* Whether `dir` holds a complete install whose executable reports the recorded version */
+static bool version_usable(const char* dir, const char* onefile_asset, char* exe, size_t size) {
+    char recorded[64], reported[64];
+    return version_exe(dir, onefile_asset, exe, size) &&
+           read_marker(dir, recorded, sizeof(recorded)) &&
+           ytdlp_tool_version(exe, reported, sizeof(reported)) &&
+           strcmp(recorded, reported) == 0;
+}
+
+static bool read_current(const char* install_dir, char* version, size_t size) {
+    char path[YTDLP_PATH_MAX];
+    return versions_path(install_dir, YTDLP_VERSIONS_CURRENT, path, sizeof(path)) &&
+           read_version_file(path, version, size);
+}
+
+/* Point `current` at `version` with a single rename */
+static bool write_current(const char* install_dir, const char* version) {
+    char path[YTDLP_PATH_MAX], temp[YTDLP_PATH_MAX];
+    if (!versions_path(install_dir, YTDLP_VERSIONS_CURRENT, path, sizeof(path)) ||
+        !versions_path(install_dir, "." YTDLP_VERSIONS_CURRENT, temp, sizeof(temp))) {
+        return false;
+    }
+    return write_version_file(temp, version) && replace_file(temp, path);
+}
+
+/*
+ * Versions this process is running yt-dlp from. A version pruned while runs
+ * from it are in flight is retired instead, and removed by the last of them.
+ */
+#define YTDLP_VERSIONS_IN_USE_MAX 8
+
+typedef struct VersionUse {
+    char dir[YTDLP_PATH_MAX];  /* Version directory; empty when the slot is free */
+    int runs;
+    bool retired;
+} VersionUse;
+
+static YtdlpMutex s_use_lock = YTDLP_MUTEX_INIT;
+static VersionUse s_uses[YTDLP_VERSIONS_IN_USE_MAX];
+
+/* The version directory `path` runs from, if it is inside a versioned install */
+static bool version_dir_of(const char* path, char* dir, size_t size) {
+    const char* marker = PATH_SEPARATOR YTDLP_VERSIONS_DIR PATH_SEPARATOR;
+    const char* found = NULL;
+    for (const char* p = strstr(path, marker); p; p = strstr(p + 1, marker)) {
+        found = p;
+    }
+    if (!found) return false;
+
+    const char* name = found + strlen(marker);
+    size_t len = (size_t)(name - path) + strcspn(name, PATH_SEPARATOR);
+    if (name[0] == '\0' || name[0] == '.' || len >= size) return false;
+
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+    return true;
+}
+
+static VersionUse* find_use(const char* dir) {
+    for (int i = 0; i < YTDLP_VERSIONS_IN_USE_MAX; i++) {
+        if (s_uses[i].dir[0] && strcmp(s_uses[i].dir, dir) == 0) return &s_uses[i];
+    }
+    return NULL;
+}
+
+void ytdlp_versions_run_begin(const char* path) {
+    char dir[YTDLP_PATH_MAX];
+    if (!path || !version_dir_of(path, dir, sizeof(dir))) return;
+
+    ytdlp_mutex_lock(&s_use_lock);
+    VersionUse* use = find_use(dir);
+    for (int i = 0; !use && i < YTDLP_VERSIONS_IN_USE_MAX; i++) {
+        if (!s_uses[i].dir[0]) {
+            use = &s_uses[i];
+            snprintf(use->dir, sizeof(use->dir), "%s", dir);
+            use->retired = false;
+        }
+    }
+    if (use) use->runs++;  /* Untracked when full: the previous version is kept anyway */
+    ytdlp_mutex_unlock(&s_use_lock);
+}
+
+void ytdlp_versions_run_end(const char* path) {
+    char dir[YTDLP_PATH_MAX];
+    if (!path || !version_dir_of(path, dir, sizeof(dir))) return;
+
+    bool remove = false;
+    ytdlp_mutex_lock(&s_use_lock);
+    VersionUse* use = find_use(dir);
+    if (use && --use->runs <= 0) {
+        remove = use->retired;
+        use->dir[0] = '\0';
+    }
+    ytdlp_mutex_unlock(&s_use_lock);
+
+    if (remove) remove_tree(dir);
+}
+
+/* Set whether the last run from `dir` removes it; false if nothing runs from it */
+static bool set_retired(const char* dir, bool retired) {
+    ytdlp_mutex_lock(&s_use_lock);
+    VersionUse* use = find_use(dir);
+    if (use) use->retired = retired;
+    ytdlp_mutex_unlock(&s_use_lock);
+    return use != NULL;
+}
+
+typedef struct PruneVersions {
+    const char* install_dir;
+    const char* keep;
+    const char* previous;
+} PruneVersions;
+
+static void prune_entry(const char* name, void* context) {
+    const PruneVersions* prune = (const PruneVersions*)context;
+
+    /* Dot entries are the pointer's temporary and partial downloads, which resume */
+    if (name[0] == '.' || strcmp(name, YTDLP_VERSIONS_CURRENT) == 0) return;
+
+    char path[YTDLP_PATH_MAX];
+    if (!versions_path(prune->install_dir, name, path, sizeof(path))) return;
+
+    /* A version switched back to must outlive runs that retired it */
+    bool keep = strcmp(name, prune->keep) == 0 || strcmp(name, prune->previous) == 0;
+    if (!set_retired(path, !keep) && !keep) {
+        remove_tree(path);  /* On Windows, fails harmlessly while another process runs from it */
+    }
+}
+
+/* Download `version` into a new directory, returning the version it reports */
+static bool stage_version(
+    const char* install_dir,
+    const char* version,
+    const char* onefile_asset,
+    char* reported,
+    size_t reported_size,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    char staging[YTDLP_PATH_MAX], zip[YTDLP_PATH_MAX], exe[YTDLP_PATH_MAX];
+    if (!versions_path(install_dir, ".partial", staging, sizeof(staging)) ||
+        !versions_path(install_dir, ".download.zip", zip, sizeof(zip))) {
+        return false;
+    }
+
+    remove_tree(staging);
+    if (!make_directory(staging)) return false;
+
+    /* The unpacked build where there is one; an interrupted download is kept
+     * in <zip>.part and resumed */
+    bool ok = false;
+    if (UNPACKED_ASSET[0]) {
+        ok = ytdlp_release_download(version, UNPACKED_ASSET, zip, false, progress, user_data) &&
+             ytdlp_extract_zip(zip, staging) && layout_exe(staging, exe, sizeof(exe));
+        remove_tree(zip);
+#ifndef _WIN32
+        /* Python's zipfile drops the executable bit */
+        if (ok) ok = chmod(exe, 0755) == 0;
+#endif
+        if (!ok) {
+            remove_tree(staging);
+            if (!make_directory(staging)) return false;
+        }
+    }
+
+    if (!ok) {
+        char name[YTDLP_PATH_MAX], download[YTDLP_PATH_MAX];
+        int n = snprintf(exe, sizeof(exe), "%s" PATH_SEPARATOR "%s", staging, onefile_asset);
+        snprintf(name, sizeof(name), ".download-%s", onefile_asset);
+        ok = n > 0 && (size_t)n < sizeof(exe) && versions_path(install_dir, name, download, sizeof(download)) &&
+             ytdlp_release_download(version, onefile_asset, download, true, progress, user_data) &&
+             move_path(download, exe);
+    }
+
+    /* The build must run, and be the release that was asked for */
+    if (ok) ok = ytdlp_tool_version(exe, reported, reported_size);
+    if (ok && version && version[0]) ok = strcmp(reported, version) == 0;
+    if (ok) ok = write_marker(staging, reported);
+
+    if (!ok) remove_tree(staging);
+    return ok;
+}
+
+bool ytdlp_versions_install(
+    const char* install_dir,
+    const char* version,
+    const char* onefile_asset,
+    char* path,
+    size_t size,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    if (!install_dir || !install_dir[0]) return false;
+
+    char root[YTDLP_PATH_MAX], dir[YTDLP_PATH_MAX];
+    if (!versions_path(install_dir, NULL, root, sizeof(root))) return false;
+    make_directory(root);
+
+    /* A version installed earlier only needs switching to */
+    char installed[64] = "";
+    if (version && version[0] && versions_path(install_dir, version, dir, sizeof(dir)) &&
+        version_usable(dir, onefile_asset, path, size)) {
+        snprintf(installed, sizeof(installed), "%s", version);
+    }
+
+    if (!installed[0]) {
+        if (!stage_version(install_dir, version, onefile_asset, installed, sizeof(installed),
+                           progress, user_data)) {
+            return false;
+        }
+
+        char staging[YTDLP_PATH_MAX];
+        versions_path(install_dir, ".partial", staging, sizeof(staging));
+        if (!versions_path(install_dir, installed, dir, sizeof(dir))) {
+            remove_tree(staging);
+            return false;
+        }
+
+        /* Keep an intact copy of the same version, which may be running */
+        if (version_usable(dir, onefile_asset, path, size)) {
+            remove_tree(staging);
+        } else {
+            remove_tree(dir);
+            if (!move_path(staging, dir) || !version_exe(dir, onefile_asset, path, size)) {
+                remove_tree(staging);
+                return false;
+            }
+        }
+    }
+
+    char previous[64] = "";
+    read_current(install_dir, previous, sizeof(previous));
+    if (strcmp(previous, installed) != 0 && !write_current(install_dir, installed)) {
+        return false;
+    }
+
+    PruneVersions prune = { install_dir, installed, previous };
+    list_directory(root, prune_entry, &prune);
+    return true;
+}
+
+bool ytdlp_versions_find(const char* install_dir, const char* onefile_asset, char* path, size_t size) {
+    if (!install_dir || !install_dir[0]) return false;
+
+    char current[64], dir[YTDLP_PATH_MAX];
+    return read_current(install_dir, current, sizeof(current)) &&
+           versions_path(install_dir, current, dir, sizeof(dir)) &&
+           version_usable(dir, onefile_asset, path, size);
+}
@@ -0,0 +1,902 @@
+/*
+ * Prism yt-dlp Plugin - Internal Declarations
+ *
+ * Shared between the plugin translation units. Not installed.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#ifndef PRISM_YTDLP_INTERNAL_H
+#define PRISM_YTDLP_INTERNAL_H
+
+#include "prism_ytdlp_plugin.h"
+#include <prism/prism_resolver.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+    #define YTDLP_THREAD_LOCAL __declspec(thread)
+#else
+    #define YTDLP_THREAD_LOCAL _Thread_local
+#endif
+
+/* ============================================================================
+ * Atomics
+ * ========================================================================== */
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+
+static inline uint64_t ytdlp_atomic_add_u64(volatile uint64_t* p, uint64_t v) {
+    return (uint64_t)InterlockedExchangeAdd64((volatile LONG64*)p, (LONG64)v) + v;
+}
+static inline uint64_t ytdlp_atomic_load_u64(volatile uint64_t* p) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+}
+static inline void ytdlp_atomic_store_u64(volatile uint64_t* p, uint64_t v) {
+    InterlockedExchange64((volatile LONG64*)p, (LONG64)v);
+}
+static inline int32_t ytdlp_atomic_add_i32(volatile int32_t* p, int32_t v) {
+    return (int32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v) + v;
+}
+static inline int32_t ytdlp_atomic_load_i32(volatile int32_t* p) {
+    return (int32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+static inline void ytdlp_atomic_store_i32(volatile int32_t* p, int32_t v) {
+    InterlockedExchange((volatile LONG*)p, (LONG)v);
+}
+static inline bool ytdlp_atomic_cas_i32(volatile int32_t* p, int32_t expected, int32_t desired) {
+    return InterlockedCompareExchange((volatile LONG*)p, (LONG)desired, (LONG)expected) == (LONG)expected;
+}
+static inline void* ytdlp_atomic_load_ptr(void* volatile* p) {
+    return InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+static inline void* ytdlp_atomic_exchange_ptr(void* volatile* p, void* v) {
+    return InterlockedExchangePointer(p, v);
+}
+static inline void ytdlp_atomic_fence(void) {
+    MemoryBarrier();
+}
+#else
+static inline uint64_t ytdlp_atomic_add_u64(volatile uint64_t* p, uint64_t v) {
+    return __atomic_add_fetch(p, v, __ATOMIC_RELAXED);
+}
+static inline uint64_t ytdlp_atomic_load_u64(volatile uint64_t* p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+static inline void ytdlp_atomic_store_u64(volatile uint64_t* p, uint64_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+static inline int32_t ytdlp_atomic_add_i32(volatile int32_t* p, int32_t v) {
+    return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+}
+static inline int32_t ytdlp_atomic_load_i32(volatile int32_t* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+static inline void ytdlp_atomic_store_i32(volatile int32_t* p, int32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+static inline bool ytdlp_atomic_cas_i32(volatile int32_t* p, int32_t expected, int32_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline void* ytdlp_atomic_load_ptr(void* volatile* p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+static inline void* ytdlp_atomic_exchange_ptr(void* volatile* p, void* v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+static inline void ytdlp_atomic_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+/* ============================================================================
+ * Mutex and Condition Variable
+ *
+ * Statically initializable: YtdlpMutex m = YTDLP_MUTEX_INIT;
+ * ========================================================================== */
+
+#ifdef _WIN32
+typedef SRWLOCK YtdlpMutex;
+typedef CONDITION_VARIABLE YtdlpCond;
+#define YTDLP_MUTEX_INIT SRWLOCK_INIT
+#define YTDLP_COND_INIT CONDITION_VARIABLE_INIT
+static inline void ytdlp_mutex_init(YtdlpMutex* m) { InitializeSRWLock(m); }
+static inline void ytdlp_mutex_destroy(YtdlpMutex* m) { (void)m; }
+static inline void ytdlp_mutex_lock(YtdlpMutex* m) { AcquireSRWLockExclusive(m); }
+static inline void ytdlp_mutex_unlock(YtdlpMutex* m) { ReleaseSRWLockExclusive(m); }
+static inline void ytdlp_cond_init(YtdlpCond* c) { InitializeConditionVariable(c); }
+static inline void ytdlp_cond_destroy(YtdlpCond* c) { (void)c; }
+static inline void ytdlp_cond_wait(YtdlpCond* c, YtdlpMutex* m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+static inline void ytdlp_cond_signal(YtdlpCond* c) { WakeConditionVariable(c); }
+static inline void ytdlp_cond_broadcast(YtdlpCond* c) { WakeAllConditionVariable(c); }
+#else
+#include <pthread.h>
+typedef pthread_mutex_t YtdlpMutex;
+typedef pthread_cond_t YtdlpCond;
+#define YTDLP_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define YTDLP_COND_INIT PTHREAD_COND_INITIALIZER
+static inline void ytdlp_mutex_init(YtdlpMutex* m) { pthread_mutex_init(m, NULL); }
+static inline void ytdlp_mutex_destroy(YtdlpMutex* m) { pthread_mutex_destroy(m); }
+static inline void ytdlp_mutex_lock(YtdlpMutex* m) { pthread_mutex_lock(m); }
+static inline void ytdlp_mutex_unlock(YtdlpMutex* m) { pthread_mutex_unlock(m); }
+static inline void ytdlp_cond_init(YtdlpCond* c) { pthread_cond_init(c, NULL); }
+static inline void ytdlp_cond_destroy(YtdlpCond* c) { pthread_cond_destroy(c); }
+static inline void ytdlp_cond_wait(YtdlpCond* c, YtdlpMutex* m) { pthread_cond_wait(c, m); }
+static inline void ytdlp_cond_signal(YtdlpCond* c) { pthread_cond_signal(c); }
+static inline void ytdlp_cond_broadcast(YtdlpCond* c) { pthread_cond_broadcast(c); }
+#endif
+
+/* ============================================================================
+ * Platform (ytdlp_platform.c)
+ * ========================================================================== */
+
+/* Milliseconds from an arbitrary fixed point; never goes backwards */
+uint64_t ytdlp_monotonic_ms(void);
+
+/* Give up the rest of the current time slice */
+void ytdlp_thread_yield(void);
+
+void ytdlp_sleep_ms(uint32_t ms);
+
+/* Wait on `cond` for at most `timeout_ms`; spurious wakeups are possible */
+void ytdlp_cond_wait_ms(YtdlpCond* cond, YtdlpMutex* mutex, uint32_t timeout_ms);
+
+#ifdef _WIN32
+typedef HANDLE YtdlpThread;
+#else
+typedef pthread_t YtdlpThread;
+#endif
+
+/* Run `fn(arg)` on a new joinable thread */
+bool ytdlp_thread_start(YtdlpThread* thread, void (*fn)(void*), void* arg);
+void ytdlp_thread_join(YtdlpThread thread);
+bool ytdlp_thread_is_current(YtdlpThread thread);
+
+/* ============================================================================
+ * Processes (ytdlp_resolver.c)
+ * ========================================================================== */
+
+/* Output and error live in the calling thread's scratch buffers and are only
+ * valid until the next ytdlp_run_process() on the same thread. */
+typedef struct YtdlpProcessResult {
+    char* output;
+    const char* error;
+    int exit_code;
+} YtdlpProcessResult;
+
+/* Run `command` with space-separated `args` ("..." quotes one argument) in
+ * its own process group (job object on Windows); a timeout kills the group */
+YtdlpProcessResult ytdlp_run_process(const char* command, const char* args, int timeout_ms);
+
+/* As ytdlp_run_process(), but the child is also killed once `*cancel` becomes
+ * nonzero ("Process cancelled") */
+YtdlpProcessResult ytdlp_run_process_cancellable(
+    const char* command,
+    const char* args,
+    int timeout_ms,
+    volatile int32_t* cancel
+);
+
+/* Kill every running child with the processes it started, and wait for the
+ * runs to reap them. Runs return "Process cancelled". */
+void ytdlp_process_shutdown(void);
+
+#ifndef _WIN32
+/* pipe() with both ends close-on-exec, atomically where pipe2() exists */
+bool ytdlp_make_pipe(int fds[2]);
+#endif
+
+/* Network limits for an extraction that has `budget_ms` left (<= 0 = none):
+ * yt-dlp's socket timeout in seconds, short enough that a stalled request
+ * leaves time to retry, and how many extractor retries fit */
+void ytdlp_network_limits(int budget_ms, int* socket_timeout_s, int* retries);
+
+/* ============================================================================
+ * Configuration Snapshots (ytdlp_config.c)
+ *
+ * The active configuration is an immutable, reference-counted snapshot.
+ * Readers take a reference without locking and keep a consistent view for as
+ * long as they hold it; writers copy, edit and publish a replacement, so a
+ * reconfiguration never waits for in-flight resolves.
+ * ========================================================================== */
+
+#define YTDLP_PATH_MAX 1024
+
+typedef struct YtdlpConfig {
+    volatile int32_t refs;
+    char ytdlp_path[YTDLP_PATH_MAX];
+    char install_dir[YTDLP_PATH_MAX];
+    bool auto_download;
+    int process_timeout_ms;
+    char cache_dir[YTDLP_PATH_MAX];   /* yt-dlp --cache-dir (empty = default location) */
+    int cache_dir_max_mb;             /* Size bound of cache_dir (<0 = yt-dlp's own cache) */
+    PrismYtdlpBackend backend;
+    char python_library[YTDLP_PATH_MAX];
+    char python_path[YTDLP_PATH_MAX];
+    char python_executable[YTDLP_PATH_MAX];
+    char release_url[YTDLP_PATH_MAX]; /* Base of release downloads (empty = GitHub) */
+    char shared_cache_name[64];       /* Shared memory cache segment (empty = none) */
+    int shared_cache_mb;
+    char daemon_endpoints[YTDLP_PATH_MAX]; /* Resolve daemons to forward to, comma-separated (empty = none) */
+} YtdlpConfig;
+
+/*
+ * A slot holds the currently published snapshot. There is one global slot;
+ * resolvers created with their own settings own another.
+ */
+typedef struct YtdlpConfigSlot {
+    void* volatile current;
+    volatile int32_t epoch;
+    volatile int32_t readers[2];
+    YtdlpMutex writer_lock;
+} YtdlpConfigSlot;
+
+YtdlpConfigSlot* ytdlp_config_global(void);
+
+bool ytdlp_config_slot_init(YtdlpConfigSlot* slot, const YtdlpConfig* initial);
+void ytdlp_config_slot_destroy(YtdlpConfigSlot* slot);
+
+/* Take a reference to the slot's current snapshot. Never returns NULL. */
+const YtdlpConfig* ytdlp_config_slot_acquire(YtdlpConfigSlot* slot);
+void ytdlp_config_release(const YtdlpConfig* config);
+
+/* Start an update: returns a private copy of the current snapshot with the
+ * slot's writer lock held. Finish with exactly one of commit or abort. */
+YtdlpConfig* ytdlp_config_slot_begin_update(YtdlpConfigSlot* slot);
+void ytdlp_config_slot_commit(YtdlpConfigSlot* slot, YtdlpConfig* config);
+void ytdlp_config_slot_abort(YtdlpConfigSlot* slot, YtdlpConfig* config);
+
+/* Shorthands for the global slot */
+const YtdlpConfig* ytdlp_config_acquire(void);
+YtdlpConfig* ytdlp_config_begin_update(void);
+void ytdlp_config_commit(YtdlpConfig* config);
+void ytdlp_config_abort(YtdlpConfig* config);
+
+/* ============================================================================
+ * Counted Heap Allocation (ytdlp_arena.c)
+ *
+ * Every heap allocation the plugin makes goes through these so the number of
+ * allocations per resolve can be reported.
+ * ========================================================================== */
+
+void* ytdlp_malloc(size_t size);
+void* ytdlp_calloc(size_t count, size_t size);
+void* ytdlp_realloc(void* ptr, size_t size);
+void ytdlp_free(void* ptr);
+
+/* Allocations made by the calling thread since it started */
+uint64_t ytdlp_thread_alloc_count(void);
+
+/* ============================================================================
+ * Statistics (ytdlp_resolver.c)
+ * ========================================================================== */
+
+typedef struct YtdlpStats {
+    volatile uint64_t resolves;
+    volatile uint64_t resolve_allocations;
+    volatile uint64_t last_resolve_allocations;
+    volatile uint64_t heap_allocations;
+    volatile uint64_t cache_hits;
+    volatile uint64_t cache_misses;
+    volatile uint64_t concurrency_waits;
+    volatile uint64_t refreshes;
+    volatile uint64_t direct_resolves;
+    volatile uint64_t deadline_misses;
+    volatile uint64_t stale_results;
+    volatile uint64_t negative_hits;
+    volatile uint64_t hedges;
+    volatile uint64_t hedge_wins;
+    volatile uint64_t shared_hits;
+    volatile uint64_t shared_cache_errors;
+    volatile uint64_t daemon_resolves;
+    volatile uint64_t daemon_fallbacks;
+    volatile uint64_t daemon_timeouts;
+} YtdlpStats;
+
+/* Plugin-wide totals; each resolver instance also keeps its own */
+extern YtdlpStats g_ytdlp_stats;
+
+/* ============================================================================
+ * Arena
+ *
+ * Chunked bump allocator. Pointers stay valid until the arena is released
+ * past them; individual allocations are never freed.
+ * ========================================================================== */
+
+typedef struct YtdlpArenaChunk YtdlpArenaChunk;
+
+typedef struct YtdlpArena {
+    YtdlpArenaChunk* head;
+    YtdlpArenaChunk* current;
+} YtdlpArena;
+
+typedef struct YtdlpArenaMark {
+    YtdlpArenaChunk* chunk;
+    size_t used;
+} YtdlpArenaMark;
+
+void* ytdlp_arena_alloc(YtdlpArena* arena, size_t size);
+char* ytdlp_arena_strdup(YtdlpArena* arena, const char* s);
+char* ytdlp_arena_strndup(YtdlpArena* arena, const char* s, size_t len);
+YtdlpArenaMark ytdlp_arena_mark(const YtdlpArena* arena);
+void ytdlp_arena_release(YtdlpArena* arena, YtdlpArenaMark mark);
+
+/* ============================================================================
+ * Growable Byte Buffer
+ * ========================================================================== */
+
+typedef struct YtdlpBuffer {
+    char* data;
+    size_t len;
+    size_t cap;
+} YtdlpBuffer;
+
+/* Reset length to zero, keeping capacity */
+void ytdlp_buffer_clear(YtdlpBuffer* buf);
+
+/* Append bytes, growing geometrically. Keeps data NUL-terminated. */
+bool ytdlp_buffer_append(YtdlpBuffer* buf, const char* bytes, size_t len);
+
+/* Return a pointer to at least `min_free` writable bytes after the current
+ * contents (growing geometrically) and store the usable size in `*avail`.
+ * Follow with ytdlp_buffer_commit() once bytes have been written there. */
+char* ytdlp_buffer_reserve(YtdlpBuffer* buf, size_t min_free, size_t* avail);
+void ytdlp_buffer_commit(YtdlpBuffer* buf, size_t len);
+
+/* ============================================================================
+ * Bounded Ring Buffer
+ *
+ * Keeps only the most recent `cap` bytes written to it.
+ * ========================================================================== */
+
+typedef struct YtdlpRing {
+    char* data;      /* cap + 1 bytes, room for a terminator once linearized */
+    size_t cap;
+    size_t start;    /* Offset of the oldest byte */
+    size_t len;
+    bool truncated;  /* Older bytes were overwritten */
+} YtdlpRing;
+
+void ytdlp_ring_clear(YtdlpRing* ring);
+
+/* Contiguous writable region at the logical end; NULL when out of memory */
+char* ytdlp_ring_reserve(YtdlpRing* ring, size_t* avail);
+void ytdlp_ring_commit(YtdlpRing* ring, size_t len);
+
+/* Write `len` bytes, keeping the most recent `cap` of them */
+void ytdlp_ring_append(YtdlpRing* ring, const char* bytes, size_t len);
+
+/* Rotate contents to start at data[0], NUL-terminate and return them.
+ * When older output was dropped, the partial first line is skipped. */
+const char* ytdlp_ring_linearize(YtdlpRing* ring);
+
+/* ============================================================================
+ * Thread-local Scratch
+ *
+ * Reused across requests on the same thread. The arena holds per-request
+ * temporaries (sanitized URL, argv tokens); `out` holds a process's stdout
+ * and `err` the tail of its stderr, valid until the next process run on the
+ * same thread.
+ * ========================================================================== */
+
+typedef struct YtdlpScratch {
+    YtdlpArena arena;
+    YtdlpBuffer out;
+    YtdlpRing err;
+} YtdlpScratch;
+
+YtdlpScratch* ytdlp_scratch(void);
+
+/* ============================================================================
+ * Resolved Stream Builder
+ *
+ * Fields are staged in an arena, then copied out with every string and
+ * header array in its own heap allocation, as the Prism host expects to
+ * free them. Release with prism_ytdlp_free_stream().
+ * ========================================================================== */
+
+typedef struct YtdlpStreamBuilder {
+    PrismResolvedStream stream;
+    PrismYtdlpErrorClass error_class;
+    YtdlpArena* arena;
+} YtdlpStreamBuilder;
+
+void ytdlp_builder_init(YtdlpStreamBuilder* builder, YtdlpArena* arena);
+
+/* Copy `value` into the builder arena and store it in `*field` */
+void ytdlp_builder_set(YtdlpStreamBuilder* builder, const char** field, const char* value);
+
+/* Copy `count` header name/value pairs into the builder arena */
+void ytdlp_builder_set_headers(
+    YtdlpStreamBuilder* builder,
+    const char* const* names,
+    const char* const* values,
+    int count
+);
+
+/* Mark the stream failed with the given message, classified by
+ * ytdlp_classify_error() */
+void ytdlp_builder_fail(YtdlpStreamBuilder* builder, const char* error);
+
+/* Copy out to the heap. Returns NULL only when out of memory. */
+PrismResolvedStream* ytdlp_builder_finish(YtdlpStreamBuilder* builder);
+
+/* ============================================================================
+ * URLs (ytdlp_url.c)
+ *
+ * A parsed URL holds views into the string it was parsed from, which must
+ * outlive it, and copies only the lowercased host.
+ * ========================================================================== */
+
+#define YTDLP_URL_HOST_MAX 256
+#define YTDLP_URL_CONTENT_KEY_MAX 128
+
+typedef enum YtdlpSite {
+    YTDLP_SITE_OTHER,
+    YTDLP_SITE_YOUTUBE,
+    YTDLP_SITE_TWITCH,
+    YTDLP_SITE_VIMEO,
+    YTDLP_SITE_TIKTOK
+} YtdlpSite;
+
+typedef struct YtdlpUrl {
+    const char* text;                 /* The whole URL */
+    const char* scheme;               /* Without "://" (length 0 if absent) */
+    size_t scheme_len;
+    const char* port;                 /* Without ':' (length 0 if absent) */
+    size_t port_len;
+    const char* path;                 /* From the '/' after the host ("" if none) */
+    size_t path_len;
+    const char* query;                /* After '?', up to the fragment */
+    size_t query_len;
+    const char* rest;                 /* What follows the query: "" or the '#' fragment */
+    char host[YTDLP_URL_HOST_MAX];    /* Lowercased, without credentials or port */
+    YtdlpSite site;
+    char content_key[YTDLP_URL_CONTENT_KEY_MAX];  /* "youtube:<id>" etc. ("" = none) */
+} YtdlpUrl;
+
+typedef struct YtdlpUrlParam {
+    const char* text;   /* "name=value" as written */
+    size_t text_len;
+    const char* name;
+    size_t name_len;
+    const char* value;  /* Still percent-encoded */
+    size_t value_len;
+} YtdlpUrlParam;
+
+/* Parse `text`, with or without a scheme. False if it has neither a host nor
+ * a scheme. */
+bool ytdlp_url_parse(const char* text, YtdlpUrl* url);
+
+/* Whether the host is `domain` or one of its subdomains */
+bool ytdlp_url_host_is(const YtdlpUrl* url, const char* domain);
+
+/* Next query parameter from `*offset` (start at 0); false when done */
+bool ytdlp_url_next_param(const YtdlpUrl* url, size_t* offset, YtdlpUrlParam* param);
+
+/* Key for what the URL points at: the content key when there is one, else
+ * the URL without credentials or fragment and with scheme and host
+ * lowercased. snprintf semantics; returns the full length. */
+size_t ytdlp_url_key(const YtdlpUrl* url, char* buf, size_t size);
+
+/* ============================================================================
+ * Error Classes (ytdlp_error.c)
+ * ========================================================================== */
+
+/* Class of a failure message: yt-dlp's stderr, a Python exception or one of
+ * the plugin's own. PRISM_YTDLP_ERROR_UNKNOWN if nothing matches. */
+PrismYtdlpErrorClass ytdlp_classify_error(const char* text);
+
+/* ============================================================================
+ * JSON Reader (ytdlp_json.c)
+ *
+ * Nodes live in an arena and strings are decoded in place, so the parsed
+ * tree is valid as long as both the arena mark and the input text are.
+ * ========================================================================== */
+
+typedef enum YtdlpJsonType {
+    YTDLP_JSON_NULL,
+    YTDLP_JSON_BOOL,
+    YTDLP_JSON_NUMBER,
+    YTDLP_JSON_STRING,
+    YTDLP_JSON_ARRAY,
+    YTDLP_JSON_OBJECT
+} YtdlpJsonType;
+
+typedef struct YtdlpJson {
+    YtdlpJsonType type;
+    const char* key;          /* Member name inside an object */
+    struct YtdlpJson* next;   /* Next element or member */
+    struct YtdlpJson* child;  /* First element or member of a container */
+    size_t count;             /* Number of children */
+    const char* string;
+    double number;
+    bool boolean;
+} YtdlpJson;
+
+/* Parse `text` (modified in place). Returns NULL on malformed input. */
+YtdlpJson* ytdlp_json_parse(YtdlpArena* arena, char* text);
+
+const YtdlpJson* ytdlp_json_get(const YtdlpJson* object, const char* key);
+const char* ytdlp_json_string(const YtdlpJson* object, const char* key);
+double ytdlp_json_number(const YtdlpJson* object, const char* key, double fallback);
+bool ytdlp_json_bool(const YtdlpJson* object, const char* key, bool fallback);
+
+/* ============================================================================
+ * Media Info (ytdlp_media.c)
+ *
+ * Everything one `yt-dlp -J` extraction yields that resolves need: metadata
+ * and the full format ladder. Immutable, reference-counted and packed into a
+ * single allocation so it can be shared through the cache.
+ * ========================================================================== */
+
+typedef struct YtdlpMediaInfo {
+    volatile int32_t refs;
+    PrismYtdlpFormatList list;
+    const char* channel;
+    const char* thumbnail_url;
+    int64_t expires_at;  /* Earliest format URL expiry, Unix time (0 = none) */
+    size_t size;         /* Bytes in the allocation */
+} YtdlpMediaInfo;
+
+/* Unix time a signed media URL expires (0 = unknown) */
+int64_t ytdlp_url_expiry(const char* url);
+
+/* Build from a parsed info dict. Returns NULL if it has no usable formats. */
+YtdlpMediaInfo* ytdlp_media_info_from_json(const YtdlpJson* root);
+
+void ytdlp_media_info_retain(const YtdlpMediaInfo* info);
+void ytdlp_media_info_release(const YtdlpMediaInfo* info);
+
+/* Copy `info`'s `info->size` bytes to `dst` with every pointer stored as an
+ * offset from the start, so it can be read at any address */
+void ytdlp_media_info_flatten(const YtdlpMediaInfo* info, void* dst);
+
+/* Turn a flattened copy, read into a ytdlp_malloc() block of `size` bytes,
+ * back into media info in place. NULL if an offset is out of range. */
+YtdlpMediaInfo* ytdlp_media_info_unflatten(void* block, size_t size);
+
+/* Caller-owned single-allocation copy of the ladder */
+PrismYtdlpFormatList* ytdlp_media_info_copy_list(const YtdlpMediaInfo* info);
+
+/* ============================================================================
+ * Format Selection (ytdlp_format.c)
+ *
+ * Evaluates yt-dlp format selectors (the subset documented in ytdlp_format.c)
+ * against a ladder ordered worst to best, exactly as yt-dlp would pick.
+ * ========================================================================== */
+
+typedef struct YtdlpFormatSelection {
+    const PrismYtdlpFormat* video;  /* The selected format, or the video half of a merge */
+    const PrismYtdlpFormat* audio;  /* The audio half of a merge, otherwise NULL */
+} YtdlpFormatSelection;
+
+/* Target height for a requested quality (AUTO and unknown values mean 720) */
+int ytdlp_quality_height(PrismStreamQuality quality);
+
+/* Write the resolver's fallback selector for live or on-demand media */
+void ytdlp_format_chain(char* buf, size_t size, bool is_live, int height);
+
+/* Returns false when nothing matches or the selector is not understood */
+bool ytdlp_format_select(
+    const PrismYtdlpFormatList* list,
+    const char* selector,
+    YtdlpFormatSelection* out
+);
+
+/* ============================================================================
+ * Resolve Cache (ytdlp_cache.c)
+ *
+ * Small LRU of extracted media keyed by request. Each resolver instance owns
+ * its own cache, so tenants never see each other's entries.
+ * ========================================================================== */
+
+typedef struct YtdlpCache YtdlpCache;
+
+YtdlpCache* ytdlp_cache_create(int capacity, int ttl_ms);
+void ytdlp_cache_destroy(YtdlpCache* cache);
+
+/* Returns a new reference to a live entry, or NULL */
+const YtdlpMediaInfo* ytdlp_cache_get(YtdlpCache* cache, const char* key);
+
+/* As ytdlp_cache_get(), but also returns an entry past its TTL that has not
+ * been evicted yet; one with no URL expiry only up to a second TTL later */
+const YtdlpMediaInfo* ytdlp_cache_get_stale(YtdlpCache* cache, const char* key);
+
+/* Stores a reference to `info` for at most `max_ttl_ms` (<= 0 = cache TTL) */
+void ytdlp_cache_put(YtdlpCache* cache, const char* key, const YtdlpMediaInfo* info, int max_ttl_ms);
+
+/* Remembers that `key` failed with `error` for at most `max_ttl_ms`
+ * (<= 0 = cache TTL). A later put of media info replaces it. */
+void ytdlp_cache_put_failure(YtdlpCache* cache, const char* key, const char* error, int max_ttl_ms);
+
+/* Copies the error of a live failure for `key` into `error`; false if none */
+bool ytdlp_cache_get_failure(YtdlpCache* cache, const char* key, char* error, size_t error_size);
+
+/* ============================================================================
+ * Shared Resolve Cache (ytdlp_shmcache.c)
+ *
+ * Optional second level behind a resolver's cache, in a named shared memory
+ * segment that every process mapping the same name reads and writes. Same
+ * contract as the resolver cache, except that lookups copy the entry out.
+ * ========================================================================== */
+
+typedef struct YtdlpSharedCache YtdlpSharedCache;
+
+/* Map the segment `name`, creating it at `bytes` if no process has yet.
+ * Entries live for at most `ttl_ms`. NULL if it cannot be mapped. */
+YtdlpSharedCache* ytdlp_shared_cache_open(const char* name, size_t bytes, int ttl_ms);
+void ytdlp_shared_cache_close(YtdlpSharedCache* cache);
+
+/* The system name of the segment for `name` ("/prism-ytdlp-<name>-<layout>"
+ * on POSIX); false if it does not fit */
+bool ytdlp_shared_cache_segment(const char* name, char* out, size_t size);
+
+/* Returns a new private copy of a live entry, or NULL. `ttl_ms` receives
+ * the time it has left. */
+const YtdlpMediaInfo* ytdlp_shared_cache_get(YtdlpSharedCache* cache, const char* key, int* ttl_ms);
+bool ytdlp_shared_cache_get_failure(YtdlpSharedCache* cache, const char* key, char* error, size_t error_size);
+
+/* Entries too large for a slot are not stored */
+void ytdlp_shared_cache_put(YtdlpSharedCache* cache, const char* key, const YtdlpMediaInfo* info, int max_ttl_ms);
+void ytdlp_shared_cache_put_failure(YtdlpSharedCache* cache, const char* key, const char* error, int max_ttl_ms);
+
+/* ============================================================================
+ * Resolve Daemon Protocol (ytdlp_daemon.c)
+ *
+ * Requests to prism_ytdlp_resolved and the streams it answers with, one
+ * request per connection. An endpoint is a unix socket path or
+ * "tcp:host:port". POSIX only; on Windows calls fail and resolves run in
+ * process.
+ * ========================================================================== */
+
+typedef enum YtdlpDaemonOp {
+    YTDLP_DAEMON_RESOLVE = 1,
+    YTDLP_DAEMON_REFRESH = 2,   /* Resolve past the daemon's cache */
+    YTDLP_DAEMON_PROBE = 3,
+    YTDLP_DAEMON_PING = 4       /* Health check; answered without resolving */
+} YtdlpDaemonOp;
+
+typedef struct YtdlpDaemonRequest {
+    YtdlpDaemonOp op;
+    const char* url;
+    bool has_options;           /* Probes carry none */
+    PrismResolverOptions options;
+} YtdlpDaemonRequest;
+
+typedef enum YtdlpDaemonResult {
+    YTDLP_DAEMON_ANSWERED,
+    YTDLP_DAEMON_UNREACHABLE,   /* Refused, dropped the connection or answered garbage */
+    YTDLP_DAEMON_TIMED_OUT      /* No answer within the timeout */
+} YtdlpDaemonResult;
+
+/* Send `request` to one of `endpoints` (comma-separated), chosen by
+ * consistent hashing of `key` and failing over along the ring past endpoints
+ * that cannot be reached, and fill the builder from the answer within
+ * `timeout_ms`. The builder is untouched unless one answered. */
+YtdlpDaemonResult ytdlp_daemon_call(const char* endpoints, const char* key, const YtdlpDaemonRequest* request,
+                                    int timeout_ms, YtdlpStreamBuilder* b);
+
+/* Stop health checks of the endpoints last called */
+void ytdlp_daemon_shutdown(void);
+
+/* Listening socket at `endpoint`, replacing a stale socket file; -1 on
+ * error, with errno EADDRINUSE if a daemon already answers there. A TCP
+ * address other hosts can reach needs `allow_remote`, else errno is
+ * EACCES. */
+int ytdlp_daemon_listen(const char* endpoint, bool allow_remote);
+
+/* Close a listening socket, removing its socket file */
+void ytdlp_daemon_unlisten(int fd, const char* endpoint);
+
+/* Read one request from an accepted connection; strings live in `arena` */
+bool ytdlp_daemon_read_request(int fd, YtdlpArena* arena, YtdlpDaemonRequest* request, int timeout_ms);
+bool ytdlp_daemon_write_stream(int fd, const PrismResolvedStream* stream, int timeout_ms);
+
+/* Answer a request with `resolver` (from prism_ytdlp_create_resolver()),
+ * as the daemon does. A URL or language that could be taken for more than
+ * one yt-dlp argument gets a failed stream. Caller frees the stream. */
+PrismResolvedStream* ytdlp_resolver_serve(PrismResolver* resolver, const YtdlpDaemonRequest* request);
+
+/* ============================================================================
+ * yt-dlp Cache Directory (ytdlp_cachedir.c)
+ *
+ * One size-bounded --cache-dir shared by every yt-dlp run, so the YouTube
+ * player work yt-dlp caches there is reused across resolves.
+ * ========================================================================== */
+
+/* Resolve the directory to use (`configured`, or the default when empty) into
+ * `dir` and create it if needed. Returns false if it cannot be created. */
+bool ytdlp_cache_dir_prepare(const char* configured, char* dir, size_t dir_size);
+
+/* Record a run against `dir`; starts a background prune pass when one is due */
+void ytdlp_cache_dir_note_use(const char* dir, uint64_t max_bytes);
+
+/* Wait for a prune pass in progress */
+void ytdlp_cache_dir_shutdown(void);
+
+/* ============================================================================
+ * Embedded Python Backend (ytdlp_python.c)
+ *
+ * yt_dlp imported once into an interpreter loaded at runtime; extractions
+ * return the `yt-dlp -J` JSON without starting a process.
+ * ========================================================================== */
+
+/* Python source defining _prism_ytdlp_extract(url, lang, cache_dir, timeout_s)
+ * against a module imported as _prism_yt_dlp */
+extern const char ytdlp_python_extract_source[];
+
+/* Load libpython (`library`, or the usual names when empty) and import yt_dlp,
+ * adding `python_path` to sys.path. Attempted once per process; returns
+ * whether the backend is usable. */
+bool ytdlp_python_load(const char* library, const char* python_path);
+
+/* Extract `url` in-process. Output and error live in the thread's scratch
+ * buffers like a process run's. `language` and `cache_dir` may be NULL. */
+YtdlpProcessResult ytdlp_python_extract(const char* url, const char* language, const char* cache_dir, int timeout_ms);
+
+/* Copy the imported yt_dlp's version into `version`; false if not loaded */
+bool ytdlp_python_version(char* version, size_t size);
+
+/* ============================================================================
+ * Zygote Backend (ytdlp_zygote.c)
+ *
+ * A Python process with yt_dlp and its extractors imported, forking one
+ * child per extraction on request over a unix socket. POSIX only.
+ * ========================================================================== */
+
+/* Start the zygote with `python` (NULL = python3), adding `python_path` to its
+ * sys.path, unless it is running. Failed starts are retried after a minute.
+ * Returns whether it is running. */
+bool ytdlp_zygote_start(const char* python, const char* python_path);
+
+/* Extract `url` in a child forked from the zygote, killing it once
+ * `timeout_ms` passes. Results live in the thread's scratch buffers. */
+YtdlpProcessResult ytdlp_zygote_extract(const char* url, const char* language, const char* cache_dir, int timeout_ms);
+
+/* Stop the zygote; children already forked finish on their own */
+void ytdlp_zygote_shutdown(void);
+
+/* Copy the zygote's yt_dlp version into `version`; false if it is not running */
+bool ytdlp_zygote_version(char* version, size_t size);
+
+/* ============================================================================
+ * Release Downloads (ytdlp_download.c)
+ *
+ * yt-dlp release assets fetched resumably and verified against the release's
+ * SHA2-256SUMS before they are put in place.
+ * ========================================================================== */
+
+typedef void (*YtdlpDownloadProgress)(float progress, void* user_data);
+
+/* Download `asset` of release `version` (NULL = latest) to `path`. Transfers
+ * resume from <path>.part; `path` is replaced only by a verified file, made
+ * executable first if asked. `progress` gets fractions up to 1.0 on success. */
+bool ytdlp_release_download(
+    const char* version,
+    const char* asset,
+    const char* path,
+    bool executable,
+    YtdlpDownloadProgress progress,
+    void* user_data
+);
+
+/* Version of the latest release, from the tag "latest" redirects to */
+bool ytdlp_release_latest(char* version, size_t size);
+
+/* While set, downloads and their curl runs stop as soon as they can */
+void ytdlp_download_set_cancelled(bool cancelled);
+
+/* ============================================================================
+ * Single-flight Installs (ytdlp_singleflight.c)
+ *
+ * One install per install_dir at a time: callers in this process join the
+ * install in flight, and processes take turns through a lock file there.
+ * ========================================================================== */
+
+/* Install into install_dir, reporting download progress */
+typedef bool (*YtdlpInstallFn)(const char* install_dir, void* context, YtdlpDownloadProgress progress, void* user_data);
+
+/* Publish what another process installed while this one waited, if usable */
+typedef bool (*YtdlpAdoptFn)(const char* install_dir, void* context);
+
+/* Run `install` unless an install into install_dir is already in flight in
+ * this process; then wait for it instead, relaying its progress on this
+ * thread, and return its result. `adopt` (may be NULL) is tried first when
+ * another process held the directory's lock. */
+bool ytdlp_install_once(
+    const char* install_dir,
+    YtdlpInstallFn install,
+    YtdlpAdoptFn adopt,
+    void* context,
+    YtdlpDownloadProgress progress,
+    void* user_data
+);
+
+/* ============================================================================
+ * yt-dlp Installs (ytdlp_install.c)
+ *
+ * Releases installed side by side in <install_dir>/yt-dlp-versions/<version>,
+ * preferring the onedir build so launches skip the onefile binary's
+ * self-extraction. `current` in there names the version in use.
+ * ========================================================================== */
+
+#define YTDLP_VERSIONS_DIR "yt-dlp-versions"
+#define YTDLP_UNPACKED_DIR "yt-dlp-unpacked"  /* Layout of earlier plugin versions */
+
+/* Extract the archive `zip` into the existing directory `dir` */
+bool ytdlp_extract_zip(const char* zip, const char* dir);
+
+/* Run `path --version` and copy the trimmed version into `version` */
+bool ytdlp_tool_version(const char* path, char* version, size_t size);
+
+/* Path of the executable in install_dir's legacy unpacked layout, if it
+ * reports the version recorded when it was installed */
+bool ytdlp_unpacked_find(const char* install_dir, char* path, size_t size);
+
+/* Install `version` (NULL = latest) next to the versions already in
+ * install_dir and make it current; a version already installed is switched
+ * to without a download. The unpacked build is used where the platform has
+ * one, else `onefile_asset`. The previous current version is kept and older
+ * ones removed, once no run counted by ytdlp_versions_run_begin() uses them.
+ * Returns the executable path. `progress` (may be NULL) follows the
+ * download. */
+bool ytdlp_versions_install(
+    const char* install_dir,
+    const char* version,
+    const char* onefile_asset,
+    char* path,
+    size_t size,
+    YtdlpDownloadProgress progress,
+    void* user_data
+);
+
+/* Path of install_dir's current version, if it reports the version recorded
+ * when it was installed */
+bool ytdlp_versions_find(const char* install_dir, const char* onefile_asset, char* path, size_t size);
+
+/* Count a yt-dlp run from the executable at `path`, keeping its version on
+ * disk until the matching ytdlp_versions_run_end(). Paths outside a
+ * versioned install are ignored. */
+void ytdlp_versions_run_begin(const char* path);
+void ytdlp_versions_run_end(const char* path);
+
+/* Cancel an update_tool() install still running in the background and wait
+ * for it (ytdlp_resolver.c) */
+void ytdlp_update_shutdown(void);
+
+/* ============================================================================
+ * Refresh Scheduler (ytdlp_refresh.c)
+ *
+ * Tracks the expiry of streams handed out by a resolver and re-resolves them
+ * on a background thread, started on the first watch.
+ * ========================================================================== */
+
+/* Resolve `url` bypassing cached extractions */
+typedef PrismResolvedStream* (*YtdlpRefreshResolve)(void* context, const char* url, const PrismResolverOptions* options);
+
+typedef struct YtdlpRefresher YtdlpRefresher;
+
+YtdlpRefresher* ytdlp_refresher_create(YtdlpRefreshResolve resolve, void* context, int margin_ms);
+
+/* Stops the thread, waiting for a refresh in flight. Not callable from a callback. */
+void ytdlp_refresher_destroy(YtdlpRefresher* refresher);
+
+uint64_t ytdlp_refresher_watch(
+    YtdlpRefresher* refresher,
+    const PrismResolvedStream* stream,
+    const PrismResolverOptions* options,
+    PrismYtdlpRefreshCallback callback,
+    void* user_data
+);
+
+void ytdlp_refresher_unwatch(YtdlpRefresher* refresher, uint64_t watch_id);
+
+#endif /* PRISM_YTDLP_INTERNAL_H */
@@ -0,0 +1,280 @@
+/*
+ * Prism yt-dlp Plugin - JSON Reader
+ *
+ * Minimal parser for yt-dlp's info JSON. Strings are decoded in place in the
+ * input text and nodes are allocated from an arena, so parsing a response
+ * costs no heap allocations beyond arena growth.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define YTDLP_JSON_MAX_DEPTH 64
+
+typedef struct JsonParser {
+    YtdlpArena* arena;
+    char* p;
+    int depth;
+} JsonParser;
+
+static void skip_whitespace(JsonParser* ps) {
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' || *ps->p == '\r') {
+        ps->p++;
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool read_hex4(const char* s, unsigned* out) {
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_value(s[i]);
+        if (digit < 0) return false;
+        value = (value << 4) | (unsigned)digit;
+    }
+    *out = value;
+    return true;
+}
+
+static char* encode_utf8(char* out, unsigned cp) {
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+/*
+ * Decode the string starting after the opening quote. The decoded form is
+ * never longer than the escaped one, so it is written over the input.
+ */
+static char* parse_string(JsonParser* ps) {
+    char* start = ps->p;
+    char* out = start;
+
+    for (;;) {
+        char c = *ps->p;
+        if (c == '\0') return NULL;
+
+        if (c == '"') {
+            ps->p++;
+            *out = '\0';
+            return start;
+        }
+
+        if (c != '\\') {
+            *out++ = c;
+            ps->p++;
+            continue;
+        }
+
+        char e = ps->p[1];
+        ps->p += 2;
+        switch (e) {
+            case '"':  *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/':  *out++ = '/'; break;
+            case 'b':  *out++ = '\b'; break;
+            case 'f':  *out++ = '\f'; break;
+            case 'n':  *out++ = '\n'; break;
+            case 'r':  *out++ = '\r'; break;
+            case 't':  *out++ = '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (!read_hex4(ps->p, &cp)) return NULL;
+                ps->p += 4;
+
+                /* Surrogate pair */
+                if (cp >= 0xD800 && cp <= 0xDBFF && ps->p[0] == '\\' && ps->p[1] == 'u') {
+                    unsigned low;
+                    if (read_hex4(ps->p + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        ps->p += 6;
+                    }
+                }
+                if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;  /* Lone surrogate */
+                out = encode_utf8(out, cp);
+                break;
+            }
+            default:
+                return NULL;
+        }
+    }
+}
+
+static YtdlpJson* new_node(JsonParser* ps, YtdlpJsonType type) {
+    YtdlpJson* node = (YtdlpJson*)ytdlp_arena_alloc(ps->arena, sizeof(YtdlpJson));
+    if (node) {
+        memset(node, 0, sizeof(*node));
+        node->type = type;
+    }
+    return node;
+}
+
+static bool match_literal(JsonParser* ps, const char* literal) {
+    size_t len = strlen(literal);
+    if (strncmp(ps->p, literal, len) != 0) return false;
+    ps->p += len;
+    return true;
+}
+
+static YtdlpJson* parse_value(JsonParser* ps);
+
+/* Parse the members of an array or object after its opening bracket */
+static YtdlpJson* parse_container(JsonParser* ps, YtdlpJsonType type, char close) {
+    if (++ps->depth > YTDLP_JSON_MAX_DEPTH) return NULL;
+
+    YtdlpJson* node = new_node(ps, type);
+    if (!node) return NULL;
+
+    YtdlpJson** tail = &node->child;
+
+    skip_whitespace(ps);
+    if (*ps->p == close) {
+        ps->p++;
+        ps->depth--;
+        return node;
+    }
+
+    for (;;) {
+        const char* key = NULL;
+
+        if (type == YTDLP_JSON_OBJECT) {
+            skip_whitespace(ps);
+            if (*ps->p != '"') return NULL;
+            ps->p++;
+            key = parse_string(ps);
+            if (!key) return NULL;
+
+            skip_whitespace(ps);
+            if (*ps->p != ':') return NULL;
+            ps->p++;
+        }
+
+        YtdlpJson* child = parse_value(ps);
+        if (!child) return NULL;
+
+        child->key = key;
+        *tail = child;
+        tail = &child->next;
+        node->count++;
+
+        skip_whitespace(ps);
+        if (*ps->p == ',') {
+            ps->p++;
+            continue;
+        }
+        if (*ps->p == close) {
+            ps->p++;
+            ps->depth--;
+            return node;
+        }
+        return NULL;
+    }
+}
+
+static YtdlpJson* parse_value(JsonParser* ps) {
+    skip_whitespace(ps);
+
+    char c = *ps->p;
+    YtdlpJson* node;
+
+    switch (c) {
+        case '{':
+            ps->p++;
+            return parse_container(ps, YTDLP_JSON_OBJECT, '}');
+
+        case '[':
+            ps->p++;
+            return parse_container(ps, YTDLP_JSON_ARRAY, ']');
+
+        case '"':
+            ps->p++;
+            node = new_node(ps, YTDLP_JSON_STRING);
+            if (!node) return NULL;
+            node->string = parse_string(ps);
+            return node->string ? node : NULL;
+
+        case 't':
+        case 'f':
+            node = new_node(ps, YTDLP_JSON_BOOL);
+            if (!node) return NULL;
+            node->boolean = (c == 't');
+            return match_literal(ps, c == 't' ? "true" : "false") ? node : NULL;
+
+        case 'n':
+            node = new_node(ps, YTDLP_JSON_NULL);
+            return (node && match_literal(ps, "null")) ? node : NULL;
+
+        default: {
+            /* yt-dlp also emits NaN and Infinity for some float fields */
+            char* end = NULL;
+            double value = strtod(ps->p, &end);
+            if (end == ps->p) return NULL;
+            ps->p = end;
+
+            node = new_node(ps, YTDLP_JSON_NUMBER);
+            if (node) node->number = value;
+            return node;
+        }
+    }
+}
+
+YtdlpJson* ytdlp_json_parse(YtdlpArena* arena, char* text) {
+    if (!text) return NULL;
+
+    JsonParser ps = { arena, text, 0 };
+    YtdlpJson* root = parse_value(&ps);
+    if (!root) return NULL;
+
+    skip_whitespace(&ps);
+    return *ps.p == '\0' ? root : NULL;
+}
+
+/* ============================================================================
+ * Lookup
+ * ========================================================================== */
+
+const YtdlpJson* ytdlp_json_get(const YtdlpJson* object, const char* key) {
+    if (!object || object->type != YTDLP_JSON_OBJECT) return NULL;
+
+    for (const YtdlpJson* member = object->child; member; member = member->next) {
+        if (strcmp(member->key, key) == 0) return member;
+    }
+    return NULL;
+}
+
+const char* ytdlp_json_string(const YtdlpJson* object, const char* key) {
+    const YtdlpJson* value = ytdlp_json_get(object, key);
+    return (value && value->type == YTDLP_JSON_STRING) ? value->string : NULL;
+}
+
+double ytdlp_json_number(const YtdlpJson* object, const char* key, double fallback) {
+    const YtdlpJson* value = ytdlp_json_get(object, key);
+    return (value && value->type == YTDLP_JSON_NUMBER) ? value->number : fallback;
+}
+
+bool ytdlp_json_bool(const YtdlpJson* object, const char* key, bool fallback) {
+    const YtdlpJson* value = ytdlp_json_get(object, key);
+    return (value && value->type == YTDLP_JSON_BOOL) ? value->boolean : fallback;
+}
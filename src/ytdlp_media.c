@@ -0,0 +1,493 @@
+/*
+ * Prism yt-dlp Plugin - Media Info
+ *
+ * Packs the metadata and format ladder of one extraction into a single
+ * shared allocation.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Packer
+ *
+ * Every layout is produced by running the same fill code twice: first with
+ * no base to measure, then into a block of exactly the measured size.
+ * ========================================================================== */
+
+#define PACK_ALIGN (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+
+typedef struct Packer {
+    char* base;   /* NULL while measuring */
+    size_t used;
+} Packer;
+
+static void* pack_reserve(Packer* pk, size_t size) {
+    pk->used = (pk->used + PACK_ALIGN - 1) & ~(PACK_ALIGN - 1);
+    size = (size + PACK_ALIGN - 1) & ~(PACK_ALIGN - 1);
+    void* p = pk->base ? pk->base + pk->used : NULL;
+    pk->used += size;
+    return p;
+}
+
+static const char* pack_string(Packer* pk, const char* s) {
+    if (!s) return NULL;
+
+    size_t n = strlen(s) + 1;
+    char* p = pk->base ? pk->base + pk->used : NULL;
+    if (p) memcpy(p, s, n);
+    pk->used += n;
+    return p;
+}
+
+/* ============================================================================
+ * Field Helpers
+ * ========================================================================== */
+
+static int json_int(const YtdlpJson* object, const char* key) {
+    double value = ytdlp_json_number(object, key, 0.0);
+    if (value != value || value < 0.0 || value > 1e9) return 0;  /* NaN or absurd */
+    return (int)value;
+}
+
+static double json_double(const YtdlpJson* object, const char* key) {
+    double value = ytdlp_json_number(object, key, 0.0);
+    return (value != value) ? 0.0 : value;
+}
+
+/*
+ * Signed media URLs carry their expiry as `expire=<unix time>` in the query
+ * (progressive and DASH) or as an `/expire/<unix time>/` path segment (HLS).
+ */
+int64_t ytdlp_url_expiry(const char* url) {
+    if (!url) return 0;
+
+    for (const char* p = strstr(url, "expire"); p; p = strstr(p + 1, "expire")) {
+        char before = (p > url) ? p[-1] : '\0';
+        const char* digits = NULL;
+
+        if ((before == '?' || before == '&') && p[6] == '=') {
+            digits = p + 7;
+        } else if (before == '/' && p[6] == '/') {
+            digits = p + 7;
+        }
+
+        if (digits && *digits >= '0' && *digits <= '9') {
+            return (int64_t)strtoll(digits, NULL, 10);
+        }
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * HTTP Headers and Cookies
+ * ========================================================================== */
+
+static int count_headers(const YtdlpJson* headers) {
+    int count = 0;
+    if (headers && headers->type == YTDLP_JSON_OBJECT) {
+        for (const YtdlpJson* h = headers->child; h; h = h->next) {
+            if (h->type == YTDLP_JSON_STRING) count++;
+        }
+    }
+    return count;
+}
+
+/* Pack the string members of `http_headers` as parallel name/value arrays */
+static void pack_headers(Packer* pk, PrismYtdlpFormat* out, const YtdlpJson* headers) {
+    int count = count_headers(headers);
+    if (count == 0) return;
+
+    const char** names = (const char**)pack_reserve(pk, sizeof(const char*) * (size_t)count);
+    const char** values = (const char**)pack_reserve(pk, sizeof(const char*) * (size_t)count);
+
+    int i = 0;
+    for (const YtdlpJson* h = headers->child; h; h = h->next) {
+        if (h->type != YTDLP_JSON_STRING) continue;
+        const char* name = pack_string(pk, h->key);
+        const char* value = pack_string(pk, h->string);
+        if (names) {
+            names[i] = name;
+            values[i] = value;
+        }
+        i++;
+    }
+
+    if (out) {
+        out->header_names = names;
+        out->header_values = values;
+        out->header_count = count;
+    }
+}
+
+static bool is_cookie_attribute(const char* token, size_t len) {
+    static const char* const attributes[] = {
+        "Domain=", "Path=", "Expires=", "Max-Age=", "Version=", "SameSite=", "Secure", "HttpOnly"
+    };
+
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++) {
+        const char* a = attributes[i];
+        size_t n = strlen(a);
+        bool has_value = a[n - 1] == '=';
+        if (has_value ? len < n : len != n) continue;
+
+        size_t j = 0;
+        while (j < n && tolower((unsigned char)token[j]) == tolower((unsigned char)a[j])) j++;
+        if (j == n) return true;
+    }
+    return false;
+}
+
+/*
+ * yt-dlp reports the cookies for a format in Set-Cookie form
+ * ("a=1; Domain=.example.com; Path=/; Secure; b=2; ..."). Only the
+ * name=value pairs are kept, which is what a Cookie request header carries.
+ */
+static const char* pack_cookie_header(Packer* pk, const char* raw) {
+    if (!raw) return NULL;
+
+    char* out = pk->base ? pk->base + pk->used : NULL;
+    size_t n = 0;
+
+    for (const char* p = raw; *p; ) {
+        while (*p == ' ') p++;
+        const char* end = strchr(p, ';');
+        if (!end) end = p + strlen(p);
+
+        size_t len = (size_t)(end - p);
+        if (len > 0 && memchr(p, '=', len) && !is_cookie_attribute(p, len)) {
+            if (n > 0) {
+                if (out) memcpy(out + n, "; ", 2);
+                n += 2;
+            }
+            if (out) memcpy(out + n, p, len);
+            n += len;
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    if (n == 0) return NULL;
+    if (out) out[n] = '\0';
+    pk->used += n + 1;
+    return out;
+}
+
+/* ============================================================================
+ * Formats
+ * ========================================================================== */
+
+static bool is_usable_format(const YtdlpJson* format) {
+    return format->type == YTDLP_JSON_OBJECT && ytdlp_json_string(format, "url") != NULL;
+}
+
+static void pack_format(Packer* pk, PrismYtdlpFormat* out, const YtdlpJson* src) {
+    const char* format_id = pack_string(pk, ytdlp_json_string(src, "format_id"));
+    const char* url = pack_string(pk, ytdlp_json_string(src, "url"));
+    const char* ext = pack_string(pk, ytdlp_json_string(src, "ext"));
+    const char* protocol = pack_string(pk, ytdlp_json_string(src, "protocol"));
+    const char* vcodec = pack_string(pk, ytdlp_json_string(src, "vcodec"));
+    const char* acodec = pack_string(pk, ytdlp_json_string(src, "acodec"));
+    const char* language = pack_string(pk, ytdlp_json_string(src, "language"));
+    const char* cookies = pack_cookie_header(pk, ytdlp_json_string(src, "cookies"));
+
+    if (out) memset(out, 0, sizeof(*out));
+    pack_headers(pk, out, ytdlp_json_get(src, "http_headers"));
+
+    if (!out) return;
+
+    out->format_id = format_id;
+    out->url = url;
+    out->ext = ext;
+    out->protocol = protocol;
+    out->video_codec = vcodec;
+    out->audio_codec = acodec;
+    out->language = language;
+    out->width = json_int(src, "width");
+    out->height = json_int(src, "height");
+    out->fps = json_double(src, "fps");
+    out->tbr = json_double(src, "tbr");
+    out->expires_at = ytdlp_url_expiry(url);
+    out->cookies = cookies;
+}
+
+static YtdlpMediaInfo* pack_info(Packer* pk, const YtdlpJson* root, const YtdlpJson* formats, int count) {
+    YtdlpMediaInfo* info = (YtdlpMediaInfo*)pack_reserve(pk, sizeof(YtdlpMediaInfo));
+    PrismYtdlpFormat* ladder = (PrismYtdlpFormat*)pack_reserve(pk, sizeof(PrismYtdlpFormat) * (size_t)count);
+
+    const char* original_url = pack_string(pk, ytdlp_json_string(root, "webpage_url"));
+    const char* title = pack_string(pk, ytdlp_json_string(root, "title"));
+    const char* channel = ytdlp_json_string(root, "channel");
+    channel = pack_string(pk, channel ? channel : ytdlp_json_string(root, "uploader"));
+    const char* thumbnail = pack_string(pk, ytdlp_json_string(root, "thumbnail"));
+
+    int64_t expires_at = 0;
+    int i = 0;
+
+    if (formats) {
+        for (const YtdlpJson* f = formats->child; f; f = f->next) {
+            if (!is_usable_format(f)) continue;
+            pack_format(pk, ladder ? &ladder[i] : NULL, f);
+            if (ladder && ladder[i].expires_at &&
+                (!expires_at || ladder[i].expires_at < expires_at)) {
+                expires_at = ladder[i].expires_at;
+            }
+            i++;
+        }
+    } else {
+        /* Single-format extractors put the media fields on the root */
+        pack_format(pk, ladder, root);
+        if (ladder) expires_at = ladder[0].expires_at;
+    }
+
+    if (!info) return NULL;
+
+    memset(info, 0, sizeof(*info));
+    info->refs = 1;
+    info->list.original_url = original_url;
+    info->list.title = title;
+    info->list.is_live = ytdlp_json_bool(root, "is_live", false);
+    info->list.duration = json_double(root, "duration");
+    info->list.count = count;
+    info->list.formats = ladder;
+    info->channel = channel;
+    info->thumbnail_url = thumbnail;
+    info->expires_at = expires_at;
+    return info;
+}
+
+/* ============================================================================
+ * Media Info
+ * ========================================================================== */
+
+YtdlpMediaInfo* ytdlp_media_info_from_json(const YtdlpJson* root) {
+    if (!root || root->type != YTDLP_JSON_OBJECT) return NULL;
+
+    const YtdlpJson* formats = ytdlp_json_get(root, "formats");
+    if (formats && formats->type != YTDLP_JSON_ARRAY) formats = NULL;
+
+    int count = 0;
+    if (formats) {
+        for (const YtdlpJson* f = formats->child; f; f = f->next) {
+            if (is_usable_format(f)) count++;
+        }
+    }
+    if (count == 0 && is_usable_format(root)) {
+        formats = NULL;
+        count = 1;
+    }
+
+    if (count == 0) return NULL;
+
+    Packer pk = { NULL, 0 };
+    pack_info(&pk, root, formats, count);
+
+    size_t size = pk.used;
+    pk.base = (char*)ytdlp_malloc(size);
+    if (!pk.base) return NULL;
+    pk.used = 0;
+
+    YtdlpMediaInfo* info = pack_info(&pk, root, formats, count);
+    info->size = size;
+    return info;
+}
+
+void ytdlp_media_info_retain(const YtdlpMediaInfo* info) {
+    if (info) ytdlp_atomic_add_i32(&((YtdlpMediaInfo*)info)->refs, 1);
+}
+
+void ytdlp_media_info_release(const YtdlpMediaInfo* info) {
+    YtdlpMediaInfo* mutable_info = (YtdlpMediaInfo*)info;
+    if (mutable_info && ytdlp_atomic_add_i32(&mutable_info->refs, -1) == 0) {
+        ytdlp_free(mutable_info);
+    }
+}
+
+/* ============================================================================
+ * Flattened Copies
+ *
+ * The shared cache holds media info in memory each process maps at its own
+ * address. Pointers there are offsets from the start of the block, which
+ * is never itself pointed to, so NULL stays 0 either way.
+ * ========================================================================== */
+
+typedef struct Relocation {
+    char* block;       /* The copy being rewritten */
+    uintptr_t from;    /* Base the copy's pointers are relative to */
+    uintptr_t to;      /* Base they are rewritten against */
+    size_t size;
+    bool ok;
+} Relocation;
+
+/* Rewrite `*field` and return where it points within the copy */
+static void* relocate(Relocation* r, const void** field, size_t length) {
+    uintptr_t p = (uintptr_t)*field;
+    if (!p) return NULL;
+
+    size_t offset = (size_t)(p - r->from);
+    if (offset >= r->size || length > r->size - offset) {
+        r->ok = false;
+        *field = NULL;
+        return NULL;
+    }
+
+    *field = (const void*)(r->to + offset);
+    return r->block + offset;
+}
+
+#define RELOCATE(r, field, length) relocate((r), (const void**)&(field), (length))
+
+static void relocate_info(Relocation* r) {
+    YtdlpMediaInfo* info = (YtdlpMediaInfo*)r->block;
+    if (info->list.count < 0 || (size_t)info->list.count > r->size / sizeof(PrismYtdlpFormat)) {
+        r->ok = false;
+        return;
+    }
+
+    RELOCATE(r, info->list.original_url, 1);
+    RELOCATE(r, info->list.title, 1);
+    RELOCATE(r, info->channel, 1);
+    RELOCATE(r, info->thumbnail_url, 1);
+
+    PrismYtdlpFormat* formats = (PrismYtdlpFormat*)RELOCATE(r, info->list.formats,
+                                                            sizeof(PrismYtdlpFormat) * (size_t)info->list.count);
+    if (!formats) {
+        if (info->list.count > 0) r->ok = false;
+        return;
+    }
+
+    for (int i = 0; i < info->list.count && r->ok; i++) {
+        PrismYtdlpFormat* f = &formats[i];
+        RELOCATE(r, f->format_id, 1);
+        RELOCATE(r, f->url, 1);
+        RELOCATE(r, f->ext, 1);
+        RELOCATE(r, f->protocol, 1);
+        RELOCATE(r, f->video_codec, 1);
+        RELOCATE(r, f->audio_codec, 1);
+        RELOCATE(r, f->language, 1);
+        RELOCATE(r, f->cookies, 1);
+
+        if (f->header_count < 0 || (size_t)f->header_count > r->size / sizeof(char*)) {
+            r->ok = false;
+            break;
+        }
+        size_t length = sizeof(char*) * (size_t)f->header_count;
+        const char** names = (const char**)RELOCATE(r, f->header_names, length);
+        const char** values = (const char**)RELOCATE(r, f->header_values, length);
+        for (int h = 0; names && values && h < f->header_count; h++) {
+            RELOCATE(r, names[h], 1);
+            RELOCATE(r, values[h], 1);
+        }
+    }
+}
+
+void ytdlp_media_info_flatten(const YtdlpMediaInfo* info, void* dst) {
+    memcpy(dst, info, info->size);
+
+    Relocation r = { (char*)dst, (uintptr_t)info, 0, info->size, true };
+    relocate_info(&r);
+}
+
+YtdlpMediaInfo* ytdlp_media_info_unflatten(void* block, size_t size) {
+    if (size < sizeof(YtdlpMediaInfo)) return NULL;
+
+    Relocation r = { (char*)block, 0, (uintptr_t)block, size, true };
+    relocate_info(&r);
+    if (!r.ok) return NULL;
+
+    /* Every string starts inside the block, so ending the block with a NUL
+     * ends each of them inside it. The packer leaves a string's NUL or
+     * padding there anyway. */
+    YtdlpMediaInfo* info = (YtdlpMediaInfo*)block;
+    ((char*)block)[size - 1] = '\0';
+    info->refs = 1;
+    info->size = size;
+    return info;
+}
+
+/* ============================================================================
+ * Format List Copies
+ * ========================================================================== */
+
+static PrismYtdlpFormatList* pack_list(Packer* pk, const PrismYtdlpFormatList* src) {
+    PrismYtdlpFormatList* list = (PrismYtdlpFormatList*)pack_reserve(pk, sizeof(PrismYtdlpFormatList));
+    PrismYtdlpFormat* ladder = (PrismYtdlpFormat*)pack_reserve(pk, sizeof(PrismYtdlpFormat) * (size_t)src->count);
+
+    const char* original_url = pack_string(pk, src->original_url);
+    const char* title = pack_string(pk, src->title);
+
+    for (int i = 0; i < src->count; i++) {
+        const PrismYtdlpFormat* f = &src->formats[i];
+        const char* format_id = pack_string(pk, f->format_id);
+        const char* url = pack_string(pk, f->url);
+        const char* ext = pack_string(pk, f->ext);
+        const char* protocol = pack_string(pk, f->protocol);
+        const char* vcodec = pack_string(pk, f->video_codec);
+        const char* acodec = pack_string(pk, f->audio_codec);
+        const char* language = pack_string(pk, f->language);
+        const char* cookies = pack_string(pk, f->cookies);
+
+        const char** names = NULL;
+        const char** values = NULL;
+        if (f->header_count > 0) {
+            names = (const char**)pack_reserve(pk, sizeof(const char*) * (size_t)f->header_count);
+            values = (const char**)pack_reserve(pk, sizeof(const char*) * (size_t)f->header_count);
+            for (int h = 0; h < f->header_count; h++) {
+                const char* name = pack_string(pk, f->header_names[h]);
+                const char* value = pack_string(pk, f->header_values[h]);
+                if (names) {
+                    names[h] = name;
+                    values[h] = value;
+                }
+            }
+        }
+
+        if (ladder) {
+            ladder[i] = *f;
+            ladder[i].format_id = format_id;
+            ladder[i].url = url;
+            ladder[i].ext = ext;
+            ladder[i].protocol = protocol;
+            ladder[i].video_codec = vcodec;
+            ladder[i].audio_codec = acodec;
+            ladder[i].language = language;
+            ladder[i].cookies = cookies;
+            ladder[i].header_names = names;
+            ladder[i].header_values = values;
+        }
+    }
+
+    if (!list) return NULL;
+
+    *list = *src;
+    list->original_url = original_url;
+    list->title = title;
+    list->formats = ladder;
+    return list;
+}
+
+PrismYtdlpFormatList* ytdlp_media_info_copy_list(const YtdlpMediaInfo* info) {
+    if (!info) return NULL;
+
+    Packer pk = { NULL, 0 };
+    pack_list(&pk, &info->list);
+
+    pk.base = (char*)ytdlp_malloc(pk.used);
+    if (!pk.base) return NULL;
+    pk.used = 0;
+
+    return pack_list(&pk, &info->list);
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+PRISM_YTDLP_API void prism_ytdlp_free_formats(PrismYtdlpFormatList* list) {
+    ytdlp_free(list);
+}
@@ -0,0 +1,145 @@
+/*
+ * Prism yt-dlp Plugin - Platform Helpers
+ *
+ * Small OS abstractions shared by the plugin translation units.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <errno.h>
+    #include <time.h>
+    #include <sched.h>
+#endif
+
+/* ============================================================================
+ * Clock
+ * ========================================================================== */
+
+#ifdef _WIN32
+
+uint64_t ytdlp_monotonic_ms(void) {
+    return (uint64_t)GetTickCount64();
+}
+
+void ytdlp_thread_yield(void) {
+    SwitchToThread();
+}
+
+void ytdlp_sleep_ms(uint32_t ms) {
+    Sleep(ms);
+}
+
+void ytdlp_cond_wait_ms(YtdlpCond* cond, YtdlpMutex* mutex, uint32_t timeout_ms) {
+    SleepConditionVariableSRW(cond, mutex, timeout_ms, 0);
+}
+
+#else /* POSIX */
+
+uint64_t ytdlp_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+void ytdlp_thread_yield(void) {
+    sched_yield();
+}
+
+void ytdlp_sleep_ms(uint32_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+void ytdlp_cond_wait_ms(YtdlpCond* cond, YtdlpMutex* mutex, uint32_t timeout_ms) {
+    /* Condition variables are initialized with the default (realtime) clock */
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+#endif
+
+/* ============================================================================
+ * Threads
+ * ========================================================================== */
+
+typedef struct ThreadStart {
+    void (*fn)(void*);
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+
+static unsigned __stdcall thread_main(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    ytdlp_free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+bool ytdlp_thread_start(YtdlpThread* thread, void (*fn)(void*), void* arg) {
+    ThreadStart* start = (ThreadStart*)ytdlp_malloc(sizeof(ThreadStart));
+    if (!start) return false;
+    start->fn = fn;
+    start->arg = arg;
+
+    uintptr_t handle = _beginthreadex(NULL, 0, thread_main, start, 0, NULL);
+    if (!handle) {
+        ytdlp_free(start);
+        return false;
+    }
+    *thread = (HANDLE)handle;
+    return true;
+}
+
+void ytdlp_thread_join(YtdlpThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+bool ytdlp_thread_is_current(YtdlpThread thread) {
+    return GetThreadId(thread) == GetCurrentThreadId();
+}
+
+#else /* POSIX */
+
+static void* thread_main(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    ytdlp_free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+bool ytdlp_thread_start(YtdlpThread* thread, void (*fn)(void*), void* arg) {
+    ThreadStart* start = (ThreadStart*)ytdlp_malloc(sizeof(ThreadStart));
+    if (!start) return false;
+    start->fn = fn;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_main, start) != 0) {
+        ytdlp_free(start);
+        return false;
+    }
+    return true;
+}
+
+void ytdlp_thread_join(YtdlpThread thread) {
+    pthread_join(thread, NULL);
+}
+
+bool ytdlp_thread_is_current(YtdlpThread thread) {
+    return pthread_equal(thread, pthread_self()) != 0;
+}
+
+#endif
@@ -7,6 +7,7 @@
  */
 
 #include "prism_ytdlp_plugin.h"
+#include "ytdlp_internal.h"
 #include <prism/prism_plugin.h>
 #include <prism/prism_resolver.h>
 
@@ -75,12 +76,25 @@ static const PrismPluginInfo* ytdlp_plugin_get_info(void) {
 
 static PrismError ytdlp_plugin_init(const char* config) {
     (void)config;
-    /* Initialization handled lazily on first use */
+
+    /* Create the yt-dlp cache directory up front; everything else is
+     * initialized lazily on first use */
+    const YtdlpConfig* current = ytdlp_config_acquire();
+    if (current->cache_dir_max_mb >= 0) {
+        char dir[YTDLP_PATH_MAX];
+        ytdlp_cache_dir_prepare(current->cache_dir, dir, sizeof(dir));
+    }
+    ytdlp_config_release(current);
+
     return PRISM_OK;
 }
 
 static void ytdlp_plugin_shutdown(void) {
-    /* Nothing to clean up */
+    ytdlp_update_shutdown();
+    ytdlp_daemon_shutdown();
+    ytdlp_process_shutdown();
+    ytdlp_cache_dir_shutdown();
+    ytdlp_zygote_shutdown();
 }
 
 static PrismError ytdlp_plugin_register(PrismPluginRegistry* registry) {
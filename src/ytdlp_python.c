@@ -0,0 +1,430 @@
+/*
+ * Prism yt-dlp Plugin - Embedded Python Backend
+ *
+ * Runs yt-dlp inside the plugin instead of as a child process: libpython is
+ * loaded at runtime, `yt_dlp` is imported once, and each extraction is a call
+ * to YoutubeDL.extract_info() on the resolving thread. That removes process
+ * startup, the interpreter's own startup and the module imports from every
+ * resolve. The info dict comes back as the same JSON `yt-dlp -J` prints, so
+ * the media parser and everything after it are shared with the process
+ * backend.
+ *
+ * libpython is never a link-time dependency. If it cannot be loaded, or the
+ * yt_dlp package cannot be imported, the resolver keeps using the yt-dlp
+ * binary.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE  /* dladdr */
+#endif
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#ifndef _WIN32
+    #include <dlfcn.h>
+    #include <unistd.h>
+#endif
+
+/* ============================================================================
+ * libpython Symbols
+ *
+ * Only a handful of long-standing exports are used, so any Python 3.8+ works.
+ * ========================================================================== */
+
+typedef struct PyObject PyObject;
+typedef struct PyThreadState PyThreadState;
+typedef intptr_t PySsize;   /* Py_ssize_t */
+
+typedef struct PythonApi {
+    int (*Py_IsInitialized)(void);
+    void (*Py_InitializeEx)(int);
+    PyThreadState* (*PyEval_SaveThread)(void);
+    int (*PyGILState_Ensure)(void);
+    void (*PyGILState_Release)(int);
+    int (*PyRun_SimpleString)(const char*);
+    PyObject* (*PyImport_AddModule)(const char*);
+    PyObject* (*PyObject_GetAttrString)(PyObject*, const char*);
+    PyObject* (*PyObject_CallFunction)(PyObject*, const char*, ...);
+    const char* (*PyUnicode_AsUTF8AndSize)(PyObject*, PySsize*);
+    void (*Py_DecRef)(PyObject*);
+    void (*PyErr_Clear)(void);
+    const char* (*Py_GetVersion)(void);
+    void (*Py_SetPythonHome)(const wchar_t*);   /* Optional; deprecated since 3.11 */
+} PythonApi;
+
+#ifdef _WIN32
+    typedef HMODULE PythonLibrary;
+    #define library_open(name) LoadLibraryA(name)
+    #define library_symbol(lib, name) ((void*)GetProcAddress((lib), (name)))
+    #define library_close(lib) FreeLibrary(lib)
+
+    static const char* s_library_names[] = {
+        "python3.dll", "python313.dll", "python312.dll", "python311.dll",
+        "python310.dll", "python39.dll", "python38.dll", NULL
+    };
+#else
+    typedef void* PythonLibrary;
+    /* RTLD_GLOBAL so the interpreter's extension modules can bind to it */
+    #define library_open(name) dlopen((name), RTLD_NOW | RTLD_GLOBAL)
+    #define library_symbol(lib, name) dlsym((lib), (name))
+    #define library_close(lib) dlclose(lib)
+
+    static const char* s_library_names[] = {
+    #ifdef __APPLE__
+        "libpython3.13.dylib", "libpython3.12.dylib", "libpython3.11.dylib",
+        "libpython3.10.dylib", "libpython3.9.dylib", "libpython3.8.dylib",
+    #else
+        "libpython3.so",
+        "libpython3.13.so.1.0", "libpython3.12.so.1.0", "libpython3.11.so.1.0",
+        "libpython3.10.so.1.0", "libpython3.9.so.1.0", "libpython3.8.so.1.0",
+    #endif
+        NULL
+    };
+#endif
+
+/* ============================================================================
+ * Extraction Glue
+ *
+ * _prism_ytdlp_extract() never raises: it returns the sanitized info dict as
+ * JSON prefixed with 'J', or an error message prefixed with 'E'. The zygote
+ * runs the same definition.
+ * ========================================================================== */
+
+const char ytdlp_python_extract_source[] =
+    "import json as _prism_json\n"
+    "class _PrismQuietLogger:\n"
+    "    def debug(self, msg): pass\n"
+    "    def info(self, msg): pass\n"
+    "    def warning(self, msg): pass\n"
+    "    def error(self, msg): pass\n"
+    "def _prism_ytdlp_extract(url, lang, cache_dir, timeout_s, retries):\n"
+    "    try:\n"
+    "        opts = {'quiet': True, 'no_warnings': True, 'noplaylist': True,\n"
+    "                'nocheckcertificate': True, 'logger': _PrismQuietLogger()}\n"
+    "        if lang:\n"
+    "            opts['extractor_args'] = {'youtube': {'lang': [lang]}}\n"
+    "        if cache_dir:\n"
+    "            opts['cachedir'] = cache_dir\n"
+    "        if timeout_s > 0:\n"
+    "            opts['socket_timeout'] = timeout_s\n"
+    "        if retries >= 0:\n"
+    "            opts['extractor_retries'] = retries\n"
+    "        with _prism_yt_dlp.YoutubeDL(opts) as ydl:\n"
+    "            info = ydl.extract_info(url, download=False)\n"
+    "            return 'J' + _prism_json.dumps(ydl.sanitize_info(info))\n"
+    "    except BaseException as e:\n"
+    "        return 'E' + (str(e) or type(e).__name__)\n";
+
+/* Run in __main__ around the extraction source; the function is only left
+ * defined if yt_dlp could be imported */
+static const char s_import[] =
+    "import sys as _prism_sys\n"
+    "if _prism_path and _prism_path not in _prism_sys.path:\n"
+    "    _prism_sys.path.insert(0, _prism_path)\n"
+    "try:\n"
+    "    import yt_dlp as _prism_yt_dlp\n"
+    "except ImportError:\n"
+    "    _prism_yt_dlp = None\n";
+
+static const char s_cleanup[] =
+    "if _prism_yt_dlp is None:\n"
+    "    del _prism_ytdlp_extract\n";
+
+typedef enum PythonState {
+    PYTHON_UNLOADED,
+    PYTHON_READY,
+    PYTHON_FAILED
+} PythonState;
+
+static YtdlpMutex s_lock = YTDLP_MUTEX_INIT;
+static PythonState s_state = PYTHON_UNLOADED;
+static PythonApi s_api;
+static PyObject* s_extract;   /* _prism_ytdlp_extract, kept referenced */
+static char s_version[64];    /* yt_dlp.version.__version__ of the imported module */
+
+static bool bind_api(PythonLibrary lib, PythonApi* api) {
+#define BIND(name) \
+    if (!(*(void**)&api->name = library_symbol(lib, #name))) return false
+
+    BIND(Py_IsInitialized);
+    BIND(Py_InitializeEx);
+    BIND(PyEval_SaveThread);
+    BIND(PyGILState_Ensure);
+    BIND(PyGILState_Release);
+    BIND(PyRun_SimpleString);
+    BIND(PyImport_AddModule);
+    BIND(PyObject_GetAttrString);
+    BIND(PyObject_CallFunction);
+    BIND(PyUnicode_AsUTF8AndSize);
+    BIND(Py_DecRef);
+    BIND(PyErr_Clear);
+    BIND(Py_GetVersion);
+    *(void**)&api->Py_SetPythonHome = library_symbol(lib, "Py_SetPythonHome");
+    return true;
+
+#undef BIND
+}
+
+/* Open `name` and bind the API from it; NULL if either fails */
+static PythonLibrary open_bound(const char* name, PythonApi* api) {
+    PythonLibrary lib = library_open(name);
+    if (lib && !bind_api(lib, api)) {
+        library_close(lib);
+        lib = NULL;
+    }
+    return lib;
+}
+
+/* The configured library, or the first of the usual names that binds. The
+ * libpython3 stable-ABI shims of Python < 3.10 lack a symbol and are skipped. */
+static PythonLibrary open_library(const char* configured, PythonApi* api) {
+    if (configured && configured[0]) {
+        return open_bound(configured, api);
+    }
+
+    for (int i = 0; s_library_names[i]; i++) {
+        PythonLibrary lib = open_bound(s_library_names[i], api);
+        if (lib) return lib;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Python Home
+ *
+ * Without a home, the interpreter locates its standard library from the host
+ * executable or from `python3` on PATH, which may be a different Python than
+ * the libpython that was loaded. The home is derived from the library's own
+ * location instead, as the nearest ancestor holding the matching stdlib.
+ * ========================================================================== */
+
+static wchar_t s_home[YTDLP_PATH_MAX];   /* Python keeps the pointer */
+
+static bool library_dir(char* dir, size_t size) {
+#ifdef _WIN32
+    HMODULE module = NULL;
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                            (LPCSTR)(void*)s_api.Py_IsInitialized, &module) ||
+        !GetModuleFileNameA(module, dir, (DWORD)size)) {
+        return false;
+    }
+    char* slash = strrchr(dir, '\\');
+#else
+    Dl_info info;
+    if (!dladdr(*(void**)&s_api.Py_IsInitialized, &info) || !info.dli_fname) return false;
+    snprintf(dir, size, "%s", info.dli_fname);
+    char* slash = strrchr(dir, '/');
+#endif
+    if (!slash) return false;
+    *slash = '\0';
+    return true;
+}
+
+static bool has_stdlib(const char* prefix, const char* version) {
+    char landmark[YTDLP_PATH_MAX];
+#ifdef _WIN32
+    (void)version;
+    snprintf(landmark, sizeof(landmark), "%s\\Lib\\os.py", prefix);
+    return GetFileAttributesA(landmark) != INVALID_FILE_ATTRIBUTES;
+#else
+    snprintf(landmark, sizeof(landmark), "%s/lib/python%s/os.py", prefix, version);
+    return access(landmark, F_OK) == 0;
+#endif
+}
+
+static void set_python_home(void) {
+    if (!s_api.Py_SetPythonHome || getenv("PYTHONHOME")) return;
+
+    /* "3.11.7 (main, ...)" -> "3.11" */
+    char version[16];
+    const char* full = s_api.Py_GetVersion();
+    size_t len = 0;
+    for (int dots = 0; full[len] && len < sizeof(version) - 1; len++) {
+        if (full[len] == '.' && ++dots == 2) break;
+        if (full[len] == ' ') break;
+        version[len] = full[len];
+    }
+    version[len] = '\0';
+
+    char prefix[YTDLP_PATH_MAX];
+    if (!library_dir(prefix, sizeof(prefix))) return;
+
+    /* The library sits in the prefix (Windows), in <prefix>/lib, or in a
+     * multiarch directory below it */
+    for (int depth = 0; depth < 3; depth++) {
+        if (has_stdlib(prefix, version)) {
+            if (mbstowcs(s_home, prefix, YTDLP_PATH_MAX - 1) != (size_t)-1) {
+                s_home[YTDLP_PATH_MAX - 1] = L'\0';
+                s_api.Py_SetPythonHome(s_home);
+            }
+            return;
+        }
+        char* slash = strrchr(prefix, '/');
+#ifdef _WIN32
+        char* backslash = strrchr(prefix, '\\');
+        if (!slash || (backslash && backslash > slash)) slash = backslash;
+#endif
+        if (!slash || slash == prefix) return;
+        *slash = '\0';
+    }
+}
+
+/* ============================================================================
+ * Loading
+ * ========================================================================== */
+
+/* Run the glue with the GIL held; returns a reference to the extract function */
+static PyObject* install_glue(const char* python_path) {
+    /* sys.path entry as a Python string literal; paths with quotes or
+     * backslashes are passed raw-escaped */
+    char path_literal[YTDLP_PATH_MAX * 2 + 16];
+    size_t n = 0;
+    path_literal[n++] = '\'';
+    for (const char* p = python_path ? python_path : ""; *p && n < sizeof(path_literal) - 3; p++) {
+        if (*p == '\\' || *p == '\'') path_literal[n++] = '\\';
+        path_literal[n++] = *p;
+    }
+    path_literal[n++] = '\'';
+    path_literal[n] = '\0';
+
+    char prologue[sizeof(path_literal) + 32];
+    snprintf(prologue, sizeof(prologue), "_prism_path = %s\n", path_literal);
+
+    if (s_api.PyRun_SimpleString(prologue) != 0 ||
+        s_api.PyRun_SimpleString(s_import) != 0 ||
+        s_api.PyRun_SimpleString(ytdlp_python_extract_source) != 0 ||
+        s_api.PyRun_SimpleString(s_cleanup) != 0) {
+        return NULL;
+    }
+
+    PyObject* main_module = s_api.PyImport_AddModule("__main__");  /* Borrowed */
+    if (!main_module) return NULL;
+    return s_api.PyObject_GetAttrString(main_module, "_prism_ytdlp_extract");
+}
+
+/* Copy yt_dlp.version.__version__ into s_version; the GIL must be held */
+static void read_version(void) {
+    PyObject* main_module = s_api.PyImport_AddModule("__main__");  /* Borrowed */
+    PyObject* module = main_module ? s_api.PyObject_GetAttrString(main_module, "_prism_yt_dlp") : NULL;
+    PyObject* version_module = module ? s_api.PyObject_GetAttrString(module, "version") : NULL;
+    PyObject* version = version_module ? s_api.PyObject_GetAttrString(version_module, "__version__") : NULL;
+
+    PySsize len = 0;
+    const char* text = version ? s_api.PyUnicode_AsUTF8AndSize(version, &len) : NULL;
+    if (text && len > 0 && (size_t)len < sizeof(s_version)) {
+        memcpy(s_version, text, (size_t)len);
+        s_version[len] = '\0';
+    }
+
+    if (version) s_api.Py_DecRef(version);
+    if (version_module) s_api.Py_DecRef(version_module);
+    if (module) s_api.Py_DecRef(module);
+    s_api.PyErr_Clear();
+}
+
+bool ytdlp_python_load(const char* library, const char* python_path) {
+    ytdlp_mutex_lock(&s_lock);
+
+    if (s_state == PYTHON_UNLOADED) {
+        s_state = PYTHON_FAILED;
+
+        PythonLibrary lib = open_library(library, &s_api);
+
+        /* A host that already embeds Python keeps its interpreter; ours is
+         * started without installing signal handlers. Once touched, libpython
+         * stays loaded even if yt_dlp turns out to be missing. */
+        if (lib && s_api.Py_IsInitialized()) {
+            int gil = s_api.PyGILState_Ensure();
+            s_extract = install_glue(python_path);
+            if (s_extract) read_version();
+            else s_api.PyErr_Clear();
+            s_api.PyGILState_Release(gil);
+        } else if (lib) {
+            set_python_home();
+            s_api.Py_InitializeEx(0);
+            s_extract = install_glue(python_path);
+            if (s_extract) read_version();
+            else s_api.PyErr_Clear();
+            /* Drop the GIL initialization took so resolving threads can take it */
+            s_api.PyEval_SaveThread();
+        }
+
+        if (s_extract) s_state = PYTHON_READY;
+    }
+
+    bool ready = s_state == PYTHON_READY;
+    ytdlp_mutex_unlock(&s_lock);
+    return ready;
+}
+
+bool ytdlp_python_version(char* version, size_t size) {
+    ytdlp_mutex_lock(&s_lock);
+    bool known = s_state == PYTHON_READY && s_version[0] && strlen(s_version) < size;
+    if (known) memcpy(version, s_version, strlen(s_version) + 1);
+    ytdlp_mutex_unlock(&s_lock);
+    return known;
+}
+
+/* ============================================================================
+ * Extraction
+ * ========================================================================== */
+
+YtdlpProcessResult ytdlp_python_extract(const char* url, const char* language, const char* cache_dir, int timeout_ms) {
+    YtdlpProcessResult result = { NULL, NULL, -1 };
+
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) {
+        result.error = "Out of memory";
+        return result;
+    }
+    ytdlp_buffer_clear(&scratch->out);
+    ytdlp_ring_clear(&scratch->err);
+
+    ytdlp_mutex_lock(&s_lock);
+    bool ready = s_state == PYTHON_READY;
+    ytdlp_mutex_unlock(&s_lock);
+    if (!ready) {
+        result.error = "Embedded Python backend not loaded";
+        return result;
+    }
+
+    /* Extraction cannot be interrupted; the budget bounds each network
+     * operation and the retries instead of the whole call */
+    int timeout_s, retries;
+    ytdlp_network_limits(timeout_ms, &timeout_s, &retries);
+
+    int gil = s_api.PyGILState_Ensure();
+
+    PyObject* ret = s_api.PyObject_CallFunction(s_extract, "zzzii", url, language,
+                                                cache_dir && cache_dir[0] ? cache_dir : NULL, timeout_s, retries);
+    PySsize len = 0;
+    const char* text = ret ? s_api.PyUnicode_AsUTF8AndSize(ret, &len) : NULL;
+
+    if (text && len > 0 && text[0] == 'J') {
+        if (ytdlp_buffer_append(&scratch->out, text + 1, (size_t)len - 1)) {
+            result.output = scratch->out.data;
+            result.exit_code = 0;
+        } else {
+            result.error = "Out of memory";
+        }
+    } else if (text && len > 0) {
+        ytdlp_ring_append(&scratch->err, text + 1, (size_t)len - 1);
+        result.exit_code = 1;
+        result.error = ytdlp_ring_linearize(&scratch->err);
+    } else {
+        s_api.PyErr_Clear();
+        result.error = "Embedded yt-dlp call failed";
+    }
+
+    if (ret) s_api.Py_DecRef(ret);
+    s_api.PyGILState_Release(gil);
+
+    return result;
+}
@@ -0,0 +1,321 @@
+/*
+ * Prism yt-dlp Plugin - Refresh Scheduler
+ *
+ * Re-resolves watched streams a margin before their signed URLs expire, so a
+ * long session can switch to fresh URLs instead of stalling on a 403.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Minimum spacing of refreshes of one watch, so a failing extraction or URLs
+ * that come back already inside the margin are not re-resolved in a loop */
+#define YTDLP_REFRESH_INTERVAL_MS (30 * 1000)
+
+typedef struct RefreshWatch {
+    uint64_t id;
+    char* url;
+    char* language;
+    PrismResolverOptions options;
+    int64_t expires_at;               /* Unix time the current URLs stop working */
+    uint64_t due_ms;                  /* Monotonic time of the next attempt */
+    bool cancelled;                   /* Unwatched while its refresh was in flight */
+    PrismYtdlpRefreshCallback callback;
+    void* user_data;
+} RefreshWatch;
+
+struct YtdlpRefresher {
+    YtdlpMutex lock;
+    YtdlpCond wake;                   /* Watches changed or stop requested */
+    YtdlpCond idle;                   /* A refresh in flight finished */
+
+    YtdlpThread thread;
+    bool running;
+    bool stopping;
+
+    YtdlpRefreshResolve resolve;
+    void* context;
+    int margin_ms;
+
+    RefreshWatch* watches;
+    int count;
+    int capacity;
+    uint64_t next_id;
+    uint64_t in_flight;               /* Watch being refreshed outside the lock (0 = none) */
+};
+
+/* ============================================================================
+ * Helpers
+ * ========================================================================== */
+
+static char* str_copy(const char* s) {
+    if (!s) return NULL;
+
+    size_t n = strlen(s) + 1;
+    char* copy = (char*)ytdlp_malloc(n);
+    if (copy) memcpy(copy, s, n);
+    return copy;
+}
+
+/* Earliest expiry of the URLs a stream hands to the player */
+static int64_t stream_expiry(const PrismResolvedStream* stream) {
+    int64_t video = ytdlp_url_expiry(stream->direct_url);
+    int64_t audio = ytdlp_url_expiry(stream->audio_url);
+    if (!video) return audio;
+    if (!audio) return video;
+    return video < audio ? video : audio;
+}
+
+static uint64_t due_before_expiry(const YtdlpRefresher* refresher, int64_t expires_at) {
+    uint64_t now = ytdlp_monotonic_ms();
+    int64_t remaining_ms = (expires_at - (int64_t)time(NULL)) * 1000 - refresher->margin_ms;
+    return remaining_ms > 0 ? now + (uint64_t)remaining_ms : now;
+}
+
+static RefreshWatch* find_watch(YtdlpRefresher* refresher, uint64_t id) {
+    for (int i = 0; i < refresher->count; i++) {
+        if (refresher->watches[i].id == id) return &refresher->watches[i];
+    }
+    return NULL;
+}
+
+static void remove_watch(YtdlpRefresher* refresher, RefreshWatch* watch) {
+    ytdlp_free(watch->url);
+    ytdlp_free(watch->language);
+    *watch = refresher->watches[--refresher->count];
+}
+
+static RefreshWatch* earliest_watch(YtdlpRefresher* refresher) {
+    RefreshWatch* next = NULL;
+    for (int i = 0; i < refresher->count; i++) {
+        RefreshWatch* watch = &refresher->watches[i];
+        if (watch->id != refresher->in_flight && (!next || watch->due_ms < next->due_ms)) {
+            next = watch;
+        }
+    }
+    return next;
+}
+
+/* ============================================================================
+ * Refresh Thread
+ * ========================================================================== */
+
+/* Called with the lock held once a refresh of `id` has been delivered */
+/* `retry` tells whether a failure may go away by itself */
+static void reschedule(YtdlpRefresher* refresher, uint64_t id, int64_t expires_at, bool succeeded, bool retry) {
+    RefreshWatch* watch = find_watch(refresher, id);
+    if (!watch) return;
+
+    if (watch->cancelled) {
+        remove_watch(refresher, watch);
+        return;
+    }
+
+    if (succeeded) {
+        /* Fresh URLs without an expiry need no further refreshes */
+        if (!expires_at) {
+            remove_watch(refresher, watch);
+            return;
+        }
+        uint64_t earliest = ytdlp_monotonic_ms() + YTDLP_REFRESH_INTERVAL_MS;
+        uint64_t due = due_before_expiry(refresher, expires_at);
+        watch->expires_at = expires_at;
+        watch->due_ms = due > earliest ? due : earliest;
+        return;
+    }
+
+    /* Retry while the URLs the player holds still work */
+    if (retry && (int64_t)time(NULL) * 1000 + YTDLP_REFRESH_INTERVAL_MS < watch->expires_at * 1000) {
+        watch->due_ms = ytdlp_monotonic_ms() + YTDLP_REFRESH_INTERVAL_MS;
+    } else {
+        remove_watch(refresher, watch);
+    }
+}
+
+static void refresh_thread(void* arg) {
+    YtdlpRefresher* refresher = (YtdlpRefresher*)arg;
+
+    ytdlp_mutex_lock(&refresher->lock);
+
+    while (!refresher->stopping) {
+        RefreshWatch* watch = earliest_watch(refresher);
+        if (!watch) {
+            ytdlp_cond_wait(&refresher->wake, &refresher->lock);
+            continue;
+        }
+
+        uint64_t now = ytdlp_monotonic_ms();
+        if (watch->due_ms > now) {
+            uint64_t wait_ms = watch->due_ms - now;
+            ytdlp_cond_wait_ms(&refresher->wake, &refresher->lock,
+                               wait_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)wait_ms);
+            continue;
+        }
+
+        /* The URL and language strings stay put while the watch is in flight */
+        uint64_t id = watch->id;
+        const char* url = watch->url;
+        PrismResolverOptions options = watch->options;
+        PrismYtdlpRefreshCallback callback = watch->callback;
+        void* user_data = watch->user_data;
+        refresher->in_flight = id;
+
+        ytdlp_mutex_unlock(&refresher->lock);
+        PrismResolvedStream* stream = refresher->resolve(refresher->context, url, &options);
+        ytdlp_mutex_lock(&refresher->lock);
+
+        bool succeeded = stream && stream->success;
+        bool retry = !stream || prism_ytdlp_error_is_transient(prism_ytdlp_error_class(stream));
+        int64_t expires_at = succeeded ? stream_expiry(stream) : 0;
+
+        watch = find_watch(refresher, id);
+        if (stream && watch && !watch->cancelled) {
+            ytdlp_mutex_unlock(&refresher->lock);
+            callback(id, stream, user_data);
+            ytdlp_mutex_lock(&refresher->lock);
+        } else {
+            prism_ytdlp_free_stream(stream);
+        }
+
+        reschedule(refresher, id, expires_at, succeeded, retry);
+        refresher->in_flight = 0;
+        ytdlp_cond_broadcast(&refresher->idle);
+    }
+
+    ytdlp_mutex_unlock(&refresher->lock);
+}
+
+/* ============================================================================
+ * Scheduler
+ * ========================================================================== */
+
+YtdlpRefresher* ytdlp_refresher_create(YtdlpRefreshResolve resolve, void* context, int margin_ms) {
+    YtdlpRefresher* refresher = (YtdlpRefresher*)ytdlp_calloc(1, sizeof(YtdlpRefresher));
+    if (!refresher) return NULL;
+
+    ytdlp_mutex_init(&refresher->lock);
+    ytdlp_cond_init(&refresher->wake);
+    ytdlp_cond_init(&refresher->idle);
+    refresher->resolve = resolve;
+    refresher->context = context;
+    refresher->margin_ms = margin_ms;
+    refresher->next_id = 1;
+    return refresher;
+}
+
+void ytdlp_refresher_destroy(YtdlpRefresher* refresher) {
+    if (!refresher) return;
+
+    ytdlp_mutex_lock(&refresher->lock);
+    refresher->stopping = true;
+    ytdlp_cond_broadcast(&refresher->wake);
+    bool running = refresher->running;
+    ytdlp_mutex_unlock(&refresher->lock);
+
+    if (running) {
+        ytdlp_thread_join(refresher->thread);
+    }
+
+    while (refresher->count > 0) {
+        remove_watch(refresher, &refresher->watches[0]);
+    }
+    ytdlp_free(refresher->watches);
+    ytdlp_cond_destroy(&refresher->idle);
+    ytdlp_cond_destroy(&refresher->wake);
+    ytdlp_mutex_destroy(&refresher->lock);
+    ytdlp_free(refresher);
+}
+
+uint64_t ytdlp_refresher_watch(
+    YtdlpRefresher* refresher,
+    const PrismResolvedStream* stream,
+    const PrismResolverOptions* options,
+    PrismYtdlpRefreshCallback callback,
+    void* user_data
+) {
+    if (!refresher || !stream || !stream->success || !stream->original_url || !callback) return 0;
+
+    int64_t expires_at = stream_expiry(stream);
+    if (!expires_at) return 0;
+
+    RefreshWatch watch;
+    memset(&watch, 0, sizeof(watch));
+    if (options) {
+        watch.options = *options;
+    } else {
+        prism_resolver_options_init(&watch.options);
+        watch.options.quality = stream->requested_quality;
+    }
+    watch.url = str_copy(stream->original_url);
+    watch.language = str_copy(watch.options.preferred_audio_language);
+    watch.options.preferred_audio_language = watch.language;
+    watch.expires_at = expires_at;
+    watch.due_ms = due_before_expiry(refresher, expires_at);
+    watch.callback = callback;
+    watch.user_data = user_data;
+
+    if (!watch.url || (watch.options.preferred_audio_language && !watch.language)) {
+        ytdlp_free(watch.url);
+        ytdlp_free(watch.language);
+        return 0;
+    }
+
+    ytdlp_mutex_lock(&refresher->lock);
+
+    if (refresher->count == refresher->capacity) {
+        int capacity = refresher->capacity ? refresher->capacity * 2 : 8;
+        RefreshWatch* grown = (RefreshWatch*)ytdlp_realloc(refresher->watches, sizeof(RefreshWatch) * (size_t)capacity);
+        if (!grown) {
+            ytdlp_mutex_unlock(&refresher->lock);
+            ytdlp_free(watch.url);
+            ytdlp_free(watch.language);
+            return 0;
+        }
+        refresher->watches = grown;
+        refresher->capacity = capacity;
+    }
+
+    if (!refresher->running && !refresher->stopping) {
+        refresher->running = ytdlp_thread_start(&refresher->thread, refresh_thread, refresher);
+    }
+    if (!refresher->running) {
+        ytdlp_mutex_unlock(&refresher->lock);
+        ytdlp_free(watch.url);
+        ytdlp_free(watch.language);
+        return 0;
+    }
+
+    watch.id = refresher->next_id++;
+    refresher->watches[refresher->count++] = watch;
+    ytdlp_cond_signal(&refresher->wake);
+
+    ytdlp_mutex_unlock(&refresher->lock);
+    return watch.id;
+}
+
+void ytdlp_refresher_unwatch(YtdlpRefresher* refresher, uint64_t watch_id) {
+    if (!refresher || watch_id == 0) return;
+
+    ytdlp_mutex_lock(&refresher->lock);
+
+    RefreshWatch* watch = find_watch(refresher, watch_id);
+    if (watch && refresher->in_flight == watch_id) {
+        /* The refresh thread drops it once the refresh completes */
+        watch->cancelled = true;
+        if (!ytdlp_thread_is_current(refresher->thread)) {
+            while (refresher->in_flight == watch_id) {
+                ytdlp_cond_wait(&refresher->idle, &refresher->lock);
+            }
+        }
+    } else if (watch) {
+        remove_watch(refresher, watch);
+        ytdlp_cond_signal(&refresher->wake);
+    }
+
+    ytdlp_mutex_unlock(&refresher->lock);
+}
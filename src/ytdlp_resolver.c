@@ -6,7 +6,12 @@
  * License: Unlicense (Public Domain)
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE  /* pipe2 */
+#endif
+
 #include "prism_ytdlp_plugin.h"
+#include "ytdlp_internal.h"
 #include <prism/prism_resolver.h>
 
 #include <stdio.h>
@@ -14,6 +19,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <limits.h>
+#include <time.h>
 
 #ifdef _WIN32
     #ifndef WIN32_LEAN_AND_MEAN
@@ -21,26 +28,41 @@
     #endif
     #include <windows.h>
     #include <shlobj.h>
-    #include <urlmon.h>
-    #pragma comment(lib, "urlmon.lib")
     #pragma comment(lib, "shell32.lib")
-    /* strtok_r is strtok_s on Windows */
-    #define strtok_r strtok_s
 #else
     #include <unistd.h>
     #include <sys/wait.h>
     #include <sys/stat.h>
     #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
     #include <pthread.h>
+    #include <signal.h>
 #endif
 
 /* ============================================================================
  * Configuration
  * ========================================================================== */
 
-#define YTDLP_PROCESS_TIMEOUT_MS 30000
-#define YTDLP_OUTPUT_BUFFER_SIZE 8192
-#define YTDLP_GITHUB_RELEASES "https://github.com/yt-dlp/yt-dlp/releases/latest/download/"
+#define YTDLP_OUTPUT_BUFFER_SIZE 8192  /* Minimum free space per pipe read */
+#define YTDLP_CANCEL_POLL_MS 100       /* Cancellable runs check their flag this often */
+#define YTDLP_SHUTDOWN_REAP_MS 5000    /* Shutdown waits this long for killed children */
+#define YTDLP_CACHE_CAPACITY 64                  /* Default extractions kept per resolver */
+#define YTDLP_CACHE_TTL_MS (5 * 60 * 1000)       /* Default lifetime of a cached extraction */
+#define YTDLP_EXPIRY_MARGIN_MS (60 * 1000)       /* Stop serving cached URLs this long before they expire */
+#define YTDLP_REFRESH_MARGIN_MS (2 * 60 * 1000)  /* Default lead time for refreshing watched streams */
+#define YTDLP_SLOT_WAIT_SHARE 2                  /* Waiting for a yt-dlp slot may use 1/N of a deadline */
+#define YTDLP_SOCKET_TIMEOUT_MAX_S 20            /* yt-dlp socket timeout when time is plentiful */
+#define YTDLP_EXTRACTOR_RETRIES_MAX 3            /* yt-dlp's own default */
+#define YTDLP_RATE_LIMIT_BACKOFF_MS (60 * 1000)   /* Resolves skip a site this long after it throttled */
+#define YTDLP_OFFLINE_RETRY_MS (30 * 1000)        /* Offline live channels are checked again after this */
+#define YTDLP_BROKEN_RETRY_MS (60 * 1000)         /* Broken extractions, in case yt-dlp was updated */
+#define YTDLP_HEDGE_HOSTS 32                      /* Hosts whose latencies a hedging resolver tracks */
+#define YTDLP_HEDGE_SAMPLES 64                    /* Recent extraction latencies kept per host */
+#define YTDLP_HEDGE_MIN_SAMPLES 16                /* Latencies needed before a host is hedged */
+#define YTDLP_HEDGE_MAX_PERCENT 5                 /* Default hedges per 100 extractions */
+#define YTDLP_HEDGE_BURST 3                       /* Hedges that may be saved up for a burst */
+#define YTDLP_DAEMON_MARGIN_MS 5000               /* Daemon answers may take this much past a yt-dlp run */
 
 /* Known hosts that yt-dlp can resolve */
 static const char* s_known_hosts[] = {
@@ -64,48 +86,85 @@ static const char* s_known_hosts[] = {
     NULL
 };
 
-/* Hosts that support multiple audio language tracks (AI-dubbed content).
- * Only these hosts will have the language preference applied during resolution
- * to avoid unnecessary processing overhead for other platforms. */
-static const char* s_language_capable_hosts[] = {
-    "youtube.com", "youtu.be", "www.youtube.com", "m.youtube.com",
-    NULL
-};
-
 /* Default preferred audio language */
 static const char* s_default_language = "en";
 
-/* Global configuration */
-static struct {
-    char ytdlp_path[1024];
-    char install_dir[1024];
-    bool auto_download;
-    int process_timeout_ms;
-    bool initialized;
-    bool download_attempted;
-} g_config = {
-    .ytdlp_path = {0},
-    .install_dir = {0},
-    .auto_download = true,
-    .process_timeout_ms = YTDLP_PROCESS_TIMEOUT_MS,
-    .initialized = false,
-    .download_attempted = false
-};
+/* Set once an automatic download has failed; later resolves do not retry it */
+static volatile int32_t s_download_failed = 0;
+
+/* Plugin-wide counters, reported through prism_ytdlp_get_stats() */
+YtdlpStats g_ytdlp_stats = {0};
 
 /* ============================================================================
  * Internal Types
  * ========================================================================== */
 
+/* Latencies of recent successful extractions from one host */
+typedef struct HostLatency {
+    char host[YTDLP_URL_HOST_MAX];  /* Empty = unused */
+    uint32_t samples[YTDLP_HEDGE_SAMPLES];
+    int count;
+    int next;
+    uint64_t last_used;
+} HostLatency;
+
+/* An extraction in progress; later misses for the same key wait for it */
+typedef struct InFlight {
+    struct InFlight* next;
+    const char* key;                  /* Stored after the struct */
+    int refs;                         /* The extracting caller and each waiter */
+    bool done;
+    bool out_of_time;                 /* The extracting caller ran out of its own time */
+    const YtdlpMediaInfo* info;       /* Result once done; NULL on failure */
+    PrismYtdlpErrorClass error_class;
+    char error[1024];
+} InFlight;
+
 typedef struct YtdlpResolver {
     PrismResolver base;
     bool is_available;
+
+    /* Settings of resolvers created with their own configuration; empty
+     * path and zero timeout inherit the global snapshot */
+    bool owns_config;
+    YtdlpConfigSlot config_slot;
+
+    /* Concurrency budget (max_concurrent <= 0 = unlimited) */
+    int max_concurrent;
+    int active;
+    YtdlpMutex budget_lock;
+    YtdlpCond budget_cond;
+
+    /* Hedging (hedge_percentile == 0 = off); hedges are paid for from a
+     * bucket that each extraction tops up by hedge_max_percent / 100 */
+    int hedge_percentile;
+    int hedge_max_percent;
+    YtdlpMutex hedge_lock;
+    double hedge_tokens;
+    uint64_t hedge_tick;
+    HostLatency* hosts;
+
+    /* Extractions in progress, by cache key */
+    YtdlpMutex inflight_lock;
+    YtdlpCond inflight_cond;
+    InFlight* inflight;
+
+    YtdlpCache* cache;
+    YtdlpSharedCache* shared;  /* Behind `cache`, shared with other processes */
+    YtdlpRefresher* refresher;
+    YtdlpStats stats;
 } YtdlpResolver;
 
-typedef struct ProcessResult {
-    char* output;
-    char* error;
-    int exit_code;
-} ProcessResult;
+/* Binary and timeout one request runs with; holds the snapshots they live in */
+typedef struct RunContext {
+    const YtdlpConfig* global;
+    const YtdlpConfig* instance;
+    const char* ytdlp_path;
+    int timeout_ms;
+    char cache_dir[YTDLP_PATH_MAX];   /* Managed --cache-dir (empty = yt-dlp default) */
+    uint64_t cache_dir_max_bytes;
+    PrismYtdlpBackend backend;        /* How extractions run */
+} RunContext;
 
 /* ============================================================================
  * String Utilities
@@ -114,7 +173,7 @@ typedef struct ProcessResult {
 static char* str_dup(const char* s) {
     if (!s) return NULL;
     size_t len = strlen(s);
-    char* copy = (char*)malloc(len + 1);
+    char* copy = (char*)ytdlp_malloc(len + 1);
     if (copy) {
         memcpy(copy, s, len + 1);
     }
@@ -148,23 +207,114 @@ static bool str_contains(const char* haystack, const char* needle) {
     return strstr(haystack, needle) != NULL;
 }
 
-/* Check if a URL is from a host that supports multiple audio languages */
-static bool is_language_capable_url(const char* url) {
-    if (!url || !url[0]) return false;
+/* ============================================================================
+ * URL Parsing
+ * ========================================================================== */
 
-    char host[256];
-    if (!extract_host(url, host, sizeof(host))) {
-        return false;
+static bool is_known_host(const YtdlpUrl* url) {
+    for (int i = 0; s_known_hosts[i]; i++) {
+        if (ytdlp_url_host_is(url, s_known_hosts[i])) return true;
+    }
+    return false;
+}
+
+/* Only YouTube offers multiple audio language tracks (AI-dubbed content), so
+ * only its extractions get the language preference and are keyed by it */
+static bool is_language_capable_url(const YtdlpUrl* url) {
+    return url->site == YTDLP_SITE_YOUTUBE;
+}
+
+/* ============================================================================
+ * Direct Media
+ *
+ * URLs that already point at a media file or manifest are handed back as
+ * they are, without spawning yt-dlp.
+ * ========================================================================== */
+
+typedef enum DirectMediaKind {
+    DIRECT_MEDIA_NONE,
+    DIRECT_MEDIA_VIDEO,   /* Progressive file carrying video (usually with audio) */
+    DIRECT_MEDIA_AUDIO,   /* Audio-only file */
+    DIRECT_MEDIA_HLS,
+    DIRECT_MEDIA_DASH
+} DirectMediaKind;
+
+typedef struct DirectMediaRule {
+    const char* match;
+    DirectMediaKind kind;
+} DirectMediaRule;
+
+/* Path extensions, compared case-insensitively */
+static const DirectMediaRule s_direct_extensions[] = {
+    { "mp4", DIRECT_MEDIA_VIDEO }, { "m4v", DIRECT_MEDIA_VIDEO }, { "webm", DIRECT_MEDIA_VIDEO },
+    { "mkv", DIRECT_MEDIA_VIDEO }, { "mov", DIRECT_MEDIA_VIDEO }, { "flv", DIRECT_MEDIA_VIDEO },
+    { "ts", DIRECT_MEDIA_VIDEO },
+    { "m4a", DIRECT_MEDIA_AUDIO }, { "mp3", DIRECT_MEDIA_AUDIO }, { "aac", DIRECT_MEDIA_AUDIO },
+    { "ogg", DIRECT_MEDIA_AUDIO }, { "opus", DIRECT_MEDIA_AUDIO }, { "flac", DIRECT_MEDIA_AUDIO },
+    { "wav", DIRECT_MEDIA_AUDIO },
+    { "m3u8", DIRECT_MEDIA_HLS },
+    { "mpd", DIRECT_MEDIA_DASH },
+    { NULL, DIRECT_MEDIA_NONE }
+};
+
+/* Media CDNs whose URLs are playable as is, matched on the host suffix */
+static const DirectMediaRule s_direct_hosts[] = {
+    { "googlevideo.com", DIRECT_MEDIA_VIDEO },  /* YouTube videoplayback */
+    { "ttvnw.net", DIRECT_MEDIA_HLS },          /* Twitch usher and edge playlists */
+    { NULL, DIRECT_MEDIA_NONE }
+};
+
+/* Extension of the last path segment, without the dot ("" if none) */
+static void path_extension(const YtdlpUrl* url, char* ext, size_t ext_size) {
+    ext[0] = '\0';
+
+    const char* path = url->path;
+    size_t path_len = url->path_len;
+    const char* dot = NULL;
+    for (size_t i = 0; i < path_len; i++) {
+        if (path[i] == '/') dot = NULL;
+        else if (path[i] == '.') dot = path + i;
     }
+    if (!dot) return;
 
-    for (int i = 0; s_language_capable_hosts[i]; i++) {
-        if (str_contains(host, s_language_capable_hosts[i]) ||
-            str_contains(s_language_capable_hosts[i], host)) {
-            return true;
+    size_t len = (size_t)(path + path_len - dot - 1);
+    if (len == 0 || len >= ext_size) return;
+
+    memcpy(ext, dot + 1, len);
+    ext[len] = '\0';
+    str_to_lower(ext);
+}
+
+static DirectMediaKind classify_direct_media(const YtdlpUrl* url) {
+    char ext[8];
+    path_extension(url, ext, sizeof(ext));
+    for (int i = 0; s_direct_extensions[i].match; i++) {
+        if (strcmp(ext, s_direct_extensions[i].match) == 0) {
+            return s_direct_extensions[i].kind;
         }
     }
 
-    return false;
+    /* Local files are never worth an extractor */
+    if (url->scheme_len == 4 && strncmp(url->scheme, "file", 4) == 0) return DIRECT_MEDIA_VIDEO;
+
+    for (int i = 0; s_direct_hosts[i].match; i++) {
+        if (!ytdlp_url_host_is(url, s_direct_hosts[i].match)) continue;
+
+        /* videoplayback URLs name their content type in the query */
+        if (s_direct_hosts[i].kind == DIRECT_MEDIA_VIDEO) {
+            size_t offset = 0;
+            YtdlpUrlParam param;
+            while (ytdlp_url_next_param(url, &offset, &param)) {
+                if (param.name_len == 4 && memcmp(param.name, "mime", 4) == 0 &&
+                    param.value_len >= 5 && memcmp(param.value, "audio", 5) == 0) {
+                    return DIRECT_MEDIA_AUDIO;
+                }
+            }
+        }
+        return s_direct_hosts[i].kind;
+    }
+
+    return DIRECT_MEDIA_NONE;
 }
 
 /* YouTube URL parameters that can interfere with language resolution */
@@ -179,140 +329,192 @@ static const char* s_youtube_params_to_strip[] = {
  * The 'pp' parameter in particular can contain encoded playback settings that override
  * the language preference set via yt-dlp's extractor-args.
  *
- * Returns a newly allocated sanitized URL (caller must free), or NULL on error.
+ * Returns the sanitized URL allocated from `arena`, or NULL on error.
  */
-static char* sanitize_youtube_url(const char* url) {
-    if (!url || !url[0]) return str_dup(url);
-
+static char* sanitize_youtube_url(YtdlpArena* arena, const YtdlpUrl* url) {
     /* Only process YouTube URLs */
-    if (!is_language_capable_url(url)) {
-        return str_dup(url);
-    }
-
-    /* Find query string */
-    const char* query_start = strchr(url, '?');
-    if (!query_start) {
-        return str_dup(url);
+    if (!is_language_capable_url(url) || url->query_len == 0) {
+        return ytdlp_arena_strdup(arena, url->text);
     }
 
-    /* Calculate base URL length (before query) */
-    size_t base_len = (size_t)(query_start - url);
-
-    /* Allocate output buffer (worst case: same size as input) */
-    size_t url_len = strlen(url);
-    char* result = (char*)malloc(url_len + 1);
-    if (!result) return str_dup(url);
-
-    /* Copy base URL */
-    memcpy(result, url, base_len);
-    result[base_len] = '\0';
-
-    /* Parse and filter query parameters */
-    char* query_copy = str_dup(query_start + 1);
-    if (!query_copy) {
-        free(result);
-        return str_dup(url);
-    }
+    /* The result is never longer than the input */
+    size_t url_len = strlen(url->text);
+    char* result = (char*)ytdlp_arena_alloc(arena, url_len + 1);
+    if (!result) return NULL;
 
-    char* filtered_params = (char*)malloc(url_len + 1);
-    if (!filtered_params) {
-        free(result);
-        free(query_copy);
-        return str_dup(url);
-    }
-    filtered_params[0] = '\0';
+    /* Base URL up to and excluding the '?' */
+    size_t len = (size_t)(url->query - 1 - url->text);
+    memcpy(result, url->text, len);
 
-    char* saveptr = NULL;
-    char* param = strtok_r(query_copy, "&", &saveptr);
+    size_t offset = 0;
+    YtdlpUrlParam param;
     bool first_param = true;
-
-    while (param) {
-        /* Get parameter name (before '=') */
-        char* eq = strchr(param, '=');
-        size_t name_len = eq ? (size_t)(eq - param) : strlen(param);
-
+    while (ytdlp_url_next_param(url, &offset, &param)) {
         /* Check if this parameter should be stripped */
         bool should_strip = false;
         for (int i = 0; s_youtube_params_to_strip[i]; i++) {
-            if (name_len == strlen(s_youtube_params_to_strip[i]) &&
-                strncmp(param, s_youtube_params_to_strip[i], name_len) == 0) {
+            if (param.name_len == strlen(s_youtube_params_to_strip[i]) &&
+                memcmp(param.name, s_youtube_params_to_strip[i], param.name_len) == 0) {
                 should_strip = true;
                 break;
             }
         }
+        if (should_strip) continue;
 
-        if (!should_strip) {
-            if (!first_param) {
-                strcat(filtered_params, "&");
-            }
-            strcat(filtered_params, param);
-            first_param = false;
-        }
-
-        param = strtok_r(NULL, "&", &saveptr);
+        result[len++] = first_param ? '?' : '&';
+        memcpy(result + len, param.text, param.text_len);
+        len += param.text_len;
+        first_param = false;
     }
 
-    free(query_copy);
-
-    /* Build final URL */
-    if (filtered_params[0]) {
-        strcat(result, "?");
-        strcat(result, filtered_params);
-    }
+    /* Fragment */
+    size_t rest_len = strlen(url->rest);
+    memcpy(result + len, url->rest, rest_len + 1);
 
-    free(filtered_params);
     return result;
 }
 
 /* ============================================================================
- * URL Parsing
+ * Process Execution (Platform-specific)
+ *
+ * Every child runs in its own process group (a job object on Windows), so a
+ * timeout or cancel also kills the ffmpeg and helper processes yt-dlp
+ * started, and whatever a child leaves behind is killed when it exits.
+ * Running children are listed so shutdown can kill them; each run still
+ * reaps its own child.
  * ========================================================================== */
 
-static bool extract_host(const char* url, char* host, size_t host_size) {
-    if (!url || !host || host_size == 0) return false;
+typedef struct ChildProcess {
+    struct ChildProcess* prev;
+    struct ChildProcess* next;
+    volatile int32_t killed;   /* Set when shutdown killed it */
+    bool registered;           /* Listed; false if shutdown had already begun */
+#ifdef _WIN32
+    HANDLE job;                /* NULL if the child could not be put in one */
+    HANDLE process;
+#else
+    pid_t pid;                 /* Also its process group */
+#endif
+} ChildProcess;
+
+static YtdlpMutex s_children_lock = YTDLP_MUTEX_INIT;
+static YtdlpCond s_children_cond = YTDLP_COND_INIT;
+static ChildProcess* s_children = NULL;
+static bool s_children_closed = false;  /* Shutdown in progress; new children are killed */
+
+/* Kill the child with everything it started */
+static void child_kill(ChildProcess* child);
+
+/* List a started child. During shutdown it is killed instead; false then. */
+static bool child_register(ChildProcess* child) {
+    ytdlp_mutex_lock(&s_children_lock);
+    bool open = !s_children_closed;
+    if (open) {
+        child->prev = NULL;
+        child->next = s_children;
+        if (s_children) s_children->prev = child;
+        s_children = child;
+    }
+    ytdlp_mutex_unlock(&s_children_lock);
+
+    if (!open) child_kill(child);
+    return open;
+}
 
-    const char* start = url;
+/* Called before the child is reaped, so shutdown never signals a reused pid.
+ * Only for a child child_register() listed. */
+static void child_unregister(ChildProcess* child) {
+    ytdlp_mutex_lock(&s_children_lock);
+    if (child->prev) child->prev->next = child->next;
+    else s_children = child->next;
+    if (child->next) child->next->prev = child->prev;
+    if (!s_children) ytdlp_cond_broadcast(&s_children_cond);
+    ytdlp_mutex_unlock(&s_children_lock);
+}
 
-    /* Skip protocol */
-    const char* proto = strstr(url, "://");
-    if (proto) {
-        start = proto + 3;
-    }
+void ytdlp_process_shutdown(void) {
+    ytdlp_mutex_lock(&s_children_lock);
+    s_children_closed = true;
 
-    /* Skip user:pass@ */
-    const char* at = strchr(start, '@');
-    if (at) {
-        start = at + 1;
+    for (ChildProcess* child = s_children; child; child = child->next) {
+        ytdlp_atomic_store_i32(&child->killed, 1);
+        child_kill(child);
     }
 
-    /* Find end of host (port, path, query, or end) */
-    const char* end = start;
-    while (*end && *end != ':' && *end != '/' && *end != '?' && *end != '#') {
-        end++;
+    /* The runs notice, reap their children and return */
+    uint64_t deadline = ytdlp_monotonic_ms() + YTDLP_SHUTDOWN_REAP_MS;
+    for (;;) {
+        uint64_t now = ytdlp_monotonic_ms();
+        if (!s_children || now >= deadline) break;
+        ytdlp_cond_wait_ms(&s_children_cond, &s_children_lock, (uint32_t)(deadline - now));
     }
 
-    size_t len = (size_t)(end - start);
-    if (len >= host_size) len = host_size - 1;
+    s_children_closed = false;
+    ytdlp_mutex_unlock(&s_children_lock);
+}
 
-    memcpy(host, start, len);
-    host[len] = '\0';
-    str_to_lower(host);
+#ifdef _WIN32
 
-    return len > 0;
+static void child_kill(ChildProcess* child) {
+    if (child->job) TerminateJobObject(child->job, 1);
+    else TerminateProcess(child->process, 1);
 }
 
-/* ============================================================================
- * Process Execution (Platform-specific)
- * ========================================================================== */
+/* Move whatever is currently buffered in `pipe` into the capture target
+ * without blocking. Clears `*open` once the write end is gone. */
+static bool drain_pipe(HANDLE pipe, YtdlpBuffer* out, YtdlpRing* err, bool* open) {
+    bool progressed = false;
 
-#ifdef _WIN32
+    for (;;) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL)) {
+            *open = false;
+            return progressed;
+        }
+        if (available == 0) return progressed;
+
+        size_t space = 0;
+        char* dst = out ? ytdlp_buffer_reserve(out, YTDLP_OUTPUT_BUFFER_SIZE, &space)
+                        : ytdlp_ring_reserve(err, &space);
+        if (!dst) {
+            *open = false;
+            return progressed;
+        }
+
+        DWORD want = available < space ? available : (DWORD)space;
+        DWORD bytes_read = 0;
+        if (!ReadFile(pipe, dst, want, &bytes_read, NULL) || bytes_read == 0) {
+            *open = false;
+            return progressed;
+        }
 
-static ProcessResult run_process(const char* command, const char* args, int timeout_ms) {
-    ProcessResult result = {0};
+        if (out) ytdlp_buffer_commit(out, bytes_read);
+        else ytdlp_ring_commit(err, bytes_read);
+        progressed = true;
+    }
+}
+
+YtdlpProcessResult ytdlp_run_process_cancellable(
+    const char* command,
+    const char* args,
+    int timeout_ms,
+    volatile int32_t* cancel
+) {
+    YtdlpProcessResult result = {0};
     result.exit_code = -1;
 
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) {
+        result.error = "Out of memory";
+        return result;
+    }
+    ytdlp_buffer_clear(&scratch->out);
+    ytdlp_ring_clear(&scratch->err);
+
     HANDLE stdout_read = NULL, stdout_write = NULL;
     HANDLE stderr_read = NULL, stderr_write = NULL;
+    ChildProcess child;
+    ZeroMemory(&child, sizeof(child));
 
     SECURITY_ATTRIBUTES sa;
     sa.nLength = sizeof(SECURITY_ATTRIBUTES);
@@ -322,7 +524,7 @@ static ProcessResult run_process(const char* command, const char* args, int time
     /* Create pipes for stdout and stderr */
     if (!CreatePipe(&stdout_read, &stdout_write, &sa, 0) ||
         !CreatePipe(&stderr_read, &stderr_write, &sa, 0)) {
-        result.error = str_dup("Failed to create pipes");
+        result.error = "Failed to create pipes";
         goto cleanup;
     }
 
@@ -345,70 +547,86 @@ static ProcessResult run_process(const char* command, const char* args, int time
     PROCESS_INFORMATION pi;
     ZeroMemory(&pi, sizeof(pi));
 
+    /* Children of the child join its job; closing the last handle kills them */
+    child.job = CreateJobObjectA(NULL, NULL);
+    if (child.job) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+        ZeroMemory(&limits, sizeof(limits));
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(child.job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+    }
+
+    /* Suspended until it is in the job, so nothing it starts escapes */
     if (!CreateProcessA(NULL, cmdline, NULL, NULL, TRUE,
-                        CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-        result.error = str_dup("Failed to create process");
+                        CREATE_NO_WINDOW | CREATE_SUSPENDED, NULL, NULL, &si, &pi)) {
+        result.error = "Failed to create process";
         goto cleanup;
     }
 
+    child.process = pi.hProcess;
+    if (child.job && !AssignProcessToJobObject(child.job, pi.hProcess)) {
+        CloseHandle(child.job);  /* A host job that forbids nesting */
+        child.job = NULL;
+    }
+    ResumeThread(pi.hThread);
+    child.registered = child_register(&child);
+    bool cancelled = !child.registered;
+
     /* Close write ends in parent */
     CloseHandle(stdout_write); stdout_write = NULL;
     CloseHandle(stderr_write); stderr_write = NULL;
 
-    /* Wait for process with timeout */
-    DWORD wait_result = WaitForSingleObject(pi.hProcess, (DWORD)timeout_ms);
+    /* Drain both pipes while waiting so a large -J dump cannot fill the pipe
+     * and stall the child until the timeout. */
+    uint64_t deadline = ytdlp_monotonic_ms() + (uint64_t)timeout_ms;
+    bool out_open = true, err_open = true;
+    bool exited = false, timed_out = false;
+
+    while (!exited && !cancelled) {
+        bool progressed = false;
+        if (out_open) progressed |= drain_pipe(stdout_read, &scratch->out, NULL, &out_open);
+        if (err_open) progressed |= drain_pipe(stderr_read, NULL, &scratch->err, &err_open);
 
-    if (wait_result == WAIT_TIMEOUT) {
+        exited = WaitForSingleObject(pi.hProcess, progressed ? 0 : 10) == WAIT_OBJECT_0;
+
+        if (!exited && ((cancel && ytdlp_atomic_load_i32(cancel)) || ytdlp_atomic_load_i32(&child.killed))) {
+            cancelled = true;
+        } else if (!exited && ytdlp_monotonic_ms() >= deadline) {
+            timed_out = true;
+            break;
+        }
+    }
+
+    /* Kill the child on timeout or cancel, and what it left running either way */
+    if (child.job) TerminateJobObject(child.job, 1);
+    if (timed_out || cancelled) {
         TerminateProcess(pi.hProcess, 1);
-        result.error = str_dup("Process timed out");
+        WaitForSingleObject(pi.hProcess, INFINITE);
+    }
+    if (child.registered) child_unregister(&child);
+
+    if (timed_out || cancelled) {
+        result.error = timed_out ? "Process timed out" : "Process cancelled";
         goto cleanup_process;
     }
 
+    /* Collect anything written between the last drain and exit */
+    if (out_open) drain_pipe(stdout_read, &scratch->out, NULL, &out_open);
+    if (err_open) drain_pipe(stderr_read, NULL, &scratch->err, &err_open);
+
     /* Get exit code */
     DWORD exit_code;
     GetExitCodeProcess(pi.hProcess, &exit_code);
     result.exit_code = (int)exit_code;
 
-    /* Read stdout */
-    char buffer[YTDLP_OUTPUT_BUFFER_SIZE];
-    DWORD bytes_read;
-    size_t total_stdout = 0;
-    result.output = (char*)malloc(YTDLP_OUTPUT_BUFFER_SIZE);
-    if (result.output) {
-        result.output[0] = '\0';
-        while (ReadFile(stdout_read, buffer, sizeof(buffer) - 1, &bytes_read, NULL) && bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            size_t new_len = total_stdout + bytes_read;
-            char* new_buf = (char*)realloc(result.output, new_len + 1);
-            if (new_buf) {
-                result.output = new_buf;
-                memcpy(result.output + total_stdout, buffer, bytes_read + 1);
-                total_stdout = new_len;
-            }
-        }
-    }
-
-    /* Read stderr */
-    size_t total_stderr = 0;
-    result.error = (char*)malloc(YTDLP_OUTPUT_BUFFER_SIZE);
-    if (result.error) {
-        result.error[0] = '\0';
-        while (ReadFile(stderr_read, buffer, sizeof(buffer) - 1, &bytes_read, NULL) && bytes_read > 0) {
-            buffer[bytes_read] = '\0';
-            size_t new_len = total_stderr + bytes_read;
-            char* new_buf = (char*)realloc(result.error, new_len + 1);
-            if (new_buf) {
-                result.error = new_buf;
-                memcpy(result.error + total_stderr, buffer, bytes_read + 1);
-                total_stderr = new_len;
-            }
-        }
+    size_t ignored;
+    if (ytdlp_buffer_reserve(&scratch->out, 0, &ignored)) {
+        result.output = scratch->out.data;
     }
 
-    /* If exit code is 0 and error is empty, set error to NULL */
-    if (result.exit_code == 0 && result.error && result.error[0] == '\0') {
-        free(result.error);
-        result.error = NULL;
+    /* Leave error NULL when the process succeeded silently */
+    if (!(result.exit_code == 0 && scratch->err.len == 0)) {
+        result.error = ytdlp_ring_linearize(&scratch->err);
     }
 
 cleanup_process:
@@ -416,6 +634,7 @@ cleanup_process:
     CloseHandle(pi.hThread);
 
 cleanup:
+    if (child.job) CloseHandle(child.job);
     if (stdout_read) CloseHandle(stdout_read);
     if (stdout_write) CloseHandle(stdout_write);
     if (stderr_read) CloseHandle(stderr_read);
@@ -424,6 +643,10 @@ cleanup:
     return result;
 }
 
+YtdlpProcessResult ytdlp_run_process(const char* command, const char* args, int timeout_ms) {
+    return ytdlp_run_process_cancellable(command, args, timeout_ms, NULL);
+}
+
 static bool file_exists(const char* path) {
     DWORD attrs = GetFileAttributesA(path);
     return attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY);
@@ -444,87 +667,233 @@ static void get_default_install_dir(char* path, size_t size) {
 
 #else /* POSIX */
 
-static ProcessResult run_process(const char* command, const char* args, int timeout_ms) {
-    ProcessResult result = {0};
+static void child_kill(ChildProcess* child) {
+    kill(-child->pid, SIGKILL);
+}
+
+/* A pipe whose fds other threads' children do not inherit */
+bool ytdlp_make_pipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) < 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+/* Split the next argument off `*cursor` in place, or NULL at the end.
+ * Arguments are separated by spaces; a double-quoted span is kept in one
+ * argument, so quoted paths may contain spaces. The quotes are dropped. */
+static char* next_arg(char** cursor) {
+    char* p = *cursor;
+    while (*p == ' ') p++;
+    if (!*p) return NULL;
+
+    char* arg = p;
+    char* out = p;
+    bool quoted = false;
+    for (; *p && (quoted || *p != ' '); p++) {
+        if (*p == '"') quoted = !quoted;
+        else *out++ = *p;
+    }
+    *cursor = *p ? p + 1 : p;
+    *out = '\0';
+    return arg;
+}
+
+/* Read everything currently available on a non-blocking fd directly into the
+ * capture target. Clears `*open` on EOF or error. */
+static void drain_fd(int fd, YtdlpBuffer* out, YtdlpRing* err, bool* open) {
+    for (;;) {
+        size_t space = 0;
+        char* dst = out ? ytdlp_buffer_reserve(out, YTDLP_OUTPUT_BUFFER_SIZE, &space)
+                        : ytdlp_ring_reserve(err, &space);
+        if (!dst) {
+            *open = false;
+            return;
+        }
+
+        ssize_t n = read(fd, dst, space);
+        if (n > 0) {
+            if (out) ytdlp_buffer_commit(out, (size_t)n);
+            else ytdlp_ring_commit(err, (size_t)n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        *open = false;
+        return;
+    }
+}
+
+YtdlpProcessResult ytdlp_run_process_cancellable(
+    const char* command,
+    const char* args,
+    int timeout_ms,
+    volatile int32_t* cancel
+) {
+    YtdlpProcessResult result = {0};
     result.exit_code = -1;
 
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) {
+        result.error = "Out of memory";
+        return result;
+    }
+    ytdlp_buffer_clear(&scratch->out);
+    ytdlp_ring_clear(&scratch->err);
+
+    /* Parse args into argv array (simple tokenization). Done before fork so
+     * the child does not allocate. */
+    YtdlpArenaMark mark = ytdlp_arena_mark(&scratch->arena);
+    char* args_copy = ytdlp_arena_strdup(&scratch->arena, args);
+    char* argv[64];
+    int argc = 0;
+
+    argv[argc++] = (char*)command;
+
+    if (args_copy) {
+        char* cursor = args_copy;
+        char* token;
+        while (argc < 62 && (token = next_arg(&cursor)) != NULL) {
+            argv[argc++] = token;
+        }
+    }
+    argv[argc] = NULL;
+
     int stdout_pipe[2], stderr_pipe[2];
 
-    if (pipe(stdout_pipe) < 0 || pipe(stderr_pipe) < 0) {
-        result.error = str_dup("Failed to create pipes");
+    if (!ytdlp_make_pipe(stdout_pipe)) {
+        result.error = "Failed to create pipes";
+        ytdlp_arena_release(&scratch->arena, mark);
+        return result;
+    }
+    if (!ytdlp_make_pipe(stderr_pipe)) {
+        result.error = "Failed to create pipes";
+        close(stdout_pipe[0]); close(stdout_pipe[1]);
+        ytdlp_arena_release(&scratch->arena, mark);
         return result;
     }
 
     pid_t pid = fork();
 
     if (pid < 0) {
-        result.error = str_dup("Failed to fork process");
+        result.error = "Failed to fork process";
         close(stdout_pipe[0]); close(stdout_pipe[1]);
         close(stderr_pipe[0]); close(stderr_pipe[1]);
+        ytdlp_arena_release(&scratch->arena, mark);
         return result;
     }
 
     if (pid == 0) {
-        /* Child process */
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
+        /* Child process: its own process group, which a background group
+         * reading the terminal would stop, so stdin is /dev/null */
+        setpgid(0, 0);
+
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            if (null_fd != STDIN_FILENO) close(null_fd);
+        }
 
+        /* dup2() clears close-on-exec on the copies */
         dup2(stdout_pipe[1], STDOUT_FILENO);
         dup2(stderr_pipe[1], STDERR_FILENO);
 
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
-
-        /* Parse args into argv array (simple tokenization) */
-        char* args_copy = str_dup(args);
-        char* argv[64];
-        int argc = 0;
-
-        argv[argc++] = (char*)command;
-
-        if (args_copy) {
-            char* token = strtok(args_copy, " ");
-            while (token && argc < 62) {
-                /* Handle quoted strings */
-                if (token[0] == '"') {
-                    token++;
-                    char* end = strchr(token, '"');
-                    if (end) *end = '\0';
-                }
-                argv[argc++] = token;
-                token = strtok(NULL, " ");
-            }
-        }
-        argv[argc] = NULL;
-
         execvp(command, argv);
         _exit(127);
     }
 
-    /* Parent process */
+    /* Parent process. Also set the group here, so it exists before any
+     * kill of it whichever side runs first */
+    setpgid(pid, pid);
+
+    ChildProcess child;
+    memset(&child, 0, sizeof(child));
+    child.pid = pid;
+    child.registered = child_register(&child);
+    bool cancelled = !child.registered;
+
     close(stdout_pipe[1]);
     close(stderr_pipe[1]);
+    ytdlp_arena_release(&scratch->arena, mark);
+
+    fcntl(stdout_pipe[0], F_SETFL, fcntl(stdout_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(stderr_pipe[0], F_SETFL, fcntl(stderr_pipe[0], F_GETFL) | O_NONBLOCK);
+
+    /* Drain both pipes while the child runs so a large -J dump cannot fill
+     * the pipe and stall the child until the timeout. */
+    uint64_t deadline = ytdlp_monotonic_ms() + (uint64_t)timeout_ms;
+    bool out_open = true, err_open = true;
+    bool timed_out = false;
+
+    while ((out_open || err_open) && !cancelled) {
+        uint64_t now = ytdlp_monotonic_ms();
+        if (now >= deadline) {
+            timed_out = true;
+            break;
+        }
+        if (cancel && ytdlp_atomic_load_i32(cancel)) {
+            cancelled = true;
+            break;
+        }
+
+        struct pollfd fds[2];
+        int nfds = 0;
+        if (out_open) { fds[nfds].fd = stdout_pipe[0]; fds[nfds].events = POLLIN; nfds++; }
+        if (err_open) { fds[nfds].fd = stderr_pipe[0]; fds[nfds].events = POLLIN; nfds++; }
+
+        /* A cancellable run wakes up regularly to check the flag */
+        uint64_t wait_ms = deadline - now;
+        if (cancel && wait_ms > YTDLP_CANCEL_POLL_MS) wait_ms = YTDLP_CANCEL_POLL_MS;
+
+        int ready = poll(fds, (nfds_t)nfds, (int)wait_ms);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        for (int i = 0; i < nfds; i++) {
+            if (!fds[i].revents) continue;
+            if (fds[i].fd == stdout_pipe[0]) drain_fd(stdout_pipe[0], &scratch->out, NULL, &out_open);
+            else drain_fd(stderr_pipe[0], NULL, &scratch->err, &err_open);
+        }
+    }
 
-    /* Wait with timeout */
-    int status;
-    int elapsed = 0;
-    const int interval = 100;
-
-    while (elapsed < timeout_ms) {
-        pid_t wpid = waitpid(pid, &status, WNOHANG);
-        if (wpid == pid) break;
-        if (wpid < 0) {
-            result.error = str_dup("waitpid failed");
-            goto cleanup;
+    /* Both pipes are closed; wait for the child to exit within the remaining
+     * budget. It is left unreaped, which keeps its process group valid. */
+    bool wait_failed = false;
+    while (!timed_out && !cancelled) {
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0) {
+            if (info.si_pid == pid) break;
+        } else if (errno != EINTR) {
+            wait_failed = true;
+            break;
+        }
+        if (ytdlp_monotonic_ms() >= deadline) {
+            timed_out = true;
+            break;
+        }
+        if ((cancel && ytdlp_atomic_load_i32(cancel)) || ytdlp_atomic_load_i32(&child.killed)) {
+            cancelled = true;
+            break;
         }
-        usleep(interval * 1000);
-        elapsed += interval;
+        usleep(2000);
     }
 
-    if (elapsed >= timeout_ms) {
-        kill(pid, SIGKILL);
-        waitpid(pid, &status, 0);
-        result.error = str_dup("Process timed out");
+    /* Kill the child on timeout or cancel, and what it left running either
+     * way, then reap it */
+    kill(-pid, SIGKILL);
+    if (child.registered) child_unregister(&child);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+    if (ytdlp_atomic_load_i32(&child.killed)) cancelled = true;
+    if (timed_out || cancelled || wait_failed) {
+        result.error = timed_out ? "Process timed out" : cancelled ? "Process cancelled" : "waitpid failed";
         goto cleanup;
     }
 
@@ -532,45 +901,13 @@ static ProcessResult run_process(const char* command, const char* args, int time
         result.exit_code = WEXITSTATUS(status);
     }
 
-    /* Read stdout */
-    char buffer[YTDLP_OUTPUT_BUFFER_SIZE];
-    ssize_t bytes_read;
-    size_t total_stdout = 0;
-    result.output = (char*)malloc(YTDLP_OUTPUT_BUFFER_SIZE);
-    if (result.output) {
-        result.output[0] = '\0';
-        while ((bytes_read = read(stdout_pipe[0], buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytes_read] = '\0';
-            size_t new_len = total_stdout + (size_t)bytes_read;
-            char* new_buf = (char*)realloc(result.output, new_len + 1);
-            if (new_buf) {
-                result.output = new_buf;
-                memcpy(result.output + total_stdout, buffer, (size_t)bytes_read + 1);
-                total_stdout = new_len;
-            }
-        }
-    }
-
-    /* Read stderr */
-    size_t total_stderr = 0;
-    result.error = (char*)malloc(YTDLP_OUTPUT_BUFFER_SIZE);
-    if (result.error) {
-        result.error[0] = '\0';
-        while ((bytes_read = read(stderr_pipe[0], buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytes_read] = '\0';
-            size_t new_len = total_stderr + (size_t)bytes_read;
-            char* new_buf = (char*)realloc(result.error, new_len + 1);
-            if (new_buf) {
-                result.error = new_buf;
-                memcpy(result.error + total_stderr, buffer, (size_t)bytes_read + 1);
-                total_stderr = new_len;
-            }
-        }
+    size_t ignored;
+    if (ytdlp_buffer_reserve(&scratch->out, 0, &ignored)) {
+        result.output = scratch->out.data;
     }
 
-    if (result.exit_code == 0 && result.error && result.error[0] == '\0') {
-        free(result.error);
-        result.error = NULL;
+    if (!(result.exit_code == 0 && scratch->err.len == 0)) {
+        result.error = ytdlp_ring_linearize(&scratch->err);
     }
 
 cleanup:
@@ -580,6 +917,10 @@ cleanup:
     return result;
 }
 
+YtdlpProcessResult ytdlp_run_process(const char* command, const char* args, int timeout_ms) {
+    return ytdlp_run_process_cancellable(command, args, timeout_ms, NULL);
+}
+
 static bool file_exists(const char* path) {
     return access(path, F_OK) == 0;
 }
@@ -603,22 +944,11 @@ static void get_default_install_dir(char* path, size_t size) {
 
 #endif
 
-static void free_process_result(ProcessResult* result) {
-    if (result->output) {
-        free(result->output);
-        result->output = NULL;
-    }
-    if (result->error) {
-        free(result->error);
-        result->error = NULL;
-    }
-}
-
 /* ============================================================================
  * yt-dlp Detection and Download
  * ========================================================================== */
 
-static bool find_ytdlp(char* path, size_t path_size) {
+static bool find_ytdlp(const YtdlpConfig* config, char* path, size_t path_size) {
     /* Check common locations */
     const char* candidates[] = {
 #ifdef _WIN32
@@ -633,11 +963,23 @@ static bool find_ytdlp(char* path, size_t path_size) {
         NULL
     };
 
+    /* Managed installs first; their unpacked builds start faster than any
+     * onefile binary */
+    char default_dir[1024];
+    get_default_install_dir(default_dir, sizeof(default_dir));
+    const char* binary = get_platform_binary_name();
+    if (ytdlp_versions_find(config->install_dir, binary, path, path_size) ||
+        ytdlp_versions_find(default_dir, binary, path, path_size) ||
+        ytdlp_unpacked_find(config->install_dir, path, path_size) ||
+        ytdlp_unpacked_find(default_dir, path, path_size)) {
+        return true;
+    }
+
     /* Check install directory first */
-    if (g_config.install_dir[0]) {
+    if (config->install_dir[0]) {
         char install_path[1024];
         snprintf(install_path, sizeof(install_path), "%s/%s",
-                 g_config.install_dir, get_platform_binary_name());
+                 config->install_dir, get_platform_binary_name());
         if (file_exists(install_path)) {
             strncpy(path, install_path, path_size - 1);
             path[path_size - 1] = '\0';
@@ -646,8 +988,6 @@ static bool find_ytdlp(char* path, size_t path_size) {
     }
 
     /* Check default install directory */
-    char default_dir[1024];
-    get_default_install_dir(default_dir, sizeof(default_dir));
     char default_path[1024];
     snprintf(default_path, sizeof(default_path), "%s/%s",
              default_dir, get_platform_binary_name());
@@ -695,12 +1035,12 @@ static bool find_ytdlp(char* path, size_t path_size) {
                 if (file_exists(full_path)) {
                     strncpy(path, full_path, path_size - 1);
                     path[path_size - 1] = '\0';
-                    free(path_copy);
+                    ytdlp_free(path_copy);
                     return true;
                 }
                 dir = strtok(NULL, ":");
             }
-            free(path_copy);
+            ytdlp_free(path_copy);
         }
     }
 #endif
@@ -708,6 +1048,22 @@ static bool find_ytdlp(char* path, size_t path_size) {
     return false;
 }
 
+/* Directory installs go to: `install_dir`, else the configured one, else the default */
+static void managed_install_dir(const char* install_dir, char* dir, size_t size) {
+    if (install_dir && install_dir[0]) {
+        snprintf(dir, size, "%s", install_dir);
+        return;
+    }
+
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    if (config->install_dir[0]) {
+        snprintf(dir, size, "%s", config->install_dir);
+    } else {
+        get_default_install_dir(dir, size);
+    }
+    ytdlp_config_release(config);
+}
+
 static void ensure_directory_exists(const char* dir) {
 #ifdef _WIN32
     CreateDirectoryA(dir, NULL);
@@ -716,360 +1072,1369 @@ static void ensure_directory_exists(const char* dir) {
 #endif
 }
 
-/* ============================================================================
- * Download Implementation
- * ========================================================================== */
-
-#ifdef _WIN32
+/* Publish a new binary path; resolves already running keep their snapshot */
+static void publish_ytdlp_path(YtdlpConfigSlot* slot, const char* path) {
+    YtdlpConfig* config = ytdlp_config_slot_begin_update(slot);
+    if (!config) return;
 
-PrismError prism_ytdlp_download(
-    const char* install_dir,
-    void (*progress_callback)(float progress, void* user_data),
-    void* user_data
-) {
-    char target_dir[1024];
-    if (install_dir && install_dir[0]) {
-        strncpy(target_dir, install_dir, sizeof(target_dir) - 1);
+    if (path) {
+        strncpy(config->ytdlp_path, path, sizeof(config->ytdlp_path) - 1);
+        config->ytdlp_path[sizeof(config->ytdlp_path) - 1] = '\0';
     } else {
-        get_default_install_dir(target_dir, sizeof(target_dir));
+        config->ytdlp_path[0] = '\0';
     }
-    target_dir[sizeof(target_dir) - 1] = '\0';
 
-    ensure_directory_exists(target_dir);
+    ytdlp_config_slot_commit(slot, config);
+}
 
-    char target_path[1024];
-    snprintf(target_path, sizeof(target_path), "%s\\%s",
-             target_dir, get_platform_binary_name());
+/* ============================================================================
+ * Download Implementation
+ * ========================================================================== */
 
-    char url[512];
-    snprintf(url, sizeof(url), "%s%s", YTDLP_GITHUB_RELEASES, get_platform_binary_name());
+/* Install the latest release into target_dir and publish it */
+static bool install_download(
+    const char* target_dir,
+    void* context,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    (void)context;
 
-    /* Use URLDownloadToFile */
-    HRESULT hr = URLDownloadToFileA(NULL, url, target_path, 0, NULL);
+    /* Resumes an interrupted download, and only installs a build that
+     * matches the release checksum */
+    char path[YTDLP_PATH_MAX];
+    if (!ytdlp_versions_install(target_dir, NULL, get_platform_binary_name(), path, sizeof(path),
+                                progress, user_data)) {
+        return false;
+    }
 
-    if (progress_callback) {
-        progress_callback(1.0f, user_data);
+    publish_ytdlp_path(ytdlp_config_global(), path);
+    if (progress) {
+        progress(1.0f, user_data);
     }
+    return true;
+}
 
-    if (SUCCEEDED(hr) && file_exists(target_path)) {
-        /* Update global path */
-        strncpy(g_config.ytdlp_path, target_path, sizeof(g_config.ytdlp_path) - 1);
-        return PRISM_OK;
+/* Another process installed into target_dir while this one waited */
+static bool adopt_download(const char* target_dir, void* context) {
+    (void)context;
+
+    char path[YTDLP_PATH_MAX];
+    if (!ytdlp_versions_find(target_dir, get_platform_binary_name(), path, sizeof(path))) {
+        return false;
     }
 
-    return PRISM_ERROR_NETWORK;
+    publish_ytdlp_path(ytdlp_config_global(), path);
+    return true;
 }
 
-#else /* POSIX */
-
 PrismError prism_ytdlp_download(
     const char* install_dir,
     void (*progress_callback)(float progress, void* user_data),
     void* user_data
 ) {
     char target_dir[1024];
-    if (install_dir && install_dir[0]) {
-        strncpy(target_dir, install_dir, sizeof(target_dir) - 1);
-    } else {
-        get_default_install_dir(target_dir, sizeof(target_dir));
-    }
-    target_dir[sizeof(target_dir) - 1] = '\0';
+    managed_install_dir(install_dir, target_dir, sizeof(target_dir));
 
     ensure_directory_exists(target_dir);
 
-    char target_path[1024];
-    snprintf(target_path, sizeof(target_path), "%s/%s",
-             target_dir, get_platform_binary_name());
-
-    char url[512];
-    snprintf(url, sizeof(url), "%s%s", YTDLP_GITHUB_RELEASES, get_platform_binary_name());
-
-    /* Use curl to download */
-    char curl_args[1024];
-    snprintf(curl_args, sizeof(curl_args), "-L -o \"%s\" \"%s\"", target_path, url);
-
-    ProcessResult result = run_process("curl", curl_args, 120000); /* 2 minute timeout */
-
-    if (progress_callback) {
-        progress_callback(1.0f, user_data);
-    }
-
-    free_process_result(&result);
-
-    if (!file_exists(target_path)) {
-        return PRISM_ERROR_NETWORK;
-    }
-
-    /* Make executable */
-    chmod(target_path, 0755);
-
-    /* Update global path */
-    strncpy(g_config.ytdlp_path, target_path, sizeof(g_config.ytdlp_path) - 1);
-
-    return PRISM_OK;
+    /* Concurrent callers share one download */
+    bool ok = ytdlp_install_once(target_dir, install_download, adopt_download, NULL,
+                                 progress_callback, user_data);
+    return ok ? PRISM_OK : PRISM_ERROR_NETWORK;
 }
 
-#endif
-
 /* ============================================================================
  * Public API
  * ========================================================================== */
 
 PRISM_YTDLP_API bool prism_ytdlp_is_available(void) {
-    if (g_config.ytdlp_path[0]) {
-        return file_exists(g_config.ytdlp_path);
-    }
+    const YtdlpConfig* config = ytdlp_config_acquire();
 
-    char path[1024];
-    if (find_ytdlp(path, sizeof(path))) {
-        strncpy(g_config.ytdlp_path, path, sizeof(g_config.ytdlp_path) - 1);
-        return true;
+    bool available = false;
+    if (config->ytdlp_path[0]) {
+        available = file_exists(config->ytdlp_path);
+    } else {
+        char path[YTDLP_PATH_MAX];
+        if (find_ytdlp(config, path, sizeof(path))) {
+            publish_ytdlp_path(ytdlp_config_global(), path);
+            available = true;
+        }
     }
 
-    return false;
+    ytdlp_config_release(config);
+    return available;
 }
 
 PRISM_YTDLP_API const char* prism_ytdlp_get_path(void) {
+    /* The snapshot may be replaced at any time, so hand out a per-thread copy */
+    static YTDLP_THREAD_LOCAL char path[YTDLP_PATH_MAX];
+
     if (!prism_ytdlp_is_available()) {
         return NULL;
     }
-    return g_config.ytdlp_path;
+
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    memcpy(path, config->ytdlp_path, sizeof(path));
+    ytdlp_config_release(config);
+
+    return path[0] ? path : NULL;
 }
 
 PRISM_YTDLP_API void prism_ytdlp_configure(const PrismYtdlpConfig* config) {
     if (!config) return;
 
+    YtdlpConfig* next = ytdlp_config_begin_update();
+    if (!next) return;
+
     if (config->ytdlp_path) {
-        strncpy(g_config.ytdlp_path, config->ytdlp_path, sizeof(g_config.ytdlp_path) - 1);
+        strncpy(next->ytdlp_path, config->ytdlp_path, sizeof(next->ytdlp_path) - 1);
+        next->ytdlp_path[sizeof(next->ytdlp_path) - 1] = '\0';
     }
 
     if (config->install_dir) {
-        strncpy(g_config.install_dir, config->install_dir, sizeof(g_config.install_dir) - 1);
+        strncpy(next->install_dir, config->install_dir, sizeof(next->install_dir) - 1);
+        next->install_dir[sizeof(next->install_dir) - 1] = '\0';
     }
 
-    g_config.auto_download = config->auto_download;
+    next->auto_download = config->auto_download;
 
     if (config->process_timeout_ms > 0) {
-        g_config.process_timeout_ms = config->process_timeout_ms;
+        next->process_timeout_ms = config->process_timeout_ms;
     }
-}
-
-/* ============================================================================
- * Resolver Implementation
- * ========================================================================== */
 
-static bool ensure_ytdlp_available(void) {
-    if (prism_ytdlp_is_available()) {
-        return true;
+    if (config->cache_dir) {
+        strncpy(next->cache_dir, config->cache_dir, sizeof(next->cache_dir) - 1);
+        next->cache_dir[sizeof(next->cache_dir) - 1] = '\0';
     }
 
-    if (!g_config.auto_download || g_config.download_attempted) {
-        return false;
+    if (config->cache_dir_max_mb != 0) {
+        next->cache_dir_max_mb = config->cache_dir_max_mb;
     }
 
-    g_config.download_attempted = true;
-    return prism_ytdlp_download(NULL, NULL, NULL) == PRISM_OK;
-}
+    next->backend = config->backend;
 
-static bool ytdlp_can_resolve(PrismResolver* resolver, const char* url) {
-    (void)resolver;
+    if (config->python_library) {
+        strncpy(next->python_library, config->python_library, sizeof(next->python_library) - 1);
+        next->python_library[sizeof(next->python_library) - 1] = '\0';
+    }
 
-    if (!url || !url[0]) return false;
+    if (config->python_path) {
+        strncpy(next->python_path, config->python_path, sizeof(next->python_path) - 1);
+        next->python_path[sizeof(next->python_path) - 1] = '\0';
+    }
 
-    char host[256];
-    if (!extract_host(url, host, sizeof(host))) {
-        return false;
+    if (config->python_executable) {
+        strncpy(next->python_executable, config->python_executable, sizeof(next->python_executable) - 1);
+        next->python_executable[sizeof(next->python_executable) - 1] = '\0';
     }
 
-    for (int i = 0; s_known_hosts[i]; i++) {
-        if (str_contains(host, s_known_hosts[i]) || str_contains(s_known_hosts[i], host)) {
-            return true;
+    if (config->release_url) {
+        strncpy(next->release_url, config->release_url, sizeof(next->release_url) - 1);
+        next->release_url[sizeof(next->release_url) - 1] = '\0';
+    }
+
+    if (config->shared_cache_name) {
+        strncpy(next->shared_cache_name, config->shared_cache_name, sizeof(next->shared_cache_name) - 1);
+        next->shared_cache_name[sizeof(next->shared_cache_name) - 1] = '\0';
+    }
+
+    if (config->shared_cache_mb > 0) {
+        next->shared_cache_mb = config->shared_cache_mb;
+    }
+
+    if (config->daemon_endpoints) {
+        strncpy(next->daemon_endpoints, config->daemon_endpoints, sizeof(next->daemon_endpoints) - 1);
+        next->daemon_endpoints[sizeof(next->daemon_endpoints) - 1] = '\0';
+    }
+
+    /* Create the directory now rather than on the first resolve */
+    if (next->cache_dir_max_mb >= 0) {
+        char dir[YTDLP_PATH_MAX];
+        ytdlp_cache_dir_prepare(next->cache_dir, dir, sizeof(dir));
+    }
+
+    ytdlp_config_commit(next);
+}
+
+PRISM_YTDLP_API void prism_ytdlp_get_stats(PrismYtdlpStats* stats) {
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->resolves = ytdlp_atomic_load_u64(&g_ytdlp_stats.resolves);
+    stats->resolve_allocations = ytdlp_atomic_load_u64(&g_ytdlp_stats.resolve_allocations);
+    stats->last_resolve_allocations = ytdlp_atomic_load_u64(&g_ytdlp_stats.last_resolve_allocations);
+    stats->heap_allocations = ytdlp_atomic_load_u64(&g_ytdlp_stats.heap_allocations);
+    stats->cache_hits = ytdlp_atomic_load_u64(&g_ytdlp_stats.cache_hits);
+    stats->cache_misses = ytdlp_atomic_load_u64(&g_ytdlp_stats.cache_misses);
+    stats->concurrency_waits = ytdlp_atomic_load_u64(&g_ytdlp_stats.concurrency_waits);
+    stats->refreshes = ytdlp_atomic_load_u64(&g_ytdlp_stats.refreshes);
+    stats->direct_resolves = ytdlp_atomic_load_u64(&g_ytdlp_stats.direct_resolves);
+    stats->deadline_misses = ytdlp_atomic_load_u64(&g_ytdlp_stats.deadline_misses);
+    stats->stale_results = ytdlp_atomic_load_u64(&g_ytdlp_stats.stale_results);
+    stats->negative_hits = ytdlp_atomic_load_u64(&g_ytdlp_stats.negative_hits);
+    stats->hedges = ytdlp_atomic_load_u64(&g_ytdlp_stats.hedges);
+    stats->hedge_wins = ytdlp_atomic_load_u64(&g_ytdlp_stats.hedge_wins);
+    stats->shared_hits = ytdlp_atomic_load_u64(&g_ytdlp_stats.shared_hits);
+    stats->shared_cache_errors = ytdlp_atomic_load_u64(&g_ytdlp_stats.shared_cache_errors);
+    stats->daemon_resolves = ytdlp_atomic_load_u64(&g_ytdlp_stats.daemon_resolves);
+    stats->daemon_fallbacks = ytdlp_atomic_load_u64(&g_ytdlp_stats.daemon_fallbacks);
+    stats->daemon_timeouts = ytdlp_atomic_load_u64(&g_ytdlp_stats.daemon_timeouts);
+}
+
+/* Count into both the plugin-wide totals and the resolver's own */
+#define YTDLP_STAT_ADD(resolver, field, n) do { \
+    ytdlp_atomic_add_u64(&g_ytdlp_stats.field, (n)); \
+    ytdlp_atomic_add_u64(&(resolver)->stats.field, (n)); \
+} while (0)
+
+#define YTDLP_STAT_SET(resolver, field, n) do { \
+    ytdlp_atomic_store_u64(&g_ytdlp_stats.field, (n)); \
+    ytdlp_atomic_store_u64(&(resolver)->stats.field, (n)); \
+} while (0)
+
+/* ============================================================================
+ * Resolver Implementation
+ * ========================================================================== */
+
+/*
+ * Make sure yt-dlp is present (downloading it once if allowed) and return a
+ * reference to the configuration snapshot to run it with, or NULL.
+ */
+static const YtdlpConfig* acquire_available_config(void) {
+    if (!prism_ytdlp_is_available()) {
+        const YtdlpConfig* config = ytdlp_config_acquire();
+        bool auto_download = config->auto_download;
+        ytdlp_config_release(config);
+
+        if (!auto_download || ytdlp_atomic_load_i32(&s_download_failed)) {
+            return NULL;
+        }
+
+        /* Resolves that arrive while the download runs wait for it */
+        if (prism_ytdlp_download(NULL, NULL, NULL) != PRISM_OK) {
+            ytdlp_atomic_cas_i32(&s_download_failed, 0, 1);
+            return NULL;
         }
     }
 
-    return false;
+    return ytdlp_config_acquire();
 }
 
-static PrismResolvedStream* ytdlp_resolve(
-    PrismResolver* resolver,
+/* The selected backend if it could be brought up, else the process backend */
+static PrismYtdlpBackend ready_backend(const YtdlpConfig* config) {
+    switch (config->backend) {
+    case PRISM_YTDLP_BACKEND_PYTHON:
+        if (ytdlp_python_load(config->python_library, config->python_path)) return PRISM_YTDLP_BACKEND_PYTHON;
+        break;
+    case PRISM_YTDLP_BACKEND_ZYGOTE:
+        if (ytdlp_zygote_start(config->python_executable, config->python_path)) return PRISM_YTDLP_BACKEND_ZYGOTE;
+        break;
+    default:
+        break;
+    }
+    return PRISM_YTDLP_BACKEND_PROCESS;
+}
+
+/*
+ * Pick the binary and timeout for a request. A resolver with its own path
+ * uses it as-is; otherwise the global binary is used (and downloaded if
+ * allowed). Extractions use the Python or zygote backend instead when it is
+ * selected and comes up, which needs no binary. Returns false if neither is
+ * available.
+ */
+static bool run_context_acquire(YtdlpResolver* resolver, RunContext* run) {
+    memset(run, 0, sizeof(*run));
+
+    if (resolver->owns_config) {
+        run->instance = ytdlp_config_slot_acquire(&resolver->config_slot);
+    }
+
+    if (run->instance && run->instance->ytdlp_path[0]) {
+        if (!file_exists(run->instance->ytdlp_path)) {
+            ytdlp_config_release(run->instance);
+            return false;
+        }
+        run->global = ytdlp_config_acquire();
+        run->ytdlp_path = run->instance->ytdlp_path;
+    } else {
+        const YtdlpConfig* config = ytdlp_config_acquire();
+        run->backend = ready_backend(config);
+        if (run->backend != PRISM_YTDLP_BACKEND_PROCESS) {
+            run->global = config;
+        } else {
+            ytdlp_config_release(config);
+            run->global = acquire_available_config();
+        }
+        if (!run->global) {
+            ytdlp_config_release(run->instance);
+            return false;
+        }
+        run->ytdlp_path = run->global->ytdlp_path;
+    }
+
+    run->timeout_ms = (run->instance && run->instance->process_timeout_ms > 0) ?
+                      run->instance->process_timeout_ms : run->global->process_timeout_ms;
+
+    /* Runs without a usable cache directory fall back to yt-dlp's own */
+    if (run->global->cache_dir_max_mb >= 0 &&
+        ytdlp_cache_dir_prepare(run->global->cache_dir, run->cache_dir, sizeof(run->cache_dir))) {
+        int max_mb = run->global->cache_dir_max_mb;
+        run->cache_dir_max_bytes = (uint64_t)max_mb * 1024u * 1024u;
+    } else {
+        run->cache_dir[0] = '\0';
+    }
+
+    /* An update may not remove the version while this run uses it */
+    ytdlp_versions_run_begin(run->ytdlp_path);
+    return true;
+}
+
+/* `--cache-dir "<dir>" ` for the run, or an empty string */
+static const char* cache_dir_args(const RunContext* run, char* buf, size_t size) {
+    if (!run->cache_dir[0]) return "";
+    snprintf(buf, size, "--cache-dir \"%s\" ", run->cache_dir);
+    return buf;
+}
+
+static void run_context_release(RunContext* run) {
+    ytdlp_versions_run_end(run->ytdlp_path);
+    ytdlp_config_release(run->instance);
+    ytdlp_config_release(run->global);
+    memset(run, 0, sizeof(*run));
+}
+
+/* Take a concurrency slot, waiting until `wait_until` at most (0 = no limit) */
+static bool budget_enter(YtdlpResolver* resolver, uint64_t wait_until) {
+    if (resolver->max_concurrent <= 0) return true;
+
+    ytdlp_mutex_lock(&resolver->budget_lock);
+    if (resolver->active >= resolver->max_concurrent) {
+        YTDLP_STAT_ADD(resolver, concurrency_waits, 1);
+        do {
+            if (!wait_until) {
+                ytdlp_cond_wait(&resolver->budget_cond, &resolver->budget_lock);
+                continue;
+            }
+
+            uint64_t now = ytdlp_monotonic_ms();
+            if (now >= wait_until) {
+                /* Pass on a wakeup this waiter may have taken */
+                ytdlp_cond_signal(&resolver->budget_cond);
+                ytdlp_mutex_unlock(&resolver->budget_lock);
+                return false;
+            }
+            ytdlp_cond_wait_ms(&resolver->budget_cond, &resolver->budget_lock, (uint32_t)(wait_until - now));
+        } while (resolver->active >= resolver->max_concurrent);
+    }
+    resolver->active++;
+    ytdlp_mutex_unlock(&resolver->budget_lock);
+    return true;
+}
+
+static void budget_leave(YtdlpResolver* resolver) {
+    if (resolver->max_concurrent <= 0) return;
+
+    ytdlp_mutex_lock(&resolver->budget_lock);
+    resolver->active--;
+    ytdlp_cond_signal(&resolver->budget_cond);
+    ytdlp_mutex_unlock(&resolver->budget_lock);
+}
+
+static bool ytdlp_can_resolve(PrismResolver* resolver, const char* url) {
+    (void)resolver;
+
+    YtdlpUrl parsed;
+    return ytdlp_url_parse(url, &parsed) && is_known_host(&parsed);
+}
+
+/* Give back the concurrency slot and the binary taken for a run */
+static void run_end(YtdlpResolver* resolver, RunContext* run) {
+    budget_leave(resolver);
+    ytdlp_cache_dir_note_use(run->cache_dir, run->cache_dir_max_bytes);
+    run_context_release(run);
+}
+
+/* Run `fill` against a builder staged in the thread's scratch arena and copy
+ * the result out to the heap. */
+static PrismResolvedStream* build_stream(
+    void (*fill)(YtdlpStreamBuilder*, YtdlpResolver*, const char*, const PrismResolverOptions*),
+    YtdlpResolver* resolver,
     const char* url,
     const PrismResolverOptions* options
 ) {
-    (void)resolver;
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) return NULL;
+
+    YtdlpArenaMark mark = ytdlp_arena_mark(&scratch->arena);
 
-    PrismResolvedStream* stream = (PrismResolvedStream*)calloc(1, sizeof(PrismResolvedStream));
-    if (!stream) return NULL;
+    YtdlpStreamBuilder builder;
+    ytdlp_builder_init(&builder, &scratch->arena);
 
     if (!url) {
-        stream->success = false;
-        stream->error = str_dup("URL is NULL");
-        return stream;
+        ytdlp_builder_fail(&builder, "URL is NULL");
+    } else {
+        ytdlp_builder_set(&builder, &builder.stream.original_url, url);
+        fill(&builder, resolver, url, options);
     }
 
-    stream->original_url = str_dup(url);
+    PrismResolvedStream* stream = ytdlp_builder_finish(&builder);
+    ytdlp_arena_release(&scratch->arena, mark);
+
+    return stream;
+}
+
+static const char* preferred_language(const PrismResolverOptions* options) {
+    return (options && options->preferred_audio_language) ?
+           options->preferred_audio_language : s_default_language;
+}
+
+/* ============================================================================
+ * Extraction
+ *
+ * One `yt-dlp -J` per media captures metadata and every format; the result
+ * is cached per resolver and all quality selection happens in-process.
+ * ========================================================================== */
 
-    if (!ensure_ytdlp_available()) {
-        stream->success = false;
-        stream->error = str_dup("yt-dlp not available");
-        return stream;
+/* Monotonic time by which a request must finish (0 = none) */
+static uint64_t request_deadline(const PrismResolverOptions* options) {
+    if (!options || options->timeout_ms <= 0) return 0;
+    return ytdlp_monotonic_ms() + (uint64_t)options->timeout_ms;
+}
+
+void ytdlp_network_limits(int budget_ms, int* socket_timeout_s, int* retries) {
+    if (budget_ms <= 0) {
+        *socket_timeout_s = YTDLP_SOCKET_TIMEOUT_MAX_S;
+        *retries = YTDLP_EXTRACTOR_RETRIES_MAX;
+        return;
     }
 
-    /* Sanitize YouTube URLs to remove parameters that interfere with language selection */
-    char* sanitized_url = sanitize_youtube_url(url);
-    if (!sanitized_url) {
-        stream->success = false;
-        stream->error = str_dup("Out of memory");
-        return stream;
+    /* A quarter of the budget per request, and the first attempt gets half
+     * the budget; retries share the other half */
+    int socket_s = budget_ms / 4000;
+    if (socket_s < 1) socket_s = 1;
+    if (socket_s > YTDLP_SOCKET_TIMEOUT_MAX_S) socket_s = YTDLP_SOCKET_TIMEOUT_MAX_S;
+
+    int fit = (budget_ms / 2) / (socket_s * 1000);
+    *socket_timeout_s = socket_s;
+    *retries = fit < YTDLP_EXTRACTOR_RETRIES_MAX ? fit : YTDLP_EXTRACTOR_RETRIES_MAX;
+}
+
+/* Cache key: what the URL points at plus everything that changes what
+ * yt-dlp extracts for it. Different links to one video share a key. */
+static char* make_cache_key(YtdlpArena* arena, const YtdlpUrl* url, const PrismResolverOptions* options) {
+    const char* language = is_language_capable_url(url) ? preferred_language(options) : "";
+
+    size_t prefix = strlen(language) + 1;
+    size_t size = prefix + ytdlp_url_key(url, NULL, 0) + 1;
+    char* key = (char*)ytdlp_arena_alloc(arena, size);
+    if (key) {
+        snprintf(key, size, "%s|", language);
+        ytdlp_url_key(url, key + prefix, size - prefix);
     }
+    return key;
+}
 
-    /* Get quality from options - default to 720p (HIGH) if AUTO */
-    PrismStreamQuality quality = options ? options->quality : PRISM_QUALITY_AUTO;
-    stream->requested_quality = quality;
+/* Parse a finished yt-dlp run. Fails the builder on error. */
+static YtdlpMediaInfo* media_info_from_result(YtdlpStreamBuilder* b, const YtdlpProcessResult* result) {
+    if (result->exit_code != 0 || !result->output || result->output[0] == '\0') {
+        ytdlp_builder_fail(b, result->error ? result->error : "Failed to resolve URL");
+        return NULL;
+    }
 
-    /* Build format argument based on quality */
-    char format_arg[256];
-    int height = 0;
-
-    switch (quality) {
-        case PRISM_QUALITY_LOW:    height = 360; break;
-        case PRISM_QUALITY_MEDIUM: height = 480; break;
-        case PRISM_QUALITY_HIGH:   height = 720; break;
-        case PRISM_QUALITY_FULL:   height = 1080; break;
-        case PRISM_QUALITY_QHD:    height = 1440; break;
-        case PRISM_QUALITY_4K:     height = 2160; break;
-        case PRISM_QUALITY_AUTO:   height = 720; break;  /* Default to 720p for AUTO */
-        default:
-            /* For numeric values like 360, 720, etc., use directly */
-            if (quality > 0 && quality <= 4320) {
-                height = (int)quality;
-            } else {
-                height = 720;  /* Fallback to 720p */
-            }
-            break;
+    YtdlpJson* root = ytdlp_json_parse(b->arena, result->output);
+    if (!root) {
+        ytdlp_builder_fail(b, "Failed to parse yt-dlp output");
+        return NULL;
+    }
+
+    YtdlpMediaInfo* info = ytdlp_media_info_from_json(root);
+    if (!info) {
+        ytdlp_builder_fail(b, "No playable formats found");
     }
+    return info;
+}
 
-    /* Check if live stream first */
-    char args[1024];
-    snprintf(args, sizeof(args), "--no-warnings --no-check-certificate --print is_live \"%s\"", sanitized_url);
+/* ============================================================================
+ * Hedged Extraction
+ *
+ * Most extractions of a host take about as long as each other; the slow
+ * tail is a run stuck on one request. A resolver with hedging on learns the
+ * latency of each host, and once an extraction runs past the configured
+ * percentile it starts a second, identical run. The first to succeed wins
+ * and the other is killed. Hedges are paid for from a token bucket that each
+ * extraction tops up, so they stay a bounded share of all runs.
+ * ========================================================================== */
+
+/* Known sites are tracked as a whole, whichever of their hosts a URL uses */
+static const char* latency_host(const YtdlpUrl* url) {
+    switch (url->site) {
+        case YTDLP_SITE_YOUTUBE: return "youtube";
+        case YTDLP_SITE_TWITCH: return "twitch";
+        case YTDLP_SITE_VIMEO: return "vimeo";
+        case YTDLP_SITE_TIKTOK: return "tiktok";
+        default: return url->host;
+    }
+}
 
-    ProcessResult live_check = run_process(g_config.ytdlp_path, args, g_config.process_timeout_ms);
-    bool is_live = false;
-    if (live_check.output) {
-        char* trimmed = str_trim(live_check.output);
-        str_to_lower(trimmed);
-        is_live = strcmp(trimmed, "true") == 0;
+/* Entry for `host`; with `create`, the least recently used one is reused
+ * when it is new. Called with hedge_lock held. */
+static HostLatency* host_latency(YtdlpResolver* resolver, const char* host, bool create) {
+    HostLatency* victim = NULL;
+    for (int i = 0; i < YTDLP_HEDGE_HOSTS; i++) {
+        HostLatency* entry = &resolver->hosts[i];
+        if (strcmp(entry->host, host) == 0) {
+            entry->last_used = ++resolver->hedge_tick;
+            return entry;
+        }
+        if (!victim || entry->last_used < victim->last_used) victim = entry;
     }
-    free_process_result(&live_check);
+    if (!create) return NULL;
 
-    stream->is_live = is_live;
+    memset(victim, 0, sizeof(*victim));
+    snprintf(victim->host, sizeof(victim->host), "%s", host);
+    victim->last_used = ++resolver->hedge_tick;
+    return victim;
+}
 
-    /* Build format string */
-    if (is_live) {
-        if (height > 0) {
-            snprintf(format_arg, sizeof(format_arg),
-                "best[height<=%d][protocol!=m3u8]/best[height<=%d][protocol!=m3u8_native]/best[height<=%d]",
-                height, height, height);
-        } else {
-            snprintf(format_arg, sizeof(format_arg),
-                "best[protocol!=m3u8]/best[protocol!=m3u8_native]/best");
+static void record_latency(YtdlpResolver* resolver, const YtdlpUrl* url, uint64_t elapsed_ms) {
+    if (!resolver->hosts) return;
+
+    ytdlp_mutex_lock(&resolver->hedge_lock);
+    HostLatency* entry = host_latency(resolver, latency_host(url), true);
+    entry->samples[entry->next] = elapsed_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_ms;
+    entry->next = (entry->next + 1) % YTDLP_HEDGE_SAMPLES;
+    if (entry->count < YTDLP_HEDGE_SAMPLES) entry->count++;
+    ytdlp_mutex_unlock(&resolver->hedge_lock);
+}
+
+/*
+ * When to hedge an extraction from `url`: the resolver's percentile of the
+ * host's recent latencies. Also tops up the hedge bucket, as every
+ * extraction does. Returns 0 when the host has too few samples.
+ */
+static uint32_t hedge_delay_ms(YtdlpResolver* resolver, const YtdlpUrl* url) {
+    uint32_t sorted[YTDLP_HEDGE_SAMPLES];
+    int count = 0;
+
+    ytdlp_mutex_lock(&resolver->hedge_lock);
+
+    resolver->hedge_tokens += resolver->hedge_max_percent / 100.0;
+    if (resolver->hedge_tokens > YTDLP_HEDGE_BURST) resolver->hedge_tokens = YTDLP_HEDGE_BURST;
+
+    HostLatency* entry = host_latency(resolver, latency_host(url), false);
+    if (entry && entry->count >= YTDLP_HEDGE_MIN_SAMPLES) {
+        count = entry->count;
+        memcpy(sorted, entry->samples, sizeof(uint32_t) * (size_t)count);
+    }
+
+    ytdlp_mutex_unlock(&resolver->hedge_lock);
+
+    if (count == 0) return 0;
+
+    for (int i = 1; i < count; i++) {
+        uint32_t v = sorted[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+
+    int rank = (count * resolver->hedge_percentile + 99) / 100;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1] > 0 ? sorted[rank - 1] : 1;
+}
+
+static bool hedge_take_token(YtdlpResolver* resolver) {
+    ytdlp_mutex_lock(&resolver->hedge_lock);
+    bool allowed = resolver->hedge_tokens >= 1.0;
+    if (allowed) resolver->hedge_tokens -= 1.0;
+    ytdlp_mutex_unlock(&resolver->hedge_lock);
+    return allowed;
+}
+
+typedef struct Hedge {
+    YtdlpResolver* resolver;
+    const char* ytdlp_path;
+    const char* args;
+    uint64_t launch_at;       /* When the second run starts */
+    uint64_t deadline;        /* When the first run's budget ends */
+
+    YtdlpMutex lock;
+    YtdlpCond cond;
+    bool primary_done;
+    bool started;
+    bool done;
+    YtdlpMediaInfo* info;     /* The second run's extraction, if it succeeded */
+    uint64_t elapsed_ms;
+
+    volatile int32_t primary_cancel;
+    volatile int32_t hedge_cancel;
+} Hedge;
+
+static void hedge_thread(void* arg) {
+    Hedge* h = (Hedge*)arg;
+
+    ytdlp_mutex_lock(&h->lock);
+    uint64_t now = ytdlp_monotonic_ms();
+    while (!h->primary_done && now < h->launch_at) {
+        ytdlp_cond_wait_ms(&h->cond, &h->lock, (uint32_t)(h->launch_at - now));
+        now = ytdlp_monotonic_ms();
+    }
+    h->started = !h->primary_done && now + 1 < h->deadline && hedge_take_token(h->resolver);
+    bool started = h->started;
+    ytdlp_mutex_unlock(&h->lock);
+
+    if (!started) return;
+    YTDLP_STAT_ADD(h->resolver, hedges, 1);
+
+    /* Output lands in this thread's scratch, which lives as long as the thread */
+    YtdlpProcessResult result = ytdlp_run_process_cancellable(h->ytdlp_path, h->args,
+                                                              (int)(h->deadline - now), &h->hedge_cancel);
+    uint64_t elapsed_ms = ytdlp_monotonic_ms() - now;
+
+    YtdlpMediaInfo* info = NULL;
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (scratch) {
+        YtdlpArenaMark mark = ytdlp_arena_mark(&scratch->arena);
+        YtdlpStreamBuilder builder;
+        ytdlp_builder_init(&builder, &scratch->arena);
+        info = media_info_from_result(&builder, &result);
+        ytdlp_arena_release(&scratch->arena, mark);
+    }
+
+    ytdlp_mutex_lock(&h->lock);
+    h->info = info;
+    h->elapsed_ms = elapsed_ms;
+    h->done = true;
+    if (info) ytdlp_atomic_store_i32(&h->primary_cancel, 1);
+    ytdlp_cond_broadcast(&h->cond);
+    ytdlp_mutex_unlock(&h->lock);
+}
+
+/*
+ * Run `args` like ytdlp_run_process(), with a second run started once
+ * `delay_ms` pass. A first run that fails for good also ends the second;
+ * one that may have failed by chance waits for it. Fails the builder on
+ * error.
+ */
+static YtdlpMediaInfo* extract_hedged(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const RunContext* run,
+    const YtdlpUrl* url,
+    const char* args,
+    int budget_ms,
+    uint32_t delay_ms
+) {
+    uint64_t start = ytdlp_monotonic_ms();
+
+    Hedge h;
+    memset(&h, 0, sizeof(h));
+    h.resolver = resolver;
+    h.ytdlp_path = run->ytdlp_path;
+    h.args = args;
+    h.launch_at = start + delay_ms;
+    h.deadline = start + (uint64_t)budget_ms;
+    ytdlp_mutex_init(&h.lock);
+    ytdlp_cond_init(&h.cond);
+
+    YtdlpThread thread;
+    bool threaded = ytdlp_thread_start(&thread, hedge_thread, &h);
+
+    YtdlpProcessResult result = ytdlp_run_process_cancellable(run->ytdlp_path, args, budget_ms, &h.primary_cancel);
+    uint64_t elapsed_ms = ytdlp_monotonic_ms() - start;
+    bool succeeded = result.exit_code == 0 && result.output && result.output[0];
+
+    if (threaded) {
+        ytdlp_mutex_lock(&h.lock);
+        h.primary_done = true;
+        if (succeeded || !prism_ytdlp_error_is_transient(ytdlp_classify_error(result.error))) {
+            ytdlp_atomic_store_i32(&h.hedge_cancel, 1);
+        }
+        ytdlp_cond_broadcast(&h.cond);
+        while (h.started && !h.done) {
+            ytdlp_cond_wait(&h.cond, &h.lock);
         }
+        ytdlp_mutex_unlock(&h.lock);
+        ytdlp_thread_join(thread);
+    }
+
+    ytdlp_cond_destroy(&h.cond);
+    ytdlp_mutex_destroy(&h.lock);
+
+    if (!succeeded && h.info) {
+        YTDLP_STAT_ADD(resolver, hedge_wins, 1);
+        record_latency(resolver, url, h.elapsed_ms);
+        return h.info;
+    }
+    ytdlp_media_info_release(h.info);
+
+    YtdlpMediaInfo* info = media_info_from_result(b, &result);
+    if (info) record_latency(resolver, url, elapsed_ms);
+    return info;
+}
+
+/* ============================================================================
+ * Extraction Runs
+ * ========================================================================== */
+
+/* Run yt-dlp once for the whole format ladder. Fails the builder on error. */
+static YtdlpMediaInfo* extract_media_info(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const RunContext* run,
+    const YtdlpUrl* url,
+    const PrismResolverOptions* options,
+    int budget_ms
+) {
+    /* Sanitize YouTube URLs to remove parameters that interfere with language selection */
+    char* sanitized_url = sanitize_youtube_url(b->arena, url);
+    if (!sanitized_url) {
+        ytdlp_builder_fail(b, "Out of memory");
+        return NULL;
+    }
+
+    /* Include language preference for language-capable hosts (YouTube) */
+    bool use_language = is_language_capable_url(url);
+    const char* language = preferred_language(options);
+
+    /* The Python backends take the same options as the command line below */
+    const char* lang = use_language && language[0] ? language : NULL;
+
+    YtdlpProcessResult result;
+    if (run->backend == PRISM_YTDLP_BACKEND_PYTHON) {
+        result = ytdlp_python_extract(sanitized_url, lang, run->cache_dir, budget_ms);
+    } else if (run->backend == PRISM_YTDLP_BACKEND_ZYGOTE) {
+        result = ytdlp_zygote_extract(sanitized_url, lang, run->cache_dir, budget_ms);
     } else {
-        if (height > 0) {
-            snprintf(format_arg, sizeof(format_arg),
-                "bestvideo[height<=%d][ext=mp4][protocol!=m3u8]+bestaudio[ext=m4a]/best[height<=%d][ext=mp4][protocol!=m3u8]/best[height<=%d][ext=mp4]/best[ext=mp4]/best",
-                height, height, height);
+        char cache_args[YTDLP_PATH_MAX + 16];
+        const char* cache = cache_dir_args(run, cache_args, sizeof(cache_args));
+
+        /* Keep yt-dlp's own waiting inside the budget; the process is killed
+         * when it runs out regardless */
+        int socket_timeout_s, retries;
+        ytdlp_network_limits(budget_ms, &socket_timeout_s, &retries);
+        char limits[64];
+        snprintf(limits, sizeof(limits), "--socket-timeout %d --extractor-retries %d ", socket_timeout_s, retries);
+
+        char args[4096];
+        if (use_language && language[0]) {
+            /* --extractor-args "youtube:lang=XX" ranks the specified audio track
+             * highest for AI-dubbed videos */
+            snprintf(args, sizeof(args),
+                "--no-warnings --no-check-certificate --no-playlist %s%s--extractor-args \"youtube:lang=%s\" -J \"%s\"",
+                cache, limits, language, sanitized_url);
         } else {
-            snprintf(format_arg, sizeof(format_arg),
-                "bestvideo[ext=mp4][protocol!=m3u8]+bestaudio[ext=m4a]/best[ext=mp4][protocol!=m3u8]/best[ext=mp4]/best");
+            snprintf(args, sizeof(args),
+                "--no-warnings --no-check-certificate --no-playlist %s%s-J \"%s\"",
+                cache, limits, sanitized_url);
         }
+
+        if (resolver->hosts) {
+            uint32_t delay_ms = hedge_delay_ms(resolver, url);
+            if (delay_ms > 0 && delay_ms < (uint32_t)budget_ms) {
+                return extract_hedged(b, resolver, run, url, args, budget_ms, delay_ms);
+            }
+        }
+
+        uint64_t start = ytdlp_monotonic_ms();
+        result = ytdlp_run_process(run->ytdlp_path, args, budget_ms);
+        if (result.exit_code == 0) record_latency(resolver, url, ytdlp_monotonic_ms() - start);
     }
 
-    /* Get direct URL - include language preference for language-capable hosts (YouTube) */
-    bool use_language = is_language_capable_url(sanitized_url);
-    const char* language = (options && options->preferred_audio_language) ?
-                           options->preferred_audio_language : s_default_language;
+    return media_info_from_result(b, &result);
+}
+
+/*
+ * How long `info` may be cached: 0 for the cache's own TTL, or less when its
+ * signed URLs expire sooner. Returns -1 if it should not be cached at all.
+ */
+static int media_info_ttl_ms(const YtdlpMediaInfo* info) {
+    if (!info->expires_at) return 0;
+
+    int64_t remaining_ms = (info->expires_at - (int64_t)time(NULL)) * 1000 - YTDLP_EXPIRY_MARGIN_MS;
+    if (remaining_ms <= 0) return -1;
+    return remaining_ms > INT_MAX ? INT_MAX : (int)remaining_ms;
+}
+
+/*
+ * A resolve that ran out of time may still answer from an earlier extraction
+ * past its cache lifetime, as long as its URLs have not expired (see
+ * ytdlp_cache_get_stale() for URLs with no known expiry). The stream
+ * then carries a warning instead of the error.
+ */
+static const YtdlpMediaInfo* stale_media_info(YtdlpStreamBuilder* b, YtdlpResolver* resolver, const char* key) {
+    const YtdlpMediaInfo* info = key ? ytdlp_cache_get_stale(resolver->cache, key) : NULL;
+    if (info && media_info_ttl_ms(info) < 0) {
+        ytdlp_media_info_release(info);
+        info = NULL;
+    }
+    if (!info) return NULL;
+
+    YTDLP_STAT_ADD(resolver, stale_results, 1);
+    b->stream.error = NULL;
+    b->error_class = PRISM_YTDLP_ERROR_NONE;
+    ytdlp_builder_set(b, &b->stream.warning, "Resolve timed out; using an earlier extraction");
+    return info;
+}
 
-    if (use_language && language && language[0]) {
-        /* --extractor-args "youtube:lang=XX" prefers specified audio track for AI-dubbed videos
-         * --audio-multistreams ensures we get the preferred language when multiple tracks exist */
-        snprintf(args, sizeof(args),
-            "--no-warnings --no-check-certificate --extractor-args \"youtube:lang=%s\" --audio-multistreams -f \"%s\" --get-url \"%s\"",
-            language, format_arg, sanitized_url);
+/*
+ * How long a failure of `error_class` is remembered: 0 for the cache's TTL,
+ * or -1 if the next resolve should try again. A rate limit applies to the
+ * whole site rather than the URL.
+ */
+static int failure_ttl_ms(PrismYtdlpErrorClass error_class) {
+    switch (error_class) {
+        case PRISM_YTDLP_ERROR_PRIVATE:
+        case PRISM_YTDLP_ERROR_REMOVED:
+        case PRISM_YTDLP_ERROR_GEO_BLOCKED:
+        case PRISM_YTDLP_ERROR_AGE_GATED:
+        case PRISM_YTDLP_ERROR_UNSUPPORTED:
+            return 0;
+        case PRISM_YTDLP_ERROR_RATE_LIMITED:
+            return YTDLP_RATE_LIMIT_BACKOFF_MS;
+        case PRISM_YTDLP_ERROR_OFFLINE_LIVE:
+            return YTDLP_OFFLINE_RETRY_MS;
+        case PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN:
+            return YTDLP_BROKEN_RETRY_MS;
+        default:
+            return -1;
+    }
+}
+
+/* Cache key of a site-wide rate limit: all YouTube hosts share one */
+static void rate_limit_key(const YtdlpUrl* url, char* key, size_t size) {
+    snprintf(key, size, "!rate-limited|%d|%s", (int)url->site, url->site == YTDLP_SITE_OTHER ? url->host : "");
+}
+
+/* Fail the builder with a remembered failure of `key` or its site; false if
+ * there is none and yt-dlp has to run */
+static bool remembered_failure(YtdlpStreamBuilder* b, YtdlpResolver* resolver, const YtdlpUrl* url, const char* key) {
+    char error[1024];
+    char site_key[YTDLP_URL_HOST_MAX + 32];
+    rate_limit_key(url, site_key, sizeof(site_key));
+
+    if (!ytdlp_cache_get_failure(resolver->cache, key, error, sizeof(error)) &&
+        !ytdlp_cache_get_failure(resolver->cache, site_key, error, sizeof(error)) &&
+        !ytdlp_shared_cache_get_failure(resolver->shared, key, error, sizeof(error)) &&
+        !ytdlp_shared_cache_get_failure(resolver->shared, site_key, error, sizeof(error))) {
+        return false;
+    }
+
+    YTDLP_STAT_ADD(resolver, negative_hits, 1);
+    ytdlp_builder_fail(b, error);
+    return true;
+}
+
+static void remember_failure(YtdlpStreamBuilder* b, YtdlpResolver* resolver, const YtdlpUrl* url, const char* key) {
+    int ttl_ms = failure_ttl_ms(b->error_class);
+    if (ttl_ms < 0 || !b->stream.error) return;
+
+    if (b->error_class == PRISM_YTDLP_ERROR_RATE_LIMITED) {
+        char site_key[YTDLP_URL_HOST_MAX + 32];
+        rate_limit_key(url, site_key, sizeof(site_key));
+        ytdlp_cache_put_failure(resolver->cache, site_key, b->stream.error, ttl_ms);
+        ytdlp_shared_cache_put_failure(resolver->shared, site_key, b->stream.error, ttl_ms);
     } else {
-        snprintf(args, sizeof(args),
-            "--no-warnings --no-check-certificate -f \"%s\" --get-url \"%s\"",
-            format_arg, sanitized_url);
+        ytdlp_cache_put_failure(resolver->cache, key, b->stream.error, ttl_ms);
+        ytdlp_shared_cache_put_failure(resolver->shared, key, b->stream.error, ttl_ms);
     }
+}
 
-    ProcessResult url_result = run_process(g_config.ytdlp_path, args, g_config.process_timeout_ms);
+/* An extraction another process stored in the shared cache, copied into the
+ * resolver's own for the rest of its lifetime there */
+static const YtdlpMediaInfo* shared_media_info(YtdlpResolver* resolver, const char* key) {
+    int shared_ttl_ms = 0;
+    const YtdlpMediaInfo* info = ytdlp_shared_cache_get(resolver->shared, key, &shared_ttl_ms);
+    if (!info) return NULL;
 
-    if (url_result.exit_code != 0 || !url_result.output || url_result.output[0] == '\0') {
-        const char* error_msg = url_result.error ? url_result.error : "Failed to resolve URL";
-        stream->success = false;
-        stream->error = str_dup(error_msg);
-        free_process_result(&url_result);
-        free(sanitized_url);
-        return stream;
+    int ttl_ms = media_info_ttl_ms(info);
+    if (ttl_ms < 0 || shared_ttl_ms <= 0) {
+        ytdlp_media_info_release(info);
+        return NULL;
     }
 
-    char* direct_url = str_trim(url_result.output);
-    stream->direct_url = str_dup(direct_url);
-    free_process_result(&url_result);
+    YTDLP_STAT_ADD(resolver, shared_hits, 1);
+    ytdlp_cache_put(resolver->cache, key, info, ttl_ms > 0 && ttl_ms < shared_ttl_ms ? ttl_ms : shared_ttl_ms);
+    return info;
+}
 
-    if (!stream->direct_url) {
-        stream->success = false;
-        stream->error = str_dup("Out of memory");
-        free(sanitized_url);
-        return stream;
+/* ============================================================================
+ * In-Flight Extractions
+ *
+ * The first cache miss for a key extracts. Misses for the same key that
+ * arrive meanwhile wait for its outcome instead of running yt-dlp again, and
+ * take over if it runs out of its own time while they still have some.
+ * ========================================================================== */
+
+typedef enum InFlightWait {
+    INFLIGHT_DONE,         /* The extraction finished, successfully or not */
+    INFLIGHT_EXPIRED,      /* The waiter's deadline passed first */
+    INFLIGHT_ABANDONED     /* The extracting caller ran out of time */
+} InFlightWait;
+
+/* Join the extraction of `key` in progress, or register a new one and set
+ * `*leader`. NULL only when out of memory. */
+static InFlight* inflight_begin(YtdlpResolver* resolver, const char* key, bool* leader) {
+    ytdlp_mutex_lock(&resolver->inflight_lock);
+
+    InFlight* flight = resolver->inflight;
+    while (flight && strcmp(flight->key, key) != 0) flight = flight->next;
+
+    *leader = flight == NULL;
+    if (!flight) {
+        size_t key_size = strlen(key) + 1;
+        flight = (InFlight*)ytdlp_malloc(sizeof(InFlight) + key_size);
+        if (flight) {
+            memset(flight, 0, sizeof(*flight));
+            memcpy(flight + 1, key, key_size);
+            flight->key = (const char*)(flight + 1);
+            flight->next = resolver->inflight;
+            resolver->inflight = flight;
+        }
     }
+    if (flight) flight->refs++;
 
-    /* Check if HLS */
-    stream->is_hls = str_contains(stream->direct_url, ".m3u8") ||
-                     str_contains(stream->direct_url, "m3u8");
+    ytdlp_mutex_unlock(&resolver->inflight_lock);
+    return flight;
+}
 
-    /* Get additional info (title, resolution) */
-    snprintf(args, sizeof(args),
-        "--no-warnings --no-check-certificate --print title --print width --print height \"%s\"",
-        sanitized_url);
+/* Called with inflight_lock held */
+static void inflight_unref(InFlight* flight) {
+    if (--flight->refs > 0) return;
+    ytdlp_media_info_release(flight->info);
+    ytdlp_free(flight);
+}
 
-    ProcessResult info_result = run_process(g_config.ytdlp_path, args, g_config.process_timeout_ms);
+/* Hand the outcome in `b` and `info` to the waiters and unregister */
+static void inflight_finish(
+    YtdlpResolver* resolver,
+    InFlight* flight,
+    const YtdlpStreamBuilder* b,
+    const YtdlpMediaInfo* info,
+    bool out_of_time
+) {
+    if (!flight) return;
 
-    if (info_result.output) {
-        char* lines = info_result.output;
-        char* saveptr = NULL;
+    ytdlp_mutex_lock(&resolver->inflight_lock);
+
+    InFlight** link = &resolver->inflight;
+    while (*link != flight) link = &(*link)->next;
+    *link = flight->next;
+
+    flight->done = true;
+    flight->out_of_time = out_of_time;
+    if (info) {
+        ytdlp_media_info_retain(info);
+        flight->info = info;
+    } else {
+        snprintf(flight->error, sizeof(flight->error), "%s", b->stream.error ? b->stream.error : "Failed to resolve URL");
+        flight->error_class = b->error_class;
+    }
+    ytdlp_cond_broadcast(&resolver->inflight_cond);
+    inflight_unref(flight);
+
+    ytdlp_mutex_unlock(&resolver->inflight_lock);
+}
+
+/* Wait for a joined extraction until `deadline` (0 = none). When done,
+ * `*info` is a new reference to its result, or NULL with the builder failed
+ * as it was. */
+static InFlightWait inflight_wait(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    InFlight* flight,
+    uint64_t deadline,
+    const YtdlpMediaInfo** info
+) {
+    *info = NULL;
+
+    ytdlp_mutex_lock(&resolver->inflight_lock);
+
+    while (!flight->done) {
+        if (!deadline) {
+            ytdlp_cond_wait(&resolver->inflight_cond, &resolver->inflight_lock);
+            continue;
+        }
+        uint64_t now = ytdlp_monotonic_ms();
+        if (now >= deadline) break;
+        ytdlp_cond_wait_ms(&resolver->inflight_cond, &resolver->inflight_lock, (uint32_t)(deadline - now));
+    }
+
+    InFlightWait outcome = !flight->done ? INFLIGHT_EXPIRED :
+                           flight->out_of_time ? INFLIGHT_ABANDONED : INFLIGHT_DONE;
+    if (outcome == INFLIGHT_DONE && flight->info) {
+        ytdlp_media_info_retain(flight->info);
+        *info = flight->info;
+    } else if (outcome == INFLIGHT_DONE) {
+        ytdlp_builder_fail(b, flight->error);
+        b->error_class = flight->error_class;
+    }
+    inflight_unref(flight);
+
+    ytdlp_mutex_unlock(&resolver->inflight_lock);
+    return outcome;
+}
+
+/* Return a reference to the media info for `url`, from the resolver's cache
+ * (unless `use_cache` is false) or a fresh extraction, which is cached.
+ * Extraction gets what is left until `deadline` (0 = none), after a slot wait
+ * that may use up to 1/YTDLP_SLOT_WAIT_SHARE of it. Fails the builder and
+ * returns NULL on error. */
+static const YtdlpMediaInfo* acquire_media_info(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const YtdlpUrl* url,
+    const PrismResolverOptions* options,
+    bool use_cache,
+    uint64_t deadline
+) {
+    const char* key = resolver->cache ? make_cache_key(b->arena, url, options) : NULL;
+
+    if (key && use_cache) {
+        const YtdlpMediaInfo* cached = ytdlp_cache_get(resolver->cache, key);
+        if (!cached) cached = shared_media_info(resolver, key);
+        YTDLP_STAT_ADD(resolver, cache_hits, cached ? 1 : 0);
+        YTDLP_STAT_ADD(resolver, cache_misses, cached ? 0 : 1);
+        if (cached) return cached;
+    }
+
+    /* Failures that would only repeat fail again without running yt-dlp */
+    if (key && remembered_failure(b, resolver, url, key)) return NULL;
+
+    /* One extraction per key at a time; the rest share its outcome */
+    InFlight* flight = NULL;
+    bool leader = false;
+    while (key && !leader) {
+        flight = inflight_begin(resolver, key, &leader);
+        if (!flight || leader) break;
+
+        const YtdlpMediaInfo* joined = NULL;
+        InFlightWait waited = inflight_wait(b, resolver, flight, deadline, &joined);
+        flight = NULL;
+        if (waited == INFLIGHT_DONE) return joined;
+        if (waited == INFLIGHT_EXPIRED) {
+            ytdlp_builder_fail(b, "Resolve timed out");
+            YTDLP_STAT_ADD(resolver, deadline_misses, 1);
+            return use_cache ? stale_media_info(b, resolver, key) : NULL;
+        }
+    }
+
+    RunContext run;
+    if (!run_context_acquire(resolver, &run)) {
+        ytdlp_builder_fail(b, "yt-dlp not available");
+        inflight_finish(resolver, flight, b, NULL, false);
+        return NULL;
+    }
+
+    uint64_t now = ytdlp_monotonic_ms();
+    uint64_t left = deadline > now ? deadline - now : 0;
+    YtdlpMediaInfo* info = NULL;
+    bool out_of_time = false;
 
-        /* Title */
-        char* line = strtok_r(lines, "\r\n", &saveptr);
-        if (line) {
-            stream->title = str_dup(str_trim(line));
+    if (!budget_enter(resolver, deadline ? now + left / YTDLP_SLOT_WAIT_SHARE : 0)) {
+        run_context_release(&run);
+        ytdlp_builder_fail(b, "Timed out waiting for a yt-dlp slot");
+        out_of_time = true;
+    } else {
+        int budget_ms = run.timeout_ms;
+        bool deadline_bound = false;
+        if (deadline) {
+            now = ytdlp_monotonic_ms();
+            left = deadline > now ? deadline - now : 0;
+            if (left <= (uint64_t)budget_ms) {
+                budget_ms = (int)left;
+                deadline_bound = true;
+            }
         }
 
-        /* Width */
-        line = strtok_r(NULL, "\r\n", &saveptr);
-        if (line) {
-            stream->width = atoi(str_trim(line));
+        if (budget_ms > 0) {
+            info = extract_media_info(b, resolver, &run, url, options, budget_ms);
+            out_of_time = !info && deadline_bound && ytdlp_monotonic_ms() >= deadline;
+        } else {
+            ytdlp_builder_fail(b, "Resolve timed out");
+            out_of_time = true;
         }
+        run_end(resolver, &run);
+    }
 
-        /* Height */
-        line = strtok_r(NULL, "\r\n", &saveptr);
-        if (line) {
-            stream->height = atoi(str_trim(line));
+    /* Cached before waiters are released, so a miss arriving then hits */
+    if (!out_of_time && !info && key) {
+        remember_failure(b, resolver, url, key);
+    } else if (!out_of_time && info && key) {
+        int ttl_ms = media_info_ttl_ms(info);
+        if (ttl_ms >= 0) {
+            ytdlp_cache_put(resolver->cache, key, info, ttl_ms);
+            ytdlp_shared_cache_put(resolver->shared, key, info, ttl_ms);
         }
     }
-    free_process_result(&info_result);
+    inflight_finish(resolver, flight, b, info, out_of_time);
+
+    if (out_of_time) {
+        YTDLP_STAT_ADD(resolver, deadline_misses, 1);
+        return use_cache ? stale_media_info(b, resolver, key) : NULL;
+    }
+    return info;
+}
+
+static bool codec_is_none(const char* codec) {
+    return codec && strcmp(codec, "none") == 0;
+}
+
+static void resolve_from_info(
+    YtdlpStreamBuilder* b,
+    const YtdlpMediaInfo* info,
+    const PrismResolverOptions* options
+) {
+    PrismResolvedStream* stream = &b->stream;
+
+    PrismStreamQuality quality = options ? options->quality : PRISM_QUALITY_AUTO;
+    stream->requested_quality = quality;
+    stream->is_live = info->list.is_live;
+
+    char selector[256];
+    ytdlp_format_chain(selector, sizeof(selector), info->list.is_live, ytdlp_quality_height(quality));
+
+    YtdlpFormatSelection selection;
+    if (!ytdlp_format_select(&info->list, selector, &selection)) {
+        ytdlp_builder_fail(b, "Requested format is not available");
+        return;
+    }
+
+    const PrismYtdlpFormat* video = selection.video;
+    const PrismYtdlpFormat* audio = selection.audio;
+
+    /* Split selections (DASH) carry the audio track as a second URL */
+    ytdlp_builder_set(b, &stream->direct_url, video->url);
+    if (audio) {
+        ytdlp_builder_set(b, &stream->audio_url, audio->url);
+    }
+
+    if (!stream->direct_url || (audio && !stream->audio_url)) {
+        ytdlp_builder_fail(b, "Out of memory");
+        return;
+    }
+
+    const PrismYtdlpFormat* audio_track = audio ? audio : video;
+    stream->has_video = !codec_is_none(video->video_codec);
+    stream->has_audio = !codec_is_none(audio_track->audio_codec);
+    if (stream->has_video) {
+        ytdlp_builder_set(b, &stream->video_codec, video->video_codec);
+    }
+    if (stream->has_audio) {
+        ytdlp_builder_set(b, &stream->audio_codec, audio_track->audio_codec);
+    }
+
+    /* Headers and cookies the CDN expects on the first media request */
+    const PrismYtdlpFormat* request = (video->header_count > 0 || !audio) ? video : audio;
+    ytdlp_builder_set_headers(b, request->header_names, request->header_values, request->header_count);
+    ytdlp_builder_set(b, &stream->cookies, video->cookies ? video->cookies : audio_track->cookies);
+
+    /* Check if HLS */
+    stream->is_hls = (video->protocol && strncmp(video->protocol, "m3u8", 4) == 0) ||
+                     str_contains(stream->direct_url, "m3u8");
+
+    ytdlp_builder_set(b, &stream->title, info->list.title);
+    ytdlp_builder_set(b, &stream->channel, info->channel);
+    ytdlp_builder_set(b, &stream->thumbnail_url, info->thumbnail_url);
+    stream->duration = info->list.duration;
+    stream->width = video->width;
+    stream->height = video->height;
 
-    free(sanitized_url);
     stream->success = true;
-    stream->has_video = true;
+}
+
+/* Fill a stream for a URL that already is media; false if it is not */
+static bool resolve_direct_media(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const YtdlpUrl* url,
+    const PrismResolverOptions* options
+) {
+    DirectMediaKind kind = classify_direct_media(url);
+    if (kind == DIRECT_MEDIA_NONE) return false;
+
+    PrismResolvedStream* stream = &b->stream;
+    stream->requested_quality = options ? options->quality : PRISM_QUALITY_AUTO;
+
+    ytdlp_builder_set(b, &stream->direct_url, url->text);
+    if (!stream->direct_url) {
+        ytdlp_builder_fail(b, "Out of memory");
+        return true;
+    }
+
+    stream->is_hls = kind == DIRECT_MEDIA_HLS;
+    stream->has_video = kind != DIRECT_MEDIA_AUDIO;
     stream->has_audio = true;
+    stream->success = true;
 
-    return stream;
+    YTDLP_STAT_ADD(resolver, direct_resolves, 1);
+    return true;
 }
 
-static void ytdlp_destroy(PrismResolver* resolver) {
-    if (resolver) {
-        free(resolver);
+/* ============================================================================
+ * Resolve Daemon
+ *
+ * With daemon endpoints configured, resolvers on the global settings send
+ * resolves and probes to prism_ytdlp_resolved, which keeps one cache, one
+ * worker pool and one set of rate limits for every process it serves.
+ * Requests are routed by the URL's canonical key, so all qualities of a
+ * media land on the same daemon's cache. When no daemon can be reached, or
+ * the one that took the request does not answer in time, the resolve runs
+ * in process.
+ * ========================================================================== */
+
+/* Fill the builder from a daemon; false if the caller should resolve in
+ * process instead */
+static bool daemon_into(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    YtdlpDaemonOp op,
+    const YtdlpUrl* url,
+    const PrismResolverOptions* options,
+    uint64_t deadline
+) {
+    /* Resolvers with their own settings would not get them applied */
+    if (resolver->owns_config) return false;
+
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    if (!config->daemon_endpoints[0]) {
+        ytdlp_config_release(config);
+        return false;
+    }
+
+    uint64_t now = ytdlp_monotonic_ms();
+    int timeout_ms = deadline ? (deadline > now ? (int)(deadline - now) : 0) :
+                     config->process_timeout_ms + YTDLP_DAEMON_MARGIN_MS;
+
+    size_t key_size = ytdlp_url_key(url, NULL, 0) + 1;
+    char* key = (char*)ytdlp_arena_alloc(b->arena, key_size);
+
+    YtdlpDaemonRequest request = { op, url->text, options != NULL, { PRISM_QUALITY_AUTO, NULL, 0, false } };
+    if (options) request.options = *options;
+
+    YtdlpDaemonResult result = YTDLP_DAEMON_UNREACHABLE;
+    if (key) {
+        ytdlp_url_key(url, key, key_size);
+        result = ytdlp_daemon_call(config->daemon_endpoints, key, &request, timeout_ms, b);
     }
+    ytdlp_config_release(config);
+
+    YTDLP_STAT_ADD(resolver, daemon_resolves, result == YTDLP_DAEMON_ANSWERED ? 1 : 0);
+    YTDLP_STAT_ADD(resolver, daemon_fallbacks, result == YTDLP_DAEMON_UNREACHABLE ? 1 : 0);
+    YTDLP_STAT_ADD(resolver, daemon_timeouts, result == YTDLP_DAEMON_TIMED_OUT ? 1 : 0);
+    return result == YTDLP_DAEMON_ANSWERED;
+}
+
+static void resolve_into(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    uint64_t deadline = request_deadline(options);
+
+    YtdlpUrl parsed;
+    if (!ytdlp_url_parse(url, &parsed)) {
+        ytdlp_builder_fail(b, "Invalid URL");
+        return;
+    }
+    if (resolve_direct_media(b, resolver, &parsed, options)) return;
+    if (daemon_into(b, resolver, YTDLP_DAEMON_RESOLVE, &parsed, options, deadline)) return;
+
+    const YtdlpMediaInfo* info = acquire_media_info(b, resolver, &parsed, options, true, deadline);
+    if (!info) return;
+
+    resolve_from_info(b, info, options);
+    ytdlp_media_info_release(info);
+}
+
+/* Cached URLs may outlive the refresh margin, so refreshes always extract */
+static void refresh_into(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    uint64_t deadline = request_deadline(options);
+
+    YtdlpUrl parsed;
+    if (!ytdlp_url_parse(url, &parsed)) {
+        ytdlp_builder_fail(b, "Invalid URL");
+        return;
+    }
+    if (daemon_into(b, resolver, YTDLP_DAEMON_REFRESH, &parsed, options, deadline)) return;
+
+    const YtdlpMediaInfo* info = acquire_media_info(b, resolver, &parsed, options, false, deadline);
+    if (!info) return;
+
+    resolve_from_info(b, info, options);
+    ytdlp_media_info_release(info);
+}
+
+static PrismResolvedStream* ytdlp_resolve(
+    PrismResolver* base,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+
+    uint64_t allocs_before = ytdlp_thread_alloc_count();
+    PrismResolvedStream* stream = build_stream(resolve_into, resolver, url, options);
+    uint64_t allocs = ytdlp_thread_alloc_count() - allocs_before;
+
+    YTDLP_STAT_ADD(resolver, resolves, 1);
+    YTDLP_STAT_ADD(resolver, resolve_allocations, allocs);
+    YTDLP_STAT_SET(resolver, last_resolve_allocations, allocs);
+
+    return stream;
+}
+
+static PrismResolvedStream* ytdlp_refresh(
+    void* context,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    YtdlpResolver* resolver = (YtdlpResolver*)context;
+
+    PrismResolvedStream* stream = build_stream(refresh_into, resolver, url, options);
+
+    YTDLP_STAT_ADD(resolver, resolves, 1);
+    YTDLP_STAT_ADD(resolver, refreshes, 1);
+
+    return stream;
+}
+
+static void ytdlp_destroy(PrismResolver* base) {
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+    if (!resolver) return;
+
+    /* First, so no refresh is running against the rest */
+    ytdlp_refresher_destroy(resolver->refresher);
+    ytdlp_cache_destroy(resolver->cache);
+    ytdlp_shared_cache_close(resolver->shared);
+    if (resolver->owns_config) {
+        ytdlp_config_slot_destroy(&resolver->config_slot);
+    }
+    ytdlp_free(resolver->hosts);
+    ytdlp_cond_destroy(&resolver->inflight_cond);
+    ytdlp_mutex_destroy(&resolver->inflight_lock);
+    ytdlp_mutex_destroy(&resolver->hedge_lock);
+    ytdlp_cond_destroy(&resolver->budget_cond);
+    ytdlp_mutex_destroy(&resolver->budget_lock);
+    ytdlp_free(resolver);
+}
+
+/* Forwards download progress to a resolver progress callback */
+typedef struct ProgressRelay {
+    PrismResolverProgressCallback progress;
+    void* user_data;
+    const char* status;
+} ProgressRelay;
+
+static void relay_progress(float progress, void* user_data) {
+    ProgressRelay* relay = (ProgressRelay*)user_data;
+    if (progress < 1.0f) relay->progress(relay->user_data, progress, relay->status);
 }
 
 static PrismError ytdlp_ensure_available(
@@ -1086,7 +2451,9 @@ static PrismError ytdlp_ensure_available(
 
     if (progress) progress(user_data, 0.0f, "Downloading yt-dlp...");
 
-    PrismError err = prism_ytdlp_download(NULL, NULL, NULL);
+    /* Joins a download already started by another caller */
+    ProgressRelay relay = { progress, user_data, "Downloading yt-dlp..." };
+    PrismError err = prism_ytdlp_download(NULL, progress ? relay_progress : NULL, &relay);
 
     if (err == PRISM_OK) {
         if (progress) progress(user_data, 1.0f, "yt-dlp downloaded");
@@ -1095,106 +2462,232 @@ static PrismError ytdlp_ensure_available(
     return err;
 }
 
-static PrismError ytdlp_update_tool(
-    PrismResolver* resolver,
-    PrismResolverProgressCallback progress,
+/* ============================================================================
+ * Background Updates
+ *
+ * An update installs the latest release next to the running one and then
+ * publishes it, so it never blocks or fails a resolve. Resolves that already
+ * hold a snapshot keep launching the previous version, which stays on disk
+ * while any of them is still running from it.
+ * ========================================================================== */
+
+typedef struct UpdateJob {
+    char ytdlp_path[YTDLP_PATH_MAX];   /* Binary in use when the update started */
+    char install_dir[YTDLP_PATH_MAX];  /* Managed install that receives it */
+} UpdateJob;
+
+static YtdlpMutex s_update_lock = YTDLP_MUTEX_INIT;
+static YtdlpThread s_update_thread;
+static bool s_update_started = false;  /* s_update_thread needs joining */
+static bool s_update_running = false;
+static UpdateJob s_update_job;
+
+static bool install_update(
+    const char* install_dir,
+    void* context,
+    YtdlpDownloadProgress progress,
     void* user_data
 ) {
-    (void)resolver;
+    const char* version = (const char*)context;
 
-    if (!prism_ytdlp_is_available()) {
-        return ytdlp_ensure_available(resolver, progress, user_data);
+    char path[YTDLP_PATH_MAX];
+    if (!ytdlp_versions_install(install_dir, version, get_platform_binary_name(), path, sizeof(path),
+                                progress, user_data)) {
+        return false;
     }
 
-    if (progress) progress(user_data, 0.0f, "Updating yt-dlp...");
+    publish_ytdlp_path(ytdlp_config_global(), path);
+    return true;
+}
 
-    /* Run yt-dlp -U to self-update */
-    ProcessResult result = run_process(g_config.ytdlp_path, "-U", g_config.process_timeout_ms);
+static void update_thread(void* arg) {
+    UpdateJob* job = (UpdateJob*)arg;
 
-    PrismError err = (result.exit_code == 0) ? PRISM_OK : PRISM_ERROR_NETWORK;
-    free_process_result(&result);
+    /* Nothing to fetch when the latest release is already in use; a mirror
+     * that cannot name it gets a fresh install of whatever it serves */
+    char latest[64] = "", running[64];
+    bool current = ytdlp_release_latest(latest, sizeof(latest)) &&
+                   ytdlp_tool_version(job->ytdlp_path, running, sizeof(running)) &&
+                   strcmp(latest, running) == 0;
 
-    if (progress) progress(user_data, 1.0f, err == PRISM_OK ? "Updated" : "Update failed");
+    if (!current) {
+        ensure_directory_exists(job->install_dir);
+        char* version = latest[0] ? latest : NULL;
+        ytdlp_install_once(job->install_dir, install_update, adopt_download, version, NULL, NULL);
+    }
 
-    return err;
+    ytdlp_mutex_lock(&s_update_lock);
+    s_update_running = false;
+    ytdlp_mutex_unlock(&s_update_lock);
 }
 
-static PrismResolvedStream* ytdlp_probe(PrismResolver* resolver, const char* url) {
-    (void)resolver;
+/* Start an update of `ytdlp_path`; false if one is already running */
+static bool start_update(const char* ytdlp_path, const char* install_dir) {
+    ytdlp_mutex_lock(&s_update_lock);
 
-    PrismResolvedStream* stream = (PrismResolvedStream*)calloc(1, sizeof(PrismResolvedStream));
-    if (!stream) return NULL;
+    bool started = false;
+    if (!s_update_running) {
+        /* The previous update has finished; reap it before starting the next */
+        if (s_update_started) {
+            ytdlp_thread_join(s_update_thread);
+            s_update_started = false;
+        }
 
-    if (!url) {
-        stream->success = false;
-        stream->error = str_dup("URL is NULL");
-        return stream;
+        snprintf(s_update_job.ytdlp_path, sizeof(s_update_job.ytdlp_path), "%s", ytdlp_path);
+        snprintf(s_update_job.install_dir, sizeof(s_update_job.install_dir), "%s", install_dir);
+        s_update_running = ytdlp_thread_start(&s_update_thread, update_thread, &s_update_job);
+        s_update_started = s_update_running;
+        started = s_update_running;
     }
 
-    stream->original_url = str_dup(url);
+    ytdlp_mutex_unlock(&s_update_lock);
+    return started;
+}
+
+void ytdlp_update_shutdown(void) {
+    ytdlp_mutex_lock(&s_update_lock);
+    bool started = s_update_started;
+    s_update_started = false;
+    ytdlp_mutex_unlock(&s_update_lock);
 
-    if (!ensure_ytdlp_available()) {
-        stream->success = false;
-        stream->error = str_dup("yt-dlp not available");
-        return stream;
+    if (started) {
+        /* Abandon the download; the partial file resumes next time */
+        ytdlp_download_set_cancelled(true);
+        ytdlp_thread_join(s_update_thread);
+        ytdlp_download_set_cancelled(false);
     }
+}
 
-    /* Get basic info without resolving URL */
-    char args[1024];
-    snprintf(args, sizeof(args),
-        "--no-warnings --no-check-certificate --print title --print is_live --print duration \"%s\"",
-        url);
-
-    ProcessResult result = run_process(g_config.ytdlp_path, args, g_config.process_timeout_ms);
+static PrismError ytdlp_update_tool(
+    PrismResolver* resolver,
+    PrismResolverProgressCallback progress,
+    void* user_data
+) {
+    (void)resolver;
 
-    if (result.exit_code != 0) {
-        stream->success = false;
-        stream->error = str_dup(result.error ? result.error : "Probe failed");
-        free_process_result(&result);
-        return stream;
+    if (!prism_ytdlp_is_available()) {
+        return ytdlp_ensure_available(resolver, progress, user_data);
     }
 
-    if (result.output) {
-        char* lines = result.output;
-        char* saveptr = NULL;
+    char install_dir[YTDLP_PATH_MAX];
+    managed_install_dir(NULL, install_dir, sizeof(install_dir));
 
-        /* Title */
-        char* line = strtok_r(lines, "\r\n", &saveptr);
-        if (line) {
-            stream->title = str_dup(str_trim(line));
-        }
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    bool started = start_update(config->ytdlp_path, install_dir);
+    ytdlp_config_release(config);
 
-        /* is_live */
-        line = strtok_r(NULL, "\r\n", &saveptr);
-        if (line) {
-            char* trimmed = str_trim(line);
-            str_to_lower(trimmed);
-            stream->is_live = strcmp(trimmed, "true") == 0;
-        }
+    if (progress) {
+        progress(user_data, 1.0f, started ? "Updating yt-dlp in the background" : "Update already in progress");
+    }
+    return PRISM_OK;
+}
 
-        /* Duration */
-        line = strtok_r(NULL, "\r\n", &saveptr);
-        if (line) {
-            stream->duration = atof(str_trim(line));
-        }
+static void probe_into(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    PrismResolvedStream* stream = &b->stream;
+
+    YtdlpUrl parsed;
+    if (!ytdlp_url_parse(url, &parsed)) {
+        ytdlp_builder_fail(b, "Invalid URL");
+        return;
     }
+    if (resolve_direct_media(b, resolver, &parsed, options)) return;
+    if (daemon_into(b, resolver, YTDLP_DAEMON_PROBE, &parsed, NULL, 0)) return;
 
-    free_process_result(&result);
+    /* One extraction through whichever backend is active, shared with
+     * resolves of the same media through the cache */
+    const YtdlpMediaInfo* info = acquire_media_info(b, resolver, &parsed, NULL, true, 0);
+    if (!info) return;
+
+    ytdlp_builder_set(b, &stream->title, info->list.title);
+    stream->is_live = info->list.is_live;
+    stream->duration = info->list.duration;
+    ytdlp_media_info_release(info);
 
     stream->success = true;
-    return stream;
 }
 
-static const char* ytdlp_get_tool_version(PrismResolver* resolver) {
+static PrismResolvedStream* ytdlp_probe(PrismResolver* resolver, const char* url) {
+    return build_stream(probe_into, (YtdlpResolver*)resolver, url, NULL);
+}
+
+/*
+ * Whether a URL from a daemon peer stays one quoted argument on a yt-dlp
+ * command line: no whitespace, quotes, backslashes or control characters,
+ * and no leading dash that would read as an option.
+ */
+static bool is_safe_request_url(const char* url) {
+    if (!url || !url[0] || url[0] == '-') return false;
+    for (const unsigned char* p = (const unsigned char*)url; *p; p++) {
+        if (*p <= ' ' || *p == 0x7f || *p == '"' || *p == '\'' || *p == '\\') return false;
+    }
+    return true;
+}
+
+/* A language tag such as "en" or "pt-BR" */
+static bool is_safe_request_language(const char* language) {
+    if (!language) return true;
+    size_t len = strlen(language);
+    if (len == 0 || len > 16) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)language[i]) && language[i] != '-' && language[i] != '_') return false;
+    }
+    return true;
+}
+
+static void invalid_request_into(
+    YtdlpStreamBuilder* b,
+    YtdlpResolver* resolver,
+    const char* url,
+    const PrismResolverOptions* options
+) {
     (void)resolver;
+    (void)url;
+    (void)options;
+    ytdlp_builder_fail(b, "Invalid URL or audio language");
+}
 
-    static char version[64] = {0};
+PrismResolvedStream* ytdlp_resolver_serve(PrismResolver* resolver, const YtdlpDaemonRequest* request) {
+    const PrismResolverOptions* options = request->has_options ? &request->options : NULL;
 
-    if (!prism_ytdlp_is_available()) {
+    /* Peers are untrusted; nothing they send may add yt-dlp options */
+    if (!is_safe_request_url(request->url) ||
+        (options && !is_safe_request_language(options->preferred_audio_language))) {
+        return build_stream(invalid_request_into, (YtdlpResolver*)resolver, request->url, NULL);
+    }
+
+    switch (request->op) {
+        case YTDLP_DAEMON_RESOLVE: return ytdlp_resolve(resolver, request->url, options);
+        case YTDLP_DAEMON_REFRESH: return ytdlp_refresh(resolver, request->url, options);
+        case YTDLP_DAEMON_PROBE: return ytdlp_probe(resolver, request->url);
+        default: return NULL;
+    }
+}
+
+static const char* ytdlp_get_tool_version(PrismResolver* resolver) {
+    static YTDLP_THREAD_LOCAL char version[64];
+    version[0] = '\0';
+
+    RunContext run;
+    if (!run_context_acquire((YtdlpResolver*)resolver, &run)) {
         return NULL;
     }
 
-    ProcessResult result = run_process(g_config.ytdlp_path, "--version", 5000);
+    /* The version that extracts: the imported module's for the Python
+     * backends, which may run without any binary */
+    if (run.backend != PRISM_YTDLP_BACKEND_PROCESS) {
+        if (run.backend == PRISM_YTDLP_BACKEND_PYTHON) ytdlp_python_version(version, sizeof(version));
+        else ytdlp_zygote_version(version, sizeof(version));
+        run_context_release(&run);
+        return version[0] ? version : NULL;
+    }
+
+    YtdlpProcessResult result = ytdlp_run_process(run.ytdlp_path, "--version", 5000);
+    run_context_release(&run);
 
     if (result.exit_code == 0 && result.output) {
         char* trimmed = str_trim(result.output);
@@ -1202,25 +2695,32 @@ static const char* ytdlp_get_tool_version(PrismResolver* resolver) {
         version[sizeof(version) - 1] = '\0';
     }
 
-    free_process_result(&result);
-
     return version[0] ? version : NULL;
 }
 
-static void ytdlp_set_tool_path(PrismResolver* resolver, const char* path) {
-    (void)resolver;
+static void ytdlp_set_tool_path(PrismResolver* base, const char* path) {
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
 
-    if (path) {
-        strncpy(g_config.ytdlp_path, path, sizeof(g_config.ytdlp_path) - 1);
-        g_config.ytdlp_path[sizeof(g_config.ytdlp_path) - 1] = '\0';
-    } else {
-        g_config.ytdlp_path[0] = '\0';
-    }
+    publish_ytdlp_path(resolver->owns_config ? &resolver->config_slot : ytdlp_config_global(), path);
 }
 
-static bool ytdlp_is_available(PrismResolver* resolver) {
-    (void)resolver;
-    return prism_ytdlp_is_available() || g_config.auto_download;
+static bool ytdlp_is_available(PrismResolver* base) {
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+
+    if (resolver->owns_config) {
+        const YtdlpConfig* instance = ytdlp_config_slot_acquire(&resolver->config_slot);
+        bool has_own_binary = instance->ytdlp_path[0] && file_exists(instance->ytdlp_path);
+        ytdlp_config_release(instance);
+        if (has_own_binary) return true;
+    }
+
+    if (prism_ytdlp_is_available()) return true;
+
+    const YtdlpConfig* config = ytdlp_config_acquire();
+    bool auto_download = config->auto_download;
+    ytdlp_config_release(config);
+
+    return auto_download;
 }
 
 /* ============================================================================
@@ -1241,17 +2741,159 @@ static const PrismResolverVTable s_ytdlp_vtable = {
     .set_tool_path = ytdlp_set_tool_path
 };
 
-static PrismResolver* ytdlp_factory_create(void) {
-    YtdlpResolver* resolver = (YtdlpResolver*)calloc(1, sizeof(YtdlpResolver));
+PRISM_YTDLP_API PrismResolver* prism_ytdlp_create_resolver(const PrismYtdlpResolverConfig* config) {
+    YtdlpResolver* resolver = (YtdlpResolver*)ytdlp_calloc(1, sizeof(YtdlpResolver));
     if (!resolver) return NULL;
 
     resolver->base.vtable = &s_ytdlp_vtable;
     resolver->base.identifier = PRISM_YTDLP_PLUGIN_ID;
-    resolver->is_available = prism_ytdlp_is_available();
+    ytdlp_mutex_init(&resolver->budget_lock);
+    ytdlp_cond_init(&resolver->budget_cond);
+    ytdlp_mutex_init(&resolver->hedge_lock);
+    ytdlp_mutex_init(&resolver->inflight_lock);
+    ytdlp_cond_init(&resolver->inflight_cond);
+
+    if (config && ((config->ytdlp_path && config->ytdlp_path[0]) || config->process_timeout_ms > 0)) {
+        YtdlpConfig initial;
+        memset(&initial, 0, sizeof(initial));
+        if (config->ytdlp_path) {
+            strncpy(initial.ytdlp_path, config->ytdlp_path, sizeof(initial.ytdlp_path) - 1);
+        }
+        initial.process_timeout_ms = config->process_timeout_ms > 0 ? config->process_timeout_ms : 0;
+
+        if (!ytdlp_config_slot_init(&resolver->config_slot, &initial)) {
+            ytdlp_destroy(&resolver->base);
+            return NULL;
+        }
+        resolver->owns_config = true;
+    }
+
+    resolver->max_concurrent = config ? config->max_concurrent_resolves : 0;
+
+    int cache_capacity = config ? config->cache_capacity : 0;
+    int cache_ttl_ms = (config && config->cache_ttl_ms > 0) ? config->cache_ttl_ms : YTDLP_CACHE_TTL_MS;
+    if (cache_capacity == 0) cache_capacity = YTDLP_CACHE_CAPACITY;
+    if (cache_capacity > 0) {
+        resolver->cache = ytdlp_cache_create(cache_capacity, cache_ttl_ms);
+    }
+
+    /* The shared cache sits behind the resolver's own; without one, no
+     * lookups would reach it */
+    const YtdlpConfig* global = ytdlp_config_acquire();
+    const char* shared_name = (config && config->shared_cache_name) ? config->shared_cache_name : global->shared_cache_name;
+    if (resolver->cache && shared_name[0]) {
+        size_t shared_bytes = (size_t)global->shared_cache_mb * 1024u * 1024u;
+        resolver->shared = ytdlp_shared_cache_open(shared_name, shared_bytes, cache_ttl_ms);
+        YTDLP_STAT_ADD(resolver, shared_cache_errors, resolver->shared ? 0 : 1);
+    }
+    ytdlp_config_release(global);
+
+    if (config && config->hedge_percentile > 0) {
+        resolver->hedge_percentile = config->hedge_percentile < 100 ? config->hedge_percentile : 99;
+        resolver->hedge_max_percent = config->hedge_max_percent > 0 ? config->hedge_max_percent : YTDLP_HEDGE_MAX_PERCENT;
+        resolver->hosts = (HostLatency*)ytdlp_calloc(YTDLP_HEDGE_HOSTS, sizeof(HostLatency));
+        if (!resolver->hosts) {
+            ytdlp_destroy(&resolver->base);
+            return NULL;
+        }
+    }
+
+    int refresh_margin_ms = (config && config->refresh_margin_ms > 0) ? config->refresh_margin_ms : YTDLP_REFRESH_MARGIN_MS;
+    resolver->refresher = ytdlp_refresher_create(ytdlp_refresh, resolver, refresh_margin_ms);
+    if (!resolver->refresher) {
+        ytdlp_destroy(&resolver->base);
+        return NULL;
+    }
+
+    resolver->is_available = ytdlp_is_available(&resolver->base);
 
     return &resolver->base;
 }
 
+PRISM_YTDLP_API void prism_ytdlp_get_resolver_stats(PrismResolver* base, PrismYtdlpStats* stats) {
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!base || base->vtable != &s_ytdlp_vtable) return;
+
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+    stats->resolves = ytdlp_atomic_load_u64(&resolver->stats.resolves);
+    stats->resolve_allocations = ytdlp_atomic_load_u64(&resolver->stats.resolve_allocations);
+    stats->last_resolve_allocations = ytdlp_atomic_load_u64(&resolver->stats.last_resolve_allocations);
+    stats->heap_allocations = ytdlp_atomic_load_u64(&g_ytdlp_stats.heap_allocations);
+    stats->cache_hits = ytdlp_atomic_load_u64(&resolver->stats.cache_hits);
+    stats->cache_misses = ytdlp_atomic_load_u64(&resolver->stats.cache_misses);
+    stats->concurrency_waits = ytdlp_atomic_load_u64(&resolver->stats.concurrency_waits);
+    stats->refreshes = ytdlp_atomic_load_u64(&resolver->stats.refreshes);
+    stats->direct_resolves = ytdlp_atomic_load_u64(&resolver->stats.direct_resolves);
+    stats->deadline_misses = ytdlp_atomic_load_u64(&resolver->stats.deadline_misses);
+    stats->stale_results = ytdlp_atomic_load_u64(&resolver->stats.stale_results);
+    stats->negative_hits = ytdlp_atomic_load_u64(&resolver->stats.negative_hits);
+    stats->hedges = ytdlp_atomic_load_u64(&resolver->stats.hedges);
+    stats->hedge_wins = ytdlp_atomic_load_u64(&resolver->stats.hedge_wins);
+    stats->shared_hits = ytdlp_atomic_load_u64(&resolver->stats.shared_hits);
+    stats->shared_cache_errors = ytdlp_atomic_load_u64(&resolver->stats.shared_cache_errors);
+    stats->daemon_resolves = ytdlp_atomic_load_u64(&resolver->stats.daemon_resolves);
+    stats->daemon_fallbacks = ytdlp_atomic_load_u64(&resolver->stats.daemon_fallbacks);
+    stats->daemon_timeouts = ytdlp_atomic_load_u64(&resolver->stats.daemon_timeouts);
+}
+
+PRISM_YTDLP_API PrismYtdlpFormatList* prism_ytdlp_get_formats(
+    PrismResolver* base,
+    const char* url,
+    const PrismResolverOptions* options
+) {
+    if (!base || base->vtable != &s_ytdlp_vtable || !url) return NULL;
+
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) return NULL;
+
+    YtdlpArenaMark mark = ytdlp_arena_mark(&scratch->arena);
+
+    /* The builder only collects a failure message, which is discarded */
+    YtdlpStreamBuilder builder;
+    ytdlp_builder_init(&builder, &scratch->arena);
+
+    PrismYtdlpFormatList* list = NULL;
+    YtdlpUrl parsed;
+    const YtdlpMediaInfo* info = NULL;
+    if (ytdlp_url_parse(url, &parsed)) {
+        info = acquire_media_info(&builder, (YtdlpResolver*)base, &parsed, options, true,
+                                  request_deadline(options));
+    }
+    if (info) {
+        list = ytdlp_media_info_copy_list(info);
+        ytdlp_media_info_release(info);
+    }
+
+    ytdlp_arena_release(&scratch->arena, mark);
+    return list;
+}
+
+PRISM_YTDLP_API uint64_t prism_ytdlp_watch_stream(
+    PrismResolver* base,
+    const PrismResolvedStream* stream,
+    const PrismResolverOptions* options,
+    PrismYtdlpRefreshCallback callback,
+    void* user_data
+) {
+    if (!base || base->vtable != &s_ytdlp_vtable) return 0;
+
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+    return ytdlp_refresher_watch(resolver->refresher, stream, options, callback, user_data);
+}
+
+PRISM_YTDLP_API void prism_ytdlp_unwatch_stream(PrismResolver* base, uint64_t watch_id) {
+    if (!base || base->vtable != &s_ytdlp_vtable) return;
+
+    YtdlpResolver* resolver = (YtdlpResolver*)base;
+    ytdlp_refresher_unwatch(resolver->refresher, watch_id);
+}
+
+static PrismResolver* ytdlp_factory_create(void) {
+    return prism_ytdlp_create_resolver(NULL);
+}
+
 static const PrismResolverInfo* ytdlp_factory_get_info(void) {
     static const PrismResolverInfo info = {
         .name = "yt-dlp",
@@ -1268,20 +2910,8 @@ static const PrismResolverInfo* ytdlp_factory_get_info(void) {
 }
 
 static bool ytdlp_factory_can_handle(const char* url) {
-    if (!url || !url[0]) return false;
-
-    char host[256];
-    if (!extract_host(url, host, sizeof(host))) {
-        return false;
-    }
-
-    for (int i = 0; s_known_hosts[i]; i++) {
-        if (str_contains(host, s_known_hosts[i]) || str_contains(s_known_hosts[i], host)) {
-            return true;
-        }
-    }
-
-    return false;
+    YtdlpUrl parsed;
+    return ytdlp_url_parse(url, &parsed) && is_known_host(&parsed);
 }
 
 const PrismResolverFactory g_ytdlp_resolver_factory = {
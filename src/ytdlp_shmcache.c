@@ -0,0 +1,516 @@
+/*
+ * Prism yt-dlp Plugin - Shared Resolve Cache
+ *
+ * An optional second cache level in a named shared memory segment, so every
+ * process on the machine that maps the same name can answer from an
+ * extraction another one already paid for.
+ *
+ * The segment is an open-addressed table of fixed-size slots. Each slot is
+ * guarded by a sequence count: writers make it odd for the duration of a
+ * write, and readers copy an entry out and retry if the count moved while
+ * they did. Readers take no lock and never block a writer. Writers claim a
+ * slot with a compare-and-swap and skip the write when another process holds
+ * it. A writer that died mid-write leaves its slot odd; after a second the
+ * next writer takes the slot over, and the entry checksum catches the case
+ * where the first writer was only slow.
+ *
+ * Media info is stored flattened (pointers as offsets), since each process
+ * maps the segment at its own address. Expiry times use the monotonic clock,
+ * which is machine-wide.
+ *
+ * The segment name carries the layout of the build, so builds that lay
+ * entries out differently use separate segments. On POSIX a segment outlives
+ * its processes; one whose creator died before laying it out is unlinked and
+ * created afresh by the next process that finds it.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_SHARED_MAGIC 0x43545950u                /* "PYTC" */
+#define YTDLP_SHARED_VERSION 1
+#define YTDLP_SHARED_SLOT_SIZE (128 * 1024)           /* Entries larger than a slot are not shared */
+#define YTDLP_SHARED_MIN_SLOTS 16
+#define YTDLP_SHARED_PROBES 8                         /* Slots an entry may be stored in */
+#define YTDLP_SHARED_READ_RETRIES 3
+#define YTDLP_SHARED_STALE_WRITE_MS 1000              /* A slot locked this long has lost its writer */
+#define YTDLP_SHARED_READY_WAIT_MS 1000               /* Wait for another process to lay a segment out */
+
+enum {
+    SLOT_MEDIA_INFO = 1,
+    SLOT_FAILURE = 2
+};
+
+typedef struct SharedHeader {
+    uint32_t magic;
+    uint32_t layout;      /* Version and struct sizes of the build that laid it out */
+    uint32_t slot_count;
+    uint32_t slot_size;
+    volatile int32_t ready;
+    uint32_t reserved[11];
+} SharedHeader;
+
+typedef struct SharedSlot {
+    volatile int32_t seq;         /* Odd while a writer holds the slot */
+    uint32_t hash;                /* Of the key (never 0); 0 = never written */
+    volatile uint64_t locked_at;  /* When the current writer took the slot */
+    uint64_t expires_at;          /* ytdlp_monotonic_ms() */
+    uint32_t kind;
+    uint32_t key_len;
+    uint32_t value_len;
+    uint32_t checksum;            /* Of the key and value */
+    /* Key, then the value at the next 8-byte boundary */
+} SharedSlot;
+
+struct YtdlpSharedCache {
+    char* base;
+    size_t size;
+    SharedHeader* header;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    int ttl_ms;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+#define ALIGN8(n) (((n) + 7u) & ~(size_t)7u)
+
+/* Processes built with different layouts must not read each other's entries */
+static uint32_t layout_tag(void) {
+    return (uint32_t)YTDLP_SHARED_VERSION << 24 ^
+           (uint32_t)sizeof(YtdlpMediaInfo) << 12 ^
+           (uint32_t)sizeof(PrismYtdlpFormat) ^
+           (uint32_t)sizeof(void*) << 28;
+}
+
+/* FNV-1a, never 0 */
+static uint32_t hash_key(const char* key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+/* FNV-1a over 8-byte words, then the tail */
+static uint32_t checksum(const char* data, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h ^= word;
+        h *= 1099511628211ull;
+    }
+    for (; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static SharedSlot* slot_at(YtdlpSharedCache* cache, uint32_t index) {
+    return (SharedSlot*)(cache->base + sizeof(SharedHeader) + (size_t)index * cache->slot_size);
+}
+
+static char* slot_data(SharedSlot* slot) {
+    return (char*)slot + sizeof(SharedSlot);
+}
+
+static size_t slot_capacity(const YtdlpSharedCache* cache) {
+    return cache->slot_size - sizeof(SharedSlot);
+}
+
+/* ============================================================================
+ * Segment Mapping
+ * ========================================================================== */
+
+/* Names become one path component; anything unusual is replaced */
+bool ytdlp_shared_cache_segment(const char* name, char* out, size_t size) {
+#ifdef _WIN32
+    const char* prefix = "Local\\prism-ytdlp-";
+#else
+    const char* prefix = "/prism-ytdlp-";
+#endif
+    size_t prefix_len = strlen(prefix);
+    size_t name_len = strlen(name);
+    if (prefix_len + name_len + 9 >= size) return false;
+
+    memcpy(out, prefix, prefix_len);
+    for (size_t i = 0; i < name_len; i++) {
+        char c = name[i];
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                     (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        out[prefix_len + i] = plain ? c : '_';
+    }
+    snprintf(out + prefix_len + name_len, size - prefix_len - name_len, "-%08x", (unsigned)layout_tag());
+    return true;
+}
+
+/* Lay out a segment this process created */
+static void segment_init(SharedHeader* header, size_t size) {
+    header->magic = YTDLP_SHARED_MAGIC;
+    header->layout = layout_tag();
+    header->slot_size = YTDLP_SHARED_SLOT_SIZE;
+    header->slot_count = (uint32_t)((size - sizeof(SharedHeader)) / YTDLP_SHARED_SLOT_SIZE);
+    ytdlp_atomic_store_i32(&header->ready, 1);
+}
+
+/* Wait for the process that created a segment to lay it out */
+static bool segment_wait_ready(SharedHeader* header) {
+    uint64_t give_up = ytdlp_monotonic_ms() + YTDLP_SHARED_READY_WAIT_MS;
+    while (!ytdlp_atomic_load_i32(&header->ready)) {
+        if (ytdlp_monotonic_ms() >= give_up) return false;
+        ytdlp_sleep_ms(1);
+    }
+    return true;
+}
+
+/* Check a mapped segment and take its geometry, which its creator chose */
+static bool segment_attach(YtdlpSharedCache* cache) {
+    SharedHeader* header = (SharedHeader*)cache->base;
+    if (!segment_wait_ready(header)) return false;
+
+    if (header->magic != YTDLP_SHARED_MAGIC || header->layout != layout_tag() ||
+        header->slot_size <= sizeof(SharedSlot) || header->slot_count == 0 ||
+        sizeof(SharedHeader) + (uint64_t)header->slot_count * header->slot_size > cache->size) {
+        return false;
+    }
+
+    cache->header = header;
+    cache->slot_count = header->slot_count;
+    cache->slot_size = header->slot_size;
+    return true;
+}
+
+#ifdef _WIN32
+
+static bool segment_map(YtdlpSharedCache* cache, const char* name, size_t size) {
+    cache->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+    if (!cache->mapping) return false;
+    bool created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+    cache->base = (char*)MapViewOfFile(cache->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!cache->base) return false;
+
+    MEMORY_BASIC_INFORMATION region;
+    if (VirtualQuery(cache->base, &region, sizeof(region)) == 0) return false;
+    cache->size = region.RegionSize;
+
+    if (created) segment_init((SharedHeader*)cache->base, size);
+    return true;
+}
+
+static void segment_unmap(YtdlpSharedCache* cache) {
+    if (cache->base) UnmapViewOfFile(cache->base);
+    if (cache->mapping) CloseHandle(cache->mapping);
+}
+
+#else
+
+/* Unlink the segment `fd` was opened from, unless another process already
+ * replaced it under the same name */
+static void segment_discard(const char* name, int fd) {
+    int current = shm_open(name, O_RDWR, 0600);
+    if (current < 0) return;
+
+    struct stat found, named;
+    if (fstat(fd, &found) == 0 && fstat(current, &named) == 0 &&
+        found.st_dev == named.st_dev && found.st_ino == named.st_ino) {
+        shm_unlink(name);
+    }
+    close(current);
+}
+
+/* Open the segment, creating it if needed. A segment still unsized or not
+ * laid out after YTDLP_SHARED_READY_WAIT_MS lost its creator and would stay
+ * unusable until reboot, so it is replaced, once. */
+static bool segment_map(YtdlpSharedCache* cache, const char* name, size_t size) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        /* Only the creator sizes the segment: resizing one that another
+         * process has mapped would fault its reads past the new end */
+        bool created = true;
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0 && ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+        if (fd < 0 && errno == EEXIST) {
+            created = false;
+            fd = shm_open(name, O_RDWR, 0600);
+        }
+        if (fd < 0) return false;
+
+        /* An existing segment may not be sized yet */
+        struct stat st;
+        uint64_t give_up = ytdlp_monotonic_ms() + YTDLP_SHARED_READY_WAIT_MS;
+        while (fstat(fd, &st) == 0 && st.st_size == 0 && ytdlp_monotonic_ms() < give_up) {
+            ytdlp_sleep_ms(1);
+        }
+        if (st.st_size < (off_t)sizeof(SharedHeader)) {
+            segment_discard(name, fd);
+            close(fd);
+            continue;
+        }
+
+        void* base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        if (created) segment_init((SharedHeader*)base, (size_t)st.st_size);
+        if (created || segment_wait_ready((SharedHeader*)base)) {
+            close(fd);
+            cache->base = (char*)base;
+            cache->size = (size_t)st.st_size;
+            return true;
+        }
+
+        munmap(base, (size_t)st.st_size);
+        segment_discard(name, fd);
+        close(fd);
+    }
+    return false;
+}
+
+static void segment_unmap(YtdlpSharedCache* cache) {
+    if (cache->base) munmap(cache->base, cache->size);
+}
+
+#endif
+
+YtdlpSharedCache* ytdlp_shared_cache_open(const char* name, size_t bytes, int ttl_ms) {
+    if (!name || !name[0] || ttl_ms <= 0) return NULL;
+
+    char segment[128];
+    if (!ytdlp_shared_cache_segment(name, segment, sizeof(segment))) return NULL;
+
+    size_t min_bytes = sizeof(SharedHeader) + (size_t)YTDLP_SHARED_MIN_SLOTS * YTDLP_SHARED_SLOT_SIZE;
+    if (bytes < min_bytes) bytes = min_bytes;
+
+    YtdlpSharedCache* cache = (YtdlpSharedCache*)ytdlp_calloc(1, sizeof(YtdlpSharedCache));
+    if (!cache) return NULL;
+    cache->ttl_ms = ttl_ms;
+
+    if (!segment_map(cache, segment, bytes) || !segment_attach(cache)) {
+        ytdlp_shared_cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void ytdlp_shared_cache_close(YtdlpSharedCache* cache) {
+    if (!cache) return;
+    segment_unmap(cache);
+    ytdlp_free(cache);
+}
+
+/* ============================================================================
+ * Reads
+ * ========================================================================== */
+
+/* A consistent copy of a live entry: its value in a ytdlp_malloc() block */
+typedef struct SharedEntry {
+    char* value;
+    size_t value_len;
+    uint64_t expires_at;
+} SharedEntry;
+
+/* Copy out the entry for `key` if the slot holds it, retrying while a
+ * writer moves the sequence count underneath */
+static bool slot_read(YtdlpSharedCache* cache, SharedSlot* slot, const char* key, size_t key_len,
+                      uint32_t hash, uint32_t kind, SharedEntry* out) {
+    size_t capacity = slot_capacity(cache);
+
+    for (int attempt = 0; attempt < YTDLP_SHARED_READ_RETRIES; attempt++) {
+        int32_t seq = ytdlp_atomic_load_i32(&slot->seq);
+        if (seq & 1) return false;
+
+        /* Fields may be torn here; the sequence check below catches it */
+        uint32_t slot_hash = slot->hash;
+        uint32_t slot_kind = slot->kind;
+        size_t slot_key_len = slot->key_len;
+        size_t value_len = slot->value_len;
+        uint64_t expires_at = slot->expires_at;
+        uint32_t sum = slot->checksum;
+
+        if (slot_hash != hash || slot_kind != kind || slot_key_len != key_len ||
+            ALIGN8(key_len) + value_len > capacity ||
+            memcmp(slot_data(slot), key, key_len) != 0) {
+            return false;
+        }
+
+        char* value = (char*)ytdlp_malloc(value_len ? value_len : 1);
+        if (!value) return false;
+        memcpy(value, slot_data(slot) + ALIGN8(key_len), value_len);
+
+        ytdlp_atomic_fence();
+        if (ytdlp_atomic_load_i32(&slot->seq) != seq) {
+            ytdlp_free(value);
+            continue;
+        }
+
+        uint32_t expected = checksum(key, key_len) ^ checksum(value, value_len);
+        if (sum != expected || ytdlp_monotonic_ms() >= expires_at) {
+            ytdlp_free(value);
+            return false;
+        }
+
+        out->value = value;
+        out->value_len = value_len;
+        out->expires_at = expires_at;
+        return true;
+    }
+    return false;
+}
+
+static bool shared_lookup(YtdlpSharedCache* cache, const char* key, uint32_t kind, SharedEntry* out) {
+    size_t key_len = strlen(key);
+    uint32_t hash = hash_key(key, key_len);
+
+    for (uint32_t i = 0; i < YTDLP_SHARED_PROBES && i < cache->slot_count; i++) {
+        SharedSlot* slot = slot_at(cache, (hash + i) % cache->slot_count);
+        if (slot->hash == 0) return false;  /* Nothing was ever stored past here */
+        if (slot_read(cache, slot, key, key_len, hash, kind, out)) return true;
+    }
+    return false;
+}
+
+const YtdlpMediaInfo* ytdlp_shared_cache_get(YtdlpSharedCache* cache, const char* key, int* ttl_ms) {
+    if (!cache || !key) return NULL;
+
+    SharedEntry entry;
+    if (!shared_lookup(cache, key, SLOT_MEDIA_INFO, &entry)) return NULL;
+
+    YtdlpMediaInfo* info = ytdlp_media_info_unflatten(entry.value, entry.value_len);
+    if (!info) {
+        ytdlp_free(entry.value);
+        return NULL;
+    }
+
+    if (ttl_ms) {
+        uint64_t now = ytdlp_monotonic_ms();
+        uint64_t left = entry.expires_at > now ? entry.expires_at - now : 0;
+        *ttl_ms = left > INT32_MAX ? INT32_MAX : (int)left;
+    }
+    return info;
+}
+
+bool ytdlp_shared_cache_get_failure(YtdlpSharedCache* cache, const char* key, char* error, size_t error_size) {
+    if (!cache || !key) return false;
+
+    SharedEntry entry;
+    if (!shared_lookup(cache, key, SLOT_FAILURE, &entry)) return false;
+
+    snprintf(error, error_size, "%.*s", (int)entry.value_len, entry.value);
+    ytdlp_free(entry.value);
+    return true;
+}
+
+/* ============================================================================
+ * Writes
+ * ========================================================================== */
+
+/* The slot for `key`: the one already holding it, else the first never
+ * used, else the one expiring first among the key's probe window */
+static SharedSlot* choose_slot(YtdlpSharedCache* cache, const char* key, size_t key_len, uint32_t hash) {
+    SharedSlot* victim = NULL;
+
+    for (uint32_t i = 0; i < YTDLP_SHARED_PROBES && i < cache->slot_count; i++) {
+        SharedSlot* slot = slot_at(cache, (hash + i) % cache->slot_count);
+        if (slot->hash == 0) return slot;
+        if (slot->hash == hash && slot->key_len == key_len && memcmp(slot_data(slot), key, key_len) == 0) {
+            return slot;
+        }
+        if (!victim || slot->expires_at < victim->expires_at) victim = slot;
+    }
+    return victim;
+}
+
+/* Take the slot for writing; returns the odd sequence count it now holds,
+ * or 0 if another writer has it */
+static int32_t slot_lock(SharedSlot* slot, uint64_t now) {
+    int32_t seq = ytdlp_atomic_load_i32(&slot->seq);
+
+    if (seq & 1) {
+        uint64_t locked_at = ytdlp_atomic_load_u64(&slot->locked_at);
+        if (now < locked_at + YTDLP_SHARED_STALE_WRITE_MS) return 0;
+        if (!ytdlp_atomic_cas_i32(&slot->seq, seq, seq + 2)) return 0;
+        seq += 2;
+    } else {
+        if (!ytdlp_atomic_cas_i32(&slot->seq, seq, seq + 1)) return 0;
+        seq += 1;
+    }
+
+    ytdlp_atomic_store_u64(&slot->locked_at, now);
+    ytdlp_atomic_fence();
+    return seq;
+}
+
+/* Store an entry whose value is `value_len` bytes written by `fill` */
+static void shared_store(YtdlpSharedCache* cache, const char* key, uint32_t kind, size_t value_len,
+                         void (*fill)(char* dst, const void* arg), const void* arg, int max_ttl_ms) {
+    size_t key_len = strlen(key);
+    if (ALIGN8(key_len) + value_len > slot_capacity(cache)) return;
+
+    uint32_t hash = hash_key(key, key_len);
+    uint64_t now = ytdlp_monotonic_ms();
+    int ttl_ms = (max_ttl_ms > 0 && max_ttl_ms < cache->ttl_ms) ? max_ttl_ms : cache->ttl_ms;
+
+    SharedSlot* slot = choose_slot(cache, key, key_len, hash);
+    int32_t seq = slot ? slot_lock(slot, now) : 0;
+    if (!seq) return;
+
+    char* data = slot_data(slot);
+    memcpy(data, key, key_len);
+    fill(data + ALIGN8(key_len), arg);
+
+    slot->hash = hash;
+    slot->kind = kind;
+    slot->key_len = (uint32_t)key_len;
+    slot->value_len = (uint32_t)value_len;
+    slot->expires_at = now + (uint64_t)ttl_ms;
+    slot->checksum = checksum(key, key_len) ^ checksum(data + ALIGN8(key_len), value_len);
+
+    /* Fails only if the slot was taken over as stale, which the checksum
+     * then has to catch */
+    ytdlp_atomic_fence();
+    ytdlp_atomic_cas_i32(&slot->seq, seq, seq + 1);
+}
+
+static void fill_media_info(char* dst, const void* arg) {
+    ytdlp_media_info_flatten((const YtdlpMediaInfo*)arg, dst);
+}
+
+static void fill_failure(char* dst, const void* arg) {
+    const char* error = (const char*)arg;
+    memcpy(dst, error, strlen(error));
+}
+
+void ytdlp_shared_cache_put(YtdlpSharedCache* cache, const char* key, const YtdlpMediaInfo* info, int max_ttl_ms) {
+    if (!cache || !key || !info) return;
+    shared_store(cache, key, SLOT_MEDIA_INFO, info->size, fill_media_info, info, max_ttl_ms);
+}
+
+void ytdlp_shared_cache_put_failure(YtdlpSharedCache* cache, const char* key, const char* error, int max_ttl_ms) {
+    if (!cache || !key || !error) return;
+    shared_store(cache, key, SLOT_FAILURE, strlen(error), fill_failure, error, max_ttl_ms);
+}
@@ -0,0 +1,251 @@
+/*
+ * Prism yt-dlp Plugin - Single-flight Installs
+ *
+ * Installing yt-dlp downloads tens of megabytes into a shared directory, so
+ * it must happen once no matter how many resolves find the tool missing at
+ * the same moment. Within the process, callers installing into a directory
+ * that already has an install in flight wait for that one and share its
+ * result and progress. Across processes, installs into a directory take
+ * turns through an exclusive lock on <install_dir>/.prism-ytdlp.lock, and a
+ * process that had to wait first checks whether the install it waited for
+ * left something usable behind.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/file.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_INSTALL_LOCK_FILE ".prism-ytdlp.lock"
+#define YTDLP_INSTALL_LOCK_POLL_MS 250
+#define YTDLP_INSTALL_LOCK_TIMEOUT_MS (60 * 60 * 1000)  /* Longer than any install may take */
+
+typedef struct Flight {
+    struct Flight* next;
+    char install_dir[YTDLP_PATH_MAX];
+    int refs;
+    bool done;
+    bool ok;
+    float progress;  /* Latest progress of the install (<0 = none yet) */
+    YtdlpCond cond;
+} Flight;
+
+typedef struct Leader {
+    Flight* flight;
+    YtdlpDownloadProgress progress;
+    void* user_data;
+} Leader;
+
+static YtdlpMutex s_lock = YTDLP_MUTEX_INIT;
+static Flight* s_flights = NULL;
+
+/* ============================================================================
+ * Lock File
+ * ========================================================================== */
+
+#ifdef _WIN32
+
+typedef HANDLE LockHandle;
+#define NO_LOCK INVALID_HANDLE_VALUE
+
+static LockHandle open_lock(const char* path) {
+    return CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN, NULL);
+}
+
+static bool try_lock(LockHandle handle) {
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped) != 0;
+}
+
+static void close_lock(LockHandle handle) {
+    CloseHandle(handle);  /* Releases the lock */
+}
+
+static void sleep_ms(int ms) {
+    Sleep((DWORD)ms);
+}
+
+#else /* POSIX */
+
+typedef int LockHandle;
+#define NO_LOCK (-1)
+
+static LockHandle open_lock(const char* path) {
+    return open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+
+/* flock() locks belong to the open file, so two opens in one process
+ * exclude each other as well */
+static bool try_lock(LockHandle fd) {
+    for (;;) {
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0) return true;
+        if (errno != EINTR) return false;
+    }
+}
+
+static void close_lock(LockHandle fd) {
+    close(fd);  /* Releases the lock */
+}
+
+static void sleep_ms(int ms) {
+    usleep((useconds_t)ms * 1000);
+}
+
+#endif
+
+/*
+ * Take install_dir's lock, waiting for another process's install to finish.
+ * `*waited` reports whether one was in progress. NO_LOCK with `*waited` unset
+ * means the lock file cannot be created (read-only or missing directory), and
+ * the install goes ahead unlocked as before; with `*waited` set the wait
+ * timed out.
+ */
+static LockHandle acquire_lock(const char* install_dir, bool* waited) {
+    *waited = false;
+
+    char path[YTDLP_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/" YTDLP_INSTALL_LOCK_FILE, install_dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) return NO_LOCK;
+
+    LockHandle handle = open_lock(path);
+    if (handle == NO_LOCK) return NO_LOCK;
+
+    uint64_t deadline = ytdlp_monotonic_ms() + YTDLP_INSTALL_LOCK_TIMEOUT_MS;
+    while (!try_lock(handle)) {
+        *waited = true;
+        if (ytdlp_monotonic_ms() >= deadline) {
+            close_lock(handle);
+            return NO_LOCK;
+        }
+        sleep_ms(YTDLP_INSTALL_LOCK_POLL_MS);
+    }
+
+    return handle;
+}
+
+/* ============================================================================
+ * Flights
+ * ========================================================================== */
+
+/* Called on the installing thread; waiters pick the value up on their own */
+static void leader_progress(float progress, void* user_data) {
+    Leader* leader = (Leader*)user_data;
+
+    ytdlp_mutex_lock(&s_lock);
+    leader->flight->progress = progress;
+    ytdlp_cond_broadcast(&leader->flight->cond);
+    ytdlp_mutex_unlock(&s_lock);
+
+    if (leader->progress) leader->progress(progress, leader->user_data);
+}
+
+static bool run_install(
+    Flight* flight,
+    YtdlpInstallFn install,
+    YtdlpAdoptFn adopt,
+    void* context,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    bool waited;
+    LockHandle lock = acquire_lock(flight->install_dir, &waited);
+    if (lock == NO_LOCK && waited) return false;
+
+    Leader leader = { flight, progress, user_data };
+    bool ok;
+    if (waited && adopt && adopt(flight->install_dir, context)) {
+        /* The process that held the lock installed it for us */
+        ok = true;
+        leader_progress(1.0f, &leader);
+    } else {
+        ok = install(flight->install_dir, context, leader_progress, &leader);
+    }
+
+    if (lock != NO_LOCK) close_lock(lock);
+    return ok;
+}
+
+bool ytdlp_install_once(
+    const char* install_dir,
+    YtdlpInstallFn install,
+    YtdlpAdoptFn adopt,
+    void* context,
+    YtdlpDownloadProgress progress,
+    void* user_data
+) {
+    ytdlp_mutex_lock(&s_lock);
+
+    Flight* flight = s_flights;
+    while (flight && strcmp(flight->install_dir, install_dir) != 0) {
+        flight = flight->next;
+    }
+
+    if (flight) {
+        /* Join the install in flight, relaying its progress on this thread */
+        flight->refs++;
+        float reported = -1.0f;
+        while (!flight->done || flight->progress > reported) {
+            if (flight->progress > reported) {
+                reported = flight->progress;
+                ytdlp_mutex_unlock(&s_lock);
+                if (progress) progress(reported, user_data);
+                ytdlp_mutex_lock(&s_lock);
+                continue;
+            }
+            ytdlp_cond_wait(&flight->cond, &s_lock);
+        }
+        bool ok = flight->ok;
+
+        if (--flight->refs == 0) {
+            ytdlp_cond_destroy(&flight->cond);
+            ytdlp_free(flight);
+        }
+        ytdlp_mutex_unlock(&s_lock);
+        return ok;
+    }
+
+    flight = (Flight*)ytdlp_calloc(1, sizeof(Flight));
+    if (!flight) {
+        ytdlp_mutex_unlock(&s_lock);
+        return false;
+    }
+    snprintf(flight->install_dir, sizeof(flight->install_dir), "%s", install_dir);
+    flight->refs = 1;
+    flight->progress = -1.0f;
+    ytdlp_cond_init(&flight->cond);
+    flight->next = s_flights;
+    s_flights = flight;
+
+    ytdlp_mutex_unlock(&s_lock);
+
+    bool ok = run_install(flight, install, adopt, context, progress, user_data);
+
+    ytdlp_mutex_lock(&s_lock);
+
+    /* Later callers start a new install rather than joining a finished one */
+    Flight** link = &s_flights;
+    while (*link != flight) link = &(*link)->next;
+    *link = flight->next;
+
+    flight->ok = ok;
+    flight->done = true;
+    ytdlp_cond_broadcast(&flight->cond);
+
+    if (--flight->refs == 0) {
+        ytdlp_cond_destroy(&flight->cond);
+        ytdlp_free(flight);
+    }
+    ytdlp_mutex_unlock(&s_lock);
+    return ok;
+}
@@ -0,0 +1,381 @@
+/*
+ * Prism yt-dlp Plugin - URL Parsing
+ *
+ * One pass over a page URL splits it into views of its scheme, port, path
+ * and query, with a lowercased copy of the host. Nothing is allocated, so
+ * every layer that looks at a URL can parse it on the stack.
+ *
+ * Sites that reach the same media through several URL shapes also get a
+ * content key, such as "youtube:<id>" for youtu.be/<id>, /watch?v=<id> and
+ * /shorts/<id> on any YouTube host. Caches key on it, so different links to
+ * one video share a single extraction.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define YOUTUBE_ID_LEN 11
+
+/* ============================================================================
+ * Views
+ * ========================================================================== */
+
+static bool view_is(const char* s, size_t len, const char* literal) {
+    return strlen(literal) == len && memcmp(s, literal, len) == 0;
+}
+
+static bool view_all(const char* s, size_t len, int (*pred)(int)) {
+    if (len == 0) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (!pred((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+static int is_id_char(int c) {
+    return isalnum(c) || c == '-' || c == '_';
+}
+
+/* Path segment `index` (0-based, empty segments skipped); false if absent */
+static bool path_segment(const YtdlpUrl* url, int index, const char** seg, size_t* len) {
+    const char* p = url->path;
+    const char* end = url->path + url->path_len;
+
+    while (p < end) {
+        while (p < end && *p == '/') p++;
+        const char* start = p;
+        while (p < end && *p != '/') p++;
+        if (p > start && index-- == 0) {
+            *seg = start;
+            *len = (size_t)(p - start);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool query_value(const YtdlpUrl* url, const char* name, const char** value, size_t* len) {
+    size_t offset = 0;
+    YtdlpUrlParam param;
+    while (ytdlp_url_next_param(url, &offset, &param)) {
+        if (view_is(param.name, param.name_len, name)) {
+            *value = param.value;
+            *len = param.value_len;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ============================================================================
+ * Content Keys
+ *
+ * Each writes "<site>:<id>" into url->content_key, or leaves it empty when
+ * the URL does not name a single piece of media.
+ * ========================================================================== */
+
+static void set_key(YtdlpUrl* url, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(url->content_key, sizeof(url->content_key), format, args);
+    va_end(args);
+
+    /* A key cut short could name other media */
+    if (n < 0 || (size_t)n >= sizeof(url->content_key)) url->content_key[0] = '\0';
+}
+
+/* youtu.be/<id>, /watch?v=<id>, and /shorts, /live, /embed, /v, /e/<id> */
+static void youtube_key(YtdlpUrl* url) {
+    const char* id = NULL;
+    size_t id_len = 0;
+    const char* seg;
+    size_t seg_len;
+
+    if (ytdlp_url_host_is(url, "youtu.be")) {
+        path_segment(url, 0, &id, &id_len);
+    } else if (path_segment(url, 0, &seg, &seg_len)) {
+        if (view_is(seg, seg_len, "watch")) {
+            query_value(url, "v", &id, &id_len);
+        } else if (view_is(seg, seg_len, "shorts") || view_is(seg, seg_len, "live") ||
+                   view_is(seg, seg_len, "embed") || view_is(seg, seg_len, "v") ||
+                   view_is(seg, seg_len, "e")) {
+            path_segment(url, 1, &id, &id_len);
+        }
+    }
+
+    if (id_len == YOUTUBE_ID_LEN && view_all(id, id_len, is_id_char)) {
+        set_key(url, "youtube:%.*s", (int)id_len, id);
+    }
+}
+
+/* Twitch paths that are not channel names */
+static const char* s_twitch_reserved[] = {
+    "directory", "downloads", "jobs", "p", "search", "settings", "subscriptions",
+    "turbo", "videos", "wallet", NULL
+};
+
+/* clips.twitch.tv/<slug>, /videos/<id>, /<channel>/clip/<slug>,
+ * /<channel>/v/<id> and live channels at /<channel> */
+static void twitch_key(YtdlpUrl* url) {
+    const char* first;
+    size_t first_len;
+    const char* second;
+    size_t second_len;
+    const char* third;
+    size_t third_len;
+
+    if (!path_segment(url, 0, &first, &first_len)) return;
+    bool has_second = path_segment(url, 1, &second, &second_len);
+    bool has_third = path_segment(url, 2, &third, &third_len);
+
+    if (ytdlp_url_host_is(url, "clips.twitch.tv")) {
+        if (!has_second && view_all(first, first_len, is_id_char)) {
+            set_key(url, "twitch:clip:%.*s", (int)first_len, first);
+        }
+        return;
+    }
+
+    if (view_is(first, first_len, "videos")) {
+        if (has_second && !has_third && view_all(second, second_len, isdigit)) {
+            set_key(url, "twitch:video:%.*s", (int)second_len, second);
+        }
+        return;
+    }
+
+    if (!has_second) {
+        for (int i = 0; s_twitch_reserved[i]; i++) {
+            if (view_is(first, first_len, s_twitch_reserved[i])) return;
+        }
+        if (view_all(first, first_len, is_id_char)) {
+            /* Channel names ignore case */
+            set_key(url, "twitch:live:%.*s", (int)first_len, first);
+            for (char* p = url->content_key; *p; p++) *p = (char)tolower((unsigned char)*p);
+        }
+        return;
+    }
+
+    if (!has_third) return;
+    if (view_is(second, second_len, "clip") && view_all(third, third_len, is_id_char)) {
+        set_key(url, "twitch:clip:%.*s", (int)third_len, third);
+    } else if (view_is(second, second_len, "v") && view_all(third, third_len, isdigit)) {
+        set_key(url, "twitch:video:%.*s", (int)third_len, third);
+    }
+}
+
+/* vimeo.com/<id>[/<hash>], player.vimeo.com/video/<id>[?h=<hash>], and the
+ * channel, group and showcase pages that end in /<id>. Unlisted videos need
+ * their hash, so it is part of the key. */
+static void vimeo_key(YtdlpUrl* url) {
+    const char* id = NULL;
+    size_t id_len = 0;
+    const char* hash = NULL;
+    size_t hash_len = 0;
+    const char* seg;
+    size_t seg_len;
+
+    if (ytdlp_url_host_is(url, "player.vimeo.com")) {
+        if (!path_segment(url, 0, &seg, &seg_len) || !view_is(seg, seg_len, "video")) return;
+        path_segment(url, 1, &id, &id_len);
+    } else {
+        int count = 0;
+        while (path_segment(url, count, &seg, &seg_len)) count++;
+        if (count == 0) return;
+
+        path_segment(url, 0, &seg, &seg_len);
+        if (view_all(seg, seg_len, isdigit)) {
+            if (count > 2) return;
+            id = seg;
+            id_len = seg_len;
+            if (count == 2) path_segment(url, 1, &hash, &hash_len);
+        } else if (count >= 3) {
+            path_segment(url, count - 1, &id, &id_len);
+        }
+    }
+
+    if (!id || !view_all(id, id_len, isdigit)) return;
+    if (!hash) query_value(url, "h", &hash, &hash_len);
+
+    if (hash_len > 0 && view_all(hash, hash_len, isalnum)) {
+        set_key(url, "vimeo:%.*s:%.*s", (int)id_len, id, (int)hash_len, hash);
+    } else {
+        set_key(url, "vimeo:%.*s", (int)id_len, id);
+    }
+}
+
+/* /@<user>/video/<id>, /@<user>/photo/<id>, /embed[/v2]/<id> and the mobile
+ * /v/<id>.html. vm.tiktok.com short links only redirect, so they get none. */
+static void tiktok_key(YtdlpUrl* url) {
+    const char* id = NULL;
+    size_t id_len = 0;
+    const char* first;
+    size_t first_len;
+    const char* second;
+    size_t second_len;
+
+    if (!path_segment(url, 0, &first, &first_len) || !path_segment(url, 1, &second, &second_len)) return;
+
+    if (first[0] == '@') {
+        if (view_is(second, second_len, "video") || view_is(second, second_len, "photo")) {
+            path_segment(url, 2, &id, &id_len);
+        }
+    } else if (view_is(first, first_len, "embed")) {
+        if (view_is(second, second_len, "v2")) {
+            path_segment(url, 2, &id, &id_len);
+        } else {
+            id = second;
+            id_len = second_len;
+        }
+    } else if (view_is(first, first_len, "v")) {
+        id = second;
+        id_len = second_len;
+        if (id_len > 5 && memcmp(id + id_len - 5, ".html", 5) == 0) id_len -= 5;
+    }
+
+    if (id && view_all(id, id_len, isdigit)) {
+        set_key(url, "tiktok:%.*s", (int)id_len, id);
+    }
+}
+
+/* ============================================================================
+ * Parsing
+ * ========================================================================== */
+
+bool ytdlp_url_parse(const char* text, YtdlpUrl* url) {
+    memset(url, 0, sizeof(*url));
+    if (!text || !text[0]) return false;
+    url->text = text;
+
+    /* Scheme, if there is one: [alpha][alnum+-.]*:// */
+    const char* p = text;
+    if (isalpha((unsigned char)*p)) {
+        const char* s = p + 1;
+        while (isalnum((unsigned char)*s) || *s == '+' || *s == '-' || *s == '.') s++;
+        if (s[0] == ':' && s[1] == '/' && s[2] == '/') {
+            url->scheme = p;
+            url->scheme_len = (size_t)(s - p);
+            p = s + 3;
+        }
+    }
+
+    /* Authority, without user:pass@ */
+    const char* authority_end = p + strcspn(p, "/?#");
+    for (const char* at = authority_end; at > p; at--) {
+        if (at[-1] == '@') {
+            p = at;
+            break;
+        }
+    }
+
+    const char* host = p;
+    const char* host_end;
+    if (*p == '[') {
+        /* IPv6 literal */
+        const char* close = memchr(p, ']', (size_t)(authority_end - p));
+        if (!close) return false;
+        host_end = close + 1;
+    } else {
+        host_end = memchr(p, ':', (size_t)(authority_end - p));
+        if (!host_end) host_end = authority_end;
+    }
+
+    /* file:///path has an empty host */
+    size_t host_len = (size_t)(host_end - host);
+    if ((host_len == 0 && !url->scheme) || host_len >= sizeof(url->host)) return false;
+    for (size_t i = 0; i < host_len; i++) {
+        url->host[i] = (char)tolower((unsigned char)host[i]);
+    }
+    url->host[host_len] = '\0';
+
+    if (host_end < authority_end && *host_end == ':') {
+        url->port = host_end + 1;
+        url->port_len = (size_t)(authority_end - url->port);
+    }
+
+    /* Path, query and fragment */
+    p = authority_end;
+    url->path = p;
+    url->path_len = strcspn(p, "?#");
+    p += url->path_len;
+
+    if (*p == '?') {
+        url->query = p + 1;
+        url->query_len = strcspn(url->query, "#");
+        p = url->query + url->query_len;
+    } else {
+        url->query = p;
+    }
+    url->rest = p;
+
+    if (ytdlp_url_host_is(url, "youtube.com") || ytdlp_url_host_is(url, "youtu.be") ||
+        ytdlp_url_host_is(url, "youtube-nocookie.com")) {
+        url->site = YTDLP_SITE_YOUTUBE;
+        youtube_key(url);
+    } else if (ytdlp_url_host_is(url, "twitch.tv")) {
+        url->site = YTDLP_SITE_TWITCH;
+        twitch_key(url);
+    } else if (ytdlp_url_host_is(url, "vimeo.com")) {
+        url->site = YTDLP_SITE_VIMEO;
+        vimeo_key(url);
+    } else if (ytdlp_url_host_is(url, "tiktok.com")) {
+        url->site = YTDLP_SITE_TIKTOK;
+        tiktok_key(url);
+    }
+
+    return true;
+}
+
+bool ytdlp_url_host_is(const YtdlpUrl* url, const char* domain) {
+    size_t host_len = strlen(url->host);
+    size_t domain_len = strlen(domain);
+    if (host_len < domain_len) return false;
+    if (strcmp(url->host + host_len - domain_len, domain) != 0) return false;
+    return host_len == domain_len || url->host[host_len - domain_len - 1] == '.';
+}
+
+bool ytdlp_url_next_param(const YtdlpUrl* url, size_t* offset, YtdlpUrlParam* param) {
+    while (*offset < url->query_len) {
+        const char* start = url->query + *offset;
+        size_t len = 0;
+        while (*offset + len < url->query_len && start[len] != '&') len++;
+        *offset += len + (*offset + len < url->query_len ? 1 : 0);
+        if (len == 0) continue;
+
+        const char* eq = memchr(start, '=', len);
+        param->text = start;
+        param->text_len = len;
+        param->name = start;
+        param->name_len = eq ? (size_t)(eq - start) : len;
+        param->value = eq ? eq + 1 : start + len;
+        param->value_len = eq ? (size_t)(start + len - eq - 1) : 0;
+        return true;
+    }
+    return false;
+}
+
+size_t ytdlp_url_key(const YtdlpUrl* url, char* buf, size_t size) {
+    int n;
+    if (url->content_key[0]) {
+        n = snprintf(buf, size, "%s", url->content_key);
+    } else {
+        /* Scheme and host are case-insensitive; credentials and the fragment
+         * never reach the server */
+        char scheme[16] = "https";
+        if (url->scheme_len > 0 && url->scheme_len < sizeof(scheme)) {
+            for (size_t i = 0; i < url->scheme_len; i++) {
+                scheme[i] = (char)tolower((unsigned char)url->scheme[i]);
+            }
+            scheme[url->scheme_len] = '\0';
+        }
+        n = snprintf(buf, size, "%s://%s%s%.*s%.*s%s%.*s",
+                     scheme, url->host, url->port_len ? ":" : "", (int)url->port_len, url->port,
+                     (int)url->path_len, url->path,
+                     url->query_len ? "?" : "", (int)url->query_len, url->query);
+    }
+    return n < 0 ? 0 : (size_t)n;
+}
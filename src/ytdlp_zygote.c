@@ -0,0 +1,455 @@
+/*
+ * Prism yt-dlp Plugin - Zygote Backend
+ *
+ * One long-lived Python process imports yt_dlp and every extractor module up
+ * front, then listens on a unix socket. Each connection is one extraction:
+ * the zygote forks, and the copy-on-write child reads the request, runs
+ * YoutubeDL.extract_info() and writes the `yt-dlp -J` JSON back. Resolves
+ * keep process isolation and run in parallel, but pay fork cost rather than
+ * interpreter startup and imports.
+ *
+ * Wire format. Request: six lines (URL, language, cache directory, socket
+ * timeout in seconds, extractor retries, deadline in milliseconds), empty
+ * lines for unset fields. Response: 'J' + JSON or 'E' + error message until
+ * EOF. Each child arms SIGALRM for its deadline and dies when it passes, so
+ * the plugin never signals a pid the zygote may already have reaped.
+ *
+ * The zygote leads its own process group, which its children stay in. When
+ * its stdin, a pipe held by the plugin, is closed, it kills that group, so
+ * neither it nor a running child outlives the host even if the host crashes.
+ *
+ * License: Unlicense (Public Domain)
+ */
+
+#include "ytdlp_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#define YTDLP_ZYGOTE_START_TIMEOUT_MS 60000      /* Importing every extractor takes a while cold */
+#define YTDLP_ZYGOTE_RETRY_MS (60 * 1000)        /* Spacing of start attempts after a failure */
+
+#ifdef _WIN32
+
+/* Windows has no fork(); the process backend is used instead */
+
+bool ytdlp_zygote_start(const char* python, const char* python_path) {
+    (void)python;
+    (void)python_path;
+    return false;
+}
+
+YtdlpProcessResult ytdlp_zygote_extract(const char* url, const char* language, const char* cache_dir, int timeout_ms) {
+    (void)url;
+    (void)language;
+    (void)cache_dir;
+    (void)timeout_ms;
+
+    YtdlpProcessResult result = { NULL, "yt-dlp zygote not supported on this platform", -1 };
+    return result;
+}
+
+void ytdlp_zygote_shutdown(void) {
+}
+
+bool ytdlp_zygote_version(char* version, size_t size) {
+    (void)version;
+    (void)size;
+    return false;
+}
+
+#else /* POSIX */
+
+/* argv: socket path, extra sys.path entry. Imports every extractor module and
+ * compiles their URL patterns, which children would otherwise each redo on
+ * their first extraction. Followed by the extraction source and the serve
+ * loop. */
+static const char s_zygote_prologue[] =
+    "import os, sys, socket, select, signal, random\n"
+    "_prism_socket, _prism_path = sys.argv[1], sys.argv[2]\n"
+    "if _prism_path:\n"
+    "    sys.path.insert(0, _prism_path)\n"
+    "import yt_dlp as _prism_yt_dlp\n"
+    "try:\n"
+    "    import yt_dlp.extractor._extractors\n"
+    "except ImportError:\n"
+    "    pass\n"
+    "for _prism_ie in _prism_yt_dlp.extractor.gen_extractor_classes():\n"
+    "    _prism_ie.suitable('https://example.invalid/')\n"
+    "with _prism_yt_dlp.YoutubeDL({'quiet': True}):\n"
+    "    pass\n";
+
+static const char s_zygote_loop[] =
+    "def _prism_serve(conn):\n"
+    "    f = conn.makefile('rb')\n"
+    "    url, lang, cache_dir, timeout, retries, deadline = (f.readline().decode('utf-8').rstrip('\\n') for _ in range(6))\n"
+    "    if int(deadline or 0) > 0:\n"
+    "        signal.setitimer(signal.ITIMER_REAL, int(deadline) / 1000.0)\n"
+    "    out = _prism_ytdlp_extract(url, lang or None, cache_dir or None, int(timeout or 0), int(retries or -1))\n"
+    "    conn.sendall(out.encode('utf-8'))\n"
+    "signal.signal(signal.SIGCHLD, signal.SIG_IGN)\n"
+    "try:\n"
+    "    os.unlink(_prism_socket)\n"
+    "except FileNotFoundError:\n"
+    "    pass\n"
+    "srv = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)\n"
+    "srv.bind(_prism_socket)\n"
+    "os.chmod(_prism_socket, 0o600)\n"
+    "srv.listen(64)\n"
+    "sys.stdout.write('ready %s\\n' % _prism_yt_dlp.version.__version__)\n"
+    "sys.stdout.flush()\n"
+    "while True:\n"
+    "    readable = select.select([srv, sys.stdin], [], [])[0]\n"
+    "    if sys.stdin in readable and not os.read(sys.stdin.fileno(), 1):\n"
+    "        break\n"
+    "    if srv not in readable:\n"
+    "        continue\n"
+    "    conn = srv.accept()[0]\n"
+    "    if os.fork() == 0:\n"
+    "        srv.close()\n"
+    "        os.close(0)\n"
+    "        signal.signal(signal.SIGCHLD, signal.SIG_DFL)\n"
+    "        signal.signal(signal.SIGALRM, signal.SIG_DFL)\n"
+    "        random.seed()\n"
+    "        try:\n"
+    "            _prism_serve(conn)\n"
+    "        finally:\n"
+    "            os._exit(0)\n"
+    "    conn.close()\n"
+    "try:\n"
+    "    os.unlink(_prism_socket)\n"
+    "except OSError:\n"
+    "    pass\n"
+    "os.killpg(0, signal.SIGKILL)\n";
+
+static YtdlpMutex s_lock = YTDLP_MUTEX_INIT;
+static pid_t s_pid = 0;                  /* 0 = not running */
+static int s_control = -1;               /* Write end of the zygote's stdin */
+static char s_socket[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static uint64_t s_retry_at_ms = 0;
+static uint32_t s_generation = 0;
+static char s_version[64];               /* yt_dlp.version.__version__ in the zygote */
+
+/* ============================================================================
+ * Zygote Process
+ * ========================================================================== */
+
+static void stop_locked(void) {
+    if (s_pid <= 0) return;
+
+    close(s_control);
+    s_control = -1;
+
+    /* Closing stdin asks it to kill its group; give it a moment before
+     * killing the group here. Until it is reaped its pid names the group. */
+    for (int i = 0; i < 50 && waitpid(s_pid, NULL, WNOHANG) == 0; i++) {
+        usleep(2000);
+    }
+    if (kill(-s_pid, SIGKILL) == 0) {
+        waitpid(s_pid, NULL, 0);
+    }
+
+    unlink(s_socket);
+    s_pid = 0;
+}
+
+static bool running_locked(void) {
+    if (s_pid <= 0) return false;
+    if (waitpid(s_pid, NULL, WNOHANG) == 0) return true;
+
+    /* Exited on its own */
+    close(s_control);
+    s_control = -1;
+    unlink(s_socket);
+    s_pid = 0;
+    return false;
+}
+
+static bool socket_path(char* path, size_t size) {
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir || !dir[0]) dir = getenv("TMPDIR");
+    if (!dir || !dir[0]) dir = "/tmp";
+
+    int n = snprintf(path, size, "%s/prism-ytdlp-%d-%u.sock", dir, (int)getpid(), ++s_generation);
+    return n > 0 && (size_t)n < size;
+}
+
+/* Wait for the zygote's "ready <version>" line on `fd` */
+static bool wait_ready(int fd) {
+    char line[96];
+    size_t len = 0;
+    uint64_t deadline = ytdlp_monotonic_ms() + YTDLP_ZYGOTE_START_TIMEOUT_MS;
+
+    while (len < sizeof(line) - 1) {
+        uint64_t now = ytdlp_monotonic_ms();
+        if (now >= deadline) return false;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, (int)(deadline - now));
+        if (ready < 0 && errno != EINTR) return false;
+        if (ready <= 0) continue;
+
+        ssize_t n = read(fd, line + len, sizeof(line) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        len += (size_t)n;
+
+        line[len] = '\0';
+        char* end = strchr(line, '\n');
+        if (!end) continue;
+        if (strncmp(line, "ready ", 6) != 0) return false;
+
+        *end = '\0';
+        snprintf(s_version, sizeof(s_version), "%s", line + 6);
+        return true;
+    }
+    return false;
+}
+
+static bool spawn_locked(const char* python, const char* python_path) {
+    if (!socket_path(s_socket, sizeof(s_socket))) return false;
+
+    size_t source_len = sizeof(s_zygote_prologue) + strlen(ytdlp_python_extract_source) + sizeof(s_zygote_loop);
+    char* source = (char*)ytdlp_malloc(source_len);
+    if (!source) return false;
+    snprintf(source, source_len, "%s%s%s", s_zygote_prologue, ytdlp_python_extract_source, s_zygote_loop);
+
+    char* argv[] = {
+        (char*)python, "-c", source, s_socket, (char*)(python_path ? python_path : ""), NULL
+    };
+
+    /* Close-on-exec so children spawned later hold neither end open */
+    int control[2], status[2];
+    if (!ytdlp_make_pipe(control)) {
+        ytdlp_free(source);
+        return false;
+    }
+    if (!ytdlp_make_pipe(status)) {
+        close(control[0]);
+        close(control[1]);
+        ytdlp_free(source);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        dup2(control[0], STDIN_FILENO);
+        dup2(status[1], STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) dup2(null_fd, STDERR_FILENO);
+
+        close(control[0]);
+        close(control[1]);
+        close(status[0]);
+        close(status[1]);
+
+        execvp(python, argv);
+        _exit(127);
+    }
+
+    ytdlp_free(source);
+    close(control[0]);
+    close(status[1]);
+
+    if (pid < 0) {
+        close(control[1]);
+        close(status[0]);
+        return false;
+    }
+
+    setpgid(pid, pid);
+    s_pid = pid;
+    s_control = control[1];
+
+    bool ready = wait_ready(status[0]);
+    close(status[0]);
+
+    if (!ready) {
+        stop_locked();
+        return false;
+    }
+    return true;
+}
+
+bool ytdlp_zygote_start(const char* python, const char* python_path) {
+    ytdlp_mutex_lock(&s_lock);
+
+    bool running = running_locked();
+    if (!running && ytdlp_monotonic_ms() >= s_retry_at_ms) {
+        running = spawn_locked(python && python[0] ? python : "python3", python_path);
+        if (!running) {
+            s_retry_at_ms = ytdlp_monotonic_ms() + YTDLP_ZYGOTE_RETRY_MS;
+        }
+    }
+
+    ytdlp_mutex_unlock(&s_lock);
+    return running;
+}
+
+void ytdlp_zygote_shutdown(void) {
+    ytdlp_mutex_lock(&s_lock);
+    stop_locked();
+    ytdlp_mutex_unlock(&s_lock);
+}
+
+bool ytdlp_zygote_version(char* version, size_t size) {
+    ytdlp_mutex_lock(&s_lock);
+    bool known = running_locked() && s_version[0] && strlen(s_version) < size;
+    if (known) memcpy(version, s_version, strlen(s_version) + 1);
+    ytdlp_mutex_unlock(&s_lock);
+    return known;
+}
+
+/* ============================================================================
+ * Extraction
+ * ========================================================================== */
+
+static int connect_zygote(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    ytdlp_mutex_lock(&s_lock);
+    bool running = running_locked();
+    memcpy(addr.sun_path, s_socket, sizeof(addr.sun_path));
+    ytdlp_mutex_unlock(&s_lock);
+    if (!running) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, flags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool has_newline(const char* s) {
+    return s && strchr(s, '\n');
+}
+
+YtdlpProcessResult ytdlp_zygote_extract(const char* url, const char* language, const char* cache_dir, int timeout_ms) {
+    YtdlpProcessResult result = { NULL, NULL, -1 };
+
+    YtdlpScratch* scratch = ytdlp_scratch();
+    if (!scratch) {
+        result.error = "Out of memory";
+        return result;
+    }
+    ytdlp_buffer_clear(&scratch->out);
+    ytdlp_ring_clear(&scratch->err);
+
+    if (has_newline(url) || has_newline(language) || has_newline(cache_dir)) {
+        result.error = "Invalid URL";
+        return result;
+    }
+
+    int fd = connect_zygote();
+    if (fd < 0) {
+        result.error = "yt-dlp zygote not running";
+        return result;
+    }
+
+    int timeout_s, retries;
+    ytdlp_network_limits(timeout_ms, &timeout_s, &retries);
+    char tail[YTDLP_PATH_MAX + 64];
+    snprintf(tail, sizeof(tail), "\n%s\n%s\n%d\n%d\n%d\n",
+             language ? language : "", cache_dir ? cache_dir : "", timeout_s, retries,
+             timeout_ms > 0 ? timeout_ms : 0);
+
+    if (!send_all(fd, url, strlen(url)) || !send_all(fd, tail, strlen(tail))) {
+        close(fd);
+        result.error = "Failed to send request to yt-dlp zygote";
+        return result;
+    }
+
+    /* Read until the child closes the connection */
+    uint64_t deadline = ytdlp_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    bool timed_out = false;
+    for (;;) {
+        uint64_t now = ytdlp_monotonic_ms();
+        if (timeout_ms > 0 && now >= deadline) {
+            timed_out = true;
+            break;
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms > 0 ? (int)(deadline - now) : -1);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        size_t avail;
+        char* dst = ytdlp_buffer_reserve(&scratch->out, 64 * 1024, &avail);
+        if (!dst) {
+            close(fd);
+            result.error = "Out of memory";
+            return result;
+        }
+        ssize_t n = read(fd, dst, avail);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        ytdlp_buffer_commit(&scratch->out, (size_t)n);
+    }
+    close(fd);
+
+    /* The child's own alarm ends it at the same deadline */
+    if (timed_out) {
+        result.error = "Process timed out";
+        return result;
+    }
+
+    char* body = scratch->out.data;
+    if (!body || !body[0]) {
+        result.error = "yt-dlp zygote closed the connection";
+        return result;
+    }
+
+    if (body[0] == 'J') {
+        result.output = body + 1;
+        result.exit_code = 0;
+    } else {
+        const char* message = body + (body[0] == 'E');
+        ytdlp_ring_append(&scratch->err, message, strlen(message));
+        result.exit_code = 1;
+        result.error = ytdlp_ring_linearize(&scratch->err);
+    }
+    return result;
+}
+
+#endif
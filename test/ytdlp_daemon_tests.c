@@ -0,0 +1,380 @@
+/*
+ * Prism yt-dlp Plugin - Resolve Daemon Routing Tests
+ *
+ * Several stand-in daemons, each on its own unix socket (and one on a TCP
+ * port), answer every request with their own name. The client's routing is
+ * checked against them: keys spread over every endpoint and stay put, a
+ * stopped endpoint hands only its own keys to the next one on the ring and
+ * gets them back once health checks see it again, and a hot key spreads
+ * instead of queuing on one endpoint. TCP listens on loopback unless other
+ * hosts are explicitly allowed.
+ *
+ * Usage:
+ *   ytdlp_daemon_tests [--verbose]
+ */
+
+#include "ytdlp_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+/* The library's counters live in the resolver, which is not linked in */
+YtdlpStats g_ytdlp_stats = {0};
+
+static bool g_verbose = false;
+static int g_total = 0;
+static int g_passed = 0;
+
+static void check(bool pass, const char* name) {
+    g_total++;
+    if (pass) g_passed++;
+    if (!pass || g_verbose) printf("  [%s] %s\n", pass ? "PASS" : "FAIL", name);
+}
+
+#ifndef _WIN32
+
+#define DAEMONS 3
+#define DAEMON_THREADS 8
+#define KEYS 600
+#define HOT_CALLERS 12
+#define HOT_DELAY_MS 300
+
+/* ============================================================================
+ * Stand-in Daemons
+ * ========================================================================== */
+
+typedef struct FakeDaemon {
+    char endpoint[128];
+    int fd;
+    volatile int32_t stop;
+    volatile int32_t served;
+    YtdlpThread threads[DAEMON_THREADS];
+} FakeDaemon;
+
+static void fake_serve(void* arg) {
+    FakeDaemon* d = (FakeDaemon*)arg;
+    YtdlpArena* arena = &ytdlp_scratch()->arena;
+
+    while (!ytdlp_atomic_load_i32(&d->stop)) {
+        struct pollfd p = { d->fd, POLLIN, 0 };
+        if (poll(&p, 1, 20) <= 0) continue;
+
+        int fd = accept(d->fd, NULL, NULL);
+        if (fd < 0) continue;
+
+        YtdlpArenaMark mark = ytdlp_arena_mark(arena);
+        YtdlpDaemonRequest request;
+        if (ytdlp_daemon_read_request(fd, arena, &request, 1000)) {
+            if (request.op != YTDLP_DAEMON_PING) {
+                ytdlp_atomic_add_i32(&d->served, 1);
+                if (strstr(request.url, "/hot")) ytdlp_sleep_ms(HOT_DELAY_MS);
+            }
+
+            PrismResolvedStream stream;
+            memset(&stream, 0, sizeof(stream));
+            stream.success = true;
+            stream.title = d->endpoint;
+            stream.original_url = request.url;
+            ytdlp_daemon_write_stream(fd, &stream, 1000);
+        }
+        ytdlp_arena_release(arena, mark);
+        close(fd);
+    }
+}
+
+static bool fake_start(FakeDaemon* d) {
+    d->fd = ytdlp_daemon_listen(d->endpoint, false);
+    if (d->fd < 0) return false;
+
+    ytdlp_atomic_store_i32(&d->stop, 0);
+    for (int i = 0; i < DAEMON_THREADS; i++) {
+        if (!ytdlp_thread_start(&d->threads[i], fake_serve, d)) return false;
+    }
+    return true;
+}
+
+static void fake_stop(FakeDaemon* d) {
+    ytdlp_atomic_store_i32(&d->stop, 1);
+    for (int i = 0; i < DAEMON_THREADS; i++) {
+        ytdlp_thread_join(d->threads[i]);
+    }
+    ytdlp_daemon_unlisten(d->fd, d->endpoint);
+}
+
+/* ============================================================================
+ * Client
+ * ========================================================================== */
+
+static char g_endpoints[512];
+
+/* Name of the daemon that answered for `key` within `timeout_ms`; "" if none did */
+static YtdlpDaemonResult call_within(const char* endpoints, const char* key, const char* path, int timeout_ms,
+                                     char* answered_by, size_t size) {
+    YtdlpArena* arena = &ytdlp_scratch()->arena;
+    YtdlpArenaMark mark = ytdlp_arena_mark(arena);
+
+    YtdlpStreamBuilder b;
+    ytdlp_builder_init(&b, arena);
+
+    char url[256];
+    snprintf(url, sizeof(url), "https://example.com/%s/%s", path, key);
+    YtdlpDaemonRequest request;
+    memset(&request, 0, sizeof(request));
+    request.op = YTDLP_DAEMON_RESOLVE;
+    request.url = url;
+
+    answered_by[0] = '\0';
+    YtdlpDaemonResult result = ytdlp_daemon_call(endpoints, key, &request, timeout_ms, &b);
+    if (result == YTDLP_DAEMON_ANSWERED && b.stream.title) {
+        snprintf(answered_by, size, "%s", b.stream.title);
+    }
+    ytdlp_arena_release(arena, mark);
+    return result;
+}
+
+static void call(const char* endpoints, const char* key, const char* path, char* answered_by, size_t size) {
+    call_within(endpoints, key, path, 2000, answered_by, size);
+}
+
+static int daemon_index(FakeDaemon* daemons, const char* name) {
+    for (int i = 0; i < DAEMONS; i++) {
+        if (strcmp(daemons[i].endpoint, name) == 0) return i;
+    }
+    return -1;
+}
+
+/* Which daemon answers each key, -1 if none */
+static void route_all(FakeDaemon* daemons, int* owner) {
+    char key[32];
+    char name[128];
+    for (int k = 0; k < KEYS; k++) {
+        snprintf(key, sizeof(key), "youtube:%08d", k);
+        call(g_endpoints, key, "watch", name, sizeof(name));
+        owner[k] = daemon_index(daemons, name);
+    }
+}
+
+typedef struct HotCaller {
+    YtdlpThread thread;
+    char answered_by[128];
+} HotCaller;
+
+static void hot_call(void* arg) {
+    HotCaller* c = (HotCaller*)arg;
+    call(g_endpoints, "youtube:hot", "hot", c->answered_by, sizeof(c->answered_by));
+}
+
+/* ============================================================================
+ * Tests
+ * ========================================================================== */
+
+static void run_routing(FakeDaemon* daemons) {
+    static int owner[KEYS];
+    static int again[KEYS];
+
+    route_all(daemons, owner);
+    int counts[DAEMONS] = { 0 };
+    bool all_answered = true;
+    for (int k = 0; k < KEYS; k++) {
+        if (owner[k] < 0) all_answered = false;
+        else counts[owner[k]]++;
+    }
+    if (g_verbose) printf("  keys per daemon: %d %d %d\n", counts[0], counts[1], counts[2]);
+    check(all_answered, "every key is answered");
+
+    bool spread = true;
+    for (int i = 0; i < DAEMONS; i++) {
+        if (counts[i] < KEYS / 5 || counts[i] > KEYS / 2) spread = false;
+    }
+    check(spread, "keys spread over every endpoint");
+
+    route_all(daemons, again);
+    check(memcmp(owner, again, sizeof(owner)) == 0, "a key always goes to the same endpoint");
+
+    /* Same endpoints listed in another order: the ring is the same */
+    char reordered[512];
+    snprintf(reordered, sizeof(reordered), "%s, %s,%s", daemons[2].endpoint, daemons[0].endpoint, daemons[1].endpoint);
+    bool same = true;
+    char key[32];
+    char name[128];
+    for (int k = 0; k < KEYS; k += 7) {
+        snprintf(key, sizeof(key), "youtube:%08d", k);
+        call(reordered, key, "watch", name, sizeof(name));
+        if (daemon_index(daemons, name) != owner[k]) same = false;
+    }
+    check(same, "the order of the endpoint list does not matter");
+
+    /* Lose one endpoint: only its keys move, and they are still answered */
+    fake_stop(&daemons[1]);
+    route_all(daemons, again);
+    bool others_stay = true;
+    bool moved_answered = true;
+    for (int k = 0; k < KEYS; k++) {
+        if (owner[k] != 1 && again[k] != owner[k]) others_stay = false;
+        if (owner[k] == 1 && (again[k] < 0 || again[k] == 1)) moved_answered = false;
+    }
+    check(others_stay, "keys of endpoints still up stay put");
+    check(moved_answered, "keys of a stopped endpoint fail over to the next one");
+
+    /* Bring it back: health checks notice within a couple of seconds */
+    bool restarted = fake_start(&daemons[1]);
+    check(restarted, "stopped endpoint restarts");
+    ytdlp_sleep_ms(2500);
+    route_all(daemons, again);
+    check(memcmp(owner, again, sizeof(owner)) == 0, "a restarted endpoint gets its keys back");
+}
+
+static void run_hot_key(FakeDaemon* daemons) {
+    char primary[128];
+    call(g_endpoints, "youtube:hot", "cold", primary, sizeof(primary));
+
+    for (int i = 0; i < DAEMONS; i++) ytdlp_atomic_store_i32(&daemons[i].served, 0);
+
+    HotCaller callers[HOT_CALLERS];
+    int started = 0;
+    for (int i = 0; i < HOT_CALLERS; i++) {
+        memset(&callers[i], 0, sizeof(callers[i]));
+        if (ytdlp_thread_start(&callers[i].thread, hot_call, &callers[i])) started++;
+        ytdlp_sleep_ms(5);
+    }
+    for (int i = 0; i < started; i++) {
+        ytdlp_thread_join(callers[i].thread);
+    }
+
+    int on_primary = 0;
+    int answered = 0;
+    for (int i = 0; i < started; i++) {
+        if (callers[i].answered_by[0]) answered++;
+        if (strcmp(callers[i].answered_by, primary) == 0) on_primary++;
+    }
+    int used = 0;
+    for (int i = 0; i < DAEMONS; i++) {
+        if (ytdlp_atomic_load_i32(&daemons[i].served) > 0) used++;
+    }
+    if (g_verbose) printf("  hot key: %d of %d on its endpoint, %d endpoints used\n", on_primary, started, used);
+
+    check(answered == started, "every hot key request is answered");
+    check(on_primary > 0 && on_primary < started && used > 1, "a hot key spreads past its endpoint's load bound");
+
+    char after[128];
+    call(g_endpoints, "youtube:hot", "cold", after, sizeof(after));
+    check(strcmp(after, primary) == 0, "the key returns to its endpoint once load drops");
+}
+
+static void run_tcp(void) {
+    FakeDaemon d;
+    memset(&d, 0, sizeof(d));
+    snprintf(d.endpoint, sizeof(d.endpoint), "tcp:127.0.0.1:0");
+    d.fd = ytdlp_daemon_listen(d.endpoint, false);
+    check(d.fd >= 0, "listens on TCP");
+    if (d.fd < 0) return;
+
+    /* Name it by the port the kernel picked */
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(d.fd, (struct sockaddr*)&addr, &len);
+    snprintf(d.endpoint, sizeof(d.endpoint), "tcp:127.0.0.1:%d", ntohs(addr.sin_port));
+
+    for (int i = 0; i < DAEMON_THREADS; i++) {
+        ytdlp_thread_start(&d.threads[i], fake_serve, &d);
+    }
+
+    char name[128];
+    call(d.endpoint, "youtube:tcp", "watch", name, sizeof(name));
+    check(strcmp(name, d.endpoint) == 0, "answers over TCP");
+
+    YtdlpDaemonResult result = call_within(d.endpoint, "youtube:tcp", "hot", HOT_DELAY_MS / 3, name, sizeof(name));
+    check(result == YTDLP_DAEMON_TIMED_OUT && name[0] == '\0', "a slow answer is reported as a timeout");
+
+    fake_stop(&d);
+    uint64_t started = ytdlp_monotonic_ms();
+    result = call_within(d.endpoint, "youtube:tcp", "watch", 2000, name, sizeof(name));
+    check(result == YTDLP_DAEMON_UNREACHABLE && ytdlp_monotonic_ms() - started < 1500,
+          "an unreachable endpoint fails the call");
+}
+
+static bool listens_on_loopback(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr*)&addr, &len) != 0) return false;
+    if (addr.ss_family == AF_INET) {
+        return ntohl(((struct sockaddr_in*)&addr)->sin_addr.s_addr) == INADDR_LOOPBACK;
+    }
+    return addr.ss_family == AF_INET6 && IN6_IS_ADDR_LOOPBACK(&((struct sockaddr_in6*)&addr)->sin6_addr);
+}
+
+static void run_tcp_access(void) {
+    int fd = ytdlp_daemon_listen("tcp::0", false);
+    check(fd >= 0 && listens_on_loopback(fd), "a TCP endpoint without a host listens on loopback");
+    if (fd >= 0) ytdlp_daemon_unlisten(fd, "tcp::0");
+
+    errno = 0;
+    fd = ytdlp_daemon_listen("tcp:*:0", false);
+    check(fd < 0 && errno == EACCES, "every interface is refused without allow_remote");
+    if (fd >= 0) ytdlp_daemon_unlisten(fd, "tcp:*:0");
+
+    fd = ytdlp_daemon_listen("tcp:*:0", true);
+    check(fd >= 0 && !listens_on_loopback(fd), "every interface is accepted with allow_remote");
+    if (fd >= 0) ytdlp_daemon_unlisten(fd, "tcp:*:0");
+}
+
+#endif
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        }
+    }
+
+#ifdef _WIN32
+    printf("Resolve daemon tests need unix sockets; skipped\n");
+    return 0;
+#else
+    FakeDaemon* daemons = (FakeDaemon*)calloc(DAEMONS, sizeof(FakeDaemon));
+    if (!daemons) return 1;
+
+    g_endpoints[0] = '\0';
+    bool started = true;
+    for (int i = 0; i < DAEMONS; i++) {
+        snprintf(daemons[i].endpoint, sizeof(daemons[i].endpoint), "/tmp/prism-ytdlp-test-%ld-%d.sock", (long)getpid(), i);
+        if (!fake_start(&daemons[i])) started = false;
+        snprintf(g_endpoints + strlen(g_endpoints), sizeof(g_endpoints) - strlen(g_endpoints),
+            "%s%s", i ? "," : "", daemons[i].endpoint);
+    }
+    check(started, "stand-in daemons listen");
+
+    if (started) {
+        printf("=== Routing ===\n");
+        run_routing(daemons);
+
+        printf("=== Hot Key ===\n");
+        run_hot_key(daemons);
+    }
+
+    for (int i = 0; i < DAEMONS; i++) fake_stop(&daemons[i]);
+    free(daemons);
+
+    printf("=== TCP ===\n");
+    run_tcp();
+    run_tcp_access();
+
+    ytdlp_daemon_shutdown();
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", g_total);
+    printf("  Passed:  %d\n", g_passed);
+    printf("  Failed:  %d\n", g_total - g_passed);
+
+    return g_passed == g_total ? 0 : 1;
+#endif
+}
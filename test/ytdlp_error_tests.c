@@ -0,0 +1,199 @@
+/*
+ * Prism yt-dlp Plugin - Error Class Tests
+ *
+ * Table-driven checks of the error classifier against stderr lines as
+ * yt-dlp prints them, and the plugin's own messages. Several real lines
+ * hold phrases of more than one class, so the table also pins down which
+ * class wins: a geo-blocked video also reads "Video unavailable", and a
+ * throttled or timed-out page download also reads "Unable to download".
+ *
+ * Usage:
+ *   ytdlp_error_tests [--verbose]
+ */
+
+#include "ytdlp_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+static bool g_verbose = false;
+
+/* ============================================================================
+ * Test Table
+ * ========================================================================== */
+
+typedef struct ErrorCase {
+    const char* text;
+    PrismYtdlpErrorClass expected;
+} ErrorCase;
+
+static const ErrorCase g_error_cases[] = {
+    /* Rate limited */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to download API page: HTTP Error 429: Too Many Requests",
+      PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "ERROR: unable to download video data: HTTP Error 429: Too Many Requests",
+      PRISM_YTDLP_ERROR_RATE_LIMITED },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Sign in to confirm you\xe2\x80\x99re not a bot. Use --cookies-from-browser or "
+      "--cookies for the authentication. See  https://github.com/yt-dlp/yt-dlp/wiki/FAQ#how-do-i-pass-cookies-to-yt-dlp  "
+      "for how to manually pass cookies",
+      PRISM_YTDLP_ERROR_RATE_LIMITED },
+
+    /* Age gated */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Sign in to confirm your age. This video may be inappropriate for some users. "
+      "Use --cookies-from-browser or --cookies for the authentication.",
+      PRISM_YTDLP_ERROR_AGE_GATED },
+
+    /* Geo blocked, ahead of "Video unavailable" */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable. The uploader has not made this video available in your country",
+      PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable. This video contains content from SME, who has blocked it in "
+      "your country on copyright grounds",
+      PRISM_YTDLP_ERROR_GEO_BLOCKED },
+    { "ERROR: [BBC] p0bxmb6n: This video is not available from your location due to geo restriction. You might want "
+      "to use a VPN or a proxy server (with --proxy) to workaround.",
+      PRISM_YTDLP_ERROR_GEO_BLOCKED },
+
+    /* Private, members-only or needs a login */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Private video. Sign in if you've been granted access to this video. Use "
+      "--cookies-from-browser or --cookies for the authentication.",
+      PRISM_YTDLP_ERROR_PRIVATE },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Join this channel to get access to members-only content like this video, and "
+      "other exclusive perks.",
+      PRISM_YTDLP_ERROR_PRIVATE },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable. This video is private",
+      PRISM_YTDLP_ERROR_PRIVATE },
+
+    /* Offline live */
+    { "ERROR: [twitch:stream] somechannel: The channel is not currently live",
+      PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "ERROR: [youtube] dQw4w9WgXcQ: This live event will begin in 3 hours.",
+      PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Premieres in 2 days",
+      PRISM_YTDLP_ERROR_OFFLINE_LIVE },
+
+    /* Removed */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable",
+      PRISM_YTDLP_ERROR_REMOVED },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable. This video has been removed by the uploader",
+      PRISM_YTDLP_ERROR_REMOVED },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Video unavailable. This video is no longer available because the YouTube "
+      "account associated with this video has been terminated.",
+      PRISM_YTDLP_ERROR_REMOVED },
+    { "ERROR: [vimeo] 76979871: Unable to download JSON metadata: HTTP Error 404: Not Found",
+      PRISM_YTDLP_ERROR_REMOVED },
+
+    /* Unsupported */
+    { "ERROR: Unsupported URL: https://example.com/page",
+      PRISM_YTDLP_ERROR_UNSUPPORTED },
+    { "Invalid URL",
+      PRISM_YTDLP_ERROR_UNSUPPORTED },
+
+    /* Extractor broken */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to extract initial player response; please report this issue on  "
+      "https://github.com/yt-dlp/yt-dlp/issues?q= , filling out the appropriate issue template. Confirm you are on "
+      "the latest version using  yt-dlp -U",
+      PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Signature extraction failed: Some formats may be missing",
+      PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+    { "Failed to parse yt-dlp output",
+      PRISM_YTDLP_ERROR_EXTRACTOR_BROKEN },
+
+    /* Timeout, ahead of "Unable to download" */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to download API page: The read operation timed out (caused by "
+      "TransportError('The read operation timed out'))",
+      PRISM_YTDLP_ERROR_TIMEOUT },
+    { "Process timed out",
+      PRISM_YTDLP_ERROR_TIMEOUT },
+
+    /* Network */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to download API page: [Errno -3] Temporary failure in name resolution "
+      "(caused by TransportError('[Errno -3] Temporary failure in name resolution'))",
+      PRISM_YTDLP_ERROR_NETWORK },
+    { "ERROR: [generic] Unable to download webpage: <urlopen error [Errno 111] Connection refused> (caused by "
+      "TransportError('<urlopen error [Errno 111] Connection refused>'))",
+      PRISM_YTDLP_ERROR_NETWORK },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to download webpage: HTTP Error 503: Service Unavailable",
+      PRISM_YTDLP_ERROR_NETWORK },
+    { "ERROR: [youtube] dQw4w9WgXcQ: Unable to download webpage: [SSL: CERTIFICATE_VERIFY_FAILED] certificate "
+      "verify failed: unable to get local issuer certificate (_ssl.c:1006)",
+      PRISM_YTDLP_ERROR_NETWORK },
+
+    /* Unknown */
+    { "ERROR: [youtube] dQw4w9WgXcQ: Requested format is not available. Use --list-formats for a list of available "
+      "formats",
+      PRISM_YTDLP_ERROR_UNKNOWN },
+    { "",
+      PRISM_YTDLP_ERROR_UNKNOWN },
+    { NULL,
+      PRISM_YTDLP_ERROR_UNKNOWN },
+};
+
+/* ============================================================================
+ * Runner
+ * ========================================================================== */
+
+static bool run_error_case(const ErrorCase* c) {
+    PrismYtdlpErrorClass got = ytdlp_classify_error(c->text);
+    bool pass = got == c->expected;
+
+    if (!pass || g_verbose) {
+        printf("  [%s] %-16s got %-16s %.72s\n", pass ? "PASS" : "FAIL",
+            prism_ytdlp_error_class_name(c->expected), prism_ytdlp_error_class_name(got),
+            c->text ? c->text : "(null)");
+    }
+    return pass;
+}
+
+/* Only the tail of long output is matched: the error line yt-dlp prints
+ * last decides, not a warning of a higher class buried in the output
+ * before it */
+static bool run_long_output_case(void) {
+    size_t filler = 8192;
+    const char* warning = "WARNING: [youtube] HTTP Error 429: Too Many Requests. Retrying (1/3)...\n";
+    const char* error = "ERROR: [youtube] dQw4w9WgXcQ: Unable to download API page: The read operation timed out";
+
+    char* text = (char*)malloc(strlen(warning) + filler + strlen(error) + 1);
+    if (!text) return false;
+    strcpy(text, warning);
+    memset(text + strlen(warning), '.', filler);
+    strcpy(text + strlen(warning) + filler, error);
+
+    PrismYtdlpErrorClass got = ytdlp_classify_error(text);
+    free(text);
+
+    bool pass = got == PRISM_YTDLP_ERROR_TIMEOUT;
+    if (!pass || g_verbose) {
+        printf("  [%s] long output ends in a timeout: got %s\n",
+            pass ? "PASS" : "FAIL", prism_ytdlp_error_class_name(got));
+    }
+    return pass;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        }
+    }
+
+    int total = 0;
+    int passed = 0;
+
+    printf("=== Error Classes ===\n");
+    for (size_t i = 0; i < sizeof(g_error_cases) / sizeof(g_error_cases[0]); i++) {
+        total++;
+        if (run_error_case(&g_error_cases[i])) passed++;
+    }
+
+    printf("=== Long Output ===\n");
+    total++;
+    if (run_long_output_case()) passed++;
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", total);
+    printf("  Passed:  %d\n", passed);
+    printf("  Failed:  %d\n", total - passed);
+
+    return passed == total ? 0 : 1;
+}
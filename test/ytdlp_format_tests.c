@@ -0,0 +1,438 @@
+/*
+ * Prism yt-dlp Plugin - Format Selector Tests
+ *
+ * Table-driven checks that the in-process format selector picks the same
+ * formats yt-dlp does. Each fixture is a format ladder in the order yt-dlp
+ * sorts it, and every expected result was recorded from yt-dlp 2026.08.19
+ * running `--load-info-json <fixture> -f <selector> --print format_id`.
+ *
+ * Usage:
+ *   ytdlp_format_tests [--verbose]
+ */
+
+#include "ytdlp_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* ============================================================================
+ * Test Tables
+ * ========================================================================== */
+
+typedef struct Fixture {
+    const char* name;
+    bool is_live;
+    const PrismYtdlpFormat* formats;
+    int count;
+} Fixture;
+
+typedef struct ChainCase {
+    const char* fixture;
+    PrismStreamQuality quality;
+    const char* expected;  /* format_id, "video+audio" for merges, NULL for no match */
+} ChainCase;
+
+typedef struct SelectorCase {
+    const char* fixture;
+    const char* selector;
+    const char* expected;
+} SelectorCase;
+
+static const PrismYtdlpFormat s_youtube_vod[] = {
+    { "sb0", "https://media.example/sb0", "mhtml", "mhtml", "none", "none", NULL, 80, 45, 0.5, 0, 0, NULL, NULL, 0, NULL },
+    { "139", "https://media.example/139", "m4a", "https", "none", "mp4a.40.5", "en", 0, 0, 0, 48, 0, NULL, NULL, 0, NULL },
+    { "140", "https://media.example/140", "m4a", "https", "none", "mp4a.40.2", "en", 0, 0, 0, 129, 0, NULL, NULL, 0, NULL },
+    { "140-1", "https://media.example/140-1", "m4a", "https", "none", "mp4a.40.2", "de", 0, 0, 0, 129, 0, NULL, NULL, 0, NULL },
+    { "249", "https://media.example/249", "webm", "https", "none", "opus", "en", 0, 0, 0, 50, 0, NULL, NULL, 0, NULL },
+    { "251", "https://media.example/251", "webm", "https", "none", "opus", "en", 0, 0, 0, 140, 0, NULL, NULL, 0, NULL },
+    { "160", "https://media.example/160", "mp4", "https", "avc1.4d401f", "none", NULL, 256, 144, 30, 110, 0, NULL, NULL, 0, NULL },
+    { "278", "https://media.example/278", "webm", "https", "vp9", "none", NULL, 256, 144, 30, 90, 0, NULL, NULL, 0, NULL },
+    { "133", "https://media.example/133", "mp4", "https", "avc1.4d401f", "none", NULL, 426, 240, 30, 250, 0, NULL, NULL, 0, NULL },
+    { "134", "https://media.example/134", "mp4", "https", "avc1.4d401f", "none", NULL, 640, 360, 30, 400, 0, NULL, NULL, 0, NULL },
+    { "18", "https://media.example/18", "mp4", "https", "avc1.42001E", "mp4a.40.2", NULL, 640, 360, 30, 600, 0, NULL, NULL, 0, NULL },
+    { "93", "https://media.example/93", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 640, 360, 30, 700, 0, NULL, NULL, 0, NULL },
+    { "243", "https://media.example/243", "webm", "https", "vp9", "none", NULL, 640, 360, 30, 300, 0, NULL, NULL, 0, NULL },
+    { "135", "https://media.example/135", "mp4", "https", "avc1.4d401f", "none", NULL, 853, 480, 30, 700, 0, NULL, NULL, 0, NULL },
+    { "136", "https://media.example/136", "mp4", "https", "avc1.4d401f", "none", NULL, 1280, 720, 30, 1300, 0, NULL, NULL, 0, NULL },
+    { "95", "https://media.example/95", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1280, 720, 30, 1500, 0, NULL, NULL, 0, NULL },
+    { "247", "https://media.example/247", "webm", "https", "vp9", "none", NULL, 1280, 720, 30, 1000, 0, NULL, NULL, 0, NULL },
+    { "298", "https://media.example/298", "mp4", "https", "avc1.4d401f", "none", NULL, 1280, 720, 60, 2000, 0, NULL, NULL, 0, NULL },
+    { "137", "https://media.example/137", "mp4", "https", "avc1.4d401f", "none", NULL, 1920, 1080, 30, 2600, 0, NULL, NULL, 0, NULL },
+    { "96", "https://media.example/96", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1920, 1080, 30, 3000, 0, NULL, NULL, 0, NULL },
+    { "248", "https://media.example/248", "webm", "https", "vp9", "none", NULL, 1920, 1080, 30, 2000, 0, NULL, NULL, 0, NULL },
+    { "299", "https://media.example/299", "mp4", "https", "avc1.4d401f", "none", NULL, 1920, 1080, 60, 4000, 0, NULL, NULL, 0, NULL },
+    { "271", "https://media.example/271", "webm", "https", "vp9", "none", NULL, 2560, 1440, 30, 5000, 0, NULL, NULL, 0, NULL },
+    { "400", "https://media.example/400", "mp4", "https", "av01.0.12M.08", "none", NULL, 2560, 1440, 30, 6000, 0, NULL, NULL, 0, NULL },
+    { "313", "https://media.example/313", "webm", "https", "vp9", "none", NULL, 3840, 2160, 30, 12000, 0, NULL, NULL, 0, NULL },
+    { "401", "https://media.example/401", "mp4", "https", "av01.0.12M.08", "none", NULL, 3840, 2160, 30, 14000, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_youtube_live[] = {
+    { "91", "https://media.example/91", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 256, 144, 30, 290, 0, NULL, NULL, 0, NULL },
+    { "92", "https://media.example/92", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 426, 240, 30, 550, 0, NULL, NULL, 0, NULL },
+    { "93", "https://media.example/93", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 640, 360, 30, 1000, 0, NULL, NULL, 0, NULL },
+    { "94", "https://media.example/94", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 853, 480, 30, 1300, 0, NULL, NULL, 0, NULL },
+    { "95", "https://media.example/95", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1280, 720, 30, 2600, 0, NULL, NULL, 0, NULL },
+    { "300", "https://media.example/300", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1280, 720, 60, 4000, 0, NULL, NULL, 0, NULL },
+    { "96", "https://media.example/96", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1920, 1080, 30, 4600, 0, NULL, NULL, 0, NULL },
+    { "301", "https://media.example/301", "mp4", "m3u8_native", "avc1.4d401f", "mp4a.40.2", NULL, 1920, 1080, 60, 6000, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_mixed_live[] = {
+    { "audio_only", "https://media.example/audio_only", "mp4", "m3u8_native", "none", "mp4a.40.2", NULL, 0, 0, 0, 160, 0, NULL, NULL, 0, NULL },
+    { "160p", "https://media.example/160p", "mp4", "m3u8", "avc1.4D401F", "mp4a.40.2", NULL, 284, 160, 30, 230, 0, NULL, NULL, 0, NULL },
+    { "360p", "https://media.example/360p", "mp4", "m3u8", "avc1.4D401F", "mp4a.40.2", NULL, 640, 360, 30, 630, 0, NULL, NULL, 0, NULL },
+    { "480p", "https://media.example/480p", "mp4", "m3u8", "avc1.4D401F", "mp4a.40.2", NULL, 853, 480, 30, 1400, 0, NULL, NULL, 0, NULL },
+    { "dash-720", "https://media.example/dash-720", "mp4", "https", "avc1.4D401F", "mp4a.40.2", NULL, 1280, 720, 30, 2500, 0, NULL, NULL, 0, NULL },
+    { "720p60", "https://media.example/720p60", "mp4", "m3u8", "avc1.4D401F", "mp4a.40.2", NULL, 1280, 720, 60, 3000, 0, NULL, NULL, 0, NULL },
+    { "1080p60", "https://media.example/1080p60", "mp4", "m3u8", "avc1.4D401F", "mp4a.40.2", NULL, 1920, 1080, 60, 6000, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_audio_only[] = {
+    { "http_mp3_128", "https://media.example/http_mp3_128", "mp3", "https", "none", "mp3", NULL, 0, 0, 0, 128, 0, NULL, NULL, 0, NULL },
+    { "hls_opus_64", "https://media.example/hls_opus_64", "opus", "m3u8_native", "none", "opus", NULL, 0, 0, 0, 64, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_video_only[] = {
+    { "gif", "https://media.example/gif", "mp4", "https", "avc1", "none", NULL, 640, 480, 0, 0, 0, NULL, NULL, 0, NULL },
+    { "webm", "https://media.example/webm", "webm", "https", "vp9", "none", NULL, 640, 480, 0, 0, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_progressive[] = {
+    { "http-360p", "https://media.example/http-360p", "mp4", "https", "avc1", "mp4a.40.2", NULL, 640, 360, 25, 800, 0, NULL, NULL, 0, NULL },
+    { "http-540p", "https://media.example/http-540p", "mp4", "https", "avc1", "mp4a.40.2", NULL, 960, 540, 25, 1500, 0, NULL, NULL, 0, NULL },
+    { "http-720p", "https://media.example/http-720p", "mp4", "https", "avc1", "mp4a.40.2", NULL, 1280, 720, 25, 2500, 0, NULL, NULL, 0, NULL },
+    { "hls-720p", "https://media.example/hls-720p", "mp4", "m3u8_native", "avc1", "mp4a.40.2", NULL, 1280, 720, 25, 2600, 0, NULL, NULL, 0, NULL },
+    { "http-1080p", "https://media.example/http-1080p", "mp4", "https", "avc1", "mp4a.40.2", NULL, 1920, 1080, 25, 5000, 0, NULL, NULL, 0, NULL },
+    { "hls-1080p", "https://media.example/hls-1080p", "mp4", "m3u8_native", "avc1", "mp4a.40.2", NULL, 1920, 1080, 25, 5100, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_webm_only[] = {
+    { "a", "https://media.example/a", "webm", "https", "none", "opus", NULL, 0, 0, 0, 128, 0, NULL, NULL, 0, NULL },
+    { "v480", "https://media.example/v480", "webm", "https", "vp9", "opus", NULL, 853, 480, 0, 800, 0, NULL, NULL, 0, NULL },
+    { "v1080", "https://media.example/v1080", "webm", "https", "vp9", "opus", NULL, 1920, 1080, 0, 3000, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_no_metadata[] = {
+    { "0", "https://media.example/0.mp4", "mp4", "https", NULL, NULL, NULL, 0, 0, 0, 0, 0, NULL, NULL, 0, NULL },
+};
+
+static const PrismYtdlpFormat s_dash_no_muxed[] = {
+    { "a1", "https://media.example/a1", "m4a", "https", "none", "mp4a.40.2", NULL, 0, 0, 0, 128, 0, NULL, NULL, 0, NULL },
+    { "v1", "https://media.example/v1", "mp4", "https", "avc1", "none", NULL, 1280, 720, 30, 1000, 0, NULL, NULL, 0, NULL },
+    { "v2", "https://media.example/v2", "webm", "https", "vp9", "none", NULL, 1920, 1080, 30, 2000, 0, NULL, NULL, 0, NULL },
+};
+
+#define FIXTURE(name, live) { #name, live, s_##name, (int)(sizeof(s_##name) / sizeof(s_##name[0])) }
+
+static const Fixture g_fixtures[] = {
+    FIXTURE(youtube_vod, false),
+    FIXTURE(youtube_live, true),
+    FIXTURE(mixed_live, true),
+    FIXTURE(audio_only, false),
+    FIXTURE(video_only, false),
+    FIXTURE(progressive, false),
+    FIXTURE(webm_only, false),
+    FIXTURE(no_metadata, false),
+    FIXTURE(dash_no_muxed, false),
+};
+
+/* Resolver fallback chain for each quality; live fixtures use the live chain */
+static const ChainCase g_chain_cases[] = {
+    { "youtube_vod", PRISM_QUALITY_AUTO, "298+140-1" },
+    { "youtube_vod", PRISM_QUALITY_LOW, "134+140-1" },
+    { "youtube_vod", PRISM_QUALITY_MEDIUM, "135+140-1" },
+    { "youtube_vod", PRISM_QUALITY_HIGH, "298+140-1" },
+    { "youtube_vod", PRISM_QUALITY_FULL, "299+140-1" },
+    { "youtube_vod", PRISM_QUALITY_QHD, "400+140-1" },
+    { "youtube_vod", PRISM_QUALITY_4K, "401+140-1" },
+    { "youtube_vod", (PrismStreamQuality)240, "133+140-1" },
+    { "youtube_vod", (PrismStreamQuality)1000, "298+140-1" },
+    { "youtube_live", PRISM_QUALITY_AUTO, "300" },
+    { "youtube_live", PRISM_QUALITY_LOW, "93" },
+    { "youtube_live", PRISM_QUALITY_MEDIUM, "94" },
+    { "youtube_live", PRISM_QUALITY_HIGH, "300" },
+    { "youtube_live", PRISM_QUALITY_FULL, "301" },
+    { "youtube_live", PRISM_QUALITY_QHD, "301" },
+    { "youtube_live", PRISM_QUALITY_4K, "301" },
+    { "youtube_live", (PrismStreamQuality)240, "92" },
+    { "youtube_live", (PrismStreamQuality)1000, "300" },
+    { "mixed_live", PRISM_QUALITY_AUTO, "dash-720" },
+    { "mixed_live", PRISM_QUALITY_LOW, "360p" },
+    { "mixed_live", PRISM_QUALITY_MEDIUM, "480p" },
+    { "mixed_live", PRISM_QUALITY_HIGH, "dash-720" },
+    { "mixed_live", PRISM_QUALITY_FULL, "dash-720" },
+    { "mixed_live", PRISM_QUALITY_QHD, "dash-720" },
+    { "mixed_live", PRISM_QUALITY_4K, "dash-720" },
+    { "mixed_live", (PrismStreamQuality)240, "160p" },
+    { "mixed_live", (PrismStreamQuality)1000, "dash-720" },
+    { "audio_only", PRISM_QUALITY_AUTO, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_LOW, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_MEDIUM, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_HIGH, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_FULL, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_QHD, "hls_opus_64" },
+    { "audio_only", PRISM_QUALITY_4K, "hls_opus_64" },
+    { "audio_only", (PrismStreamQuality)240, "hls_opus_64" },
+    { "audio_only", (PrismStreamQuality)1000, "hls_opus_64" },
+    { "video_only", PRISM_QUALITY_AUTO, "gif" },
+    { "video_only", PRISM_QUALITY_LOW, "gif" },
+    { "video_only", PRISM_QUALITY_MEDIUM, "gif" },
+    { "video_only", PRISM_QUALITY_HIGH, "gif" },
+    { "video_only", PRISM_QUALITY_FULL, "gif" },
+    { "video_only", PRISM_QUALITY_QHD, "gif" },
+    { "video_only", PRISM_QUALITY_4K, "gif" },
+    { "video_only", (PrismStreamQuality)240, "gif" },
+    { "video_only", (PrismStreamQuality)1000, "gif" },
+    { "progressive", PRISM_QUALITY_AUTO, "hls-720p" },
+    { "progressive", PRISM_QUALITY_LOW, "http-360p" },
+    { "progressive", PRISM_QUALITY_MEDIUM, "http-360p" },
+    { "progressive", PRISM_QUALITY_HIGH, "hls-720p" },
+    { "progressive", PRISM_QUALITY_FULL, "hls-1080p" },
+    { "progressive", PRISM_QUALITY_QHD, "hls-1080p" },
+    { "progressive", PRISM_QUALITY_4K, "hls-1080p" },
+    { "progressive", (PrismStreamQuality)240, "hls-1080p" },
+    { "progressive", (PrismStreamQuality)1000, "hls-720p" },
+    { "webm_only", PRISM_QUALITY_AUTO, "v1080" },
+    { "webm_only", PRISM_QUALITY_LOW, "v1080" },
+    { "webm_only", PRISM_QUALITY_MEDIUM, "v1080" },
+    { "webm_only", PRISM_QUALITY_HIGH, "v1080" },
+    { "webm_only", PRISM_QUALITY_FULL, "v1080" },
+    { "webm_only", PRISM_QUALITY_QHD, "v1080" },
+    { "webm_only", PRISM_QUALITY_4K, "v1080" },
+    { "webm_only", (PrismStreamQuality)240, "v1080" },
+    { "webm_only", (PrismStreamQuality)1000, "v1080" },
+    { "no_metadata", PRISM_QUALITY_AUTO, "0" },
+    { "no_metadata", PRISM_QUALITY_LOW, "0" },
+    { "no_metadata", PRISM_QUALITY_MEDIUM, "0" },
+    { "no_metadata", PRISM_QUALITY_HIGH, "0" },
+    { "no_metadata", PRISM_QUALITY_FULL, "0" },
+    { "no_metadata", PRISM_QUALITY_QHD, "0" },
+    { "no_metadata", PRISM_QUALITY_4K, "0" },
+    { "no_metadata", (PrismStreamQuality)240, "0" },
+    { "no_metadata", (PrismStreamQuality)1000, "0" },
+    { "dash_no_muxed", PRISM_QUALITY_AUTO, "v1+a1" },
+    { "dash_no_muxed", PRISM_QUALITY_LOW, NULL },
+    { "dash_no_muxed", PRISM_QUALITY_MEDIUM, NULL },
+    { "dash_no_muxed", PRISM_QUALITY_HIGH, "v1+a1" },
+    { "dash_no_muxed", PRISM_QUALITY_FULL, "v1+a1" },
+    { "dash_no_muxed", PRISM_QUALITY_QHD, "v1+a1" },
+    { "dash_no_muxed", PRISM_QUALITY_4K, "v1+a1" },
+    { "dash_no_muxed", (PrismStreamQuality)240, NULL },
+    { "dash_no_muxed", (PrismStreamQuality)1000, "v1+a1" },
+};
+
+static const SelectorCase g_selector_cases[] = {
+    { "youtube_vod", "best", "96" },
+    { "youtube_vod", "worst", "18" },
+    { "youtube_vod", "bv*+ba/b", "401+251" },
+    { "youtube_vod", "b*", "401" },
+    { "youtube_vod", "w*", "139" },
+    { "youtube_vod", "bestvideo", "401" },
+    { "youtube_vod", "bestvideo.2", "313" },
+    { "youtube_vod", "bestaudio", "251" },
+    { "youtube_vod", "wa", "139" },
+    { "youtube_vod", "ba*", "96" },
+    { "youtube_vod", "bv*", "401" },
+    { "youtube_vod", "mp4", "96" },
+    { "youtube_vod", "m4a", "140-1" },
+    { "youtube_vod", "webm", NULL },
+    { "youtube_vod", "mhtml", "sb0" },
+    { "youtube_vod", "137", "137" },
+    { "youtube_vod", "bestaudio+bestvideo", "251+401" },
+    { "youtube_vod", "bv[vcodec^=avc1]", "299" },
+    { "youtube_vod", "bv[vcodec!^=avc1]", "401" },
+    { "youtube_vod", "bv[vcodec*=01]", "401" },
+    { "youtube_vod", "bv[vcodec$=08]", "401" },
+    { "youtube_vod", "bv[vcodec!*=av01][height>=720]", "313" },
+    { "youtube_vod", "ba[language=en]", "251" },
+    { "youtube_vod", "ba[language=de]", "140-1" },
+    { "youtube_vod", "ba[language!=en]", "140-1" },
+    { "youtube_vod", "ba[language=?fr]", NULL },
+    { "youtube_vod", "b[fps>30]", NULL },
+    { "youtube_vod", "bv[fps>30]", "299" },
+    { "youtube_vod", "bv[fps>?30]", "299" },
+    { "youtube_vod", "b[height<=?480]", "93" },
+    { "youtube_vod", "b[height<480]", "93" },
+    { "youtube_vod", "b[height=720]", "95" },
+    { "youtube_vod", "b[height!=720]", "96" },
+    { "youtube_vod", "bv[ext=webm][height=1080]", "248" },
+    { "youtube_vod", "best[protocol=m3u8_native]", "96" },
+    { "youtube_vod", "best[protocol^=m3u8]", "96" },
+    { "youtube_vod", "w[height>=720]", "95" },
+    { "youtube_vod", "b[tbr>1000][tbr<3000]", "95" },
+    { "youtube_vod", "bv[filesize<100]", NULL },
+    { "youtube_vod", "bv[filesize<?100]", "401" },
+    { "youtube_vod", "b[format_id=18]", NULL },
+    { "youtube_vod", "b[format_id='18']", "18" },
+    { "youtube_vod", "bv[width>=1920]", "401" },
+    { "youtube_vod", "ba[ext=m4a]/ba", "140-1" },
+    { "youtube_vod", "nope/best[height<=360]", "93" },
+    { "youtube_vod", "ba[acodec=opus]+bv[ext=webm]", "251+313" },
+    { "youtube_vod", "bv.3[ext=mp4]", "299" },
+    { "youtube_live", "best", "301" },
+    { "youtube_live", "worst", "91" },
+    { "youtube_live", "bv*+ba/b", "301" },
+    { "youtube_live", "w*", "91" },
+    { "youtube_live", "bestvideo", NULL },
+    { "youtube_live", "bestaudio", NULL },
+    { "youtube_live", "mp4", "301" },
+    { "youtube_live", "webm", NULL },
+    { "mixed_live", "best", "1080p60" },
+    { "mixed_live", "worst", "160p" },
+    { "mixed_live", "bv*+ba/b", "1080p60" },
+    { "mixed_live", "w*", "audio_only" },
+    { "mixed_live", "bestvideo", NULL },
+    { "mixed_live", "bestaudio", "audio_only" },
+    { "mixed_live", "mp4", "1080p60" },
+    { "mixed_live", "webm", NULL },
+    { "audio_only", "best", "hls_opus_64" },
+    { "audio_only", "worst", "http_mp3_128" },
+    { "audio_only", "bv*+ba/b", "hls_opus_64" },
+    { "audio_only", "w*", "http_mp3_128" },
+    { "audio_only", "bestvideo", NULL },
+    { "audio_only", "bestaudio", "hls_opus_64" },
+    { "audio_only", "mp4", NULL },
+    { "audio_only", "webm", NULL },
+    { "video_only", "best", "webm" },
+    { "video_only", "worst", "gif" },
+    { "video_only", "bv*+ba/b", "webm" },
+    { "video_only", "w*", "gif" },
+    { "video_only", "bestvideo", "webm" },
+    { "video_only", "bestaudio", NULL },
+    { "video_only", "mp4", "gif" },
+    { "video_only", "webm", "webm" },
+    { "progressive", "best", "hls-1080p" },
+    { "progressive", "worst", "http-360p" },
+    { "progressive", "bv*+ba/b", "hls-1080p" },
+    { "progressive", "w*", "http-360p" },
+    { "progressive", "bestvideo", NULL },
+    { "progressive", "bestaudio", NULL },
+    { "progressive", "mp4", "hls-1080p" },
+    { "progressive", "webm", NULL },
+    { "webm_only", "best", "v1080" },
+    { "webm_only", "worst", "v480" },
+    { "webm_only", "bv*+ba/b", "v1080" },
+    { "webm_only", "w*", "a" },
+    { "webm_only", "bestvideo", NULL },
+    { "webm_only", "bestaudio", "a" },
+    { "webm_only", "mp4", NULL },
+    { "webm_only", "webm", "v1080" },
+    { "no_metadata", "best", "0" },
+    { "no_metadata", "worst", "0" },
+    { "no_metadata", "bv*+ba/b", "0" },
+    { "no_metadata", "w*", "0" },
+    { "no_metadata", "bestvideo", NULL },
+    { "no_metadata", "bestaudio", NULL },
+    { "no_metadata", "mp4", "0" },
+    { "no_metadata", "webm", NULL },
+    { "dash_no_muxed", "best", NULL },
+    { "dash_no_muxed", "worst", NULL },
+    { "dash_no_muxed", "bv*+ba/b", "v2+a1" },
+    { "dash_no_muxed", "w*", "a1" },
+    { "dash_no_muxed", "bestvideo", "v2" },
+    { "dash_no_muxed", "bestaudio", "a1" },
+    { "dash_no_muxed", "mp4", "v1" },
+    { "dash_no_muxed", "webm", "v2" },
+};
+
+/* ============================================================================
+ * Test Runner
+ * ========================================================================== */
+
+static bool g_verbose = false;
+
+static const Fixture* find_fixture(const char* name) {
+    for (size_t i = 0; i < sizeof(g_fixtures) / sizeof(g_fixtures[0]); i++) {
+        if (strcmp(g_fixtures[i].name, name) == 0) return &g_fixtures[i];
+    }
+    return NULL;
+}
+
+/* Format a selection the way yt-dlp prints format_id */
+static const char* describe(bool selected, const YtdlpFormatSelection* selection, char* buf, size_t size) {
+    if (!selected) return NULL;
+
+    if (selection->audio) {
+        snprintf(buf, size, "%s+%s", selection->video->format_id, selection->audio->format_id);
+    } else {
+        snprintf(buf, size, "%s", selection->video->format_id);
+    }
+    return buf;
+}
+
+static bool run_case(const char* fixture_name, const char* selector, const char* expected) {
+    const Fixture* fixture = find_fixture(fixture_name);
+    if (!fixture) {
+        printf("  [FAIL] %s: unknown fixture\n", fixture_name);
+        return false;
+    }
+
+    PrismYtdlpFormatList list;
+    memset(&list, 0, sizeof(list));
+    list.is_live = fixture->is_live;
+    list.count = fixture->count;
+    list.formats = fixture->formats;
+
+    YtdlpFormatSelection selection;
+    char buf[128];
+    bool selected = ytdlp_format_select(&list, selector, &selection);
+    const char* actual = describe(selected, &selection, buf, sizeof(buf));
+
+    /* The selector reports merges as video+audio; yt-dlp prints them as written */
+    char swapped[128] = "";
+    const char* plus = expected ? strchr(expected, '+') : NULL;
+    if (plus) {
+        snprintf(swapped, sizeof(swapped), "%s+%.*s", plus + 1, (int)(plus - expected), expected);
+    }
+
+    bool pass = (actual && expected) ?
+                (strcmp(actual, expected) == 0 || strcmp(actual, swapped) == 0) :
+                actual == expected;
+
+    if (!pass || g_verbose) {
+        printf("  [%s] %-14s %-40s expected %-12s got %s\n",
+            pass ? "PASS" : "FAIL", fixture_name, selector,
+            expected ? expected : "(none)", actual ? actual : "(none)");
+    }
+    return pass;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        }
+    }
+
+    int total = 0;
+    int passed = 0;
+
+    printf("=== Quality Chains ===\n");
+    for (size_t i = 0; i < sizeof(g_chain_cases) / sizeof(g_chain_cases[0]); i++) {
+        const ChainCase* c = &g_chain_cases[i];
+        const Fixture* fixture = find_fixture(c->fixture);
+
+        char selector[256];
+        ytdlp_format_chain(selector, sizeof(selector), fixture && fixture->is_live,
+                           ytdlp_quality_height(c->quality));
+
+        total++;
+        if (run_case(c->fixture, selector, c->expected)) passed++;
+    }
+
+    printf("=== Selectors ===\n");
+    for (size_t i = 0; i < sizeof(g_selector_cases) / sizeof(g_selector_cases[0]); i++) {
+        const SelectorCase* c = &g_selector_cases[i];
+        total++;
+        if (run_case(c->fixture, c->selector, c->expected)) passed++;
+    }
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", total);
+    printf("  Passed:  %d\n", passed);
+    printf("  Failed:  %d\n", total - passed);
+
+    return passed == total ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/*
+ * Prism yt-dlp Plugin - In-Flight Extraction Tests
+ *
+ * Many threads resolve the same media at once through one resolver, with a
+ * stand-in yt-dlp that takes a second and logs every extraction. The first
+ * miss must be the only one to run it; the others wait and share its
+ * outcome, whether that is a stream or a failure nobody remembers. A probe
+ * extracts the same way, so a resolve after it needs no second run.
+ *
+ * Usage:
+ *   ytdlp_inflight_tests [--verbose]
+ */
+
+#include "prism_ytdlp_plugin.h"
+#include "ytdlp_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static bool g_verbose = false;
+static int g_total = 0;
+static int g_passed = 0;
+
+static void check(bool pass, const char* name) {
+    g_total++;
+    if (pass) g_passed++;
+    if (!pass || g_verbose) printf("  [%s] %s\n", pass ? "PASS" : "FAIL", name);
+}
+
+#ifndef _WIN32
+
+#define CALLERS 12
+
+#define MEDIA_URL "https://www.youtube.com/watch?v=aaaaaaaaaaa"
+#define BUSY_URL "https://www.youtube.com/watch?v=bbbbbbbbbbb"
+#define PROBED_URL "https://www.youtube.com/watch?v=ccccccccccc"
+
+/* Logs each extraction, then answers after a second: a stream, or for the
+ * busy media a transient error that is not remembered */
+static const char* s_fake_ytdlp =
+    "#!/bin/sh\n"
+    "case \"$*\" in *watch*) ;; *) exit 1;; esac\n"
+    "echo extract >> \"$0.log\"\n"
+    "sleep 1\n"
+    "case \"$*\" in\n"
+    "  *bbbbbbbbbbb*) echo 'ERROR: Unable to download webpage: HTTP Error 503: Service Unavailable' >&2; exit 1;;\n"
+    "esac\n"
+    "echo '{\"id\":\"aaaaaaaaaaa\",\"title\":\"Shared\",\"webpage_url\":\"" MEDIA_URL "\",\"formats\":["
+    "{\"format_id\":\"18\",\"url\":\"https://cdn.example.com/v18?expire=4102444800\",\"ext\":\"mp4\","
+    "\"vcodec\":\"avc1.42001E\",\"acodec\":\"mp4a.40.2\",\"width\":640,\"height\":360}]}'\n";
+
+static char g_ytdlp[256];
+static char g_log[300];
+
+typedef struct Caller {
+    YtdlpThread thread;
+    PrismResolver* resolver;
+    const char* url;
+    bool success;
+    bool has_title;
+    PrismYtdlpErrorClass error_class;
+} Caller;
+
+static void resolve_call(void* arg) {
+    Caller* c = (Caller*)arg;
+    PrismResolverOptions options;
+    prism_resolver_options_init(&options);
+    options.timeout_ms = 10000;
+
+    PrismResolvedStream* stream = c->resolver->vtable->resolve(c->resolver, c->url, &options);
+    if (!stream) return;
+    c->success = stream->success;
+    c->has_title = stream->title && strcmp(stream->title, "Shared") == 0;
+    c->error_class = prism_ytdlp_error_class(stream);
+    prism_ytdlp_free_stream(stream);
+}
+
+static int extractions(void) {
+    FILE* f = fopen(g_log, "r");
+    if (!f) return 0;
+    int count = 0;
+    char line[64];
+    while (fgets(line, sizeof(line), f)) count++;
+    fclose(f);
+    return count;
+}
+
+/* Resolve `url` from CALLERS threads at once; returns how many were started */
+static int resolve_together(PrismResolver* resolver, const char* url, Caller* callers) {
+    int started = 0;
+    for (int i = 0; i < CALLERS; i++) {
+        memset(&callers[i], 0, sizeof(callers[i]));
+        callers[i].resolver = resolver;
+        callers[i].url = url;
+        if (ytdlp_thread_start(&callers[i].thread, resolve_call, &callers[i])) started++;
+    }
+    for (int i = 0; i < started; i++) {
+        ytdlp_thread_join(callers[i].thread);
+    }
+    return started;
+}
+
+static bool write_fake_ytdlp(void) {
+    snprintf(g_ytdlp, sizeof(g_ytdlp), "/tmp/prism-ytdlp-inflight-%ld", (long)getpid());
+    snprintf(g_log, sizeof(g_log), "%s.log", g_ytdlp);
+    remove(g_log);
+
+    FILE* f = fopen(g_ytdlp, "w");
+    if (!f) return false;
+    bool ok = fputs(s_fake_ytdlp, f) >= 0;
+    ok = fclose(f) == 0 && ok;
+    return ok && chmod(g_ytdlp, 0755) == 0;
+}
+
+static void run_shared_stream(PrismResolver* resolver) {
+    Caller callers[CALLERS];
+    int started = resolve_together(resolver, MEDIA_URL, callers);
+
+    bool all_answered = started == CALLERS;
+    for (int i = 0; i < started; i++) {
+        if (!callers[i].success || !callers[i].has_title) all_answered = false;
+    }
+    if (g_verbose) printf("  %d callers, %d extractions\n", started, extractions());
+
+    check(all_answered, "every caller gets the stream");
+    check(extractions() == 1, "concurrent misses for one media run yt-dlp once");
+}
+
+static void run_shared_failure(PrismResolver* resolver) {
+    remove(g_log);
+
+    Caller callers[CALLERS];
+    int started = resolve_together(resolver, BUSY_URL, callers);
+
+    bool all_failed = started == CALLERS;
+    for (int i = 0; i < started; i++) {
+        if (callers[i].success || callers[i].error_class != callers[0].error_class) all_failed = false;
+    }
+    if (g_verbose) printf("  %d callers, %d extractions\n", started, extractions());
+
+    check(all_failed, "every caller gets the same failure");
+    check(extractions() == 1, "a failure that is not remembered is still shared");
+
+    /* Nothing is in flight or remembered now, so the next miss extracts */
+    resolve_together(resolver, BUSY_URL, callers);
+    check(extractions() == 2, "a later miss extracts again");
+}
+
+static void run_probe_then_resolve(PrismResolver* resolver) {
+    remove(g_log);
+
+    PrismResolvedStream* probe = resolver->vtable->probe(resolver, PROBED_URL);
+    check(probe && probe->success && probe->title && strcmp(probe->title, "Shared") == 0,
+          "a probe reads the title from the extraction");
+    prism_ytdlp_free_stream(probe);
+
+    PrismResolverOptions options;
+    prism_resolver_options_init(&options);
+    options.timeout_ms = 10000;
+
+    PrismResolvedStream* stream = resolver->vtable->resolve(resolver, PROBED_URL, &options);
+    check(stream && stream->success && stream->direct_url, "the resolve after it succeeds");
+    prism_ytdlp_free_stream(stream);
+
+    check(extractions() == 1, "a probe and a resolve of one media run yt-dlp once");
+}
+
+#endif
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        }
+    }
+
+#ifdef _WIN32
+    printf("In-flight extraction tests need a POSIX shell; skipped\n");
+    return 0;
+#else
+    bool written = write_fake_ytdlp();
+    check(written, "stand-in yt-dlp is written");
+
+    if (written) {
+        PrismYtdlpConfig config;
+        memset(&config, 0, sizeof(config));
+        config.ytdlp_path = g_ytdlp;
+        config.daemon_endpoints = "";
+        prism_ytdlp_configure(&config);
+
+        PrismYtdlpResolverConfig resolver_config;
+        memset(&resolver_config, 0, sizeof(resolver_config));
+        resolver_config.max_concurrent_resolves = CALLERS;
+
+        PrismResolver* resolver = prism_ytdlp_create_resolver(&resolver_config);
+        check(resolver != NULL, "resolver is created");
+
+        if (resolver) {
+            printf("=== Shared Stream ===\n");
+            run_shared_stream(resolver);
+
+            printf("=== Shared Failure ===\n");
+            run_shared_failure(resolver);
+
+            printf("=== Probe Then Resolve ===\n");
+            run_probe_then_resolve(resolver);
+
+            resolver->vtable->destroy(resolver);
+        }
+
+        ytdlp_process_shutdown();
+        ytdlp_cache_dir_shutdown();
+        ytdlp_zygote_shutdown();
+
+        remove(g_log);
+        remove(g_ytdlp);
+    }
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", g_total);
+    printf("  Passed:  %d\n", g_passed);
+    printf("  Failed:  %d\n", g_total - g_passed);
+
+    return g_passed == g_total ? 0 : 1;
+#endif
+}
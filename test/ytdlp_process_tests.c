@@ -0,0 +1,225 @@
+/*
+ * Prism yt-dlp Plugin - Process Argument Tests
+ *
+ * Argument strings are split into argv in the parent before fork. A quoted
+ * path must reach the child as one argument even when it holds spaces, as
+ * home directories on some systems do, or yt-dlp reads the rest as a URL
+ * and unzip never finds the archive of an unpacked install.
+ *
+ * Usage:
+ *   ytdlp_process_tests [--verbose]
+ */
+
+#include "prism_ytdlp_plugin.h"
+#include "ytdlp_internal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static bool g_verbose = false;
+static int g_total = 0;
+static int g_passed = 0;
+
+static void check(bool pass, const char* name) {
+    g_total++;
+    if (pass) g_passed++;
+    if (!pass || g_verbose) printf("  [%s] %s\n", pass ? "PASS" : "FAIL", name);
+}
+
+#ifndef _WIN32
+
+#define MEDIA_URL "https://www.youtube.com/watch?v=aaaaaaaaaaa"
+
+/* Logs the --cache-dir it was given and the arguments that are not options,
+ * then answers with a stream */
+static const char* s_fake_ytdlp =
+    "#!/bin/sh\n"
+    "case \"$*\" in *watch*) ;; *) exit 1;; esac\n"
+    ": > \"$0.log\"\n"
+    "while [ $# -gt 0 ]; do\n"
+    "  case \"$1\" in\n"
+    "    --cache-dir) shift; echo \"cache $1\" >> \"$0.log\";;\n"
+    "    --extractor-args|--extractor-retries|--socket-timeout) shift;;\n"
+    "    -*) ;;\n"
+    "    *) echo \"url $1\" >> \"$0.log\";;\n"
+    "  esac\n"
+    "  shift\n"
+    "done\n"
+    "echo '{\"id\":\"aaaaaaaaaaa\",\"title\":\"Spaced\",\"webpage_url\":\"" MEDIA_URL "\",\"formats\":["
+    "{\"format_id\":\"18\",\"url\":\"https://cdn.example.com/v18?expire=4102444800\",\"ext\":\"mp4\","
+    "\"vcodec\":\"avc1.42001E\",\"acodec\":\"mp4a.40.2\",\"width\":640,\"height\":360}]}'\n";
+
+/* A stored zip holding "yt-dlp dist/yt-dlp" with the text "2026.08.19\n" */
+static const char s_release_zip[] =
+    "\x50\x4b\x03\x04\x14\x00\x00\x00\x00\x00\x00\x00\x13\x5d\x82\xf6"
+    "\xab\xb1\x0b\x00\x00\x00\x0b\x00\x00\x00\x12\x00\x00\x00\x79\x74"
+    "\x2d\x64\x6c\x70\x20\x64\x69\x73\x74\x2f\x79\x74\x2d\x64\x6c\x70"
+    "\x32\x30\x32\x36\x2e\x30\x38\x2e\x31\x39\x0a\x50\x4b\x01\x02\x14"
+    "\x03\x14\x00\x00\x00\x00\x00\x00\x00\x13\x5d\x82\xf6\xab\xb1\x0b"
+    "\x00\x00\x00\x0b\x00\x00\x00\x12\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x80\x01\x00\x00\x00\x00\x79\x74\x2d\x64\x6c\x70\x20"
+    "\x64\x69\x73\x74\x2f\x79\x74\x2d\x64\x6c\x70\x50\x4b\x05\x06\x00"
+    "\x00\x00\x00\x01\x00\x01\x00\x40\x00\x00\x00\x3b\x00\x00\x00\x00"
+    "\x00";
+
+static char g_root[256];
+static char g_ytdlp[300];
+static char g_log[320];
+
+static bool write_file(const char* path, const char* text, int mode) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    bool ok = fputs(text, f) >= 0;
+    ok = fclose(f) == 0 && ok;
+    return ok && chmod(path, (mode_t)mode) == 0;
+}
+
+static bool read_file(const char* path, char* text, size_t size) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    size_t n = fread(text, 1, size - 1, f);
+    text[n] = '\0';
+    fclose(f);
+    return true;
+}
+
+static void run_argument_splitting(void) {
+    YtdlpProcessResult result = ytdlp_run_process("printf",
+        "\"[%s]\" --cache-dir \"/home/Jane Doe/.cache\" \"\" plain \"a\"\"b\" x\"y z\"", 5000);
+    const char* expected = "[--cache-dir][/home/Jane Doe/.cache][][plain][ab][xy z]";
+    if (g_verbose) printf("  output: %s\n", result.output ? result.output : "(none)");
+
+    check(result.exit_code == 0, "printf runs");
+    check(result.output && strcmp(result.output, expected) == 0,
+          "a quoted span is one argument, spaces included");
+
+    result = ytdlp_run_process("printf", "  \"[%s]\"   one    two  ", 5000);
+    check(result.output && strcmp(result.output, "[one][two]") == 0,
+          "repeated and trailing spaces separate nothing");
+}
+
+static void run_spaced_cache_dir(void) {
+    char cache_dir[400];
+    snprintf(cache_dir, sizeof(cache_dir), "%s/Jane Doe/yt-dlp cache", g_root);
+
+    PrismYtdlpConfig config;
+    memset(&config, 0, sizeof(config));
+    config.ytdlp_path = g_ytdlp;
+    config.daemon_endpoints = "";
+    config.cache_dir = cache_dir;
+    prism_ytdlp_configure(&config);
+
+    PrismResolver* resolver = prism_ytdlp_create_resolver(NULL);
+    check(resolver != NULL, "resolver is created");
+    if (!resolver) return;
+
+    PrismResolverOptions options;
+    prism_resolver_options_init(&options);
+    options.timeout_ms = 10000;
+
+    PrismResolvedStream* stream = resolver->vtable->resolve(resolver, MEDIA_URL, &options);
+    check(stream && stream->success && stream->title && strcmp(stream->title, "Spaced") == 0,
+          "a resolve with a cache dir holding a space succeeds");
+    prism_ytdlp_free_stream(stream);
+
+    char expected[1024], logged[1024] = "";
+    snprintf(expected, sizeof(expected), "cache %s\nurl %s\n", cache_dir, MEDIA_URL);
+    read_file(g_log, logged, sizeof(logged));
+    if (g_verbose) printf("  yt-dlp saw:\n%s", logged);
+    check(strcmp(logged, expected) == 0, "yt-dlp gets the cache dir whole and one URL");
+
+    struct stat st;
+    check(stat(cache_dir, &st) == 0 && S_ISDIR(st.st_mode), "the cache dir is created");
+
+    resolver->vtable->destroy(resolver);
+}
+
+static void run_spaced_zip(void) {
+    char home[320], install_dir[400], zip[500], staging[500], exe[600];
+    snprintf(home, sizeof(home), "%s/Jane Doe", g_root);
+    snprintf(install_dir, sizeof(install_dir), "%s/install dir", home);
+    snprintf(zip, sizeof(zip), "%s/release archive.zip", install_dir);
+    snprintf(staging, sizeof(staging), "%s/.partial", install_dir);
+    snprintf(exe, sizeof(exe), "%s/yt-dlp dist/yt-dlp", staging);
+
+    bool staged = false;
+    FILE* f = NULL;
+    if ((mkdir(home, 0755) == 0 || errno == EEXIST) && mkdir(install_dir, 0755) == 0 && mkdir(staging, 0755) == 0 &&
+        (f = fopen(zip, "wb")) != NULL) {
+        staged = fwrite(s_release_zip, 1, sizeof(s_release_zip) - 1, f) == sizeof(s_release_zip) - 1;
+    }
+    if (f) staged = fclose(f) == 0 && staged;
+    check(staged, "archive is written under a path with spaces");
+
+    char version[64] = "";
+    check(staged && ytdlp_extract_zip(zip, staging), "the archive extracts");
+    check(read_file(exe, version, sizeof(version)) && strcmp(version, "2026.08.19\n") == 0,
+          "the extracted file is where the archive put it");
+
+    remove(exe);
+    snprintf(exe, sizeof(exe), "%s/yt-dlp dist", staging);
+    rmdir(exe);
+    rmdir(staging);
+    remove(zip);
+    rmdir(install_dir);
+}
+
+#endif
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        }
+    }
+
+#ifdef _WIN32
+    printf("Process argument tests need a POSIX shell; skipped\n");
+    return 0;
+#else
+    snprintf(g_root, sizeof(g_root), "/tmp/prism-ytdlp-process-%ld", (long)getpid());
+    snprintf(g_ytdlp, sizeof(g_ytdlp), "%s/yt-dlp", g_root);
+    snprintf(g_log, sizeof(g_log), "%s.log", g_ytdlp);
+
+    bool written = mkdir(g_root, 0755) == 0 && write_file(g_ytdlp, s_fake_ytdlp, 0755);
+    check(written, "stand-in yt-dlp is written");
+
+    printf("=== Argument Splitting ===\n");
+    run_argument_splitting();
+
+    if (written) {
+        printf("=== Cache Dir With A Space ===\n");
+        run_spaced_cache_dir();
+
+        printf("=== Zip Extraction ===\n");
+        run_spaced_zip();
+    }
+
+    ytdlp_process_shutdown();
+    ytdlp_cache_dir_shutdown();
+    ytdlp_zygote_shutdown();
+
+    char path[400];
+    remove(g_log);
+    remove(g_ytdlp);
+    snprintf(path, sizeof(path), "%s/Jane Doe/yt-dlp cache", g_root);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/Jane Doe", g_root);
+    rmdir(path);
+    rmdir(g_root);
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", g_total);
+    printf("  Passed:  %d\n", g_passed);
+    printf("  Failed:  %d\n", g_total - g_passed);
+
+    return g_passed == g_total ? 0 : 1;
+#endif
+}
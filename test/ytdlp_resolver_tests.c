@@ -18,6 +18,18 @@
  *   --timeout <sec>    Set test timeout in seconds (default: 60)
  *   --verbose          Enable verbose logging
  *   --json             Output results as JSON
+ *   --cache-bench <n>  Time n resolves with a cold vs. warm yt-dlp cache directory
+ *   --spawn-bench <n>  Time n yt-dlp launches of each --binary (default: detected path)
+ *   --binary <path>    yt-dlp binary for --spawn-bench (repeatable)
+ *   --python <dir>     Use the embedded Python backend with yt_dlp from <dir> ("" = sys.path)
+ *   --python-library <lib>  libpython to load for --python (default: search)
+ *   --zygote <python>  Use the zygote backend with this interpreter (--python adds a path)
+ *   --download <dir>   Download yt-dlp into <dir>, printing progress
+ *   --release-url <url>  Base URL of yt-dlp releases for downloads (e.g. a local mirror)
+ *   --daemon <endpoints>  Send resolves to prism_ytdlp_resolved daemons (comma-separated
+ *                      socket paths or tcp:host:port)
+ *   --soak <n>         Run n resolves that time out or leave helpers behind, then
+ *                      check that no processes or fds leaked (POSIX)
  */
 
 #include "prism_ytdlp_plugin.h"
@@ -41,8 +53,13 @@
         return (double)counter.QuadPart * 1000.0 / (double)freq.QuadPart;
     }
 #else
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <signal.h>
     #include <unistd.h>
+    #include <sys/stat.h>
     #include <sys/time.h>
+    #include <sys/wait.h>
     #define sleep_ms(ms) usleep((ms) * 1000)
 
     static double get_time_ms(void) {
@@ -57,6 +74,7 @@
  * ========================================================================== */
 
 #define MAX_TESTS 32
+#define MAX_BENCH_BINARIES 4
 #define DEFAULT_TIMEOUT_SEC 60
 #define PRISM_DEFAULT_QUALITY PRISM_QUALITY_AUTO
 
@@ -125,6 +143,7 @@ typedef struct TestResults {
     const char* name;
     TestResult result;
     double resolve_time_ms;
+    uint64_t allocations;
     char resolved_url[1024];
     char title[256];
     int width;
@@ -144,6 +163,17 @@ typedef struct Config {
     const char* category_filter;
     const char* test_filter;
     const char* direct_url;
+    int cache_bench_runs;
+    int spawn_bench_runs;
+    const char* binaries[MAX_BENCH_BINARIES];
+    int binary_count;
+    const char* python_path;
+    const char* python_library;
+    const char* python_executable;
+    const char* download_dir;
+    const char* release_url;
+    const char* daemon_endpoints;
+    int soak_runs;
 } Config;
 
 /* ============================================================================
@@ -312,6 +342,10 @@ static TestResults run_single_test(const TestCase* test, const Config* config) {
 
     results.resolve_time_ms = get_time_ms() - start_time;
 
+    PrismYtdlpStats stats;
+    prism_ytdlp_get_stats(&stats);
+    results.allocations = stats.last_resolve_allocations;
+
     if (!stream) {
         results.result = TEST_RESULT_FAIL;
         snprintf(results.error_message, sizeof(results.error_message),
@@ -354,6 +388,20 @@ static TestResults run_single_test(const TestCase* test, const Config* config) {
                    stream->direct_url,
                    strlen(stream->direct_url) > 100 ? "..." : "");
         }
+        if (stream->audio_url) {
+            printf("  [DEBUG] Audio URL: %.100s%s\n",
+                   stream->audio_url,
+                   strlen(stream->audio_url) > 100 ? "..." : "");
+        }
+        for (int i = 0; i < stream->header_count; i++) {
+            printf("  [DEBUG] Header: %s: %s\n", stream->header_names[i], stream->header_values[i]);
+        }
+        if (stream->cookies) {
+            printf("  [DEBUG] Cookies: %s\n", stream->cookies);
+        }
+        printf("  [DEBUG] Codecs: video=%s, audio=%s\n",
+               stream->video_codec ? stream->video_codec : "(none)",
+               stream->audio_codec ? stream->audio_codec : "(none)");
     }
 
     /* Validate results */
@@ -384,8 +432,9 @@ static void print_results_text(const TestResults* results) {
     printf("  [%s] %s", result_to_string(results->result), results->name);
 
     if (results->result == TEST_RESULT_PASS) {
-        printf(" (%.1fms, %dx%d, %s%s)\n",
+        printf(" (%.1fms, %llu allocs, %dx%d, %s%s)\n",
                results->resolve_time_ms,
+               (unsigned long long)results->allocations,
                results->width,
                results->height,
                results->is_live ? "LIVE" : "VOD",
@@ -403,6 +452,7 @@ static void print_results_json(const TestResults* results, bool last) {
     printf("      \"name\": \"%s\",\n", results->name);
     printf("      \"result\": \"%s\",\n", result_to_string(results->result));
     printf("      \"resolve_time_ms\": %.2f,\n", results->resolve_time_ms);
+    printf("      \"allocations\": %llu,\n", (unsigned long long)results->allocations);
     printf("      \"width\": %d,\n", results->width);
     printf("      \"height\": %d,\n", results->height);
     printf("      \"is_live\": %s,\n", results->is_live ? "true" : "false");
@@ -444,6 +494,17 @@ static void print_usage(const char* program) {
     printf("  --timeout <sec>    Set test timeout (default: %d)\n", DEFAULT_TIMEOUT_SEC);
     printf("  --verbose          Enable verbose logging\n");
     printf("  --json             Output results as JSON\n");
+    printf("  --cache-bench <n>  Time n resolves with a cold vs. warm yt-dlp cache directory\n");
+    printf("  --spawn-bench <n>  Time n yt-dlp launches of each --binary (default: detected path)\n");
+    printf("  --binary <path>    yt-dlp binary for --spawn-bench (repeatable)\n");
+    printf("  --python <dir>     Use the embedded Python backend with yt_dlp from <dir> (\"\" = sys.path)\n");
+    printf("  --python-library <lib>  libpython to load for --python (default: search)\n");
+    printf("  --zygote <python>  Use the zygote backend with this interpreter (--python adds a path)\n");
+    printf("  --download <dir>   Download yt-dlp into <dir>, printing progress\n");
+    printf("  --release-url <url>  Base URL of yt-dlp releases for downloads (e.g. a local mirror)\n");
+    printf("  --daemon <endpoints>  Send resolves to prism_ytdlp_resolved daemons (comma-separated\n");
+    printf("                     socket paths or tcp:host:port)\n");
+    printf("  --soak <n>         Run n resolves that time out or leave helpers behind, then check for leaks\n");
     printf("  --help             Show this help\n");
     printf("\n");
     printf("Examples:\n");
@@ -513,6 +574,46 @@ static Config parse_args(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 config.timeout_sec = atoi(argv[++i]);
             }
+        } else if (strcmp(argv[i], "--cache-bench") == 0) {
+            if (i + 1 < argc) {
+                config.cache_bench_runs = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--spawn-bench") == 0) {
+            if (i + 1 < argc) {
+                config.spawn_bench_runs = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--python") == 0) {
+            if (i + 1 < argc) {
+                config.python_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--python-library") == 0) {
+            if (i + 1 < argc) {
+                config.python_library = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--zygote") == 0) {
+            if (i + 1 < argc) {
+                config.python_executable = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--download") == 0) {
+            if (i + 1 < argc) {
+                config.download_dir = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--release-url") == 0) {
+            if (i + 1 < argc) {
+                config.release_url = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            if (i + 1 < argc) {
+                config.daemon_endpoints = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--soak") == 0) {
+            if (i + 1 < argc) {
+                config.soak_runs = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            if (i + 1 < argc && config.binary_count < MAX_BENCH_BINARIES) {
+                config.binaries[config.binary_count++] = argv[++i];
+            }
         } else if (argv[i][0] != '-') {
             if (strstr(argv[i], "://") != NULL) {
                 config.direct_url = argv[i];
@@ -548,6 +649,503 @@ static bool should_run_test(const TestCase* test, const Config* config) {
     return false;
 }
 
+/* ============================================================================
+ * Cache Directory Benchmark
+ * ========================================================================== */
+
+/* Backend selected by --zygote / --python */
+static PrismYtdlpBackend selected_backend(const Config* config) {
+    if (config->python_executable) return PRISM_YTDLP_BACKEND_ZYGOTE;
+    if (config->python_path) return PRISM_YTDLP_BACKEND_PYTHON;
+    return PRISM_YTDLP_BACKEND_PROCESS;
+}
+
+/* Point the plugin's yt-dlp cache at `dir`, keeping the detected binary and backend */
+static void use_cache_dir(const char* ytdlp_path, const char* dir, const Config* config) {
+    PrismYtdlpConfig ytdlp_config = {
+        .ytdlp_path = ytdlp_path,
+        .auto_download = true,
+        .process_timeout_ms = config->timeout_sec * 1000,
+        .cache_dir = dir,
+        .backend = selected_backend(config),
+        .python_library = config->python_library,
+        .python_path = config->python_path,
+        .python_executable = config->python_executable,
+        .release_url = config->release_url
+    };
+    prism_ytdlp_configure(&ytdlp_config);
+}
+
+/* One uncached resolve; returns its time in ms, or a negative value on failure */
+static double timed_resolve(const char* url, const Config* config) {
+    /* No resolver cache, so every resolve runs yt-dlp */
+    PrismYtdlpResolverConfig resolver_config = { .cache_capacity = -1 };
+    PrismResolver* resolver = prism_ytdlp_create_resolver(&resolver_config);
+    if (!resolver) return -1.0;
+
+    PrismResolverOptions options;
+    prism_resolver_options_init(&options);
+    options.timeout_ms = config->timeout_sec * 1000;
+    options.quality = (PrismStreamQuality)config->quality;
+
+    double start = get_time_ms();
+    PrismResolvedStream* stream = resolver->vtable->resolve(resolver, url, &options);
+    double elapsed = get_time_ms() - start;
+
+    bool ok = stream && stream->success;
+    if (!ok && config->verbose) {
+        printf("  [DEBUG] Resolve failed: %s\n", stream && stream->error ? stream->error : "unknown error");
+    }
+    free_resolved_stream(stream);
+    resolver->vtable->destroy(resolver);
+
+    return ok ? elapsed : -1.0;
+}
+
+/*
+ * Compare resolves that start from an empty yt-dlp cache directory (cold:
+ * YouTube player signature work is redone) with resolves sharing a primed one
+ * (warm). Each cold run gets a directory of its own.
+ */
+static int run_cache_benchmark(const Config* config) {
+    const char* url = config->direct_url ? config->direct_url : PRISM_TEST_YOUTUBE_VOD_SHORT;
+    int runs = config->cache_bench_runs;
+
+    const char* path = prism_ytdlp_get_path();
+    char ytdlp_path[1024] = {0};
+    if (path) {
+        strncpy(ytdlp_path, path, sizeof(ytdlp_path) - 1);
+    }
+
+#ifdef _WIN32
+    const char* tmp = getenv("TEMP");
+    if (!tmp) tmp = "C:\\Temp";
+    const char sep = '\\';
+#else
+    const char* tmp = getenv("TMPDIR");
+    if (!tmp) tmp = "/tmp";
+    const char sep = '/';
+#endif
+
+    char base[512];
+    snprintf(base, sizeof(base), "%s%cprism-cache-bench-%lld", tmp, sep, (long long)get_time_ms());
+
+    printf("\n=== yt-dlp Cache Directory Benchmark ===\n\n");
+    printf("URL:      %s\n", url);
+    printf("Runs:     %d\n", runs);
+    printf("Cache:    %s\n\n", base);
+
+    char dir[640];
+    double cold_total = 0.0, warm_total = 0.0;
+    int cold_ok = 0, warm_ok = 0;
+
+    for (int i = 0; i < runs; i++) {
+        snprintf(dir, sizeof(dir), "%s%ccold-%d", base, sep, i);
+        use_cache_dir(ytdlp_path[0] ? ytdlp_path : NULL, dir, config);
+        double ms = timed_resolve(url, config);
+        printf("  cold %2d: %8.1f ms%s\n", i + 1, ms < 0 ? 0.0 : ms, ms < 0 ? " (failed)" : "");
+        if (ms >= 0) {
+            cold_total += ms;
+            cold_ok++;
+        }
+    }
+
+    snprintf(dir, sizeof(dir), "%s%cwarm", base, sep);
+    use_cache_dir(ytdlp_path[0] ? ytdlp_path : NULL, dir, config);
+    timed_resolve(url, config);  /* Prime */
+
+    for (int i = 0; i < runs; i++) {
+        double ms = timed_resolve(url, config);
+        printf("  warm %2d: %8.1f ms%s\n", i + 1, ms < 0 ? 0.0 : ms, ms < 0 ? " (failed)" : "");
+        if (ms >= 0) {
+            warm_total += ms;
+            warm_ok++;
+        }
+    }
+
+    if (cold_ok == 0 || warm_ok == 0) {
+        printf("\nBenchmark failed: no successful %s resolves\n", cold_ok == 0 ? "cold" : "warm");
+        return 1;
+    }
+
+    double cold_avg = cold_total / cold_ok;
+    double warm_avg = warm_total / warm_ok;
+    printf("\nCold average: %.1f ms\n", cold_avg);
+    printf("Warm average: %.1f ms\n", warm_avg);
+    printf("Speedup:      %.2fx (%.1f ms saved per resolve)\n\n", cold_avg / warm_avg, cold_avg - warm_avg);
+    return 0;
+}
+
+/* ============================================================================
+ * Spawn Benchmark
+ * ========================================================================== */
+
+/*
+ * Time `yt-dlp --version` launches, which are dominated by process startup.
+ * Pass the onefile binary and the unpacked layout's executable as --binary to
+ * compare them; the first launch of each is reported separately because it
+ * includes cold page cache (and, for onefile builds, the first extraction).
+ */
+static int run_spawn_benchmark(const Config* config) {
+    int runs = config->spawn_bench_runs;
+    const char* binaries[MAX_BENCH_BINARIES];
+    int count = config->binary_count;
+
+    for (int i = 0; i < count; i++) {
+        binaries[i] = config->binaries[i];
+    }
+    if (count == 0) {
+        const char* path = prism_ytdlp_is_available() ? prism_ytdlp_get_path() : NULL;
+        if (!path) {
+            printf("\nBenchmark failed: yt-dlp not found\n");
+            return 1;
+        }
+        binaries[count++] = path;
+    }
+
+    printf("\n=== yt-dlp Spawn Benchmark ===\n\n");
+    printf("Runs:     %d\n\n", runs);
+
+    int failures = 0;
+    for (int b = 0; b < count; b++) {
+        PrismYtdlpResolverConfig resolver_config = {
+            .ytdlp_path = binaries[b],
+            .process_timeout_ms = config->timeout_sec * 1000
+        };
+        PrismResolver* resolver = prism_ytdlp_create_resolver(&resolver_config);
+        if (!resolver) return 1;
+
+        printf("%s\n", binaries[b]);
+
+        double start = get_time_ms();
+        const char* version = resolver->vtable->get_tool_version(resolver);
+        double first = get_time_ms() - start;
+        if (!version) {
+            printf("  failed to launch\n\n");
+            resolver->vtable->destroy(resolver);
+            failures++;
+            continue;
+        }
+
+        double total = 0.0, best = 0.0;
+        int ok = 0;
+        for (int i = 0; i < runs; i++) {
+            start = get_time_ms();
+            bool launched = resolver->vtable->get_tool_version(resolver) != NULL;
+            double ms = get_time_ms() - start;
+            if (!launched) continue;
+            total += ms;
+            if (ok == 0 || ms < best) best = ms;
+            ok++;
+        }
+        resolver->vtable->destroy(resolver);
+
+        printf("  version: %s\n", version);
+        printf("  first:   %8.1f ms\n", first);
+        if (ok > 0) {
+            printf("  average: %8.1f ms (best %.1f ms, %d/%d launches)\n\n", total / ok, best, ok, runs);
+        } else {
+            printf("  no successful launches\n\n");
+            failures++;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
+
+/* ============================================================================
+ * Download Test
+ * ========================================================================== */
+
+typedef struct DownloadProgress {
+    int calls;
+    int last_percent;
+} DownloadProgress;
+
+static void print_download_progress(float progress, void* user_data) {
+    DownloadProgress* state = (DownloadProgress*)user_data;
+    state->calls++;
+
+    int percent = (int)(progress * 100.0f);
+    if (percent != state->last_percent && (percent / 10 != state->last_percent / 10 || percent == 100)) {
+        printf("  %3d%%\n", percent);
+        fflush(stdout);
+    }
+    state->last_percent = percent;
+}
+
+/*
+ * Download yt-dlp into --download's directory. Point --release-url at a local
+ * server with latest/download/<asset> and SHA2-256SUMS to exercise resuming
+ * (drop the connection mid-transfer) and checksum failures.
+ */
+static int run_download_test(const Config* config) {
+    printf("\n=== yt-dlp Download ===\n\n");
+    printf("Directory: %s\n", config->download_dir);
+    printf("Releases:  %s\n\n", config->release_url ? config->release_url : "GitHub");
+
+    DownloadProgress state = { .calls = 0, .last_percent = -100 };
+    double start = get_time_ms();
+    PrismError err = prism_ytdlp_download(config->download_dir, print_download_progress, &state);
+    double elapsed = get_time_ms() - start;
+
+    printf("\nResult:    %s\n", err == PRISM_OK ? "ok" : "failed");
+    printf("Time:      %.1f ms\n", elapsed);
+    printf("Progress:  %d callbacks\n", state.calls);
+    if (err == PRISM_OK) {
+        printf("Path:      %s\n", prism_ytdlp_get_path());
+    }
+    printf("\n");
+    return err == PRISM_OK ? 0 : 1;
+}
+
+/* ============================================================================
+ * Process Soak Test
+ * ========================================================================== */
+
+#ifndef _WIN32
+
+/* Exported by the plugin for the host */
+void prism_plugin_shutdown(void);
+
+#define SOAK_SHUTDOWN_THREADS 4
+#define SOAK_RACE_THREADS 4
+
+/* Stand-in for yt-dlp: starts a helper the way yt-dlp starts ffmpeg, then
+ * either answers or hangs. Both pids are appended to <script>.pids. */
+static const char s_soak_script[] =
+    "#!/bin/sh\n"
+    "echo $$ >> \"$0.pids\"\n"
+    "sleep 60 >/dev/null 2>&1 &\n"
+    "echo $! >> \"$0.pids\"\n"
+    "case \"$*\" in\n"
+    "  *hang*) sleep 60 ;;\n"
+    "  *) echo '{\"title\": \"soak\", \"formats\": [{\"format_id\": \"18\", \"url\": \"https://cdn.invalid/18.mp4\", "
+    "\"protocol\": \"https\", \"vcodec\": \"avc1\", \"acodec\": \"mp4a.40.2\", \"height\": 360}]}' ;;\n"
+    "esac\n";
+
+typedef struct SoakResolve {
+    PrismResolver* resolver;
+    const char* url;
+    int timeout_ms;
+    bool success;
+    char error[128];
+    volatile int finished;
+} SoakResolve;
+
+static void* soak_resolve(void* arg) {
+    SoakResolve* job = (SoakResolve*)arg;
+
+    PrismResolverOptions options;
+    prism_resolver_options_init(&options);
+    options.timeout_ms = job->timeout_ms;
+
+    PrismResolvedStream* stream = job->resolver->vtable->resolve(job->resolver, job->url, &options);
+    job->success = stream && stream->success;
+    snprintf(job->error, sizeof(job->error), "%s", stream && stream->error ? stream->error : "");
+    prism_ytdlp_free_stream(stream);
+    __atomic_store_n(&job->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* Spawns answering resolves back to back until `stop`, so some start while
+ * a shutdown is in progress */
+typedef struct SoakRacer {
+    PrismResolver* resolver;
+    int index;
+    volatile int* stop;
+    int runs;
+    int failed;   /* Neither answered nor cancelled */
+} SoakRacer;
+
+static void* soak_race(void* arg) {
+    SoakRacer* racer = (SoakRacer*)arg;
+    while (!__atomic_load_n(racer->stop, __ATOMIC_ACQUIRE)) {
+        char url[96];
+        snprintf(url, sizeof(url), "https://www.youtube.com/watch?v=race%d-%d", racer->index, racer->runs);
+
+        SoakResolve job = { racer->resolver, url, 60000, false, "", 0 };
+        soak_resolve(&job);
+        racer->runs++;
+        if (!job.success && strcmp(job.error, "Process cancelled") != 0) racer->failed++;
+    }
+    return NULL;
+}
+
+static int count_open_fds(void) {
+    int count = 0;
+    for (int fd = 0; fd < 1024; fd++) {
+        if (fcntl(fd, F_GETFD) != -1) count++;
+    }
+    return count;
+}
+
+static bool process_running(pid_t pid) {
+    /* An exited child nobody reaped */
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == pid) return true;
+    if (kill(pid, 0) != 0) return false;
+
+#ifdef __linux__
+    /* Killed helpers belong to init, which in some containers never reaps */
+    char path[64], stat[256];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f) {
+        size_t n = fread(stat, 1, sizeof(stat) - 1, f);
+        fclose(f);
+        stat[n] = '\0';
+        const char* paren = strrchr(stat, ')');
+        if (paren && paren[1] == ' ' && paren[2] == 'Z') return false;
+    }
+#endif
+    return true;
+}
+
+/*
+ * Run resolves against a stand-in yt-dlp that starts a helper process: every
+ * third one hangs until its deadline, the rest answer and leave the helper
+ * running. Then hang a few resolves on threads and shut the plugin down under
+ * them while other threads keep starting resolves, so some spawns race the
+ * shutdown. Shutdown must not return before the hung resolves have reaped
+ * their children. Afterwards no stand-in or helper may be alive or unreaped,
+ * and the number of open fds must be what it was.
+ */
+static int run_soak_test(const Config* config) {
+    printf("\n=== Process Soak ===\n\n");
+
+    char dir[] = "/tmp/prism-soak-XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("Soak failed: cannot create a temporary directory\n");
+        return 1;
+    }
+
+    char script[64], pids[80];
+    snprintf(script, sizeof(script), "%s/yt-dlp", dir);
+    snprintf(pids, sizeof(pids), "%s.pids", script);
+
+    FILE* f = fopen(script, "w");
+    if (!f || fputs(s_soak_script, f) < 0 || fclose(f) != 0 || chmod(script, 0755) != 0) {
+        printf("Soak failed: cannot write %s\n", script);
+        return 1;
+    }
+
+    PrismYtdlpResolverConfig resolver_config = {
+        .ytdlp_path = script,
+        .cache_capacity = -1
+    };
+    PrismResolver* resolver = prism_ytdlp_create_resolver(&resolver_config);
+    if (!resolver) return 1;
+
+    int fds_before = count_open_fds();
+    int answered = 0, timed_out = 0;
+    double start = get_time_ms();
+
+    for (int i = 0; i < config->soak_runs; i++) {
+        char url[128];
+        bool hang = i % 3 == 2;
+        snprintf(url, sizeof(url), "https://www.youtube.com/watch?v=%s%d", hang ? "hang" : "soak", i);
+
+        SoakResolve job = { resolver, url, 300, false, "", 0 };
+        soak_resolve(&job);
+        if (job.success) answered++;
+        else if (hang && strcmp(job.error, "Process timed out") == 0) timed_out++;
+        else printf("  resolve %d: %s\n", i, job.error[0] ? job.error : "failed");
+    }
+
+    printf("Resolves:  %d (%d answered, %d timed out) in %.1f ms\n",
+           config->soak_runs, answered, timed_out, get_time_ms() - start);
+
+    /* Shutdown kills and reaps children still running */
+    pthread_t threads[SOAK_SHUTDOWN_THREADS];
+    SoakResolve jobs[SOAK_SHUTDOWN_THREADS];
+    char urls[SOAK_SHUTDOWN_THREADS][64];
+    int started = 0;
+    for (int i = 0; i < SOAK_SHUTDOWN_THREADS; i++) {
+        snprintf(urls[i], sizeof(urls[i]), "https://www.youtube.com/watch?v=hang-shutdown%d", i);
+        jobs[i] = (SoakResolve){ resolver, urls[i], 60000, false, "", 0 };
+        if (pthread_create(&threads[i], NULL, soak_resolve, &jobs[i]) == 0) started++;
+        else break;
+    }
+
+    pthread_t race_threads[SOAK_RACE_THREADS];
+    SoakRacer racers[SOAK_RACE_THREADS];
+    volatile int stop = 0;
+    int racing = 0;
+    for (int i = 0; i < SOAK_RACE_THREADS; i++) {
+        racers[i] = (SoakRacer){ resolver, i, &stop, 0, 0 };
+        if (pthread_create(&race_threads[i], NULL, soak_race, &racers[i]) == 0) racing++;
+        else break;
+    }
+    sleep_ms(500);
+
+    start = get_time_ms();
+    prism_plugin_shutdown();
+    int unreaped = 0;
+    for (int i = 0; i < started; i++) {
+        if (!__atomic_load_n(&jobs[i].finished, __ATOMIC_ACQUIRE)) unreaped++;
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+
+    int cancelled = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (strcmp(jobs[i].error, "Process cancelled") == 0) cancelled++;
+    }
+    int raced = 0, race_failed = 0;
+    for (int i = 0; i < racing; i++) {
+        pthread_join(race_threads[i], NULL);
+        raced += racers[i].runs;
+        race_failed += racers[i].failed;
+    }
+    printf("Shutdown:  %d/%d hung resolves cancelled in %.1f ms, %d still running when it returned\n",
+           cancelled, started, get_time_ms() - start, unreaped);
+    printf("Racing:    %d resolves started around the shutdown, %d failed\n", raced, race_failed);
+
+    resolver->vtable->destroy(resolver);
+
+    /* Give init a moment to reap the helpers it inherited */
+    sleep_ms(200);
+
+    int spawned = 0, leaked = 0;
+    f = fopen(pids, "r");
+    if (f) {
+        int pid;
+        while (fscanf(f, "%d", &pid) == 1) {
+            spawned++;
+            if (process_running((pid_t)pid)) {
+                printf("  leaked process %d\n", pid);
+                kill((pid_t)pid, SIGKILL);
+                leaked++;
+            }
+        }
+        fclose(f);
+    }
+    int fds_after = count_open_fds();
+
+    printf("Processes: %d started, %d leaked\n", spawned, leaked);
+    printf("Open fds:  %d before, %d after\n\n", fds_before, fds_after);
+
+    remove(pids);
+    remove(script);
+    rmdir(dir);
+
+    bool ok = leaked == 0 && fds_after == fds_before && cancelled == started && unreaped == 0 &&
+              race_failed == 0 && answered + timed_out == config->soak_runs;
+    printf("Result:    %s\n\n", ok ? "ok" : "failed");
+    return ok ? 0 : 1;
+}
+
+#else
+
+static int run_soak_test(const Config* config) {
+    (void)config;
+    printf("\nThe soak test needs a POSIX shell\n");
+    return 2;
+}
+
+#endif
+
 /* ============================================================================
  * Main
  * ========================================================================== */
@@ -560,6 +1158,35 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    if (selected_backend(&config) != PRISM_YTDLP_BACKEND_PROCESS || config.release_url || config.daemon_endpoints) {
+        PrismYtdlpConfig ytdlp_config = {
+            .auto_download = true,
+            .backend = selected_backend(&config),
+            .python_library = config.python_library,
+            .python_path = config.python_path,
+            .python_executable = config.python_executable,
+            .release_url = config.release_url,
+            .daemon_endpoints = config.daemon_endpoints
+        };
+        prism_ytdlp_configure(&ytdlp_config);
+    }
+
+    if (config.download_dir) {
+        return run_download_test(&config);
+    }
+
+    if (config.cache_bench_runs > 0) {
+        return run_cache_benchmark(&config);
+    }
+
+    if (config.spawn_bench_runs > 0) {
+        return run_spawn_benchmark(&config);
+    }
+
+    if (config.soak_runs > 0) {
+        return run_soak_test(&config);
+    }
+
     if (!config.run_all && !config.category_filter && !config.test_filter && !config.direct_url) {
         print_usage(argv[0]);
         return 2;
@@ -580,7 +1207,6 @@ int main(int argc, char* argv[]) {
             config.quality == 1080 ? "1080p" : "custom"));
     printf("\n");
 
-    TestResults all_results[MAX_TESTS];
     int test_count = 0;
     int passed = 0, failed = 0, skipped = 0, timeout = 0;
     double total_start = get_time_ms();
@@ -610,7 +1236,7 @@ int main(int argc, char* argv[]) {
         }
 
         TestResults results = run_single_test(&direct_test, &config);
-        all_results[test_count++] = results;
+        test_count++;
 
         switch (results.result) {
             case TEST_RESULT_PASS:    passed++; break;
@@ -641,7 +1267,7 @@ int main(int argc, char* argv[]) {
             }
 
             TestResults results = run_single_test(&g_test_cases[i], &config);
-            all_results[test_count++] = results;
+            test_count++;
 
             switch (results.result) {
                 case TEST_RESULT_PASS:    passed++; break;
@@ -0,0 +1,356 @@
+/*
+ * Prism yt-dlp Plugin - Shared Cache Tests
+ *
+ * Round trips through a shared memory segment mapped twice, then a stress
+ * run: several processes read and overwrite a small set of keys at once,
+ * with entries sized so the table is full and keeps evicting. Every entry
+ * a reader gets back must be one some writer stored whole; a torn or mixed
+ * entry fails the run. Segments whose creator died before sizing or laying
+ * them out must be replaced rather than leave the cache off.
+ *
+ * Usage:
+ *   ytdlp_shmcache_tests [--verbose] [--processes <n>] [--seconds <n>]
+ */
+
+#include "ytdlp_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+/* The library's counters live in the resolver, which is not linked in */
+YtdlpStats g_ytdlp_stats = {0};
+
+static bool g_verbose = false;
+
+#define STRESS_KEYS 48
+#define STRESS_SLOTS_MB 4          /* About 32 slots, fewer than the keys */
+#define STRESS_TTL_MS 250
+
+/* ============================================================================
+ * Entries
+ *
+ * Each write of key `k` is generation `g` of it: the title, the page URL
+ * and every format URL say which, and the ladder length depends on both,
+ * so any mix of two writes is detectable.
+ * ========================================================================== */
+
+static int format_count(int key, int generation) {
+    return 1 + (key * 7 + generation * 3) % 40;
+}
+
+static YtdlpMediaInfo* make_info(YtdlpArena* arena, int key, int generation) {
+    int count = format_count(key, generation);
+    size_t size = 256 + (size_t)count * 512;
+    char* json = (char*)ytdlp_arena_alloc(arena, size);
+    if (!json) return NULL;
+
+    int n = snprintf(json, size,
+        "{\"title\":\"key-%d-gen-%d\",\"webpage_url\":\"https://example.com/%d/%d\",\"formats\":[",
+        key, generation, key, generation);
+    for (int i = 0; i < count; i++) {
+        n += snprintf(json + n, size - (size_t)n,
+            "%s{\"format_id\":\"f%d\",\"url\":\"https://cdn.example.com/%d/%d/%d?expire=4102444800\","
+            "\"ext\":\"mp4\",\"height\":%d,\"http_headers\":{\"X-Key\":\"%d\",\"X-Gen\":\"%d\"}}",
+            i ? "," : "", i, key, generation, i, 144 + i, key, generation);
+    }
+    snprintf(json + n, size - (size_t)n, "]}");
+
+    YtdlpJson* root = ytdlp_json_parse(arena, json);
+    return root ? ytdlp_media_info_from_json(root) : NULL;
+}
+
+/* True if `info` is exactly what make_info(key, g) built for some g */
+static bool info_is_whole(const YtdlpMediaInfo* info, int key) {
+    int k = -1, generation = -1;
+    if (!info->list.title || sscanf(info->list.title, "key-%d-gen-%d", &k, &generation) != 2 || k != key) {
+        return false;
+    }
+    if (info->list.count != format_count(key, generation)) return false;
+
+    char expected[128];
+    snprintf(expected, sizeof(expected), "https://example.com/%d/%d", key, generation);
+    if (!info->list.original_url || strcmp(info->list.original_url, expected) != 0) return false;
+
+    for (int i = 0; i < info->list.count; i++) {
+        const PrismYtdlpFormat* f = &info->list.formats[i];
+        snprintf(expected, sizeof(expected), "https://cdn.example.com/%d/%d/%d?expire=4102444800", key, generation, i);
+        if (!f->url || strcmp(f->url, expected) != 0 || f->height != 144 + i || f->header_count != 2) return false;
+
+        char value[16];
+        snprintf(value, sizeof(value), "%d", generation);
+        if (strcmp(f->header_names[1], "X-Gen") != 0 || strcmp(f->header_values[1], value) != 0) return false;
+    }
+    return true;
+}
+
+static void key_name(char* buf, size_t size, int key) {
+    snprintf(buf, size, "en|https://example.com/watch/%d", key);
+}
+
+/* ============================================================================
+ * Round Trips
+ * ========================================================================== */
+
+static int g_total = 0;
+static int g_passed = 0;
+
+static void check(bool pass, const char* name) {
+    g_total++;
+    if (pass) g_passed++;
+    if (!pass || g_verbose) printf("  [%s] %s\n", pass ? "PASS" : "FAIL", name);
+}
+
+static void run_round_trips(const char* name) {
+    YtdlpArena arena = {0};
+    YtdlpSharedCache* a = ytdlp_shared_cache_open(name, STRESS_SLOTS_MB * 1024 * 1024, 60000);
+    YtdlpSharedCache* b = ytdlp_shared_cache_open(name, STRESS_SLOTS_MB * 1024 * 1024, 60000);
+    check(a && b, "segment maps twice");
+    if (!a || !b) return;
+
+    char key[128];
+    key_name(key, sizeof(key), 1);
+    YtdlpMediaInfo* info = make_info(&arena, 1, 7);
+    ytdlp_shared_cache_put(a, key, info, 0);
+
+    int ttl_ms = 0;
+    const YtdlpMediaInfo* copy = ytdlp_shared_cache_get(b, key, &ttl_ms);
+    check(copy && copy != info && info_is_whole(copy, 1), "media info reads back through another mapping");
+    check(ttl_ms > 59000 && ttl_ms <= 60000, "time left is reported");
+    ytdlp_media_info_release(copy);
+
+    key_name(key, sizeof(key), 2);
+    check(ytdlp_shared_cache_get(b, key, NULL) == NULL, "missing key misses");
+
+    char error[64] = "";
+    ytdlp_shared_cache_put_failure(a, key, "ERROR: Private video", 0);
+    check(ytdlp_shared_cache_get_failure(b, key, error, sizeof(error)) && strcmp(error, "ERROR: Private video") == 0,
+          "failure reads back");
+    check(ytdlp_shared_cache_get(b, key, NULL) == NULL, "failure is not media info");
+
+    ytdlp_shared_cache_put(a, key, info, 0);
+    copy = ytdlp_shared_cache_get(b, key, NULL);
+    check(copy != NULL && !ytdlp_shared_cache_get_failure(b, key, error, sizeof(error)),
+          "media info replaces a failure");
+    ytdlp_media_info_release(copy);
+
+    key_name(key, sizeof(key), 3);
+    ytdlp_shared_cache_put(a, key, info, 30);
+    ytdlp_sleep_ms(60);
+    check(ytdlp_shared_cache_get(b, key, NULL) == NULL, "entries expire");
+
+    ytdlp_media_info_release(info);
+    ytdlp_shared_cache_close(a);
+    ytdlp_shared_cache_close(b);
+}
+
+/* ============================================================================
+ * Stale Segments
+ * ========================================================================== */
+
+#ifndef _WIN32
+
+/* Leave `segment` as a creator that died after `size` bytes of ftruncate
+ * (0 = before it) and before laying it out would */
+static bool make_stale_segment(const char* segment, size_t size) {
+    shm_unlink(segment);
+    int fd = shm_open(segment, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return false;
+    bool ok = size == 0 || ftruncate(fd, (off_t)size) == 0;
+    close(fd);
+    return ok;
+}
+
+static void run_stale_segments(const char* name, const char* segment) {
+    static const struct { size_t size; const char* what; } cases[] = {
+        { 0, "a segment its creator never sized is replaced" },
+        { STRESS_SLOTS_MB * 1024 * 1024, "a segment its creator never laid out is replaced" },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (!make_stale_segment(segment, cases[i].size)) {
+            check(false, "stale segment is set up");
+            continue;
+        }
+
+        YtdlpArena arena = {0};
+        YtdlpSharedCache* a = ytdlp_shared_cache_open(name, STRESS_SLOTS_MB * 1024 * 1024, 60000);
+        YtdlpSharedCache* b = ytdlp_shared_cache_open(name, STRESS_SLOTS_MB * 1024 * 1024, 60000);
+        bool shared = false;
+        if (a && b) {
+            char key[128];
+            key_name(key, sizeof(key), 1);
+            YtdlpMediaInfo* info = make_info(&arena, 1, 3);
+            ytdlp_shared_cache_put(a, key, info, 0);
+            const YtdlpMediaInfo* copy = ytdlp_shared_cache_get(b, key, NULL);
+            shared = copy && info_is_whole(copy, 1);
+            ytdlp_media_info_release(copy);
+            ytdlp_media_info_release(info);
+        }
+        check(shared, cases[i].what);
+
+        ytdlp_shared_cache_close(a);
+        ytdlp_shared_cache_close(b);
+        shm_unlink(segment);
+    }
+}
+
+#endif
+
+/* ============================================================================
+ * Stress
+ * ========================================================================== */
+
+#ifndef _WIN32
+
+typedef struct StressCounts {
+    unsigned long reads;
+    unsigned long hits;
+    unsigned long writes;
+    unsigned long torn;
+} StressCounts;
+
+static void stress_child(const char* name, int index, int seconds, StressCounts* out) {
+    YtdlpArena arena = {0};
+    YtdlpSharedCache* cache = ytdlp_shared_cache_open(name, STRESS_SLOTS_MB * 1024 * 1024, STRESS_TTL_MS);
+    if (!cache) {
+        out->torn = 1;
+        return;
+    }
+
+    unsigned int seed = 2166136261u ^ (unsigned int)index * 16777619u;
+    uint64_t end = ytdlp_monotonic_ms() + (uint64_t)seconds * 1000u;
+    int generation = index * 1000000;
+    char key[128];
+    char error[64];
+
+    while (ytdlp_monotonic_ms() < end) {
+        seed = seed * 1103515245u + 12345u;
+        int k = (int)((seed >> 8) % STRESS_KEYS);
+        int op = (int)((seed >> 20) % 10);
+        key_name(key, sizeof(key), k);
+
+        if (op < 2) {
+            YtdlpArenaMark mark = ytdlp_arena_mark(&arena);
+            YtdlpMediaInfo* info = make_info(&arena, k, generation++);
+            ytdlp_arena_release(&arena, mark);
+            ytdlp_shared_cache_put(cache, key, info, 0);
+            ytdlp_media_info_release(info);
+            out->writes++;
+        } else if (op < 3 && k % 4 == 0) {
+            snprintf(error, sizeof(error), "ERROR: key %d failed", k);
+            ytdlp_shared_cache_put_failure(cache, key, error, 0);
+            out->writes++;
+        } else {
+            out->reads++;
+            const YtdlpMediaInfo* info = ytdlp_shared_cache_get(cache, key, NULL);
+            if (info) {
+                out->hits++;
+                if (!info_is_whole(info, k)) out->torn++;
+                ytdlp_media_info_release(info);
+            } else if (ytdlp_shared_cache_get_failure(cache, key, error, sizeof(error))) {
+                out->hits++;
+                int got = -1;
+                if (sscanf(error, "ERROR: key %d failed", &got) != 1 || got != k) out->torn++;
+            }
+        }
+    }
+
+    ytdlp_shared_cache_close(cache);
+}
+
+static void run_stress(const char* name, int processes, int seconds) {
+    StressCounts* counts = (StressCounts*)mmap(NULL, sizeof(StressCounts) * (size_t)processes,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counts == MAP_FAILED) {
+        check(false, "stress counters map");
+        return;
+    }
+    memset(counts, 0, sizeof(StressCounts) * (size_t)processes);
+
+    for (int i = 0; i < processes; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            stress_child(name, i, seconds, &counts[i]);
+            _exit(0);
+        }
+    }
+
+    bool exited = true;
+    for (int i = 0; i < processes; i++) {
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) exited = false;
+    }
+
+    StressCounts total = {0, 0, 0, 0};
+    for (int i = 0; i < processes; i++) {
+        total.reads += counts[i].reads;
+        total.hits += counts[i].hits;
+        total.writes += counts[i].writes;
+        total.torn += counts[i].torn;
+    }
+    munmap(counts, sizeof(StressCounts) * (size_t)processes);
+
+    printf("  %d processes, %ds: %lu reads (%lu hits), %lu writes, %lu torn\n",
+        processes, seconds, total.reads, total.hits, total.writes, total.torn);
+
+    check(exited, "stress processes exit cleanly");
+    check(total.hits > 0 && total.writes > 0, "stress reads hit entries written by other processes");
+    check(total.torn == 0, "no torn or mixed entries");
+}
+
+#endif
+
+int main(int argc, char* argv[]) {
+    int processes = 8;
+    int seconds = 2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            g_verbose = true;
+        } else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+            processes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        }
+    }
+
+#ifdef _WIN32
+    (void)processes;
+    (void)seconds;
+    printf("Shared cache tests need fork(); skipped\n");
+    return 0;
+#else
+    /* A segment of this run's own, removed again at the end */
+    char name[64];
+    char segment[96];
+    snprintf(name, sizeof(name), "test-%ld", (long)getpid());
+    ytdlp_shared_cache_segment(name, segment, sizeof(segment));
+
+    printf("=== Round Trips ===\n");
+    run_round_trips(name);
+    shm_unlink(segment);
+
+    printf("=== Stale Segments ===\n");
+    run_stale_segments(name, segment);
+
+    printf("=== Stress ===\n");
+    run_stress(name, processes, seconds);
+    shm_unlink(segment);
+
+    printf("\n=== Test Summary ===\n");
+    printf("  Total:   %d\n", g_total);
+    printf("  Passed:  %d\n", g_passed);
+    printf("  Failed:  %d\n", g_total - g_passed);
+
+    return g_passed == g_total ? 0 : 1;
+#endif
+}